@@ -693,6 +693,8 @@ static struct omap_musb_board_data musb_board_data = {
 	.mode			= MUSB_OTG,
 #endif
 	.power			= 100,
+	.bulk_double_buffer	= 1,
+	.bulk_rx_dma_mode1	= 1,
 };
 
 static struct twl4030_usb_data omap4_usbphy_data = {
@@ -1677,7 +1679,10 @@ static int notle_translate_temp(int temperature)
 }
 
 /* Gas gauge board specific configuration filled in at board init */
-static struct bq27x00_platform_data notle_gasgauge_platform_data;
+static struct bq27x00_platform_data notle_gasgauge_platform_data = {
+	.soc_int_gpio = -1,
+	.bat_low_gpio = -1,
+};
 
 static struct i2c_board_info __initdata notle_i2c_1_boardinfo[] = {
 #ifdef CONFIG_BATTERY_BQ27x00
@@ -1962,6 +1967,10 @@ static int __init notle_i2c_init(void)
 
 			case V1_EVT2:
 				notle_gasgauge_platform_data.translate_temp = notle_translate_temp;
+				notle_gasgauge_platform_data.soc_int_gpio =
+					notle_get_gpio(GPIO_SOC_INT_INDEX);
+				notle_gasgauge_platform_data.bat_low_gpio =
+					notle_get_gpio(GPIO_BAT_LOW_INDEX);
 
 				notle_charger_data.supplied_to = notle_charger_supplicants_evt2;
 				notle_charger_data.num_supplicants =
@@ -1976,6 +1985,10 @@ static int __init notle_i2c_init(void)
                         case V1_DVT1:
                         default:
 				notle_gasgauge_platform_data.translate_temp = NULL;
+				notle_gasgauge_platform_data.soc_int_gpio =
+					notle_get_gpio(GPIO_SOC_INT_INDEX);
+				notle_gasgauge_platform_data.bat_low_gpio =
+					notle_get_gpio(GPIO_BAT_LOW_INDEX);
 
 				notle_charger_data.supplied_to = notle_charger_supplicants_evt2;
 				notle_charger_data.num_supplicants =
@@ -177,4 +177,8 @@ struct uart_omap_port {
 
 int omap_serial_ext_uart_enable(u8 port_id);
 int omap_serial_ext_uart_disable(u8 port_id);
+
+struct notifier_block;
+int omap_serial_register_rx_notifier(struct notifier_block *nb);
+int omap_serial_unregister_rx_notifier(struct notifier_block *nb);
 #endif /* __OMAP_SERIAL_H__ */
@@ -100,6 +100,8 @@ struct omap_musb_board_data {
 	u8	mode;
 	u16	power;
 	unsigned extvbus:1;
+	unsigned bulk_double_buffer:1;	/* double-buffer bulk ep1..ep5 FIFOs */
+	unsigned bulk_rx_dma_mode1:1;	/* Inventra DMA mode 1 for bulk OUT */
 	void	(*set_phy_power)(u8 on);
 	void	(*clear_irq)(void);
 	void	(*set_mode)(u8 mode);
@@ -13,15 +13,19 @@
 #include <linux/earlysuspend.h>
 #include <linux/fs.h>
 #include <linux/gpio.h>
-#include <linux/irq.h>
-#include <linux/irqdesc.h>
-#include <linux/kernel_stat.h>
+#include <linux/hrtimer.h>
+#include <linux/interrupt.h>
+#include <linux/notifier.h>
 #include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/sysfs.h>
+
+#include <plat/omap-serial.h>
 
 #define GPS_ELTON_DRVNAME "gps_elton"
 
-/* EVT 1.x */
-#define OMAP_UART3_NAME "OMAP UART3"
+/* EVT 1.x, ttyO3 */
+#define GPS_ELTON_UART_PORT 3
 
 #define GPS_STATE_AWAKE 1
 #define GPS_STATE_HIBERNATE 0
@@ -50,13 +54,21 @@ struct gps_elton_data_s {
 	 * EVT2 uses a direct line from the GPS chip to indicate awake.
 	 */
 	int is_awake;
+	// Protects is_awake and last_rx against the uart notifier and timer.
+	spinlock_t state_lock;
+
+	// EVT1.x Marks the chip awake when it sends data on the uart.
+	struct notifier_block uart_nb;
+	// EVT1.x Marks the chip hibernating once the uart has gone quiet.
+	struct hrtimer idle_timer;
+	// EVT1.x Jiffies at which data was last received from the chip.
+	unsigned long last_rx;
+
+	// EVT2 Interrupt on the awake line, -1 if not requested.
+	int awake_irq;
 
-	// EVT1.x Workqueue check to poll for uart interrupts.
-	struct delayed_work work_check;
-	// EXT1.x Number of uart interrupts to infer if GPS is awake or not.
-	atomic_t uart_int_cnt;
-	// EVT1.x Used to read irq statistics to determine if chip is awake.
-	int irq_num;
+	// Sysfs node of the awake attribute, notified on every state change.
+	struct sysfs_dirent *awake_sd;
 };
 
 /* kernel/timer.c */
@@ -66,8 +78,9 @@ extern void msleep(unsigned int msecs);
 static const int wait_between_power_toggle_in_ms = 50;
 
 /* Only for EVT1.x */
-/* Time to wait between running workqueue to check for uart interrupts. */
-static const int wait_between_check_uart_ints_in_ms = 5000;
+/* Uart silence after which the chip is taken to be hibernating.  While
+ * awake it reports at least once a second. */
+static const int idle_before_hibernate_in_ms = 5000;
 
 /* NOTE(CMM) Not sure if we are supposed to hibernate during early suspend or not. */
 static int hibernate_during_early_suspend = 0;
@@ -84,21 +97,10 @@ static ssize_t gps_elton_awake_store(struct device *dev,
                                      struct device_attribute *attr,
                                      const char *buf, size_t count);
 
-static ssize_t gps_elton_int_offset_show(struct device *dev,
-                                    struct device_attribute *attr, char *buf);
-
-// Set the wake state of the GPS chip.
-static ssize_t gps_elton_int_offset_store(struct device *dev,
-                                     struct device_attribute *attr,
-                                     const char *buf, size_t count);
-
 static struct device_attribute attrs[] = {
 	__ATTR(awake, 0666,
 	       gps_elton_awake_show,
 	       gps_elton_awake_store),
-	__ATTR(int_offset, 0666,
-	       gps_elton_int_offset_show,
-	       gps_elton_int_offset_store),
 };
 
 // Determines if device is EVT 1.x or not.
@@ -106,67 +108,111 @@ static int _is_evt_1_x(struct gps_elton_data_s *gps_elton_data) {
 	return gps_elton_data->platform_data->gpio_awake == GPIO_PIN_UNCONNECTED;
 }
 
-// EVT 1.x only
-static int _get_irq_num(const char *irq_name) {
-	unsigned int irq;
-	struct irq_desc *desc;
+// Wakes up pollers of the awake attribute.  Safe in interrupt context.
+static void _notify_awake(struct gps_elton_data_s *gps_elton_data)
+{
+	if (gps_elton_data->awake_sd)
+		sysfs_notify_dirent(gps_elton_data->awake_sd);
+}
+
+static ktime_t _ms_to_ktime(int ms)
+{
+	return ktime_set(ms / MSEC_PER_SEC, (ms % MSEC_PER_SEC) * NSEC_PER_MSEC);
+}
+
+// Records the state the driver believes the chip is in.  On EVT 1.x the
+// idle timer runs while the chip is believed awake.
+static void _set_state(struct gps_elton_data_s *gps_elton_data, int state)
+{
+	unsigned long flags;
+	int changed;
 
-	for_each_irq_desc(irq,  desc) {
-		if (desc && desc->action && desc->action->name && !strcmp(desc->action->name, irq_name)) {
-			return (int)irq;
+	spin_lock_irqsave(&gps_elton_data->state_lock, flags);
+	changed = gps_elton_data->is_awake != state;
+	gps_elton_data->is_awake = state;
+	if (_is_evt_1_x(gps_elton_data)) {
+		if (state == GPS_STATE_AWAKE) {
+			gps_elton_data->last_rx = jiffies;
+			// A running callback re-arms itself from last_rx, and
+			// starting it underneath one that then returns
+			// HRTIMER_RESTART would hit the BUG_ON in __run_hrtimer.
+			if (!hrtimer_active(&gps_elton_data->idle_timer))
+				hrtimer_start(&gps_elton_data->idle_timer,
+				              _ms_to_ktime(idle_before_hibernate_in_ms),
+				              HRTIMER_MODE_REL);
+		} else {
+			// A running callback sees the new state and stops.
+			hrtimer_try_to_cancel(&gps_elton_data->idle_timer);
 		}
 	}
-	return -1;
+	spin_unlock_irqrestore(&gps_elton_data->state_lock, flags);
+
+	if (changed)
+		_notify_awake(gps_elton_data);
 }
 
 // EVT 1.x only
-// Critical failure of this approach is that we can't determine
-// transmit versus receive interrupts.
-static int _get_interrupt_count(int irq_num) {
-	int cpu_id;
-	int uart_int_cnt = 0;
-
-	for_each_online_cpu(cpu_id)
-		uart_int_cnt += kstat_irqs_cpu(irq_num, cpu_id);
+// Called from the uart interrupt.  Only received data counts, so commands
+// sent to a hibernating chip do not make it look awake.
+static int gps_elton_uart_rx_notify(struct notifier_block *nb,
+                                    unsigned long port, void *data)
+{
+	struct gps_elton_data_s *gps_elton_data = container_of(nb, struct gps_elton_data_s, uart_nb);
+
+	if (port != GPS_ELTON_UART_PORT)
+		return NOTIFY_DONE;
+
+	gps_elton_data->last_rx = jiffies;
+	if (gps_elton_data->is_awake != GPS_STATE_AWAKE) {
+		dev_info(&gps_elton_data->pdev->dev, "EVT 1.x Device was determined to be awake\n");
+		_set_state(gps_elton_data, GPS_STATE_AWAKE);
+	} else if (!hrtimer_active(&gps_elton_data->idle_timer)) {
+		// A callback that had already given up when the chip woke
+		// left no timer behind.
+		_set_state(gps_elton_data, GPS_STATE_AWAKE);
+	}
 
-	return uart_int_cnt;
+	return NOTIFY_OK;
 }
 
 // EVT 1.x only
-static void gps_elton_work_task(struct work_struct *work)
+// Rather than being restarted on every uart interrupt, the timer checks
+// how long the uart has been quiet when it expires and waits out the rest.
+static enum hrtimer_restart gps_elton_idle_timer_func(struct hrtimer *timer)
 {
-	struct delayed_work *dw = to_delayed_work(work);
-	struct gps_elton_data_s *gps_elton_data = container_of(dw, struct gps_elton_data_s, work_check);
-	int uart_int_cnt_curr;
-	int uart_int_cnt_last;
-
-	if (-1 == gps_elton_data->irq_num) {
-		dev_err(&gps_elton_data->pdev->dev,
-		        "%s Unable to determine omap uart3 interrupt; aborting check for GPS awake\n",
-		        __func__);
-		return;
+	struct gps_elton_data_s *gps_elton_data = container_of(timer, struct gps_elton_data_s, idle_timer);
+	unsigned long idle = msecs_to_jiffies(idle_before_hibernate_in_ms);
+	unsigned long since_rx;
+	enum hrtimer_restart ret = HRTIMER_NORESTART;
+	int changed = 0;
+
+	spin_lock(&gps_elton_data->state_lock);
+	if (gps_elton_data->is_awake == GPS_STATE_AWAKE) {
+		since_rx = jiffies - gps_elton_data->last_rx;
+		if (since_rx < idle) {
+			hrtimer_forward_now(timer,
+			                    _ms_to_ktime(jiffies_to_msecs(idle - since_rx)));
+			ret = HRTIMER_RESTART;
+		} else {
+			gps_elton_data->is_awake = GPS_STATE_HIBERNATE;
+			changed = 1;
+		}
 	}
+	spin_unlock(&gps_elton_data->state_lock);
 
-	// If the interrupt count hasn't changed since last time, assume we are off.
-	// Need to make sure the polling time is long enough to allow interrupts to change
-	// in between.
-	uart_int_cnt_curr = _get_interrupt_count(gps_elton_data->irq_num);
-	uart_int_cnt_last = atomic_read(&gps_elton_data->uart_int_cnt);
-	if (uart_int_cnt_last >= uart_int_cnt_curr) {
-		dev_info(&gps_elton_data->pdev->dev, "EVT 1.x Device was determined to be in hibernation last_cnt:%d curr_cnt:%d\n",
-		         uart_int_cnt_last, uart_int_cnt_curr);
-		gps_elton_data->is_awake = GPS_STATE_HIBERNATE;
-	} else {
-		dev_info(&gps_elton_data->pdev->dev, "EVT 1.x Device was determined to be awake last_cnt:%d curr_cnt:%d\n",
-		         uart_int_cnt_last, uart_int_cnt_curr);
-		gps_elton_data->is_awake = GPS_STATE_AWAKE;
-		// Update the uart interrupt count for next time.
-		atomic_set(&gps_elton_data->uart_int_cnt, uart_int_cnt_curr);
+	if (changed) {
+		dev_info(&gps_elton_data->pdev->dev, "EVT 1.x Device was determined to be in hibernation\n");
+		_notify_awake(gps_elton_data);
 	}
 
-	// Put us back on the work queue.
-	schedule_delayed_work(&gps_elton_data->work_check,
-	                      msecs_to_jiffies(wait_between_check_uart_ints_in_ms));
+	return ret;
+}
+
+// EVT 2.0 only
+static irqreturn_t gps_elton_awake_irq(int irq, void *dev_id)
+{
+	_notify_awake(dev_id);
+	return IRQ_HANDLED;
 }
 
 /* Toggles the power line to the GPS chip to bring the chip either
@@ -237,10 +283,8 @@ static ssize_t gps_elton_awake_store(struct device *dev,
 		}
 		_toggle_power(gps_elton_data);
 		if (_is_evt_1_x(gps_elton_data)) {
-			/* EVT 1.x - Force cache irq count to not equal system irq count. */
-			atomic_set(&gps_elton_data->uart_int_cnt, -1);
-			/* EVT1.x */
-			gps_elton_data->is_awake = GPS_STATE_AWAKE;
+			/* EVT1.x - the idle timer takes it back if the chip stays quiet. */
+			_set_state(gps_elton_data, GPS_STATE_AWAKE);
 		}
 		dev_info(dev, "User awoke GPS chip\n");
 	} else {
@@ -260,10 +304,8 @@ static ssize_t gps_elton_awake_store(struct device *dev,
 		}
 		_toggle_power(gps_elton_data);
 		if (_is_evt_1_x(gps_elton_data)) {
-			/* EVT 1.x - Force cache irq count to be equal to system irq count. */
-			atomic_set(&gps_elton_data->uart_int_cnt,  _get_interrupt_count(gps_elton_data->irq_num));
 			/* EVT1.x */
-			gps_elton_data->is_awake = GPS_STATE_HIBERNATE;
+			_set_state(gps_elton_data, GPS_STATE_HIBERNATE);
 		}
 		dev_info(dev, "User put GPS chip into hibernation\n");
 	}
@@ -272,41 +314,6 @@ static ssize_t gps_elton_awake_store(struct device *dev,
 	return count;
 }
 
-static ssize_t gps_elton_int_offset_show(struct device *dev,
-                                         struct device_attribute *attr, char *buf)
-{
-	struct gps_elton_data_s *gps_elton_data = dev_get_drvdata(dev);
-	if (_is_evt_1_x(gps_elton_data)) {
-		// EVT 1.x
-		return snprintf(buf, PAGE_SIZE, "%d\n", atomic_read(&gps_elton_data->uart_int_cnt));
-	} else {
-		// EVT 2.0
-		return -ENODEV;
-	}
-}
-
-/* User manually specifying suspend or resume mode of GPS chip. */
-static ssize_t gps_elton_int_offset_store(struct device *dev,
-                                          struct device_attribute *attr,
-                                          const char *buf, size_t count)
-{
-	int data;
-	int old_cnt;
-	struct gps_elton_data_s *gps_elton_data = dev_get_drvdata(dev);
-	sscanf(buf, "%d", &data);
-
-	old_cnt = atomic_read(&gps_elton_data->uart_int_cnt);
-	if (_is_evt_1_x(gps_elton_data)) {
-		atomic_add(data, &gps_elton_data->uart_int_cnt);
-		dev_info(gps_elton_data->dev, "%s Adding interrupt count old:%d new:%d cnt:%d\n",
-		         __func__, old_cnt, atomic_read( &gps_elton_data->uart_int_cnt), data);
-		return count;
-	} else {
-		// EVT 2.0
-		return -ENODEV;
-	}
-}
-
 static void gps_elton_early_suspend(struct early_suspend *h)
 {
 	if (_is_evt_1_x(gps_elton_data)) {
@@ -324,7 +331,7 @@ static void gps_elton_early_suspend(struct early_suspend *h)
 
 	if (hibernate_during_early_suspend) {
 		_toggle_power(gps_elton_data);
-		gps_elton_data->is_awake = GPS_STATE_HIBERNATE;
+		_set_state(gps_elton_data, GPS_STATE_HIBERNATE);
 		dev_info(gps_elton_data->dev, "%s system hibernated GPS chip\n", __func__);
 	}
 }
@@ -345,7 +352,7 @@ static void gps_elton_late_resume(struct early_suspend *h)
 	}
 	if (hibernate_during_early_suspend) {
 		_toggle_power(gps_elton_data);
-		gps_elton_data->is_awake = GPS_STATE_AWAKE;
+		_set_state(gps_elton_data, GPS_STATE_AWAKE);
 		dev_info(gps_elton_data->dev, "%s system awoke GPS chip\n", __func__);
 	}
 }
@@ -356,9 +363,7 @@ static int gps_elton_suspend(struct platform_device *pdev, pm_message_t state) {
 		// EVT 1.x
 		if (gps_elton_data->is_awake == GPS_STATE_AWAKE) {
 			_toggle_power(gps_elton_data);
-			gps_elton_data->is_awake = GPS_STATE_HIBERNATE;
-			/* EVT 1.x - Force cache irq count to be equal to system irq count. */
-			atomic_set(&gps_elton_data->uart_int_cnt, _get_interrupt_count(gps_elton_data->irq_num));
+			_set_state(gps_elton_data, GPS_STATE_HIBERNATE);
 			was_awake = 1;
 		}
 	} else {
@@ -381,14 +386,7 @@ static int gps_elton_resume(struct platform_device *pdev) {
 	dev_info(&pdev->dev, "Resuming\n");
 	if (_is_evt_1_x(gps_elton_data)) {
 		// EVT 1.x
-		gps_elton_data->is_awake = GPS_STATE_HIBERNATE;
-		/* EVT 1.x - Force cache irq count to be equal to system irq
-		 * count.  This because during suspend/resume cycles the UART
-		 * code is called which causes exactly 3 interrupts per
-		 * suspend/resume cycle.  Setting the irq count equal will
-		 * ensure that the GPS chip awake polling routine finds it
-		 * still hibernating.  */
-		atomic_set(&gps_elton_data->uart_int_cnt, _get_interrupt_count(gps_elton_data->irq_num));
+		_set_state(gps_elton_data, GPS_STATE_HIBERNATE);
 	} else {
 		// EVT 2.0
 		if (gpio_get_value(gps_elton_data->platform_data->gpio_awake) == 1) {
@@ -414,6 +412,10 @@ static int gps_elton_probe(struct platform_device *pdev) {
 	}
 
 	gps_elton_data->pdev = pdev;
+	gps_elton_data->awake_irq = -1;
+	spin_lock_init(&gps_elton_data->state_lock);
+	hrtimer_init(&gps_elton_data->idle_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	gps_elton_data->idle_timer.function = gps_elton_idle_timer_func;
 
 	gps_elton_data->valid_pulse_in_jiffies = INITIAL_JIFFIES;
 
@@ -455,7 +457,6 @@ static int gps_elton_probe(struct platform_device *pdev) {
 	 * EVT2 uses a direct line from the GPS chip to indicate awake.
 	 */
 	gps_elton_data->is_awake = GPS_STATE_UNKNOWN;
-	atomic_set(&gps_elton_data->uart_int_cnt, 0);
 
 	/* Set up sysfs device attributes. */
 	for (attr_count = 0; attr_count < ARRAY_SIZE(attrs); attr_count++) {
@@ -468,15 +469,31 @@ static int gps_elton_probe(struct platform_device *pdev) {
 		}
 	}
 
-	// EVT1.x
-	if (-1 == gps_elton_data->platform_data->gpio_awake) {
-		// gps_elton_data->irq_num = 102; _search_for_interrupt
-		gps_elton_data->irq_num = _get_irq_num(OMAP_UART3_NAME);
-		dev_info(gps_elton_data->dev, "%s Detected omap uart3 interrupt:%d\n",
-		         __func__, gps_elton_data->irq_num);
-		INIT_DELAYED_WORK(&gps_elton_data->work_check, gps_elton_work_task);
-		schedule_delayed_work(&gps_elton_data->work_check,
-		                      msecs_to_jiffies(wait_between_check_uart_ints_in_ms));
+	gps_elton_data->awake_sd = sysfs_get_dirent(gps_elton_data->dev->kobj.sd, NULL, "awake");
+
+	if (_is_evt_1_x(gps_elton_data)) {
+		// EVT1.x - data from the chip on the uart means it is awake.
+		gps_elton_data->uart_nb.notifier_call = gps_elton_uart_rx_notify;
+		rc = omap_serial_register_rx_notifier(&gps_elton_data->uart_nb);
+		if (rc < 0) {
+			dev_err(gps_elton_data->dev, "%s Unable to watch uart%d\n",
+			        __func__, GPS_ELTON_UART_PORT);
+			goto error_exit;
+		}
+	} else {
+		// EVT2.x - pollers of awake follow the awake line.
+		rc = request_irq(gpio_to_irq(gps_elton_data->platform_data->gpio_awake),
+		                 gps_elton_awake_irq,
+		                 IRQF_TRIGGER_RISING | IRQF_TRIGGER_FALLING,
+		                 "gps_awake", gps_elton_data);
+		if (rc < 0) {
+			// awake still reads the line, it just can't be polled.
+			dev_warn(gps_elton_data->dev, "%s Unable to request awake irq: %d\n",
+			         __func__, rc);
+			rc = 0;
+		} else {
+			gps_elton_data->awake_irq = gpio_to_irq(gps_elton_data->platform_data->gpio_awake);
+		}
 	}
 
 	// Check on_off line for default values
@@ -512,6 +529,9 @@ static int gps_elton_probe(struct platform_device *pdev) {
 	return 0;
 
 error_exit:
+	if (gps_elton_data->awake_sd)
+		sysfs_put(gps_elton_data->awake_sd);
+
 	if (gps_elton_data->class && gps_elton_data->dev)
 		device_destroy(gps_elton_data->class, gps_elton_data->dev->devt);
 
@@ -531,6 +551,15 @@ static int gps_elton_remove(struct platform_device *pdev) {
 
 	unregister_early_suspend(&gps_elton_data->early_suspend);
 
+	if (_is_evt_1_x(gps_elton_data))
+		omap_serial_unregister_rx_notifier(&gps_elton_data->uart_nb);
+	if (gps_elton_data->awake_irq >= 0)
+		free_irq(gps_elton_data->awake_irq, gps_elton_data);
+	hrtimer_cancel(&gps_elton_data->idle_timer);
+
+	if (gps_elton_data->awake_sd)
+		sysfs_put(gps_elton_data->awake_sd);
+
 	for (attr_count = 0; attr_count < ARRAY_SIZE(attrs); attr_count++) {
 		device_remove_file(gps_elton_data->dev, &attrs[attr_count]);
 	}
@@ -41,8 +41,13 @@
 #include <linux/hwspinlock.h>
 #include <linux/i2c-omap.h>
 #include <linux/pm_runtime.h>
+#include <linux/dma-mapping.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <linux/pm_qos_params.h>
 
+#include <plat/dma.h>
+
 #ifdef CONFIG_OMAP4_DPLL_CASCADING
 #include <linux/notifier.h>
 #include <plat/clock.h>
@@ -62,6 +67,24 @@
 /* timeout waiting for the controller to respond */
 #define OMAP_I2C_TIMEOUT (msecs_to_jiffies(1000))
 
+/* Size of the coherent bounce buffer used for sDMA transfers */
+#define OMAP_I2C_DMA_BUF_SIZE	PAGE_SIZE
+
+/* sDMA channel status bits that fail the message */
+#define OMAP_I2C_DMA_ERR_MASK	(OMAP_DMA_DROP_IRQ | OMAP2_DMA_TRANS_ERR_IRQ | \
+				 OMAP2_DMA_SECURE_ERR_IRQ | \
+				 OMAP2_DMA_SUPERVISOR_ERR_IRQ | \
+				 OMAP2_DMA_MISALIGNED_ERR_IRQ)
+
+/*
+ * Messages of at least this many bytes are moved by sDMA instead of the
+ * RRDY/XRDY interrupt handler. 0 disables the DMA path.
+ */
+static unsigned int dma_min_len = 64;
+module_param(dma_min_len, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(dma_min_len, "Minimum message length to transfer by sDMA "
+		 "(0 disables DMA)");
+
 /* For OMAP3 I2C_IV has changed to I2C_WE (wakeup enable) */
 enum {
 	OMAP_I2C_REV_REG = 0,
@@ -135,6 +158,8 @@ enum {
 #define OMAP_I2C_BUF_RXFIF_CLR	(1 << 14)	/* RX FIFO Clear */
 #define OMAP_I2C_BUF_XDMA_EN	(1 << 7)	/* TX DMA channel enable */
 #define OMAP_I2C_BUF_TXFIF_CLR	(1 << 6)	/* TX FIFO Clear */
+#define OMAP_I2C_BUF_RTRSH_MASK	(0x3f << 8)	/* RX FIFO threshold */
+#define OMAP_I2C_BUF_XTRSH_MASK	(0x3f << 0)	/* TX FIFO threshold */
 
 /* I2C Configuration Register (OMAP_I2C_CON): */
 #define OMAP_I2C_CON_EN		(1 << 15)	/* I2C module enable */
@@ -170,6 +195,14 @@ enum {
 #define I2C_OMAP_ERRATA_I207		(1 << 0)
 #define I2C_OMAP3_1P153			(1 << 1)
 
+struct omap_i2c_stats {
+	u64			bytes;		/* payload bytes moved */
+	unsigned long		irqs;		/* controller interrupts handled */
+	unsigned long		dma_xfers;	/* messages moved by sDMA */
+	unsigned long		pio_xfers;	/* messages moved by the ISR */
+	unsigned long		dma_errors;	/* sDMA messages that failed */
+};
+
 struct omap_i2c_dev {
 	struct device		*dev;
 	void __iomem		*base;		/* virtual */
@@ -177,6 +210,20 @@ struct omap_i2c_dev {
 	int			reg_shift;      /* bit shift for I2C register addresses */
 	struct completion	cmd_complete;
 	struct resource		*ioarea;
+	resource_size_t		phys_base;	/* physical, for sDMA */
+	int			dma_tx_req;	/* sDMA request lines, -1 if none */
+	int			dma_rx_req;
+	int			dma_tx_ch;	/* sDMA channels, -1 if none */
+	int			dma_rx_ch;
+	struct completion	dma_complete;
+	u16			dma_status;	/* ch_status seen by the callback */
+	u8			*dma_buf;	/* coherent bounce buffer */
+	dma_addr_t		dma_buf_phys;
+	spinlock_t		lock;		/* protects stats */
+	struct omap_i2c_stats	stats;
+#ifdef CONFIG_DEBUG_FS
+	struct dentry		*debugfs;
+#endif
 	u32			latency;	/* maximum mpu wkup latency */
 	int			(*device_reset)(struct device *dev);
 	struct pm_qos_request_list *pm_qos;
@@ -564,6 +611,136 @@ static int omap_i2c_bus_clear(struct omap_i2c_dev *dev)
 	return omap_i2c_wait_for_bb(dev);
 }
 
+static void omap_i2c_write_ie(struct omap_i2c_dev *dev, u16 ie)
+{
+	dev->iestate = ie;
+	if (cpu_is_omap44xx() && dev->rev >= OMAP_I2C_REV_ON_4430) {
+		omap_i2c_write_reg(dev, OMAP_I2C_IRQENABLE_CLR, 0x6FFF);
+		omap_i2c_write_reg(dev, OMAP_I2C_IRQENABLE_SET, ie);
+	} else {
+		omap_i2c_write_reg(dev, OMAP_I2C_IE_REG, ie);
+	}
+}
+
+static bool omap_i2c_use_dma(struct omap_i2c_dev *dev, struct i2c_msg *msg)
+{
+	int ch = (msg->flags & I2C_M_RD) ? dev->dma_rx_ch : dev->dma_tx_ch;
+
+	return ch != -1 && dma_min_len && msg->len >= dma_min_len &&
+		msg->len <= OMAP_I2C_DMA_BUF_SIZE;
+}
+
+/*
+ * The controller raises its DMA request each time the FIFO crosses the
+ * RX/TX threshold, so one sDMA frame is moved per request. Pick the
+ * largest frame that fits the FIFO threshold and divides the message,
+ * so the last request moves exactly the tail of the message.
+ */
+static unsigned int omap_i2c_dma_burst(struct omap_i2c_dev *dev,
+				       unsigned int len)
+{
+	unsigned int burst = dev->fifo_size;
+
+	while (len % burst)
+		burst--;
+
+	return burst;
+}
+
+/*
+ * Program and start the sDMA channel for msg; returns the BUF register
+ * value enabling the matching DMA request with the chosen threshold.
+ */
+static u16 omap_i2c_dma_start(struct omap_i2c_dev *dev, struct i2c_msg *msg,
+			      u16 buf)
+{
+	unsigned int burst = omap_i2c_dma_burst(dev, msg->len);
+	dma_addr_t data = dev->phys_base +
+		(dev->regs[OMAP_I2C_DATA_REG] << dev->reg_shift);
+
+	INIT_COMPLETION(dev->dma_complete);
+	dev->dma_status = 0;
+
+	if (msg->flags & I2C_M_RD) {
+		omap_set_dma_transfer_params(dev->dma_rx_ch,
+				OMAP_DMA_DATA_TYPE_S8, burst, msg->len / burst,
+				OMAP_DMA_SYNC_FRAME, dev->dma_rx_req,
+				OMAP_DMA_SRC_SYNC);
+		omap_set_dma_src_params(dev->dma_rx_ch, 0,
+				OMAP_DMA_AMODE_CONSTANT, data, 0, 0);
+		omap_set_dma_dest_params(dev->dma_rx_ch, 0,
+				OMAP_DMA_AMODE_POST_INC, dev->dma_buf_phys,
+				0, 0);
+		omap_start_dma(dev->dma_rx_ch);
+
+		buf &= ~OMAP_I2C_BUF_RTRSH_MASK;
+		buf |= (burst - 1) << 8 | OMAP_I2C_BUF_RDMA_EN;
+	} else {
+		memcpy(dev->dma_buf, msg->buf, msg->len);
+
+		omap_set_dma_transfer_params(dev->dma_tx_ch,
+				OMAP_DMA_DATA_TYPE_S8, burst, msg->len / burst,
+				OMAP_DMA_SYNC_FRAME, dev->dma_tx_req,
+				OMAP_DMA_DST_SYNC);
+		omap_set_dma_src_params(dev->dma_tx_ch, 0,
+				OMAP_DMA_AMODE_POST_INC, dev->dma_buf_phys,
+				0, 0);
+		omap_set_dma_dest_params(dev->dma_tx_ch, 0,
+				OMAP_DMA_AMODE_CONSTANT, data, 0, 0);
+		omap_start_dma(dev->dma_tx_ch);
+
+		buf &= ~OMAP_I2C_BUF_XTRSH_MASK;
+		buf |= (burst - 1) | OMAP_I2C_BUF_XDMA_EN;
+	}
+
+	return buf;
+}
+
+/*
+ * Wait for the sDMA side of a message whose I2C side has completed, then
+ * return the controller to interrupt driven mode. An RX channel may still
+ * be draining the FIFO when ARDY fires.
+ */
+static int omap_i2c_dma_finish(struct omap_i2c_dev *dev, struct i2c_msg *msg,
+			       bool xfer_ok)
+{
+	int ch = (msg->flags & I2C_M_RD) ? dev->dma_rx_ch : dev->dma_tx_ch;
+	unsigned long flags;
+	int r = 0;
+
+	if (xfer_ok && !wait_for_completion_timeout(&dev->dma_complete,
+						    OMAP_I2C_TIMEOUT)) {
+		dev_err(dev->dev, "sDMA timed out, addr: 0x%04x, len: %d\n",
+			msg->addr, msg->len);
+		r = -ETIMEDOUT;
+	} else if (xfer_ok && (dev->dma_status & OMAP_I2C_DMA_ERR_MASK)) {
+		dev_err(dev->dev, "sDMA error 0x%04x, addr: 0x%04x, len: %d\n",
+			dev->dma_status, msg->addr, msg->len);
+		r = -EIO;
+	}
+
+	if (r) {
+		spin_lock_irqsave(&dev->lock, flags);
+		dev->stats.dma_errors++;
+		spin_unlock_irqrestore(&dev->lock, flags);
+	}
+
+	omap_stop_dma(ch);
+
+	if (!r && xfer_ok && (msg->flags & I2C_M_RD))
+		memcpy(msg->buf, dev->dma_buf, msg->len);
+
+	return r;
+}
+
+static void omap_i2c_dma_callback(int lch, u16 ch_status, void *data)
+{
+	struct omap_i2c_dev *dev = data;
+
+	dev->dma_status |= ch_status;
+	complete(&dev->dma_complete);
+}
+
 /*
  * Low level master read/write transaction.
  */
@@ -572,7 +749,9 @@ static int omap_i2c_xfer_msg(struct i2c_adapter *adap,
 {
 	struct omap_i2c_dev *dev = i2c_get_adapdata(adap);
 	int r,i;
-	u16 w;
+	u16 w, buf = 0, iestate = dev->iestate;
+	unsigned long flags;
+	bool dma;
 
 	dev_dbg(dev->dev, "addr: 0x%04x, len: %d, flags: 0x%x, stop: %d\n",
 		msg->addr, msg->len, msg->flags, stop);
@@ -588,9 +767,26 @@ static int omap_i2c_xfer_msg(struct i2c_adapter *adap,
 
 	omap_i2c_write_reg(dev, OMAP_I2C_CNT_REG, dev->buf_len);
 
+	dma = omap_i2c_use_dma(dev, msg);
+	spin_lock_irqsave(&dev->lock, flags);
+	if (dma)
+		dev->stats.dma_xfers++;
+	else
+		dev->stats.pio_xfers++;
+	dev->stats.bytes += msg->len;
+	spin_unlock_irqrestore(&dev->lock, flags);
+
 	/* Clear the FIFO Buffers */
-	w = omap_i2c_read_reg(dev, OMAP_I2C_BUF_REG);
-	w |= OMAP_I2C_BUF_RXFIF_CLR | OMAP_I2C_BUF_TXFIF_CLR;
+	buf = omap_i2c_read_reg(dev, OMAP_I2C_BUF_REG);
+	w = buf | OMAP_I2C_BUF_RXFIF_CLR | OMAP_I2C_BUF_TXFIF_CLR;
+
+	if (dma) {
+		/* Data moves by sDMA; only ARDY and errors interrupt */
+		omap_i2c_write_ie(dev, iestate &
+				  ~(OMAP_I2C_IE_XRDY | OMAP_I2C_IE_RRDY |
+				    OMAP_I2C_IE_XDR | OMAP_I2C_IE_RDR));
+		w = omap_i2c_dma_start(dev, msg, w);
+	}
 	omap_i2c_write_reg(dev, OMAP_I2C_BUF_REG, w);
 
 	init_completion(&dev->cmd_complete);
@@ -641,6 +837,12 @@ static int omap_i2c_xfer_msg(struct i2c_adapter *adap,
 	 */
 	r = wait_for_completion_timeout(&dev->cmd_complete, OMAP_I2C_TIMEOUT);
 	dev->buf_len = 0;
+	if (dma) {
+		if (omap_i2c_dma_finish(dev, msg, r && !dev->cmd_err))
+			dev->cmd_err |= OMAP_I2C_STAT_XUDF;
+		omap_i2c_write_reg(dev, OMAP_I2C_BUF_REG, buf);
+		omap_i2c_write_ie(dev, iestate);
+	}
 	if (r == 0) {
 		dev_err(dev->dev, "controller timed out\n");
                 dev_err(dev->dev, "addr: 0x%04x, len: %d, flags: 0x%x, stop: %d\n",
@@ -1016,6 +1218,10 @@ omap_i2c_isr(int this_irq, void *dev_id)
 	if (dev->idle || dev->shutdown)
 		return IRQ_NONE;
 
+	spin_lock(&dev->lock);
+	dev->stats.irqs++;
+	spin_unlock(&dev->lock);
+
 	while ((stat = (omap_i2c_read_reg(dev, OMAP_I2C_STAT_REG))) & dev->iestate) {
 		dev_dbg(dev->dev, "IRQ (ISR = 0x%04x)\n", stat);
 		if (count++ == 100) {
@@ -1165,6 +1371,131 @@ static const struct i2c_algorithm omap_i2c_algo = {
 	.functionality	= omap_i2c_func,
 };
 
+/*
+ * Claim the sDMA channels wired to this controller. Failure is not fatal:
+ * the adapter then moves every message through the ISR.
+ */
+static void __devinit omap_i2c_request_dma(struct omap_i2c_dev *dev,
+					   struct platform_device *pdev)
+{
+	struct resource *res;
+
+	dev->dma_tx_ch = -1;
+	dev->dma_rx_ch = -1;
+
+	if (!dev->fifo_size)
+		return;
+
+	res = platform_get_resource_byname(pdev, IORESOURCE_DMA, "tx");
+	if (!res)
+		return;
+	dev->dma_tx_req = res->start;
+
+	res = platform_get_resource_byname(pdev, IORESOURCE_DMA, "rx");
+	if (!res)
+		return;
+	dev->dma_rx_req = res->start;
+
+	dev->dma_buf = dma_alloc_coherent(dev->dev, OMAP_I2C_DMA_BUF_SIZE,
+					  &dev->dma_buf_phys, GFP_KERNEL);
+	if (!dev->dma_buf)
+		goto err;
+
+	init_completion(&dev->dma_complete);
+
+	if (omap_request_dma(dev->dma_tx_req, "I2C TX",
+			     omap_i2c_dma_callback, dev, &dev->dma_tx_ch))
+		goto err_free_buf;
+
+	if (omap_request_dma(dev->dma_rx_req, "I2C RX",
+			     omap_i2c_dma_callback, dev, &dev->dma_rx_ch))
+		goto err_free_tx;
+
+	return;
+
+err_free_tx:
+	omap_free_dma(dev->dma_tx_ch);
+	dev->dma_tx_ch = -1;
+err_free_buf:
+	dma_free_coherent(dev->dev, OMAP_I2C_DMA_BUF_SIZE, dev->dma_buf,
+			  dev->dma_buf_phys);
+	dev->dma_buf = NULL;
+err:
+	dev_warn(dev->dev, "no sDMA channels, using interrupt mode only\n");
+}
+
+static void omap_i2c_free_dma(struct omap_i2c_dev *dev)
+{
+	if (dev->dma_rx_ch != -1)
+		omap_free_dma(dev->dma_rx_ch);
+	if (dev->dma_tx_ch != -1)
+		omap_free_dma(dev->dma_tx_ch);
+	if (dev->dma_buf)
+		dma_free_coherent(dev->dev, OMAP_I2C_DMA_BUF_SIZE,
+				  dev->dma_buf, dev->dma_buf_phys);
+	dev->dma_rx_ch = -1;
+	dev->dma_tx_ch = -1;
+	dev->dma_buf = NULL;
+}
+
+#ifdef CONFIG_DEBUG_FS
+static struct dentry *omap_i2c_debugfs_root;
+
+static int omap_i2c_stats_show(struct seq_file *s, void *unused)
+{
+	struct omap_i2c_dev *dev = s->private;
+	struct omap_i2c_stats st;
+	unsigned long flags;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	st = dev->stats;
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	seq_printf(s, "bytes:      %llu\n", st.bytes);
+	seq_printf(s, "irqs:       %lu\n", st.irqs);
+	seq_printf(s, "dma_xfers:  %lu\n", st.dma_xfers);
+	seq_printf(s, "pio_xfers:  %lu\n", st.pio_xfers);
+	seq_printf(s, "dma_errors: %lu\n", st.dma_errors);
+	seq_printf(s, "dma:        %s (min len %u)\n",
+		   dev->dma_tx_ch != -1 ? "yes" : "no", dma_min_len);
+
+	return 0;
+}
+
+static int omap_i2c_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, omap_i2c_stats_show, inode->i_private);
+}
+
+static const struct file_operations omap_i2c_stats_fops = {
+	.open		= omap_i2c_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void omap_i2c_debugfs_add(struct omap_i2c_dev *dev)
+{
+	if (!omap_i2c_debugfs_root)
+		omap_i2c_debugfs_root = debugfs_create_dir("omap_i2c", NULL);
+	if (IS_ERR_OR_NULL(omap_i2c_debugfs_root))
+		return;
+
+	dev->debugfs = debugfs_create_file(dev_name(dev->dev), S_IRUGO,
+					   omap_i2c_debugfs_root, dev,
+					   &omap_i2c_stats_fops);
+}
+
+static void omap_i2c_debugfs_remove(struct omap_i2c_dev *dev)
+{
+	debugfs_remove(dev->debugfs);
+	dev->debugfs = NULL;
+}
+#else
+static inline void omap_i2c_debugfs_add(struct omap_i2c_dev *dev) { }
+static inline void omap_i2c_debugfs_remove(struct omap_i2c_dev *dev) { }
+#endif
+
 static int __devinit
 omap_i2c_probe(struct platform_device *pdev)
 {
@@ -1203,6 +1534,7 @@ omap_i2c_probe(struct platform_device *pdev)
 		r = -ENOMEM;
 		goto err_release_region;
 	}
+	spin_lock_init(&dev->lock);
 
 	if (pdata) {
 		speed = pdata->clkrate;
@@ -1215,6 +1547,7 @@ omap_i2c_probe(struct platform_device *pdev)
 	dev->idle = 1;
 	dev->dev = &pdev->dev;
 	dev->irq = irq->start;
+	dev->phys_base = mem->start;
 	dev->base = ioremap(mem->start, resource_size(mem));
 	if (!dev->base) {
 		r = -ENOMEM;
@@ -1295,6 +1628,8 @@ omap_i2c_probe(struct platform_device *pdev)
 	/* reset ASAP, clearing any IRQs */
 	omap_i2c_init(dev);
 
+	omap_i2c_request_dma(dev, pdev);
+
 	/* Decide what interrupts are needed */
 	dev->iestate = (OMAP_I2C_IE_XRDY | OMAP_I2C_IE_RRDY |
 			OMAP_I2C_IE_ARDY | OMAP_I2C_IE_NACK |
@@ -1333,11 +1668,14 @@ omap_i2c_probe(struct platform_device *pdev)
 		goto err_free_irq;
 	}
 
+	omap_i2c_debugfs_add(dev);
+
 	return 0;
 
 err_free_irq:
 	free_irq(dev->irq, dev);
 err_unuse_clocks:
+	omap_i2c_free_dma(dev);
 	omap_i2c_write_reg(dev, OMAP_I2C_CON_REG, 0);
 	omap_i2c_idle(dev);
 err_free_qos:
@@ -1364,8 +1702,10 @@ omap_i2c_remove(struct platform_device *pdev)
 
 	platform_set_drvdata(pdev, NULL);
 
+	omap_i2c_debugfs_remove(dev);
 	free_irq(dev->irq, dev);
 	i2c_del_adapter(&dev->adapter);
+	omap_i2c_free_dma(dev);
 	omap_i2c_write_reg(dev, OMAP_I2C_CON_REG, 0);
 	iounmap(dev->base);
 	if (dev->pm_qos) {
@@ -1454,6 +1794,9 @@ subsys_initcall(omap_i2c_init_driver);
 static void __exit omap_i2c_exit_driver(void)
 {
 	platform_driver_unregister(&omap_i2c_driver);
+#ifdef CONFIG_DEBUG_FS
+	debugfs_remove(omap_i2c_debugfs_root);
+#endif
 }
 module_exit(omap_i2c_exit_driver);
 
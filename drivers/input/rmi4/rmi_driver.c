@@ -522,21 +522,111 @@ static void process_one_interrupt(struct rmi_function_container *fc,
 
 }
 
+static bool rmi_driver_irq_enabled(struct rmi_driver_data *data,
+				   struct rmi_function_container *fc)
+{
+	u8 irq_bits[data->num_of_irq_regs];
+
+	if (!fc->irq_mask)
+		return false;
+
+	u8_and(irq_bits, fc->irq_mask, data->current_irq_mask,
+	       data->irq_count);
+	return u8_is_any_set(irq_bits, data->num_of_irq_regs);
+}
+
+/*
+ * Work out one register span, starting at the F01 device status, that also
+ * covers the attention data of the enabled interrupt sources on the same
+ * page, so a single write-read on the bus fetches everything an attention
+ * needs. A function only joins when its registers adjoin the span: a gap
+ * may belong to a function like F54 whose data reads have side effects.
+ * Functions that would stretch the span past RMI_READ_PLAN_MAX_SPAN keep
+ * reading their own registers.
+ *
+ * Called with irq_mutex held, on the first attention after the interrupt
+ * mask or the bound function drivers changed.
+ */
+static void rmi_driver_plan_read(struct rmi_driver_data *data)
+{
+	struct rmi_function_container *entry;
+	u16 start = data->f01_container->fd.data_base_addr;
+	u16 end = start + 1 + data->num_of_irq_regs;
+	u16 new_start, new_end;
+	bool grown;
+
+	do {
+		grown = false;
+		list_for_each_entry(entry, &data->rmi_functions.list, list) {
+			u16 fstart = entry->fd.data_base_addr;
+			u16 fend = fstart + entry->attn_size;
+
+			if (!entry->attn_size ||
+			    (fstart >= start && fend <= end) ||
+			    fend < start || fstart > end ||
+			    RMI_REG_PAGE(fstart) != RMI_REG_PAGE(start) ||
+			    RMI_REG_PAGE(fend - 1) != RMI_REG_PAGE(start) ||
+			    !rmi_driver_irq_enabled(data, entry))
+				continue;
+
+			new_start = min(start, fstart);
+			new_end = max(end, fend);
+			if (new_end - new_start > RMI_READ_PLAN_MAX_SPAN)
+				continue;
+
+			start = new_start;
+			end = new_end;
+			grown = true;
+		}
+	} while (grown);
+
+	data->read_plan_addr = start;
+	data->read_plan_len = end - start;
+	data->read_plan_dirty = false;
+}
+
+/* Point each function covered by the read plan at its slice of it. */
+static void rmi_driver_hand_out_reads(struct rmi_driver_data *data)
+{
+	struct rmi_function_container *entry;
+	u16 start = data->read_plan_addr;
+	u16 end = start + data->read_plan_len;
+
+	list_for_each_entry(entry, &data->rmi_functions.list, list) {
+		u16 fstart = entry->fd.data_base_addr;
+
+		if (entry->attn_size && fstart >= start &&
+		    fstart + entry->attn_size <= end)
+			entry->attn_data = data->read_plan_buf +
+					   (fstart - start);
+		else
+			entry->attn_data = NULL;
+	}
+}
+
 static int process_interrupt_requests(struct rmi_device *rmi_dev)
 {
 	struct rmi_driver_data *data = dev_get_drvdata(&rmi_dev->dev);
 	struct device *dev = &rmi_dev->dev;
 	struct rmi_function_container *entry;
+	u16 irq_status_addr = data->f01_container->fd.data_base_addr + 1;
 	u8 irq_status[data->num_of_irq_regs];
 	int error;
 
-	error = rmi_read_block(rmi_dev,
-				data->f01_container->fd.data_base_addr + 1,
-				irq_status, data->num_of_irq_regs);
+	mutex_lock(&data->irq_mutex);
+	if (data->read_plan_dirty)
+		rmi_driver_plan_read(data);
+	mutex_unlock(&data->irq_mutex);
+
+	error = rmi_read_block(rmi_dev, data->read_plan_addr,
+				data->read_plan_buf, data->read_plan_len);
 	if (error < 0) {
 		dev_err(dev, "Failed to read irqs, code=%d\n", error);
 		return error;
 	}
+	memcpy(irq_status, data->read_plan_buf +
+	       (irq_status_addr - data->read_plan_addr),
+	       data->num_of_irq_regs);
 
 	mutex_lock(&data->irq_mutex);
 
@@ -548,11 +638,15 @@ static int process_interrupt_requests(struct rmi_device *rmi_dev)
 	 * interrupt status register and are enabled.
 	 */
 
+	rmi_driver_hand_out_reads(data);
 	list_for_each_entry(entry, &data->rmi_functions.list, list)
 		if (entry->irq_mask)
 			process_one_interrupt(entry, irq_status,
 					      data);
 
+	list_for_each_entry(entry, &data->rmi_functions.list, list)
+		entry->attn_data = NULL;
+
 	return 0;
 }
 
@@ -564,7 +658,7 @@ static int rmi_driver_irq_handler(struct rmi_device *rmi_dev, int irq)
 	/* Can get called before the driver is fully ready to deal with
 	 * interrupts.
 	 */
-	if (!data || !data->f01_container) {
+	if (!data || !data->f01_container || !data->read_plan_buf) {
 		dev_dbg(&rmi_dev->dev,
 			 "Not ready to handle interrupts yet!\n");
 		return 0;
@@ -663,6 +757,7 @@ static int rmi_driver_irq_save(struct rmi_device *rmi_dev, u8 * new_ints)
 		memcpy(data->current_irq_mask, new_ints,
 					data->num_of_irq_regs * sizeof(u8));
 		data->irq_stored = true;
+		data->read_plan_dirty = true;
 	} else {
 		retval = -ENOSPC; /* No space to store IRQs.*/
 		dev_err(dev, "Attempted to save IRQs when already stored!");
@@ -692,6 +787,7 @@ static int rmi_driver_irq_restore(struct rmi_device *rmi_dev)
 		memcpy(data->current_irq_mask, data->irq_mask_store,
 					data->num_of_irq_regs * sizeof(u8));
 		data->irq_stored = false;
+		data->read_plan_dirty = true;
 	} else {
 		retval = -EINVAL;
 		dev_err(dev, "%s: Attempted to restore values when not stored!",
@@ -1108,6 +1204,15 @@ static int __devinit rmi_driver_probe(struct device *dev)
 		goto err_free_data;
 	}
 
+	data->read_plan_buf = devm_kzalloc(dev, RMI_READ_PLAN_MAX_SPAN,
+					   GFP_KERNEL);
+	if (!data->read_plan_buf) {
+		dev_err(dev, "Failed to allocate read plan buffer.\n");
+		retval = -ENOMEM;
+		goto err_free_data;
+	}
+	data->read_plan_dirty = true;
+
 	/* call devm_kcalloc when it will be defined in kernel in furture */
 	data->irq_mask_store = devm_kzalloc(dev,
 					data->num_of_irq_regs,
@@ -1223,11 +1328,21 @@ static int f01_notifier_call(struct notifier_block *nb,
 {
 	struct device *dev = data;
 	struct rmi_function_container *fc;
+	struct rmi_driver_data *ddata;
 
 	if (dev->type != &rmi_function_type)
 		return 0;
 
 	fc = to_rmi_function_container(dev);
+
+	/* a function driver coming or going changes its attention data */
+	if (action == BUS_NOTIFY_BOUND_DRIVER ||
+	    action == BUS_NOTIFY_UNBIND_DRIVER) {
+		ddata = dev_get_drvdata(&fc->rmi_dev->dev);
+		if (ddata)
+			ddata->read_plan_dirty = true;
+	}
+
 	if (fc->fd.function_number != 0x01)
 		return 0;
 
@@ -339,6 +339,13 @@ show_store_repeated_union_struct(regtype, reg_group, propname, "%u")
 
 #define attrify(nm) (&dev_attr_##nm.attr)
 
+/*
+ * Longest register span fetched in one go on attention.  Reading a few
+ * unused bytes in between is far cheaper than another bus round trip.
+ */
+#define RMI_READ_PLAN_MAX_SPAN	128
+#define RMI_REG_PAGE(addr)	(((addr) >> 8) & 0xff)
+
 #define PDT_PROPERTIES_LOCATION 0x00EF
 #define BSR_LOCATION 0x00FE
 
@@ -366,6 +373,10 @@ struct rmi_driver_data {
 	u8 *current_irq_mask;
 	u8 *irq_mask_store;
 	bool irq_stored;
+	u8 *read_plan_buf;
+	u16 read_plan_addr;
+	int read_plan_len;
+	bool read_plan_dirty;
 	struct mutex irq_mutex;
 	struct mutex pdt_mutex;
 
@@ -1012,6 +1012,7 @@ static int rmi_f01_alloc_memory(struct rmi_function_container *fc,
 		return -ENOMEM;
 	}
 	fc->data = f01;
+	fc->attn_size = sizeof(f01->device_status.regs);
 
 	return 0;
 }
@@ -1381,7 +1382,7 @@ static int rmi_f01_attention(struct rmi_function_container *fc, u8 *irq_bits)
 	struct f01_data *data = fc->data;
 	int retval;
 
-	retval = rmi_read_block(rmi_dev, fc->fd.data_base_addr,
+	retval = rmi_read_data_block(fc, fc->fd.data_base_addr,
 		data->device_status.regs, ARRAY_SIZE(data->device_status.regs));
 	if (retval < 0) {
 		dev_err(&fc->dev, "Failed to read device status, code: %d.\n",
@@ -2478,6 +2478,7 @@ static int rmi_f11_initialize(struct rmi_function_container *fc)
 		return rc;
 
 	query_offset = (query_base_addr + 1);
+	fc->attn_size = 0;
 	/* Increase with one since number of sensors is zero based */
 	for (i = 0; i < (f11->dev_query.nbr_of_sensors + 1); i++) {
 		struct f11_2d_sensor *sensor = &f11->sensors[i];
@@ -2540,6 +2541,7 @@ static int rmi_f11_initialize(struct rmi_function_container *fc)
 		rc = f11_2d_construct_data(sensor);
 		if (rc < 0)
 			return rc;
+		fc->attn_size += sensor->pkt_size;
 
 		ctrl = &f11->dev_controls;
 		if (sensor->axis_align.delta_x_threshold) {
@@ -2817,7 +2819,6 @@ static int rmi_f11_config(struct rmi_function_container *fc)
 
 int rmi_f11_attention(struct rmi_function_container *fc, u8 *irq_bits)
 {
-	struct rmi_device *rmi_dev = fc->rmi_dev;
 	struct f11_data *f11 = fc->data;
 	u16 data_base_addr = fc->fd.data_base_addr;
 	u16 data_base_addr_offset = 0;
@@ -2825,7 +2826,7 @@ int rmi_f11_attention(struct rmi_function_container *fc, u8 *irq_bits)
 	int i;
 
 	for (i = 0; i < f11->dev_query.nbr_of_sensors + 1; i++) {
-		error = rmi_read_block(rmi_dev,
+		error = rmi_read_data_block(fc,
 				data_base_addr + data_base_addr_offset,
 				f11->sensors[i].data_pkt,
 				f11->sensors[i].pkt_size);
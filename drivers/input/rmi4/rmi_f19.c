@@ -351,6 +351,7 @@ static int rmi_f19_alloc_memory(struct rmi_function_container *fc)
 		dev_err(&fc->dev, "Failed to allocate button data buffer.\n");
 		return -ENOMEM;
 	}
+	fc->attn_size = f19->button_bitmask_size;
 
 	f19->button_map = devm_kzalloc(&fc->dev, f19->query.button_count,
 				GFP_KERNEL);
@@ -738,12 +739,11 @@ static int rmi_f19_attention(struct rmi_function_container *fc, u8 *irq_bits)
 {
 	int error;
 	int button;
-	struct rmi_device *rmi_dev = fc->rmi_dev;
 	struct f19_data *f19 = fc->data;
 	u16 data_base_addr = fc->fd.data_base_addr;
 
 	/* Read the button data. */
-	error = rmi_read_block(rmi_dev, data_base_addr, f19->button_data_buffer,
+	error = rmi_read_data_block(fc, data_base_addr, f19->button_data_buffer,
 			f19->button_bitmask_size);
 	if (error < 0) {
 		dev_err(&fc->dev, "%s: Failed to read button data registers.\n",
@@ -380,6 +380,7 @@ static int rmi_f1a_alloc_memory(struct rmi_function_container *fc)
 		dev_err(&fc->dev, "Failed to allocate button data buffer.\n");
 		return -ENOMEM;
 	}
+	fc->attn_size = f1a->button_bitmask_size;
 
 	f1a->button_map = devm_kzalloc(&fc->dev,
 				f1a->sensor_button_count, GFP_KERNEL);
@@ -858,12 +859,11 @@ static int rmi_f1a_attention(struct rmi_function_container *fc, u8 *irq_bits)
 {
 	int error;
 	int button;
-	struct rmi_device *rmi_dev = fc->rmi_dev;
 	struct f1a_data *f1a = fc->data;
 	u16 data_base_addr = fc->fd.data_base_addr;
 
 	/* Read the button data. */
-	error = rmi_read_block(rmi_dev, data_base_addr, f1a->button_data_buffer,
+	error = rmi_read_data_block(fc, data_base_addr, f1a->button_data_buffer,
 			f1a->button_bitmask_size);
 	if (error < 0) {
 		dev_err(&fc->dev, "%s: Failed to read button data registers.\n",
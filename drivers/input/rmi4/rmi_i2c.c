@@ -236,12 +236,30 @@ exit:
 }
 
 
+/*
+ * The register address write and the data read go out as one combined
+ * transfer with a repeated start, so every block read costs a single bus
+ * transaction (plus a page select only when the page actually changes).
+ */
 static int rmi_i2c_read_block(struct rmi_phys_device *phys, u16 addr, u8 *buf,
 			      int len)
 {
 	struct i2c_client *client = to_i2c_client(phys->dev);
 	struct rmi_i2c_data *data = phys->data;
 	u8 txbuf[1] = {addr & 0xff};
+	struct i2c_msg msgs[] = {
+		{
+			.addr	= client->addr,
+			.flags	= 0,
+			.len	= sizeof(txbuf),
+			.buf	= txbuf,
+		}, {
+			.addr	= client->addr,
+			.flags	= I2C_M_RD,
+			.len	= len,
+			.buf	= buf,
+		},
+	};
 	int retval;
 
 	mutex_lock(&data->page_mutex);
@@ -255,22 +273,18 @@ static int rmi_i2c_read_block(struct rmi_phys_device *phys, u16 addr, u8 *buf,
 	if (COMMS_DEBUG(data))
 		dev_dbg(&client->dev, "writes 1 bytes: %02x\n", txbuf[0]);
 
-	phys->info.tx_count++;
-	phys->info.tx_bytes += sizeof(txbuf);
-	retval = i2c_master_send(client, txbuf, sizeof(txbuf));
-	if (retval != sizeof(txbuf)) {
-		phys->info.tx_errs++;
+	/* one combined transfer, accounted (and failed) as a single read */
+	phys->info.rx_count++;
+	phys->info.rx_bytes += len;
+	retval = i2c_transfer(client->adapter, msgs, ARRAY_SIZE(msgs));
+	if (retval != ARRAY_SIZE(msgs)) {
+		phys->info.rx_errs++;
 		retval = (retval < 0) ? retval : -EIO;
 		goto exit;
 	}
+	retval = len;
 
-	retval = i2c_master_recv(client, buf, len);
-
-	phys->info.rx_count++;
-	phys->info.rx_bytes += len;
-	if (retval < 0)
-		phys->info.rx_errs++;
-	else if (COMMS_DEBUG(data)) {
+	if (COMMS_DEBUG(data)) {
 		char debug_buf[len*3 + 1];
 		char *temp = debug_buf;
 		int i;
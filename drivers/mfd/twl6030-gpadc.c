@@ -37,6 +37,7 @@
 #include <linux/miscdevice.h>
 #include <linux/slab.h>
 #include <linux/hwmon-sysfs.h>
+#include <linux/ktime.h>
 #include <linux/i2c/twl.h>
 #include <linux/i2c/twl6030-gpadc.h>
 
@@ -302,6 +303,10 @@ struct twl6030_gpadc_data {
 	int irq_n;
 	struct twl6032_chnl_calib *twl6032_cal_tbl;
 	unsigned long features;
+	/* last result of each channel, shared by all consumers */
+	struct twl6030_value	cache[GPADC_MAX_CHANNELS];
+	int			cache_rbuf[GPADC_MAX_CHANNELS];
+	ktime_t			cache_stamp[GPADC_MAX_CHANNELS];
 };
 
 static struct twl6030_gpadc_data *the_gpadc;
@@ -440,9 +445,19 @@ static int twl6030_gpadc_channel_raw_read(struct twl6030_gpadc_data *gpadc,
 	return (int)((msb << 8) | lsb);
 }
 
+/* locks held by caller */
+static void twl6030_gpadc_cache_store(struct twl6030_gpadc_data *gpadc,
+		int channel, struct twl6030_gpadc_request *req, ktime_t stamp)
+{
+	gpadc->cache[channel] = req->buf[channel];
+	gpadc->cache_rbuf[channel] = req->rbuf[channel];
+	gpadc->cache_stamp[channel] = stamp;
+}
+
 static int twl6030_gpadc_read_channels(struct twl6030_gpadc_data *gpadc,
 		u8 reg_base, u32 channels, struct twl6030_gpadc_request *req)
 {
+	ktime_t stamp = ktime_get();
 	int count = 0;
 	u8 reg, i;
 	s32 gain_error;
@@ -493,6 +508,7 @@ static int twl6030_gpadc_read_channels(struct twl6030_gpadc_data *gpadc,
 			}
 			req->buf[i].raw_channel_value = raw_channel_value;
 			dev_dbg(gpadc->dev, "GPADC val: %d\n", req->rbuf[i]);
+			twl6030_gpadc_cache_store(gpadc, i, req, stamp);
 		}
 	} else {
 		for (i = 0; i < TWL6030_GPADC_MAX_CHANNELS; i++) {
@@ -524,6 +540,7 @@ static int twl6030_gpadc_read_channels(struct twl6030_gpadc_data *gpadc,
 								* 1000) >> 13;
 			}
 			dev_dbg(gpadc->dev, "GPADC val: %d", req->rbuf[i]);
+			twl6030_gpadc_cache_store(gpadc, i, req, stamp);
 		}
 	}
 	return count;
@@ -852,6 +869,95 @@ out:
 }
 EXPORT_SYMBOL(twl6030_gpadc_conversion);
 
+/**
+ * twl6030_gpadc_conversion_cached - convert channels, sharing recent results
+ * @req: channels to convert, results are returned in req->buf and req->rbuf
+ * @max_age_ms: oldest result, in ms, the caller accepts for a channel
+ *
+ * Channels converted less than @max_age_ms ago, by this or any other
+ * consumer, are served from the result cache. The remaining ones are
+ * converted together in a single software conversion sequence.
+ *
+ * Returns the number of channels returned in @req, or < 0 on failure.
+ */
+int twl6030_gpadc_conversion_cached(struct twl6030_gpadc_request *req,
+				    unsigned int max_age_ms)
+{
+	const struct twl6030_gpadc_conversion_method *method;
+	struct twl6030_gpadc_request conv;
+	ktime_t now;
+	u32 stale = 0;
+	int i, nchannels, ret = 0;
+
+	if (unlikely(!req))
+		return -EINVAL;
+
+	if (!the_gpadc)
+		return -EAGAIN;
+
+	if (the_gpadc->features & TWL6032_SUBCLASS)
+		nchannels = TWL6032_GPADC_MAX_CHANNELS;
+	else
+		nchannels = TWL6030_GPADC_MAX_CHANNELS;
+
+	if (!req->channels || (req->channels & ~(BIT(nchannels) - 1)))
+		return -EINVAL;
+
+	mutex_lock(&the_gpadc->lock);
+
+	now = ktime_get();
+	for (i = 0; i < nchannels; i++) {
+		if (!(req->channels & BIT(i)))
+			continue;
+		if (!the_gpadc->cache_stamp[i].tv64 ||
+		    ktime_us_delta(now, the_gpadc->cache_stamp[i]) >=
+					(s64) max_age_ms * USEC_PER_MSEC)
+			stale |= BIT(i);
+	}
+
+	if (stale) {
+		/* Do we have a conversion request ongoing */
+		if (the_gpadc->requests[TWL6030_GPADC_SW2].active) {
+			ret = -EBUSY;
+			goto out;
+		}
+
+		memset(&conv, 0, sizeof(conv));
+		conv.channels = stale;
+		conv.method = TWL6030_GPADC_SW2;
+		conv.type = TWL6030_GPADC_WAIT;
+		method = &twl6030_conversion_methods[TWL6030_GPADC_SW2];
+
+		if (the_gpadc->features & TWL6032_SUBCLASS)
+			ret = _twl6032_gpadc_conversion(&conv, method);
+		else
+			ret = _twl6030_gpadc_conversion(&conv, method);
+		if (ret < 0)
+			goto out;
+	}
+
+	ret = 0;
+	for (i = 0; i < nchannels; i++) {
+		if (!(req->channels & BIT(i)))
+			continue;
+		/* the conversion did not produce this channel */
+		if (the_gpadc->cache_stamp[i].tv64 < now.tv64 &&
+		    (stale & BIT(i))) {
+			ret = -EIO;
+			goto out;
+		}
+		req->buf[i] = the_gpadc->cache[i];
+		req->rbuf[i] = the_gpadc->cache_rbuf[i];
+		ret++;
+	}
+
+out:
+	mutex_unlock(&the_gpadc->lock);
+
+	return ret;
+}
+EXPORT_SYMBOL(twl6030_gpadc_conversion_cached);
+
 static ssize_t show_channel(struct device *dev,
 		struct device_attribute *devattr, char *buf)
 {
@@ -13,6 +13,8 @@
 #include <linux/slab.h>
 #include <linux/stat.h>
 
+#include <asm/div64.h>
+
 #include <linux/mmc/card.h>
 #include <linux/mmc/host.h>
 
@@ -134,6 +136,53 @@ static const struct file_operations mmc_ios_fops = {
 	.release	= single_release,
 };
 
+static int mmc_async_stats_show(struct seq_file *s, void *data)
+{
+	struct mmc_host	*host = s->private;
+	struct mmc_async_stats *stats = &host->async_stats;
+	u64 avg = 0, max = stats->max_ns;
+
+	if (stats->count) {
+		avg = stats->total_ns;
+		do_div(avg, stats->count);
+	}
+	do_div(avg, NSEC_PER_USEC);
+	do_div(max, NSEC_PER_USEC);
+
+	seq_printf(s, "requests:\t%lu\n", stats->count);
+	seq_printf(s, "overlapped:\t%lu\n", stats->overlapped);
+	seq_printf(s, "avg latency:\t%llu us\n", avg);
+	seq_printf(s, "max latency:\t%llu us\n", max);
+
+	return 0;
+}
+
+static int mmc_async_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mmc_async_stats_show, inode->i_private);
+}
+
+static ssize_t mmc_async_stats_write(struct file *file,
+		const char __user *ubuf, size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct mmc_host *host = s->private;
+
+	mmc_claim_host(host);
+	memset(&host->async_stats, 0, sizeof(host->async_stats));
+	mmc_release_host(host);
+
+	return count;
+}
+
+static const struct file_operations mmc_async_stats_fops = {
+	.open		= mmc_async_stats_open,
+	.read		= seq_read,
+	.write		= mmc_async_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int mmc_clock_opt_get(void *data, u64 *val)
 {
 	struct mmc_host *host = data;
@@ -183,6 +232,10 @@ void mmc_add_host_debugfs(struct mmc_host *host)
 			&mmc_clock_fops))
 		goto err_node;
 
+	if (!debugfs_create_file("async_stats", S_IRUSR | S_IWUSR, root, host,
+			&mmc_async_stats_fops))
+		goto err_node;
+
 #ifdef CONFIG_MMC_CLKGATE
 	if (!debugfs_create_u32("clk_delay", (S_IRUSR | S_IWUSR),
 				root, &host->clk_delay))
@@ -134,6 +134,11 @@
 #define DMA_TABLE_NUM_ENTRIES	1024
 #define ADMA_TABLE_SZ 	\
 	(DMA_TABLE_NUM_ENTRIES * sizeof(struct adma_desc_table))
+/*
+ * One descriptor table for the transfer on the bus and one that pre_req
+ * fills for the next request in the meantime.
+ */
+#define ADMA_NUM_TABLES		2
 
 #define SDMA_XFER	1
 #define ADMA_XFER	2
@@ -197,6 +202,13 @@ struct adma_desc_table {
 	dma_addr_t addr;
 };
 
+/* DMA mapping done ahead of time by pre_req, claimed via data->host_cookie */
+struct omap_hsmmc_next {
+	unsigned int	dma_len;
+	int		adma_idx;
+	s32		cookie;
+};
+
 struct omap_hsmmc_host {
 	struct	device		*dev;
 	struct	mmc_host	*mmc;
@@ -236,8 +248,10 @@ struct omap_hsmmc_host {
 	int			suspended;
 	int			irq;
 	int			dma_type, dma_ch;
-	struct adma_desc_table	*adma_table;
+	struct adma_desc_table	*adma_table;	/* ADMA_NUM_TABLES tables */
 	dma_addr_t		phy_adma_table;
+	int			adma_idx;	/* table of the last transfer */
+	struct omap_hsmmc_next	next_data;
 	int			dma_line_tx, dma_line_rx;
 	int			slot_id;
 	int			got_dbclk;
@@ -999,7 +1013,7 @@ omap_hsmmc_xfer_done(struct omap_hsmmc_host *host, struct mmc_data *data)
 
 	host->data = NULL;
 
-	if (host->dma_type == ADMA_XFER)
+	if (host->dma_type == ADMA_XFER && !data->host_cookie)
 		dma_unmap_sg(mmc_dev(host->mmc), data->sg, host->dma_len,
 					omap_hsmmc_get_dma_dir(host, data));
 
@@ -1095,9 +1109,10 @@ static void omap_hsmmc_dma_cleanup(struct omap_hsmmc_host *host, int errno)
 	spin_unlock(&host->irq_lock);
 
 	if ((host->dma_type == SDMA_XFER) && (dma_ch != -1)) {
-		dma_unmap_sg(mmc_dev(host->mmc), host->data->sg,
-			host->data->sg_len,
-			omap_hsmmc_get_dma_dir(host, host->data));
+		if (!host->data->host_cookie)
+			dma_unmap_sg(mmc_dev(host->mmc), host->data->sg,
+				host->data->sg_len,
+				omap_hsmmc_get_dma_dir(host, host->data));
 		omap_free_dma(dma_ch);
 	}
 	host->data = NULL;
@@ -1522,8 +1537,9 @@ static void omap_hsmmc_dma_cb(int lch, u16 ch_status, void *cb_data)
 		return;
 	}
 
-	dma_unmap_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
-		omap_hsmmc_get_dma_dir(host, data));
+	if (!data->host_cookie)
+		dma_unmap_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
+			omap_hsmmc_get_dma_dir(host, data));
 
 	req_in_progress = host->req_in_progress;
 	dma_ch = host->dma_ch;
@@ -1541,6 +1557,10 @@ static void omap_hsmmc_dma_cb(int lch, u16 ch_status, void *cb_data)
 	}
 }
 
+static int omap_hsmmc_pre_dma_transfer(struct omap_hsmmc_host *host,
+				       struct mmc_data *data,
+				       struct omap_hsmmc_next *next);
+
 /*
  * Routine to configure and start DMA for the MMC card
  */
@@ -1575,8 +1595,11 @@ static int omap_hsmmc_start_sdma_transfer(struct omap_hsmmc_host *host,
 		return ret;
 	}
 
-	host->dma_len = dma_map_sg(mmc_dev(host->mmc), data->sg,
-			data->sg_len, omap_hsmmc_get_dma_dir(host, data));
+	ret = omap_hsmmc_pre_dma_transfer(host, data, NULL);
+	if (ret) {
+		omap_free_dma(dma_ch);
+		return ret;
+	}
 	host->dma_ch = dma_ch;
 	host->dma_sg_idx = 0;
 
@@ -1586,17 +1609,15 @@ static int omap_hsmmc_start_sdma_transfer(struct omap_hsmmc_host *host,
 }
 
 static int mmc_populate_adma_desc_table(struct omap_hsmmc_host *host,
-		struct mmc_request *req, struct adma_desc_table *pdesc)
+		struct mmc_data *data, unsigned int dma_len,
+		struct adma_desc_table *pdesc)
 {
 	int i, j, dmalen;
 	int splitseg, xferaddr;
 	int numblocks = 0;
 	dma_addr_t dmaaddr;
-	struct mmc_data *data = req->data;
 
-	host->dma_len = dma_map_sg(mmc_dev(host->mmc), data->sg,
-			data->sg_len, omap_hsmmc_get_dma_dir(host, data));
-	for (i = 0, j = 0; i < host->dma_len; i++) {
+	for (i = 0, j = 0; i < dma_len; i++) {
 		dmaaddr = sg_dma_address(data->sg + i);
 		dmalen = sg_dma_len(data->sg + i);
 		numblocks += dmalen / data->blksz;
@@ -1634,14 +1655,91 @@ static int mmc_populate_adma_desc_table(struct omap_hsmmc_host *host,
 	WARN_ON((i + j - 1) > DMA_TABLE_NUM_ENTRIES);
 	dev_dbg(mmc_dev(host->mmc),
 		"ADMA table has %d entries from %d sglist\n",
-		i + j, host->dma_len);
+		i + j, dma_len);
 	return numblocks;
 }
 
+static inline struct adma_desc_table *
+omap_hsmmc_adma_desc(struct omap_hsmmc_host *host, int idx)
+{
+	return host->adma_table + idx * DMA_TABLE_NUM_ENTRIES;
+}
+
 static void omap_hsmmc_start_adma_transfer(struct omap_hsmmc_host *host)
 {
 	wmb();
-	OMAP_HSMMC_WRITE(host->base, ADMA_SAL, host->phy_adma_table);
+	OMAP_HSMMC_WRITE(host->base, ADMA_SAL,
+			 host->phy_adma_table + host->adma_idx * ADMA_TABLE_SZ);
+}
+
+/*
+ * Map the data buffers for DMA.  With @next set this runs from pre_req,
+ * possibly while another transfer is on the bus: the mapping (and for
+ * ADMA the descriptor table, built in the table the running transfer
+ * does not use) is parked in @next and tagged with a cookie.  Without
+ * @next the request is about to start, and a mapping prepared earlier
+ * is picked up instead of being redone.
+ */
+static int omap_hsmmc_pre_dma_transfer(struct omap_hsmmc_host *host,
+				       struct mmc_data *data,
+				       struct omap_hsmmc_next *next)
+{
+	int dma_len, idx;
+
+	if (!next && data->host_cookie &&
+	    data->host_cookie != host->next_data.cookie) {
+		dev_warn(mmc_dev(host->mmc), "invalid cookie: "
+			 "data->host_cookie %d host->next_data.cookie %d\n",
+			 data->host_cookie, host->next_data.cookie);
+		data->host_cookie = 0;
+	}
+
+	/* Check if next job is already prepared */
+	if (next || data->host_cookie != host->next_data.cookie) {
+		dma_len = dma_map_sg(mmc_dev(host->mmc), data->sg,
+				     data->sg_len,
+				     omap_hsmmc_get_dma_dir(host, data));
+		/*
+		 * pre_req may overlap the transfer using the current table;
+		 * a request started unprepared must avoid a table still
+		 * holding a prepared one.
+		 */
+		if (next)
+			idx = host->adma_idx ^ 1;
+		else if (host->next_data.dma_len)
+			idx = host->next_data.adma_idx ^ 1;
+		else
+			idx = host->adma_idx;
+	} else {
+		dma_len = host->next_data.dma_len;
+		idx = host->next_data.adma_idx;
+		host->next_data.dma_len = 0;
+	}
+
+	if (dma_len == 0)
+		return -EINVAL;
+
+	if (host->dma_type == ADMA_XFER) {
+		/* Descriptors were already built if the cookie matched */
+		if (next || !data->host_cookie) {
+			int numblks;
+
+			numblks = mmc_populate_adma_desc_table(host, data,
+					dma_len, omap_hsmmc_adma_desc(host, idx));
+			WARN_ON(numblks != data->blocks);
+		}
+	}
+
+	if (next) {
+		next->dma_len = dma_len;
+		next->adma_idx = idx;
+		data->host_cookie = ++next->cookie < 0 ? 1 : next->cookie;
+	} else {
+		host->dma_len = dma_len;
+		host->adma_idx = idx;
+	}
+
+	return 0;
 }
 
 static void set_data_timeout(struct omap_hsmmc_host *host,
@@ -1688,7 +1786,6 @@ static int
 omap_hsmmc_prepare_data(struct omap_hsmmc_host *host, struct mmc_request *req)
 {
 	int ret;
-	int numblks;
 
 	host->data = req->data;
 
@@ -1714,14 +1811,46 @@ omap_hsmmc_prepare_data(struct omap_hsmmc_host *host, struct mmc_request *req)
 			return ret;
 		}
 	} else if (host->dma_type == ADMA_XFER) {
-		numblks = mmc_populate_adma_desc_table(host,
-				req, host->adma_table);
-		WARN_ON(numblks != req->data->blocks);
+		ret = omap_hsmmc_pre_dma_transfer(host, req->data, NULL);
+		if (ret != 0)
+			return ret;
 		omap_hsmmc_start_adma_transfer(host);
 	}
 	return 0;
 }
 
+static void omap_hsmmc_post_req(struct mmc_host *mmc, struct mmc_request *mrq,
+				int err)
+{
+	struct omap_hsmmc_host *host = mmc_priv(mmc);
+	struct mmc_data *data = mrq->data;
+
+	if (host->dma_type && data->host_cookie) {
+		dma_unmap_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
+			     omap_hsmmc_get_dma_dir(host, data));
+		/* Cancelled before it was started: free its ADMA table */
+		if (data->host_cookie == host->next_data.cookie)
+			host->next_data.dma_len = 0;
+		data->host_cookie = 0;
+	}
+}
+
+static void omap_hsmmc_pre_req(struct mmc_host *mmc, struct mmc_request *mrq,
+			       bool is_first_req)
+{
+	struct omap_hsmmc_host *host = mmc_priv(mmc);
+
+	if (mrq->data->host_cookie) {
+		mrq->data->host_cookie = 0;
+		return;
+	}
+
+	if (host->dma_type)
+		if (omap_hsmmc_pre_dma_transfer(host, mrq->data,
+						&host->next_data))
+			mrq->data->host_cookie = 0;
+}
+
 /*
  * Request function. for read/write operation
  */
@@ -2250,6 +2379,8 @@ static int omap_hsmmc_disable_simple(struct mmc_host *mmc, int lazy)
 static const struct mmc_host_ops omap_hsmmc_ops = {
 	.enable = omap_hsmmc_enable_simple,
 	.disable = omap_hsmmc_disable_simple,
+	.post_req = omap_hsmmc_post_req,
+	.pre_req = omap_hsmmc_pre_req,
 	.request = omap_hsmmc_request,
 	.set_ios = omap_hsmmc_set_ios,
 	.get_cd = omap_hsmmc_get_cd,
@@ -2261,6 +2392,8 @@ static const struct mmc_host_ops omap_hsmmc_ops = {
 static const struct mmc_host_ops omap_hsmmc_ps_ops = {
 	.enable = omap_hsmmc_enable,
 	.disable = omap_hsmmc_disable,
+	.post_req = omap_hsmmc_post_req,
+	.pre_req = omap_hsmmc_pre_req,
 	.request = omap_hsmmc_request,
 	.set_ios = omap_hsmmc_set_ios,
 	.get_cd = omap_hsmmc_get_cd,
@@ -2411,6 +2544,7 @@ static int __init omap_hsmmc_probe(struct platform_device *pdev)
 	host->dma_type	= SDMA_XFER;
 	host->dev->dma_mask = &pdata->dma_mask;
 	host->dma_ch	= -1;
+	host->next_data.cookie = 1;
 	host->irq	= irq;
 	host->id	= pdev->id;
 	host->slot_id	= 0;
@@ -2516,7 +2650,8 @@ static int __init omap_hsmmc_probe(struct platform_device *pdev)
 		 * due to unset conherency mask
 		 */
 		host->adma_table = dma_alloc_coherent(NULL,
-			ADMA_TABLE_SZ, &host->phy_adma_table, 0);
+			ADMA_TABLE_SZ * ADMA_NUM_TABLES,
+			&host->phy_adma_table, 0);
 		if (host->adma_table != NULL)
 			host->dma_type = ADMA_XFER;
 	}
@@ -2669,7 +2804,7 @@ err_irq:
 	}
 err1:
 	if (host->adma_table != NULL)
-		dma_free_coherent(NULL, ADMA_TABLE_SZ,
+		dma_free_coherent(NULL, ADMA_TABLE_SZ * ADMA_NUM_TABLES,
 			host->adma_table, host->phy_adma_table);
 	iounmap(host->base);
 err_ioremap:
@@ -2700,7 +2835,8 @@ static int omap_hsmmc_remove(struct platform_device *pdev)
 		flush_work_sync(&host->mmc_carddetect_work);
 
 		if (host->adma_table != NULL)
-			dma_free_coherent(NULL, ADMA_TABLE_SZ,
+			dma_free_coherent(NULL,
+				ADMA_TABLE_SZ * ADMA_NUM_TABLES,
 				host->adma_table, host->phy_adma_table);
 
 		mmc_release_host(host->mmc);
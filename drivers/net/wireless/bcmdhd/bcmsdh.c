@@ -727,11 +727,11 @@ bcmsdh_gpioout(void *sdh, uint32 gpio, bool enab)
 }
 
 #ifdef BCMSDIOH_TXGLOM
-void
+int
 bcmsdh_glom_post(void *sdh, uint8 *frame, uint len)
 {
 	bcmsdh_info_t *bcmsdh = (bcmsdh_info_t *)sdh;
-	sdioh_glom_post(bcmsdh->sdioh, frame, len);
+	return sdioh_glom_post(bcmsdh->sdioh, frame, len);
 }
 
 void
@@ -741,11 +741,36 @@ bcmsdh_glom_clear(void *sdh)
 	sdioh_glom_clear(bcmsdh->sdioh);
 }
 
-uint
-bcmsdh_set_mode(void *sdh, uint mode)
+int
+bcmsdh_glom_send(void *sdh, uint32 addr, uint fn, uint flags)
 {
 	bcmsdh_info_t *bcmsdh = (bcmsdh_info_t *)sdh;
-	return (sdioh_set_mode(bcmsdh->sdioh, mode));
+	SDIOH_API_RC status;
+	uint incr_fix;
+	int err = 0;
+
+	ASSERT(bcmsdh);
+	ASSERT(bcmsdh->init_success);
+
+	BCMSDH_INFO(("%s:fun = %d, addr = 0x%x\n", __FUNCTION__, fn, addr));
+
+	/* Async not implemented yet */
+	ASSERT(!(flags & SDIO_REQ_ASYNC));
+	if (flags & SDIO_REQ_ASYNC)
+		return BCME_UNSUPPORTED;
+
+	if ((err = bcmsdhsdio_set_sbaddr_window(bcmsdh, addr, FALSE)))
+		return err;
+
+	addr &= SBSDIO_SB_OFT_ADDR_MASK;
+
+	incr_fix = (flags & SDIO_REQ_FIXED) ? SDIOH_DATA_FIX : SDIOH_DATA_INC;
+	if (flags & SDIO_REQ_4BYTE)
+		addr |= SBSDIO_SB_ACCESS_2_4B_FLAG;
+
+	status = sdioh_glom_send(bcmsdh->sdioh, incr_fix, fn, addr);
+
+	return (SDIOH_API_SUCCESS(status) ? 0 : BCME_ERROR);
 }
 
 bool
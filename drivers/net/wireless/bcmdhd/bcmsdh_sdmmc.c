@@ -76,6 +76,9 @@ uint sd_clock = 1;		/* Default to SD Clock turned ON */
 uint sd_hiok = FALSE;	/* Don't use hi-speed mode by default */
 uint sd_msglevel = 0x01;
 uint sd_use_dma = TRUE;
+#ifdef BCMSDIOH_TXGLOM
+uint sd_txglom = TRUE;		/* Allow tx glomming (scatter-gather cmd53) */
+#endif
 DHD_PM_RESUME_WAIT_INIT(sdioh_request_byte_wait);
 DHD_PM_RESUME_WAIT_INIT(sdioh_request_word_wait);
 DHD_PM_RESUME_WAIT_INIT(sdioh_request_packet_wait);
@@ -154,6 +157,12 @@ sdioh_attach(osl_t *osh, void *bar0, uint irq)
 	sd->use_client_ints = TRUE;
 	sd->client_block_size[0] = 64;
 	sd->use_rxchain = FALSE;
+#ifdef BCMSDIOH_TXGLOM
+	sd->glom_buf = MALLOC(sd->osh, SDIOH_SDMMC_GLOM_BUF_SIZE);
+	sd->use_txglom_dma = (sd->glom_buf != NULL);
+	if (!sd->glom_buf)
+		sd_err(("%s: no tx glom buffer, superframes go out with PIO\n", __FUNCTION__));
+#endif
 
 	gInstance->sd = sd;
 
@@ -216,6 +225,10 @@ sdioh_detach(osl_t *osh, sdioh_info_t *sd)
 		/* deregister irq */
 		sdioh_sdmmc_osfree(sd);
 
+#ifdef BCMSDIOH_TXGLOM
+		if (sd->glom_buf)
+			MFREE(sd->osh, sd->glom_buf, SDIOH_SDMMC_GLOM_BUF_SIZE);
+#endif
 		MFREE(sd->osh, sd, sizeof(sdioh_info_t));
 	}
 	return SDIOH_API_RC_SUCCESS;
@@ -1175,6 +1188,161 @@ sdioh_request_buffer(sdioh_info_t *sd, uint pio_dma, uint fix_inc, uint write, u
 	return (Status);
 }
 
+#ifdef BCMSDIOH_TXGLOM
+extern int
+sdioh_glom_post(sdioh_info_t *sd, uint8 *frame, uint len)
+{
+	if (sd->glom_count >= SDIOH_SDMMC_MAX_SG_ENTRIES) {
+		sd_err(("%s: glom list full, %d frames\n", __FUNCTION__, sd->glom_count));
+		return BCME_NORESOURCE;
+	}
+
+	sd->glom_frame[sd->glom_count] = frame;
+	sd->glom_len[sd->glom_count] = len;
+	sd->glom_count++;
+	sd->glom_ttl_len += len;
+
+	return BCME_OK;
+}
+
+extern void
+sdioh_glom_clear(sdioh_info_t *sd)
+{
+	sd->glom_count = 0;
+	sd->glom_ttl_len = 0;
+}
+
+extern bool
+sdioh_glom_enabled(void)
+{
+	return (sd_txglom != 0);
+}
+
+/*
+ * Write the posted glom list as one superframe.  The whole blocks go out in a
+ * single block mode cmd53; a sub-block tail (when the caller did not round the
+ * superframe up to a block) follows in byte mode, the same split
+ * sdioh_request_packet() makes for packet chains.
+ *
+ * The posted frames are only DHD_SDALIGN padded, so they cannot be handed to
+ * the host as one sg entry each: the omap_hsmmc sDMA path rejects sg entries
+ * that are not a block multiple and ADMA miscounts the blocks.  The block
+ * mode part is copied into glom_buf instead and goes out as a single entry.
+ */
+extern SDIOH_API_RC
+sdioh_glom_send(sdioh_info_t *sd, uint fix_inc, uint func, uint32 addr)
+{
+	bool fifo = (fix_inc == SDIOH_DATA_FIX);
+	uint32	SGCount = 0;
+	int err_ret = 0;
+	uint ttl_len, dma_len, sg_len, lft_len, frag_len, xfred_len;
+	uint blk_num, i;
+	struct mmc_request mmc_req;
+	struct mmc_command mmc_cmd;
+	struct mmc_data mmc_dat;
+
+	sd_trace(("%s: Enter\n", __FUNCTION__));
+
+	ASSERT(sd->glom_count);
+	DHD_PM_RESUME_WAIT(sdioh_request_packet_wait);
+	DHD_PM_RESUME_RETURN_ERROR(SDIOH_API_RC_FAIL);
+
+	ttl_len = sd->glom_ttl_len;
+	if (!sd->use_txglom_dma || ttl_len <= sd->client_block_size[func]) {
+		blk_num = 0;
+		dma_len = 0;
+	} else {
+		blk_num = MIN(ttl_len, SDIOH_SDMMC_GLOM_BUF_SIZE) / sd->client_block_size[func];
+		dma_len = blk_num * sd->client_block_size[func];
+	}
+	lft_len = ttl_len - dma_len;
+
+	sd_trace(("%s: W %dB (%d frames) to func%d:%08x, %d blks with DMA, %dB leftover\n",
+		__FUNCTION__, ttl_len, sd->glom_count, func, addr, blk_num, lft_len));
+
+	/* First frame, and offset into it, left over for PIO */
+	i = 0;
+	xfred_len = 0;
+
+	if (0 != dma_len) {
+		memset(&mmc_req, 0, sizeof(struct mmc_request));
+		memset(&mmc_cmd, 0, sizeof(struct mmc_command));
+		memset(&mmc_dat, 0, sizeof(struct mmc_data));
+
+		/* Gather the whole blocks into the bounce buffer */
+		for (sg_len = 0; sg_len < dma_len; SGCount++) {
+			frag_len = MIN(sd->glom_len[i], dma_len - sg_len);
+			bcopy(sd->glom_frame[i], sd->glom_buf + sg_len, frag_len);
+			sg_len += frag_len;
+			if (frag_len < sd->glom_len[i])
+				xfred_len = frag_len;
+			else
+				i++;
+		}
+		sg_init_one(&sd->sg_list[0], sd->glom_buf, dma_len);
+
+		mmc_dat.sg = sd->sg_list;
+		mmc_dat.sg_len = 1;
+		mmc_dat.blksz = sd->client_block_size[func];
+		mmc_dat.blocks = blk_num;
+		mmc_dat.flags = MMC_DATA_WRITE;
+
+		mmc_cmd.opcode = 53;		/* SD_IO_RW_EXTENDED */
+		mmc_cmd.arg = 1<<31;
+		mmc_cmd.arg |= (func & 0x7) << 28;
+		mmc_cmd.arg |= 1<<27;
+		mmc_cmd.arg |= fifo ? 0 : 1<<26;
+		mmc_cmd.arg |= (addr & 0x1FFFF) << 9;
+		mmc_cmd.arg |= blk_num & 0x1FF;
+		mmc_cmd.flags = MMC_RSP_SPI_R5 | MMC_RSP_R5 | MMC_CMD_ADTC;
+
+		mmc_req.cmd = &mmc_cmd;
+		mmc_req.data = &mmc_dat;
+
+		sdio_claim_host(gInstance->func[func]);
+		mmc_set_data_timeout(&mmc_dat, gInstance->func[func]->card);
+		mmc_wait_for_req(gInstance->func[func]->card->host, &mmc_req);
+		sdio_release_host(gInstance->func[func]);
+
+		err_ret = mmc_cmd.error? mmc_cmd.error : mmc_dat.error;
+		if (0 != err_ret) {
+			sd_err(("%s:CMD53 glom write of %d frames failed with code %d\n",
+			       __FUNCTION__, SGCount, err_ret));
+			sd_err(("%s:Disabling tx glom DMA and fire it with PIO\n",
+			       __FUNCTION__));
+			sd->use_txglom_dma = FALSE;
+			i = 0;
+			xfred_len = 0;
+			lft_len = ttl_len;
+			err_ret = 0;
+		} else if (!fifo) {
+			addr += dma_len;
+		}
+	}
+
+	/* PIO mode */
+	if (0 != lft_len) {
+		/* Claim host controller */
+		sdio_claim_host(gInstance->func[func]);
+		for (; (i < sd->glom_count) && !err_ret; i++) {
+			frag_len = sd->glom_len[i] - xfred_len;
+			err_ret = sdio_memcpy_toio(gInstance->func[func], addr,
+			                           sd->glom_frame[i] + xfred_len, frag_len);
+			if (err_ret)
+				sd_err(("%s: TX FAILED frame %d, addr=0x%05x, len=%d, ERR=%d\n",
+				       __FUNCTION__, i, addr, frag_len, err_ret));
+			xfred_len = 0;
+			if (!fifo)
+				addr += frag_len;
+		}
+		sdio_release_host(gInstance->func[func]);
+	}
+
+	sd_trace(("%s: Exit\n", __FUNCTION__));
+	return ((err_ret == 0) ? SDIOH_API_RC_SUCCESS : SDIOH_API_RC_FAIL);
+}
+#endif /* BCMSDIOH_TXGLOM */
+
 /* this function performs "abort" for both of host & device */
 extern int
 sdioh_abort(sdioh_info_t *sd, uint func)
@@ -524,6 +524,9 @@ extern int dhd_bus_membytes(dhd_pub_t *dhdp, bool set, uint32 address, uint8 *da
 extern void dhd_print_buf(void *pbuf, int len, int bytes_per_line);
 extern bool dhd_is_associated(dhd_pub_t *dhd, void *bss_buf, int *retval);
 extern uint dhd_bus_chip_id(dhd_pub_t *dhdp);
+#ifdef BCMSDIOH_TXGLOM
+extern void dhd_bus_txglom_enable(dhd_pub_t *dhdp, bool enable);
+#endif /* BCMSDIOH_TXGLOM */
 
 #if defined(KEEP_ALIVE)
 extern int dhd_keep_alive_onoff(dhd_pub_t *dhd);
@@ -145,6 +145,13 @@ MODULE_LICENSE("GPL v2");
 #define DBUS_RX_BUFFER_SIZE_DHD(net)	(net->mtu + net->hard_header_len + dhd->pub.hdrlen + 128)
 #endif
 
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 29))
+/* Hand rx frames to the stack from a NAPI poll, so that GRO can merge them */
+#define DHD_RX_NAPI
+/* Max frames waiting for the poll, same as the default netdev_max_backlog */
+#define DHD_RX_NAPI_QLEN	1000
+#endif /* LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 29) */
+
 #if LINUX_VERSION_CODE == KERNEL_VERSION(2, 6, 15)
 const char *
 print_tainted()
@@ -289,6 +296,14 @@ typedef struct dhd_info {
 #ifdef ARP_OFFLOAD_SUPPORT
 	u32 pend_ipaddr;
 #endif /* ARP_OFFLOAD_SUPPORT */
+
+#ifdef DHD_RX_NAPI
+	/* NAPI rx path, fed by dhd_rx_frame() */
+	bool rx_napi_enabled;
+	struct napi_struct rx_napi;
+	struct sk_buff_head rx_napi_queue;
+	struct net_device rx_napi_dev;	/* dummy, not registered */
+#endif /* DHD_RX_NAPI */
 } dhd_info_t;
 
 /* Definitions to provide path to the firmware and nvram
@@ -410,6 +425,18 @@ module_param(dhd_rxbound, uint, 0);
 extern uint dhd_deferred_tx;
 module_param(dhd_deferred_tx, uint, 0);
 
+#ifdef BCMSDIOH_TXGLOM
+/* Max frames per tx superframe, 0 => one cmd53 per frame */
+extern uint dhd_txglom;
+module_param(dhd_txglom, uint, 0);
+#endif /* BCMSDIOH_TXGLOM */
+
+#ifdef DHD_RX_NAPI
+/* NAPI budget (rx frames per poll), 0 => netif_rx() from the dpc */
+int dhd_napi_weight = 64;
+module_param(dhd_napi_weight, int, 0);
+#endif /* DHD_RX_NAPI */
+
 #ifdef BCMDBGFS
 extern void dhd_dbg_init(dhd_pub_t *dhdp);
 extern void dhd_dbg_remove(void);
@@ -1430,6 +1457,30 @@ dhd_txflowcontrol(dhd_pub_t *dhdp, int ifidx, bool state)
 	}
 }
 
+#ifdef DHD_RX_NAPI
+static int
+dhd_rx_napi_poll(struct napi_struct *napi, int budget)
+{
+	dhd_info_t *dhd = container_of(napi, dhd_info_t, rx_napi);
+	struct sk_buff *skb;
+	int work = 0;
+
+	while (work < budget && (skb = skb_dequeue(&dhd->rx_napi_queue)) != NULL) {
+		napi_gro_receive(napi, skb);
+		work++;
+	}
+
+	if (work < budget) {
+		napi_complete(napi);
+		/* Catch frames queued by the dpc while we were completing */
+		if (!skb_queue_empty(&dhd->rx_napi_queue))
+			napi_schedule(napi);
+	}
+
+	return work;
+}
+#endif /* DHD_RX_NAPI */
+
 void
 dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 {
@@ -1443,6 +1494,9 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 	wl_event_msg_t event;
 	int tout_rx = 0;
 	int tout_ctrl = 0;
+#ifdef DHD_RX_NAPI
+	bool napi_pending = FALSE;
+#endif /* DHD_RX_NAPI */
 
 	DHD_TRACE(("%s: Enter\n", __FUNCTION__));
 
@@ -1569,9 +1623,27 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 		if (ifp->net)
 			ifp->net->last_rx = jiffies;
 
+#ifdef DHD_RX_NAPI
+		if (dhd->rx_napi_enabled &&
+		    skb_queue_len(&dhd->rx_napi_queue) >= DHD_RX_NAPI_QLEN) {
+			dev_kfree_skb_any(skb);
+			dhdp->dstats.rx_dropped++;
+			continue;
+		}
+#endif /* DHD_RX_NAPI */
+
 		dhdp->dstats.rx_bytes += skb->len;
 		dhdp->rx_packets++; /* Local count */
 
+#ifdef DHD_RX_NAPI
+		if (dhd->rx_napi_enabled) {
+			/* The whole glom goes up in a single poll */
+			skb_queue_tail(&dhd->rx_napi_queue, skb);
+			napi_pending = TRUE;
+			continue;
+		}
+#endif /* DHD_RX_NAPI */
+
 		if (in_interrupt()) {
 			netif_rx(skb);
 		} else {
@@ -1593,6 +1665,15 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 		}
 	}
 
+#ifdef DHD_RX_NAPI
+	if (napi_pending) {
+		/* From the dpc thread, have the softirq run the poll right away */
+		local_bh_disable();
+		napi_schedule(&dhd->rx_napi);
+		local_bh_enable();
+	}
+#endif /* DHD_RX_NAPI */
+
 	DHD_OS_WAKE_LOCK_RX_TIMEOUT_ENABLE(dhdp, tout_rx);
 	DHD_OS_WAKE_LOCK_CTRL_TIMEOUT_ENABLE(dhdp, tout_ctrl);
 }
@@ -2689,6 +2770,16 @@ dhd_attach(osl_t *osh, struct dhd_bus *bus, uint bus_hdrlen)
 	spin_lock_init(&dhd->txqlock);
 	spin_lock_init(&dhd->dhd_lock);
 
+#ifdef DHD_RX_NAPI
+	if (dhd_napi_weight > 0) {
+		skb_queue_head_init(&dhd->rx_napi_queue);
+		init_dummy_netdev(&dhd->rx_napi_dev);
+		netif_napi_add(&dhd->rx_napi_dev, &dhd->rx_napi, dhd_rx_napi_poll,
+			dhd_napi_weight);
+		napi_enable(&dhd->rx_napi);
+		dhd->rx_napi_enabled = TRUE;
+	}
+#endif /* DHD_RX_NAPI */
 
 	if (dhd_add_if(dhd, 0, (void *)net, net->name, NULL, 0, 0) == DHD_BAD_IF)
 		goto fail;
@@ -3197,6 +3288,11 @@ dhd_preinit_ioctls(dhd_pub_t *dhd)
 		dhd_wl_ioctl_cmd(dhd, WLC_SET_VAR, iovbuf, sizeof(iovbuf), TRUE, 0);
 	}
 
+#ifdef BCMSDIOH_TXGLOM
+	/* Host to dongle glomming: batch queued tx frames into superframes */
+	dhd_bus_txglom_enable(dhd, TRUE);
+#endif /* BCMSDIOH_TXGLOM */
+
 	/* Setup timeout if Beacons are lost and roam is off to report link down */
 	bcm_mkiovar("bcn_timeout", (char *)&bcn_timeout, 4, iovbuf, sizeof(iovbuf));
 	dhd_wl_ioctl_cmd(dhd, WLC_SET_VAR, iovbuf, sizeof(iovbuf), TRUE, 0);
@@ -3762,6 +3858,12 @@ void dhd_detach(dhd_pub_t *dhdp)
 		PROC_STOP(&dhd->thr_sysioc_ctl);
 	}
 
+#ifdef DHD_RX_NAPI
+	/* No more frames up to the interfaces, they are going away */
+	if (dhd->rx_napi_enabled)
+		napi_disable(&dhd->rx_napi);
+#endif /* DHD_RX_NAPI */
+
 	/* delete all interfaces, start with virtual  */
 	if (dhd->dhd_state & DHD_ATTACH_STATE_ADD_IF) {
 		int i = 1;
@@ -3819,6 +3921,14 @@ void dhd_detach(dhd_pub_t *dhdp)
 #endif /* DHDTHREAD */
 		tasklet_kill(&dhd->tasklet);
 	}
+
+#ifdef DHD_RX_NAPI
+	if (dhd->rx_napi_enabled) {
+		skb_queue_purge(&dhd->rx_napi_queue);
+		netif_napi_del(&dhd->rx_napi);
+		dhd->rx_napi_enabled = FALSE;
+	}
+#endif /* DHD_RX_NAPI */
 	if (dhd->dhd_state & DHD_ATTACH_STATE_PROT_ATTACH) {
 		dhd_bus_detach(dhdp);
 
@@ -97,12 +97,29 @@
 
 /* Total length of frame header for dongle protocol */
 #define SDPCM_HDRLEN	(SDPCM_FRAMETAG_LEN + SDPCM_SWHEADER_LEN)
+#ifdef BCMSDIOH_TXGLOM
+#define SDPCM_TXGLOM_HDRLEN	SDPCM_HWEXT_LEN
+#else
+#define SDPCM_TXGLOM_HDRLEN	0
+#endif
 #ifdef SDTEST
-#define SDPCM_RESERVE	(SDPCM_HDRLEN + SDPCM_TEST_HDRLEN + DHD_SDALIGN)
+#define SDPCM_RESERVE	(SDPCM_HDRLEN + SDPCM_TXGLOM_HDRLEN + SDPCM_TEST_HDRLEN + DHD_SDALIGN)
 #else
-#define SDPCM_RESERVE	(SDPCM_HDRLEN + DHD_SDALIGN)
+#define SDPCM_RESERVE	(SDPCM_HDRLEN + SDPCM_TXGLOM_HDRLEN + DHD_SDALIGN)
 #endif
 
+#ifdef BCMSDIOH_TXGLOM
+/* Tx glom depth limits, in frames (must fit the host sg list) */
+#define SDPCM_MAXGLOM_SIZE	16
+#define SDPCM_DEFGLOM_SIZE	16
+#define SDPCM_MINGLOM_SIZE	2	/* Starting depth */
+
+/* Extra tx header bytes (the hw extension tag) while glomming */
+#define SDPCM_TXHWEXT(bus)	((bus)->txglom_enable ? SDPCM_HWEXT_LEN : 0)
+#else
+#define SDPCM_TXHWEXT(bus)	0
+#endif /* BCMSDIOH_TXGLOM */
+
 /* Space for header read, limit for data packets */
 #ifndef MAX_HDR_READ
 #define MAX_HDR_READ	32
@@ -293,6 +310,11 @@ typedef struct dhd_bus {
 	uint		rxglomfail;		/* Failed deglom attempts */
 	uint		rxglomframes;		/* Number of glom frames (superframes) */
 	uint		rxglompkts;		/* Number of packets from glom frames */
+#ifdef BCMSDIOH_TXGLOM
+	uint		txglomfail;		/* Failed tx superframe writes */
+	uint		txglomframes;		/* Number of tx superframes */
+	uint		txglompkts;		/* Number of packets sent in superframes */
+#endif /* BCMSDIOH_TXGLOM */
 	uint		f2rxhdrs;		/* Number of header reads */
 	uint		f2rxdata;		/* Number of frame data reads */
 	uint		f2txdata;		/* Number of f2 frame writes */
@@ -302,6 +324,11 @@ typedef struct dhd_bus {
 	uint32		ctrl_frame_len;
 	bool		ctrl_frame_stat;
 	uint32		rxint_mode;	/* rx interrupt mode */
+#ifdef BCMSDIOH_TXGLOM
+	bool		txglom_enable;		/* Dongle takes tx superframes */
+	uint		txglom_max;		/* Tx glom depth limit (frames) */
+	uint		txglom_depth;		/* Current (adaptive) tx glom depth */
+#endif /* BCMSDIOH_TXGLOM */
 } dhd_bus_t;
 
 /* clkstate */
@@ -327,6 +354,10 @@ extern void dhd_os_wd_timer(void *bus, uint wdtick);
 uint dhd_txbound;
 uint dhd_rxbound;
 uint dhd_txminmax = DHD_TXMINMAX;
+#ifdef BCMSDIOH_TXGLOM
+/* Max frames per tx superframe, 0 disables tx glomming */
+uint dhd_txglom = SDPCM_DEFGLOM_SIZE;
+#endif /* BCMSDIOH_TXGLOM */
 
 /* override the RAM size if possible */
 #define DONGLE_MIN_MEMSIZE (128 *1024)
@@ -929,6 +960,74 @@ dhd_enable_oob_intr(struct dhd_bus *bus, bool enable)
 }
 #endif /* defined(OOB_INTR_ONLY) */
 
+/* Push the alignment padding (and, when glomming, room for the hw extension
+ * tag) in front of the SDPCM header space; copies the packet to a new aligned
+ * one if it lacks the headroom.  Sets *pad to the bytes pushed.
+ */
+static int
+dhdsdio_txpkt_align(dhd_bus_t *bus, void **pktp, bool *free_pkt, uint *pad)
+{
+	osl_t *osh = bus->dhd->osh;
+	uint hwext = SDPCM_TXHWEXT(bus);
+	void *pkt = *pktp;
+	void *new;
+	uint pad1;
+
+	*pad = 0;
+	pad1 = ((uintptr)PKTDATA(osh, pkt) - hwext) % DHD_SDALIGN;
+	if (!(pad1 + hwext))
+		return BCME_OK;
+
+	if (PKTHEADROOM(osh, pkt) < (pad1 + hwext)) {
+		DHD_INFO(("%s: insufficient headroom %d for %d pad1\n",
+		          __FUNCTION__, (int)PKTHEADROOM(osh, pkt), pad1 + hwext));
+		bus->dhd->tx_realloc++;
+		new = PKTGET(osh, (PKTLEN(osh, pkt) + hwext + DHD_SDALIGN), TRUE);
+		if (!new) {
+			DHD_ERROR(("%s: couldn't allocate new %d-byte packet\n",
+			           __FUNCTION__, PKTLEN(osh, pkt) + hwext + DHD_SDALIGN));
+			return BCME_NOMEM;
+		}
+
+		PKTALIGN(osh, new, PKTLEN(osh, pkt) + hwext, DHD_SDALIGN);
+		bcopy(PKTDATA(osh, pkt), (uint8*)PKTDATA(osh, new) + hwext, PKTLEN(osh, pkt));
+		if (*free_pkt)
+			PKTFREE(osh, pkt, TRUE);
+		/* free the pkt if canned one is not used */
+		*free_pkt = TRUE;
+		*pktp = new;
+		pad1 = 0;
+	} else {
+		PKTPUSH(osh, pkt, pad1 + hwext);
+		ASSERT((pad1 + hwext + SDPCM_HDRLEN) <= (int) PKTLEN(osh, pkt));
+		if (pad1)
+			bzero(PKTDATA(osh, pkt), pad1 + hwext + SDPCM_HDRLEN);
+	}
+	ASSERT(pad1 < DHD_SDALIGN);
+	ASSERT(((uintptr)PKTDATA(osh, *pktp) % DHD_SDALIGN) == 0);
+
+	*pad = pad1 + hwext;
+	return BCME_OK;
+}
+
+#ifdef BCMSDIOH_TXGLOM
+/* Fill in the hw extension tag of a frame in a tx superframe: the frame length
+ * (less the frametag) with the last-frame flag, then the tail pad length.
+ * The hw tag of the first frame carries the length of the whole superframe.
+ */
+static void
+dhdsdio_txglom_tag(uint8 *frame, uint16 act_len, uint16 len, bool lastframe)
+{
+	uint32 hwheader1, hwheader2;
+
+	hwheader1 = (act_len - SDPCM_FRAMETAG_LEN) |
+	        ((lastframe ? SDPCM_HWEXT_LASTFRAME : 0) << 24);
+	hwheader2 = (len - act_len) << 16;
+	htol32_ua_store(hwheader1, frame + SDPCM_FRAMETAG_LEN);
+	htol32_ua_store(hwheader2, frame + SDPCM_FRAMETAG_LEN + sizeof(hwheader1));
+}
+#endif /* BCMSDIOH_TXGLOM */
+
 /* Writes a HW/SW header into the packet and sends it. */
 /* Assumes: (a) header space already there, (b) caller holds lock */
 static int
@@ -937,11 +1036,12 @@ dhdsdio_txpkt(dhd_bus_t *bus, void *pkt, uint chan, bool free_pkt)
 	int ret;
 	osl_t *osh;
 	uint8 *frame;
-	uint16 len, pad1 = 0;
+	uint16 len, act_len;
+	uint pad1 = 0;
+	uint hwext = SDPCM_TXHWEXT(bus);
 	uint32 swheader;
 	uint retries = 0;
 	bcmsdh_info_t *sdh;
-	void *new;
 	int i;
 #ifdef WLMEDIA_HTSF
 	char *p;
@@ -973,49 +1073,20 @@ dhdsdio_txpkt(dhd_bus_t *bus, void *pkt, uint chan, bool free_pkt)
 #endif /* WLMEDIA_HTSF */
 
 	/* Add alignment padding, allocate new packet if needed */
-	if ((pad1 = ((uintptr)frame % DHD_SDALIGN))) {
-		if (PKTHEADROOM(osh, pkt) < pad1) {
-			DHD_INFO(("%s: insufficient headroom %d for %d pad1\n",
-			          __FUNCTION__, (int)PKTHEADROOM(osh, pkt), pad1));
-			bus->dhd->tx_realloc++;
-			new = PKTGET(osh, (PKTLEN(osh, pkt) + DHD_SDALIGN), TRUE);
-			if (!new) {
-				DHD_ERROR(("%s: couldn't allocate new %d-byte packet\n",
-				           __FUNCTION__, PKTLEN(osh, pkt) + DHD_SDALIGN));
-				ret = BCME_NOMEM;
-				goto done;
-			}
-
-			PKTALIGN(osh, new, PKTLEN(osh, pkt), DHD_SDALIGN);
-			bcopy(PKTDATA(osh, pkt), PKTDATA(osh, new), PKTLEN(osh, pkt));
-			if (free_pkt)
-				PKTFREE(osh, pkt, TRUE);
-			/* free the pkt if canned one is not used */
-			free_pkt = TRUE;
-			pkt = new;
-			frame = (uint8*)PKTDATA(osh, pkt);
-			ASSERT(((uintptr)frame % DHD_SDALIGN) == 0);
-			pad1 = 0;
-		} else {
-			PKTPUSH(osh, pkt, pad1);
-			frame = (uint8*)PKTDATA(osh, pkt);
-
-			ASSERT((pad1 + SDPCM_HDRLEN) <= (int) PKTLEN(osh, pkt));
-			bzero(frame, pad1 + SDPCM_HDRLEN);
-		}
-	}
-	ASSERT(pad1 < DHD_SDALIGN);
+	if ((ret = dhdsdio_txpkt_align(bus, &pkt, &free_pkt, &pad1)) != BCME_OK)
+		goto done;
+	frame = (uint8*)PKTDATA(osh, pkt);
 
 	/* Hardware tag: 2 byte len followed by 2 byte ~len check (all LE) */
-	len = (uint16)PKTLEN(osh, pkt);
+	len = act_len = (uint16)PKTLEN(osh, pkt);
 	*(uint16*)frame = htol16(len);
 	*(((uint16*)frame) + 1) = htol16(~len);
 
 	/* Software tag: channel, sequence number, data offset */
 	swheader = ((chan << SDPCM_CHANNEL_SHIFT) & SDPCM_CHANNEL_MASK) | bus->tx_seq |
 	        (((pad1 + SDPCM_HDRLEN) << SDPCM_DOFFSET_SHIFT) & SDPCM_DOFFSET_MASK);
-	htol32_ua_store(swheader, frame + SDPCM_FRAMETAG_LEN);
-	htol32_ua_store(0, frame + SDPCM_FRAMETAG_LEN + sizeof(swheader));
+	htol32_ua_store(swheader, frame + SDPCM_FRAMETAG_LEN + hwext);
+	htol32_ua_store(0, frame + SDPCM_FRAMETAG_LEN + hwext + sizeof(swheader));
 
 #ifdef DHD_DEBUG
 	if (PKTPRIO(pkt) < ARRAYSIZE(tx_packets)) {
@@ -1054,6 +1125,15 @@ dhdsdio_txpkt(dhd_bus_t *bus, void *pkt, uint chan, bool free_pkt)
 #endif
 	}
 
+#ifdef BCMSDIOH_TXGLOM
+	/* In glom mode a lone frame is a superframe of one */
+	if (hwext) {
+		dhdsdio_txglom_tag(frame, act_len, len, TRUE);
+		*(uint16*)frame = htol16(len);
+		*(((uint16*)frame) + 1) = htol16(~len);
+	}
+#endif /* BCMSDIOH_TXGLOM */
+
 	do {
 		ret = dhd_bcmsdh_send_buf(bus, bcmsdh_cur_sbwad(sdh), SDIO_FUNC_2, F2SYNC,
 		                          frame, len, pkt, NULL, NULL);
@@ -1236,6 +1316,242 @@ dhd_bus_txdata(struct dhd_bus *bus, void *pkt)
 	return ret;
 }
 
+#ifdef BCMSDIOH_TXGLOM
+/* Writes HW/SW headers into a batch of data packets and sends them as one
+ * superframe (a single scatter-gather cmd53).  Each frame takes its own
+ * sequence number; padding is posted with each frame so the dongle can
+ * split them again.  Completes and frees all the packets.
+ */
+static int
+dhdsdio_txglom(dhd_bus_t *bus, void **pkts, uint num)
+{
+	osl_t *osh = bus->dhd->osh;
+	bcmsdh_info_t *sdh = bus->sdh;
+	uint pad[SDPCM_MAXGLOM_SIZE];
+	uint datalen[SDPCM_MAXGLOM_SIZE];
+	uint8 *frame;
+	uint16 act_len, len;
+	uint ttl_len = 0;
+	uint32 swheader;
+	uint retries = 0;
+	uint chan = SDPCM_DATA_CHANNEL;
+	uint i, nready;
+	bool free_pkt;
+	int ret = BCME_OK;
+
+	ASSERT(num && (num <= SDPCM_MAXGLOM_SIZE));
+
+#ifdef SDTEST
+	if (bus->ext_loop)
+		chan = SDPCM_TEST_CHANNEL;
+#endif
+
+	/* Make room for the headers; stop (and send what we have) if out of memory */
+	for (nready = 0; nready < num; nready++) {
+		datalen[nready] = PKTLEN(osh, pkts[nready]) - SDPCM_HDRLEN;
+		free_pkt = TRUE;
+		if (dhdsdio_txpkt_align(bus, &pkts[nready], &free_pkt, &pad[nready]))
+			break;
+	}
+	for (i = nready; i < num; i++)
+		pad[i] = 0;
+
+	for (i = 0; i < nready; i++) {
+		frame = (uint8*)PKTDATA(osh, pkts[i]);
+		len = act_len = (uint16)PKTLEN(osh, pkts[i]);
+
+		/* Hardware tag: 2 byte len followed by 2 byte ~len check (all LE) */
+		*(uint16*)frame = htol16(len);
+		*(((uint16*)frame) + 1) = htol16(~len);
+
+		/* Software tag: channel, sequence number, data offset */
+		swheader = ((chan << SDPCM_CHANNEL_SHIFT) & SDPCM_CHANNEL_MASK) |
+		        ((bus->tx_seq + i) % SDPCM_SEQUENCE_WRAP) |
+		        (((pad[i] + SDPCM_HDRLEN) << SDPCM_DOFFSET_SHIFT) & SDPCM_DOFFSET_MASK);
+		htol32_ua_store(swheader, frame + SDPCM_FRAMETAG_LEN + SDPCM_HWEXT_LEN);
+		htol32_ua_store(0, frame + SDPCM_FRAMETAG_LEN + SDPCM_HWEXT_LEN +
+		                sizeof(swheader));
+
+		if (i < (nready - 1)) {
+			/* Frames inside the superframe start aligned */
+			if (len % DHD_SDALIGN)
+				len += DHD_SDALIGN - (len % DHD_SDALIGN);
+		} else if (bus->roundup && bus->blocksize &&
+		           ((ttl_len + len) > bus->blocksize)) {
+			/* Raise the superframe to next SDIO block to eliminate tail command */
+			uint16 pad2 = bus->blocksize - ((ttl_len + len) % bus->blocksize);
+			if ((pad2 <= bus->roundup) && (pad2 < bus->blocksize))
+				len += pad2;
+			else if (len % DHD_SDALIGN)
+				len += DHD_SDALIGN - (len % DHD_SDALIGN);
+		} else if (len % DHD_SDALIGN) {
+			len += DHD_SDALIGN - (len % DHD_SDALIGN);
+		}
+
+		/* Some controllers have trouble with odd bytes -- round to even */
+		if (forcealign && (len & (ALIGNMENT - 1)))
+			len = ROUNDUP(len, ALIGNMENT);
+
+		dhdsdio_txglom_tag(frame, act_len, len, (i == (nready - 1)));
+
+#ifdef DHD_DEBUG
+		if (PKTPRIO(pkts[i]) < ARRAYSIZE(tx_packets)) {
+			tx_packets[PKTPRIO(pkts[i])]++;
+		}
+		if (DHD_BYTES_ON() && DHD_DATA_ON()) {
+			prhex("Tx Frame", frame, act_len);
+		} else if (DHD_HDRS_ON()) {
+			prhex("TxHdr", frame, MIN(act_len, 20));
+		}
+#endif
+
+		if ((ret = bcmsdh_glom_post(sdh, frame, len)) != BCME_OK)
+			break;
+		ttl_len += len;
+	}
+
+	if (ret) {
+		bcmsdh_glom_clear(sdh);
+		bus->txglomfail++;
+	} else if (nready) {
+		/* The first hw tag covers the whole superframe */
+		frame = (uint8*)PKTDATA(osh, pkts[0]);
+		*(uint16*)frame = htol16((uint16)ttl_len);
+		*(((uint16*)frame) + 1) = htol16(~ttl_len);
+
+		do {
+			ret = bcmsdh_glom_send(sdh, bcmsdh_cur_sbwad(sdh), SDIO_FUNC_2, F2SYNC);
+			bus->f2txdata++;
+			ASSERT(ret != BCME_PENDING);
+
+			if (ret < 0) {
+				/* On failure, abort the command and terminate the frame */
+				DHD_INFO(("%s: sdio error %d, abort command and terminate frame.\n",
+				          __FUNCTION__, ret));
+				bus->tx_sderrs++;
+
+				bcmsdh_abort(sdh, SDIO_FUNC_2);
+				bcmsdh_cfg_write(sdh, SDIO_FUNC_1, SBSDIO_FUNC1_FRAMECTRL,
+				                 SFC_WF_TERM, NULL);
+				bus->f1regdata++;
+
+				for (i = 0; i < 3; i++) {
+					uint8 hi, lo;
+					hi = bcmsdh_cfg_read(sdh, SDIO_FUNC_1,
+					                     SBSDIO_FUNC1_WFRAMEBCHI, NULL);
+					lo = bcmsdh_cfg_read(sdh, SDIO_FUNC_1,
+					                     SBSDIO_FUNC1_WFRAMEBCLO, NULL);
+					bus->f1regdata += 2;
+					if ((hi == 0) && (lo == 0))
+						break;
+				}
+			}
+			if (ret == 0) {
+				bus->tx_seq = (bus->tx_seq + nready) % SDPCM_SEQUENCE_WRAP;
+			}
+		} while ((ret < 0) && retrydata && retries++ < TXRETRIES);
+
+		bcmsdh_glom_clear(sdh);
+
+		if (ret) {
+			bus->txglomfail++;
+		} else if (nready > 1) {
+			bus->txglomframes++;
+			bus->txglompkts += nready;
+		}
+	}
+
+	for (i = 0; i < num; i++) {
+		void *pkt = pkts[i];
+		bool sent = (i < nready) && (ret == 0);
+
+		if (sent)
+			bus->dhd->dstats.tx_bytes += datalen[i];
+		else
+			bus->dhd->tx_errors++;
+
+		/* restore pkt buffer pointer before calling tx complete routine */
+		PKTPULL(osh, pkt, SDPCM_HDRLEN + pad[i]);
+#ifdef PROP_TXSTATUS
+		if (bus->dhd->wlfc_state) {
+			dhd_os_sdunlock(bus->dhd);
+			dhd_wlfc_txcomplete(bus->dhd, pkt, sent);
+			dhd_os_sdlock(bus->dhd);
+		} else {
+#endif /* PROP_TXSTATUS */
+		dhd_txcomplete(bus->dhd, pkt, !sent);
+		PKTFREE(osh, pkt, TRUE);
+#ifdef PROP_TXSTATUS
+		}
+#endif
+	}
+
+	return (nready == num) ? ret : BCME_NOMEM;
+}
+
+/* Glom mode flavour of the dhdsdio_sendfromq() loop: every pass drains up to
+ * txglom_depth frames into one superframe.  The depth follows the backlog:
+ * it doubles while full superframes still leave frames queued behind them,
+ * eases off by one when the queue drains before a superframe fills, and
+ * halves on sdio errors, so light traffic doesn't hold the bus (and the
+ * rx and ctl paths behind it) for big transfers.
+ */
+static uint
+dhdsdio_sendfromq_glom(dhd_bus_t *bus, uint8 tx_prec_map, uint maxframes)
+{
+	void *pkts[SDPCM_MAXGLOM_SIZE];
+	uint32 intstatus = 0;
+	uint retries = 0;
+	int ret, prec_out;
+	uint cnt = 0;
+	uint num, limit;
+
+	sdpcmd_regs_t *regs = bus->regs;
+
+	/* Send superframes until the limit or some other event */
+	while ((cnt < maxframes) && DATAOK(bus)) {
+		/* Leave a sequence number free for control frames, as DATAOK() does */
+		limit = MIN(bus->txglom_depth, maxframes - cnt);
+		limit = MIN(limit, (uint)(uint8)(bus->tx_max - bus->tx_seq) - 1);
+
+		dhd_os_sdlock_txq(bus->dhd);
+		for (num = 0; num < limit; num++) {
+			if ((pkts[num] = pktq_mdeq(&bus->txq, tx_prec_map, &prec_out)) == NULL)
+				break;
+		}
+		dhd_os_sdunlock_txq(bus->dhd);
+		if (num == 0)
+			break;
+
+		ret = dhdsdio_txglom(bus, pkts, num);
+		cnt += num;
+
+		if (ret) {
+			bus->txglom_depth = MAX(bus->txglom_depth / 2, 1);
+		} else if (num == bus->txglom_depth) {
+			if (pktq_mlen(&bus->txq, tx_prec_map) >= num)
+				bus->txglom_depth = MIN(bus->txglom_depth * 2, bus->txglom_max);
+		} else if ((num < limit) && (bus->txglom_depth > SDPCM_MINGLOM_SIZE)) {
+			bus->txglom_depth--;
+		}
+
+		/* In poll mode, need to check for other events */
+		if (!bus->intr)
+		{
+			/* Check device status, signal pending interrupt */
+			R_SDREG(intstatus, &regs->intstatus, retries);
+			bus->f2txdata++;
+			if (bcmsdh_regfail(bus->sdh))
+				break;
+			if (intstatus & bus->hostintmask)
+				bus->ipend = TRUE;
+		}
+	}
+
+	return cnt;
+}
+#endif /* BCMSDIOH_TXGLOM */
+
 static uint
 dhdsdio_sendfromq(dhd_bus_t *bus, uint maxframes)
 {
@@ -1254,6 +1570,11 @@ dhdsdio_sendfromq(dhd_bus_t *bus, uint maxframes)
 
 	tx_prec_map = ~bus->flowcontrol;
 
+#ifdef BCMSDIOH_TXGLOM
+	if (bus->txglom_enable)
+		cnt = dhdsdio_sendfromq_glom(bus, tx_prec_map, maxframes);
+	else
+#endif /* BCMSDIOH_TXGLOM */
 	/* Send frames until the limit or some other event */
 	for (cnt = 0; (cnt < maxframes) && DATAOK(bus); cnt++) {
 		dhd_os_sdlock_txq(bus->dhd);
@@ -1305,6 +1626,7 @@ dhd_bus_txctl(struct dhd_bus *bus, uchar *msg, uint msglen)
 	uint retries = 0;
 	bcmsdh_info_t *sdh = bus->sdh;
 	uint8 doff = 0;
+	uint hwext = SDPCM_TXHWEXT(bus);
 	int ret = -1;
 	int i;
 
@@ -1314,8 +1636,8 @@ dhd_bus_txctl(struct dhd_bus *bus, uchar *msg, uint msglen)
 		return -EIO;
 
 	/* Back the pointer to make a room for bus header */
-	frame = msg - SDPCM_HDRLEN;
-	len = (msglen += SDPCM_HDRLEN);
+	frame = msg - SDPCM_HDRLEN - hwext;
+	len = (msglen += SDPCM_HDRLEN + hwext);
 
 	/* Add alignment padding (optional for ctl frames) */
 	if (dhd_alignctl) {
@@ -1323,11 +1645,11 @@ dhd_bus_txctl(struct dhd_bus *bus, uchar *msg, uint msglen)
 			frame -= doff;
 			len += doff;
 			msglen += doff;
-			bzero(frame, doff + SDPCM_HDRLEN);
+			bzero(frame, doff + SDPCM_HDRLEN + hwext);
 		}
 		ASSERT(doff < DHD_SDALIGN);
 	}
-	doff += SDPCM_HDRLEN;
+	doff += SDPCM_HDRLEN + hwext;
 
 	/* Round send length to next SDIO block */
 	if (bus->roundup && bus->blocksize && (len > bus->blocksize)) {
@@ -1360,8 +1682,17 @@ dhd_bus_txctl(struct dhd_bus *bus, uchar *msg, uint msglen)
 	/* Software tag: channel, sequence number, data offset */
 	swheader = ((SDPCM_CONTROL_CHANNEL << SDPCM_CHANNEL_SHIFT) & SDPCM_CHANNEL_MASK)
 	        | bus->tx_seq | ((doff << SDPCM_DOFFSET_SHIFT) & SDPCM_DOFFSET_MASK);
-	htol32_ua_store(swheader, frame + SDPCM_FRAMETAG_LEN);
-	htol32_ua_store(0, frame + SDPCM_FRAMETAG_LEN + sizeof(swheader));
+	htol32_ua_store(swheader, frame + SDPCM_FRAMETAG_LEN + hwext);
+	htol32_ua_store(0, frame + SDPCM_FRAMETAG_LEN + hwext + sizeof(swheader));
+
+#ifdef BCMSDIOH_TXGLOM
+	/* In glom mode a lone frame is a superframe of one */
+	if (hwext) {
+		dhdsdio_txglom_tag(frame, msglen, len, TRUE);
+		*(uint16*)frame = htol16(len);
+		*(((uint16*)frame) + 1) = htol16(~len);
+	}
+#endif /* BCMSDIOH_TXGLOM */
 
 	if (!TXCTLOK(bus)) {
 		DHD_INFO(("%s: No bus credit bus->tx_max %d, bus->tx_seq %d\n",
@@ -1642,6 +1973,11 @@ dhd_bus_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf)
 	            bus->fc_rcvd, bus->fc_xoff, bus->fc_xon);
 	bcm_bprintf(strbuf, "rxglomfail %d, rxglomframes %d, rxglompkts %d\n",
 	            bus->rxglomfail, bus->rxglomframes, bus->rxglompkts);
+#ifdef BCMSDIOH_TXGLOM
+	bcm_bprintf(strbuf, "txglomfail %d, txglomframes %d, txglompkts %d, txglom %d depth %d/%d\n",
+	            bus->txglomfail, bus->txglomframes, bus->txglompkts,
+	            bus->txglom_enable, bus->txglom_depth, bus->txglom_max);
+#endif /* BCMSDIOH_TXGLOM */
 	bcm_bprintf(strbuf, "f2rx (hdrs/data) %d (%d/%d), f2tx %d f1regs %d\n",
 	            (bus->f2rxhdrs + bus->f2rxdata), bus->f2rxhdrs, bus->f2rxdata,
 	            bus->f2txdata, bus->f1regdata);
@@ -1659,6 +1995,13 @@ dhd_bus_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf)
 		dhd_dump_pct(strbuf, ", pkts/glom", bus->rxglompkts, bus->rxglomframes);
 		bcm_bprintf(strbuf, "\n");
 
+#ifdef BCMSDIOH_TXGLOM
+		dhd_dump_pct(strbuf, "Tx: glom pct", (100 * bus->txglompkts),
+		             bus->dhd->tx_packets);
+		dhd_dump_pct(strbuf, ", pkts/glom", bus->txglompkts, bus->txglomframes);
+		bcm_bprintf(strbuf, "\n");
+#endif /* BCMSDIOH_TXGLOM */
+
 		dhd_dump_pct(strbuf, "Tx: pkts/f2wr", bus->dhd->tx_packets, bus->f2txdata);
 		dhd_dump_pct(strbuf, ", pkts/f1sd", bus->dhd->tx_packets, bus->f1regdata);
 		dhd_dump_pct(strbuf, ", pkts/sd", bus->dhd->tx_packets,
@@ -1708,6 +2051,9 @@ dhd_bus_clearcounts(dhd_pub_t *dhdp)
 	bus->rx_hdrfail = bus->rx_badhdr = bus->rx_badseq = 0;
 	bus->tx_sderrs = bus->fc_rcvd = bus->fc_xoff = bus->fc_xon = 0;
 	bus->rxglomfail = bus->rxglomframes = bus->rxglompkts = 0;
+#ifdef BCMSDIOH_TXGLOM
+	bus->txglomfail = bus->txglomframes = bus->txglompkts = 0;
+#endif /* BCMSDIOH_TXGLOM */
 	bus->f2rxhdrs = bus->f2rxdata = bus->f2txdata = bus->f1regdata = 0;
 }
 
@@ -3070,6 +3416,10 @@ dhd_bus_stop(struct dhd_bus *bus, bool enforce_mutex)
 	bus->tx_seq = bus->rx_seq = 0;
 
 	bus->tx_max = 4;
+#ifdef BCMSDIOH_TXGLOM
+	/* A restarted dongle expects plain frames until glomming is renegotiated */
+	bus->txglom_enable = FALSE;
+#endif /* BCMSDIOH_TXGLOM */
 
 	if (enforce_mutex)
 		dhd_os_sdunlock(bus->dhd);
@@ -4616,7 +4966,7 @@ clkwait:
 
 	if (TXCTLOK(bus) && bus->ctrl_frame_stat && (bus->clkstate == CLK_AVAIL))  {
 		int ret, i;
-		uint8* frame_seq = bus->ctrl_frame_buf + SDPCM_FRAMETAG_LEN;
+		uint8* frame_seq = bus->ctrl_frame_buf + SDPCM_FRAMETAG_LEN + SDPCM_TXHWEXT(bus);
 
 		if (*frame_seq != bus->tx_seq) {
 			DHD_INFO(("%s IOCTL frame seq lag detected!"
@@ -6317,6 +6667,41 @@ dhd_bus_devreset(dhd_pub_t *dhdp, uint8 flag)
 	return bcmerror;
 }
 
+#ifdef BCMSDIOH_TXGLOM
+/* Ask the dongle to take tx superframes.  Stays with single frames if glomming
+ * is turned off, the host controller glue can't do it or the firmware refuses.
+ */
+void
+dhd_bus_txglom_enable(dhd_pub_t *dhdp, bool enable)
+{
+	dhd_bus_t *bus = dhdp->bus;
+	char iovbuf[32];
+	uint32 rxglom = 1;
+	int ret;
+
+	if (!dhd_txglom || !bcmsdh_glom_enabled())
+		enable = FALSE;
+
+	if (enable) {
+		bcm_mkiovar("bus:rxglom", (char *)&rxglom, 4, iovbuf, sizeof(iovbuf));
+		ret = dhd_wl_ioctl_cmd(dhdp, WLC_SET_VAR, iovbuf, sizeof(iovbuf), TRUE, 0);
+		if (ret < 0) {
+			DHD_INFO(("%s: dongle refused tx glomming, err %d\n", __FUNCTION__, ret));
+			enable = FALSE;
+		}
+	}
+
+	dhd_os_sdlock(dhdp);
+	bus->txglom_enable = enable;
+	bus->txglom_max = MIN(dhd_txglom, SDPCM_MAXGLOM_SIZE);
+	bus->txglom_depth = MIN(SDPCM_MINGLOM_SIZE, bus->txglom_max);
+	dhd_os_sdunlock(dhdp);
+
+	DHD_INFO(("%s: tx glom %s, max %d frames\n", __FUNCTION__,
+	          enable ? "enabled" : "disabled", bus->txglom_max));
+}
+#endif /* BCMSDIOH_TXGLOM */
+
 /* Get Chip ID version */
 uint dhd_bus_chip_id(dhd_pub_t *dhdp)
 {
@@ -125,4 +125,12 @@ extern bool sdioh_gpioin(sdioh_info_t *sd, uint32 gpio);
 extern SDIOH_API_RC sdioh_gpioouten(sdioh_info_t *sd, uint32 gpio);
 extern SDIOH_API_RC sdioh_gpioout(sdioh_info_t *sd, uint32 gpio, bool enab);
 
+#ifdef BCMSDIOH_TXGLOM
+/* Tx glomming: frames posted to the glom list go out as one scatter-gather cmd53 */
+extern int sdioh_glom_post(sdioh_info_t *sd, uint8 *frame, uint len);
+extern void sdioh_glom_clear(sdioh_info_t *sd);
+extern SDIOH_API_RC sdioh_glom_send(sdioh_info_t *sd, uint fix_inc, uint fnc_num, uint32 addr);
+extern bool sdioh_glom_enabled(void);
+#endif /* BCMSDIOH_TXGLOM */
+
 #endif /* _sdio_api_h_ */
@@ -131,6 +131,18 @@ extern int bcmsdh_recv_buf(void *sdh, uint32 addr, uint fn, uint flags,
                            uint8 *buf, uint nbytes, void *pkt,
                            bcmsdh_cmplt_fn_t complete, void *handle);
 
+#ifdef BCMSDIOH_TXGLOM
+/* Tx glomming: queue frames with bcmsdh_glom_post(), then write them all with a
+ * single (scatter-gather) cmd53 via bcmsdh_glom_send().  The glom list stays
+ * posted across a failed send so the caller can retry; bcmsdh_glom_clear()
+ * releases it.  bcmsdh_glom_post() returns BCME_NORESOURCE when the list is full.
+ */
+extern int bcmsdh_glom_post(void *sdh, uint8 *frame, uint len);
+extern void bcmsdh_glom_clear(void *sdh);
+extern int bcmsdh_glom_send(void *sdh, uint32 addr, uint fn, uint flags);
+extern bool bcmsdh_glom_enabled(void);
+#endif /* BCMSDIOH_TXGLOM */
+
 /* Flags bits */
 #define SDIO_REQ_4BYTE	0x1	/* Four-byte target (backplane) width (vs. two-byte) */
 #define SDIO_REQ_FIXED	0x2	/* Fixed address (FIFO) (vs. incrementing address) */
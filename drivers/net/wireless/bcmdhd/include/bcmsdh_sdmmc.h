@@ -86,6 +86,16 @@ struct sdioh_info {
 #define SDIOH_SDMMC_MAX_SG_ENTRIES	32
 	struct scatterlist sg_list[SDIOH_SDMMC_MAX_SG_ENTRIES];
 	bool		use_rxchain;
+#ifdef BCMSDIOH_TXGLOM
+	/* Tx glom list: frames posted for the next scatter-gather cmd53 */
+	uint8		*glom_frame[SDIOH_SDMMC_MAX_SG_ENTRIES];
+	uint		glom_len[SDIOH_SDMMC_MAX_SG_ENTRIES];
+	uint		glom_count;		/* Frames posted */
+	uint		glom_ttl_len;		/* Bytes posted */
+	bool		use_txglom_dma;		/* Cleared if the host rejects the transfer */
+#define SDIOH_SDMMC_GLOM_BUF_SIZE	(32 * 1024)
+	uint8		*glom_buf;		/* Block aligned bounce for the DMA part */
+#endif /* BCMSDIOH_TXGLOM */
 };
 
 /************************************************************
@@ -290,4 +290,10 @@ typedef volatile struct {
 /* HW frame tag */
 #define SDPCM_FRAMETAG_LEN	4	/* HW frametag: 2 bytes len, 2 bytes check val */
 
+/* HW extension tag, present after the frametag on host tx when glomming */
+#define SDPCM_HWEXT_LEN		8	/* 2 bytes frame len, 1 byte rsvd, 1 byte flags,
+					 * 2 bytes rsvd, 2 bytes pad len
+					 */
+#define SDPCM_HWEXT_LASTFRAME	0x01	/* flags: last frame of the superframe */
+
 #endif	/* _sbsdpcmdev_h_ */
@@ -34,6 +34,8 @@
 #include <linux/idr.h>
 #include <linux/i2c.h>
 #include <linux/slab.h>
+#include <linux/gpio.h>
+#include <linux/interrupt.h>
 #include <asm/unaligned.h>
 
 #include <linux/power/bq27x00_battery.h>
@@ -52,6 +54,14 @@
 
 #define INVALID_REG_ADDR		0xFF
 
+/*
+ * The standard commands from Temperature() up to InternalTemperature()
+ * can be fetched with a single incremental read. Everything we poll
+ * lives in there, so one transaction gives a coherent snapshot.
+ */
+#define BQ27x00_BLOCK_START		0x06
+#define BQ27x00_BLOCK_LEN		(0x38 - BQ27x00_BLOCK_START)
+
 enum bq27x00_reg_index {
 	BQ27x00_REG_TEMP = 0,
 	BQ27x00_REG_INT_TEMP,
@@ -135,6 +145,8 @@ struct bq27x00_access_methods {
 	int (*read)(struct bq27x00_device_info *di, u8 reg, bool single);
 	int (*write)(struct bq27x00_device_info *di, u8 reg, int value,
 			bool single);
+	int (*read_block)(struct bq27x00_device_info *di, u8 reg,
+			unsigned char *buf, size_t len);
 };
 
 static int bq27x00_dump_dataflash(struct bq27x00_device_info *di);
@@ -153,7 +165,14 @@ struct bq27x00_reg_cache {
 	int capacity;
 	int flags;
 
+	/*
+	 * Instantaneous values, likely to be different even between two
+	 * consecutive reads. Not used for change detection, keep them last.
+	 */
 	int current_now;
+	int voltage;
+	int charge_now;
+	int energy;
 };
 
 struct bq27x00_device_info {
@@ -169,6 +188,15 @@ struct bq27x00_device_info {
 
 	unsigned long last_update;
 	struct delayed_work work;
+	struct mutex update_lock;
+	/* register block being decoded by bq27x00_update(), or NULL */
+	const unsigned char *snapshot;
+
+	int soc_gpio;
+	int soc_irq;
+	int bat_low_gpio;
+	int bat_low_irq;
+	bool irq_driven;
 
 	struct power_supply	bat;
 
@@ -204,6 +232,16 @@ module_param(poll_interval, uint, 0644);
 MODULE_PARM_DESC(poll_interval, "battery poll interval in seconds - " \
 				"0 disables polling");
 
+static unsigned int irq_poll_interval = 1800;
+module_param(irq_poll_interval, uint, 0644);
+MODULE_PARM_DESC(irq_poll_interval, "maximum age of the battery data in " \
+				"seconds when SOC_INT/BAT_LOW are wired up - " \
+				"0 disables polling");
+
+static bool block_read = true;
+module_param(block_read, bool, 0644);
+MODULE_PARM_DESC(block_read, "read all registers in one i2c transaction");
+
 /*
  * Common code for BQ27x00 devices
  */
@@ -213,11 +251,24 @@ static inline int bq27x00_read(struct bq27x00_device_info *di, int reg_index,
 {
 	int val;
 
+	u8 reg;
+
 	/* Reports 0 for invalid/missing registers */
 	if (!di || !di->regs || di->regs[reg_index] == INVALID_REG_ADDR)
 		return 0;
 
-	val = di->bus.read(di, di->regs[reg_index], single);
+	reg = di->regs[reg_index];
+
+	/* decode from the block snapshot when the register is part of it */
+	if (di->snapshot && reg >= BQ27x00_BLOCK_START &&
+	    reg + (single ? 1 : 2) <= BQ27x00_BLOCK_START + BQ27x00_BLOCK_LEN) {
+		const unsigned char *data =
+				di->snapshot + reg - BQ27x00_BLOCK_START;
+
+		return single ? data[0] : get_unaligned_le16(data);
+	}
+
+	val = di->bus.read(di, reg, single);
 
 	return val;
 }
@@ -351,10 +402,39 @@ static int bq27x00_battery_read_time(struct bq27x00_device_info *di, u8 reg)
 	return tval * 60;
 }
 
+/*
+ * Return the battery Available energy in µWh
+ * Or < 0 if something fails.
+ */
+static int bq27x00_battery_read_energy(struct bq27x00_device_info *di)
+{
+	int ae;
+
+	ae = bq27x00_read(di, BQ27x00_REG_AE, false);
+	if (ae < 0) {
+		dev_err(di->dev, "error reading available energy\n");
+		return ae;
+	}
+
+	if (di->chip == BQ27500)
+		ae *= 1000;
+	else
+		ae = ae * 29200 / BQ27000_RS;
+
+	return ae;
+}
+
 static void bq27x00_update(struct bq27x00_device_info *di)
 {
 	struct bq27x00_reg_cache cache = {0, };
 	bool is_bq27500 = di->chip == BQ27500;
+	unsigned char block[BQ27x00_BLOCK_LEN];
+
+	mutex_lock(&di->update_lock);
+
+	if (block_read && di->bus.read_block &&
+	    !di->bus.read_block(di, BQ27x00_BLOCK_START, block, sizeof(block)))
+		di->snapshot = block;
 
 	cache.flags = bq27x00_read(di, BQ27x00_REG_FLAGS, is_bq27500);
 	if (cache.flags >= 0) {
@@ -366,36 +446,51 @@ static void bq27x00_update(struct bq27x00_device_info *di)
 		cache.time_to_full = bq27x00_battery_read_time(di, BQ27x00_REG_TTF);
 		cache.charge_full = bq27x00_battery_read_lmd(di);
 		cache.cycle_count = bq27x00_battery_read_cyct(di);
-
-		if (!is_bq27500)
-			cache.current_now = bq27x00_read(di, BQ27x00_REG_AI, false);
+		cache.current_now = bq27x00_read(di, BQ27x00_REG_AI, false);
+		cache.voltage = bq27x00_read(di, BQ27x00_REG_VOLT, false);
+		cache.charge_now = bq27x00_battery_read_nac(di);
+		cache.energy = bq27x00_battery_read_energy(di);
 
 		/* We only have to read charge design full once */
 		if (di->charge_design_full <= 0)
 			di->charge_design_full = bq27x00_battery_read_ilmd(di);
 	}
 
-	/* Ignore current_now which is a snapshot of the current battery state
-	 * and is likely to be different even between two consecutive reads */
-	if (memcmp(&di->cache, &cache, sizeof(cache) - sizeof(int)) != 0) {
+	di->snapshot = NULL;
+
+	/* Only the slow moving part of the cache is a reason to notify */
+	if (memcmp(&di->cache, &cache,
+		   offsetof(struct bq27x00_reg_cache, current_now)) != 0) {
 		di->cache = cache;
 		power_supply_changed(&di->bat);
+	} else {
+		di->cache = cache;
 	}
 
 	di->last_update = jiffies;
+
+	mutex_unlock(&di->update_lock);
 }
 
 static void bq27x00_battery_poll(struct work_struct *work)
 {
 	struct bq27x00_device_info *di =
 		container_of(work, struct bq27x00_device_info, work.work);
+	unsigned int interval;
 
 	bq27x00_update(di);
 
-	if (poll_interval > 0) {
+	/*
+	 * With the gauge interrupts wired up, state of charge changes are
+	 * reported as they happen and polling only bounds the staleness of
+	 * everything else.
+	 */
+	interval = di->irq_driven ? irq_poll_interval : poll_interval;
+
+	if (interval > 0) {
 		/* The timer does not have to be accurate. */
-		set_timer_slack(&di->work.timer, poll_interval * HZ / 4);
-		schedule_delayed_work(&di->work, poll_interval * HZ);
+		set_timer_slack(&di->work.timer, interval * HZ / 4);
+		schedule_delayed_work(&di->work, interval * HZ);
 	}
 }
 
@@ -464,10 +559,7 @@ static int bq27x00_battery_current(struct bq27x00_device_info *di,
 {
 	int curr;
 
-	if (di->chip == BQ27500)
-	    curr = bq27x00_read(di, BQ27x00_REG_AI, false);
-	else
-	    curr = di->cache.current_now;
+	curr = di->cache.current_now;
 
 #if 0
 	if (curr < 0)
@@ -526,7 +618,7 @@ static int bq27x00_battery_voltage(struct bq27x00_device_info *di,
 {
 	int volt;
 
-	volt = bq27x00_read(di, BQ27x00_REG_VOLT, false);
+	volt = di->cache.voltage;
 	if (volt < 0)
 		return volt;
 
@@ -535,31 +627,6 @@ static int bq27x00_battery_voltage(struct bq27x00_device_info *di,
 	return 0;
 }
 
-/*
- * Return the battery Available energy in µWh
- * Or < 0 if something fails.
- */
-static int bq27x00_battery_energy(struct bq27x00_device_info *di,
-	union power_supply_propval *val)
-{
-	int ae;
-
-	ae = bq27x00_read(di, BQ27x00_REG_AE, false);
-	if (ae < 0) {
-		dev_err(di->dev, "error reading available energy\n");
-		return ae;
-	}
-
-	if (di->chip == BQ27500)
-		ae *= 1000;
-	else
-		ae = ae * 29200 / BQ27000_RS;
-
-	val->intval = ae;
-
-	return 0;
-}
-
 
 static int bq27x00_simple_value(int value,
 	union power_supply_propval *val)
@@ -629,7 +696,7 @@ static int bq27x00_battery_get_property(struct power_supply *psy,
 		val->intval = POWER_SUPPLY_TECHNOLOGY_LION;
 		break;
 	case POWER_SUPPLY_PROP_CHARGE_NOW:
-		ret = bq27x00_simple_value(bq27x00_battery_read_nac(di), val);
+		ret = bq27x00_simple_value(di->cache.charge_now, val);
 		break;
 	case POWER_SUPPLY_PROP_CHARGE_FULL:
 		ret = bq27x00_simple_value(di->cache.charge_full, val);
@@ -641,7 +708,7 @@ static int bq27x00_battery_get_property(struct power_supply *psy,
 		ret = bq27x00_simple_value(di->cache.cycle_count, val);
 		break;
 	case POWER_SUPPLY_PROP_ENERGY_NOW:
-		ret = bq27x00_battery_energy(di, val);
+		ret = bq27x00_simple_value(di->cache.energy, val);
 		break;
 	default:
 		return -EINVAL;
@@ -670,6 +737,7 @@ static int bq27x00_powersupply_init(struct bq27x00_device_info *di)
 
 	INIT_DELAYED_WORK(&di->work, bq27x00_battery_poll);
 	mutex_init(&di->lock);
+	mutex_init(&di->update_lock);
 
 	/*
 	 * Read the battery temp now to prevent races between userspace reading
@@ -700,6 +768,7 @@ static void bq27x00_powersupply_unregister(struct bq27x00_device_info *di)
 
 	power_supply_unregister(&di->bat);
 
+	mutex_destroy(&di->update_lock);
 	mutex_destroy(&di->lock);
 }
 
@@ -1123,6 +1192,102 @@ static const struct attribute_group bq27x00_attr_group = {
 	.attrs = bq27x00_attributes,
 };
 
+static irqreturn_t bq27x00_battery_irq(int irq, void *data)
+{
+	struct bq27x00_device_info *di = data;
+
+	dev_dbg(di->dev, "gauge interrupt %d\n", irq);
+
+	cancel_delayed_work_sync(&di->work);
+	schedule_delayed_work(&di->work, 0);
+
+	return IRQ_HANDLED;
+}
+
+/*
+ * Returns the irq number bound to @gpio, or < 0 if it can not be used.
+ */
+static int bq27x00_battery_request_irq(struct bq27x00_device_info *di,
+		int gpio, unsigned long flags, const char *name)
+{
+	int irq;
+	int ret;
+
+	if (!gpio_is_valid(gpio))
+		return -EINVAL;
+
+	ret = gpio_request_one(gpio, GPIOF_IN, name);
+	if (ret) {
+		dev_err(di->dev, "failed to request gpio %d: %d\n", gpio, ret);
+		return ret;
+	}
+
+	irq = gpio_to_irq(gpio);
+	ret = request_threaded_irq(irq, NULL, bq27x00_battery_irq,
+			flags | IRQF_ONESHOT, name, di);
+	if (ret) {
+		dev_err(di->dev, "failed to request irq %d: %d\n", irq, ret);
+		gpio_free(gpio);
+		return ret;
+	}
+
+	return irq;
+}
+
+static void bq27x00_battery_free_irq(struct bq27x00_device_info *di,
+		int gpio, int irq)
+{
+	if (irq < 0)
+		return;
+
+	free_irq(irq, di);
+	gpio_free(gpio);
+}
+
+static void bq27x00_battery_irq_init(struct bq27x00_device_info *di,
+		struct bq27x00_platform_data *pdata)
+{
+	di->soc_irq = -1;
+	di->bat_low_irq = -1;
+
+	if (!pdata)
+		return;
+
+	/* SOC_INT pulses low on every state of charge step */
+	di->soc_gpio = pdata->soc_int_gpio;
+	di->soc_irq = bq27x00_battery_request_irq(di, di->soc_gpio,
+			IRQF_TRIGGER_FALLING, "bq27x00_soc_int");
+
+	/* BAT_LOW is a level, follow both edges and wake up for it */
+	di->bat_low_gpio = pdata->bat_low_gpio;
+	di->bat_low_irq = bq27x00_battery_request_irq(di, di->bat_low_gpio,
+			IRQF_TRIGGER_RISING | IRQF_TRIGGER_FALLING,
+			"bq27x00_bat_low");
+	if (di->bat_low_irq >= 0)
+		enable_irq_wake(di->bat_low_irq);
+
+	di->irq_driven = di->soc_irq >= 0;
+	if (!di->irq_driven)
+		return;
+
+	dev_info(di->dev, "interrupt driven updates, polling every %us\n",
+			irq_poll_interval);
+
+	/* stretch the pending poll to the new interval */
+	cancel_delayed_work_sync(&di->work);
+	schedule_delayed_work(&di->work, 0);
+}
+
+static void bq27x00_battery_irq_exit(struct bq27x00_device_info *di)
+{
+	if (di->bat_low_irq >= 0)
+		disable_irq_wake(di->bat_low_irq);
+
+	bq27x00_battery_free_irq(di, di->bat_low_gpio, di->bat_low_irq);
+	bq27x00_battery_free_irq(di, di->soc_gpio, di->soc_irq);
+	di->irq_driven = false;
+}
+
 static int bq27x00_battery_probe(struct i2c_client *client,
 				 const struct i2c_device_id *id)
 {
@@ -1162,6 +1327,7 @@ static int bq27x00_battery_probe(struct i2c_client *client,
 	di->bat.name = name;
 	di->bus.read = &bq27x00_read_i2c;
 	di->bus.write = &bq27x00_write_i2c;
+	di->bus.read_block = &bq27x00_read_block_i2c;
 
 	if (pdata && pdata->translate_temp)
 		di->translate_temp = pdata->translate_temp;
@@ -1190,6 +1356,8 @@ static int bq27x00_battery_probe(struct i2c_client *client,
 
 	i2c_set_clientdata(client, di);
 
+	bq27x00_battery_irq_init(di, pdata);
+
 	retval = sysfs_create_group(&client->dev.kobj, &bq27x00_attr_group);
 	if (retval)
 		dev_err(&client->dev, "could not create sysfs files\n");
@@ -1212,6 +1380,8 @@ static int bq27x00_battery_remove(struct i2c_client *client)
 {
 	struct bq27x00_device_info *di = i2c_get_clientdata(client);
 
+	bq27x00_battery_irq_exit(di);
+
 	bq27x00_powersupply_unregister(di);
 
 	kfree(di->bat.name);
@@ -776,6 +776,12 @@ static const int vichrg[] = {
 	900, 1000, 1100, 1200, 1300, 1400, 1500, 300
 };
 
+/*
+ * Results this recent are shared with the other GPADC consumers instead
+ * of triggering another conversion.
+ */
+#define GPADC_SHARED_AGE_MS	10
+
 /*
  * Return channel value
  * Or < 0 on failure.
@@ -791,7 +797,7 @@ static int twl6030_get_gpadc_conversion(struct twl6030_charger_device_info *di,
 	req.method = TWL6030_GPADC_SW2;
 	req.active = 0;
 	req.func_cb = NULL;
-	ret = twl6030_gpadc_conversion(&req);
+	ret = twl6030_gpadc_conversion_cached(&req, GPADC_SHARED_AGE_MS);
 	if (ret < 0)
 		return ret;
 
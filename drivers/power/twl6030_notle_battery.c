@@ -28,6 +28,7 @@
 #include <linux/i2c/bq2415x.h>
 #include <linux/wakelock.h>
 #include <linux/usb/otg.h>
+#include <linux/seqlock.h>
 #include <asm/div64.h>
 
 #define CONTROLLER_INT_MASK	0x00
@@ -209,6 +210,8 @@
 /* TWL6030/6032 BATTERY VOLTAGE GPADC CHANNELS */
 #define TWL6030_GPADC_VBAT_CHNL	0x07
 #define TWL6032_GPADC_VBAT_CHNL	0x12
+#define TWL6030_GPADC_VBUS_CHNL	10
+#define TWL6030_GPADC_ID_CHNL	14
 
 /* TWL6030_GPADC_CTRL2 */
 #define GPADC_CTRL2_CH18_SCALER_EN	BIT(2)
@@ -275,10 +278,35 @@ static const char *twl6030_state[] = {
 #define VOLTAGE_HISTORY_ORDER 3
 #define VOLTAGE_HISTORY_LENGTH (1<<VOLTAGE_HISTORY_ORDER)
 
+/* monitoring interval (s) while charging or running low */
+#define MONITOR_FAST_INTERVAL	5
+#define LOW_CAPACITY_THRESHOLD	15
+
+/*
+ * Everything reported to userspace, sampled together by the monitor work
+ * and published as one consistent snapshot. get_property() and the sysfs
+ * files only ever read this, they never touch the hardware.
+ */
+struct twl6030_bci_snapshot {
+	int			voltage_mV;
+	int			vbus_mV;
+	int			id_level;
+	int			current_uA;
+	int			current_avg_uA;
+	int			capacity_uAh;
+	unsigned int		capacity;
+	int			state;
+	int			vbus_online;
+	int			bat_health;
+};
+
 struct twl6030_bci_device_info {
 	struct device		*dev;
 
 	int			voltage_mV;
+	int			vbat_mV;	/* last raw sample, 0 if none */
+	int			vbus_mV;
+	int			id_level;
 	int			voltage_history[VOLTAGE_HISTORY_LENGTH];
 	int			voltage_index;
 	int			current_uA;
@@ -329,6 +357,9 @@ struct twl6030_bci_device_info {
 
 	struct workqueue_struct	*wq;
 	unsigned long		features;
+
+	seqlock_t		snap_lock;
+	struct twl6030_bci_snapshot snap;
 };
 
 static void twl6030_config_min_vbus_reg(struct twl6030_bci_device_info *di,
@@ -483,11 +514,17 @@ static const int vichrg[] = {
 };
 
 /*
- * Return channel value
+ * Results this recent are shared with the other GPADC consumers instead
+ * of triggering another conversion.
+ */
+#define GPADC_SHARED_AGE_MS	10
+
+/*
+ * Return channel value, converted no more than max_age_ms ago
  * Or < 0 on failure.
  */
 static int twl6030_get_gpadc_conversion(struct twl6030_bci_device_info *di,
-					int channel_no)
+					int channel_no, unsigned max_age_ms)
 {
 	struct twl6030_gpadc_request req;
 	int temp = 0;
@@ -497,7 +534,7 @@ static int twl6030_get_gpadc_conversion(struct twl6030_bci_device_info *di,
 	req.method = TWL6030_GPADC_SW2;
 	req.active = 0;
 	req.func_cb = NULL;
-	ret = twl6030_gpadc_conversion(&req);
+	ret = twl6030_gpadc_conversion_cached(&req, max_age_ms);
 	if (ret < 0)
 		return ret;
 
@@ -632,6 +669,38 @@ static void twl6030battery_current(struct twl6030_bci_device_info *di)
 	return;
 }
 
+/*
+ * Sample all the GPADC channels we report in one batched conversion.
+ * VBAT is left out while charging, it only means something with the
+ * charger off (see twl6030_update_voltage()).
+ */
+static void twl6030_sample_adc(struct twl6030_bci_device_info *di)
+{
+	struct twl6030_gpadc_request req;
+	int ret;
+
+	req.channels = (1 << TWL6030_GPADC_VBUS_CHNL) |
+			(1 << TWL6030_GPADC_ID_CHNL);
+	if (!is_charging(di))
+		req.channels |= (1 << di->gpadc_vbat_chnl);
+	req.method = TWL6030_GPADC_SW2;
+	req.active = 0;
+	req.func_cb = NULL;
+	ret = twl6030_gpadc_conversion_cached(&req, GPADC_SHARED_AGE_MS);
+	if (ret < 0) {
+		dev_dbg(di->dev, "gpadc conversion failed %d\n", ret);
+		di->vbat_mV = 0;
+		return;
+	}
+
+	di->vbus_mV = max(req.rbuf[TWL6030_GPADC_VBUS_CHNL], 0);
+	di->id_level = max(req.rbuf[TWL6030_GPADC_ID_CHNL], 0);
+	if (is_charging(di))
+		di->vbat_mV = 0;
+	else
+		di->vbat_mV = max(req.rbuf[di->gpadc_vbat_chnl], 0);
+}
+
 static int twl6030backupbatt_setup(void)
 {
 	int ret;
@@ -800,18 +869,42 @@ static int twl6030_estimate_capacity(struct twl6030_bci_device_info *di)
 
 static int twl6030_get_battery_voltage(struct twl6030_bci_device_info *di)
 {
-	int v;
 	/* when the charger is enabled the voltage does not reflect the
 	 * actual battery voltage, so use the cached voltage (sampled
 	 * periodically with the charger disabled)
 	 */
-	if (is_charging(di))
-		return di->voltage_mV;
-	v = twl6030_get_gpadc_conversion(di, di->gpadc_vbat_chnl);
-	if (v <= 0)
+	if (is_charging(di) || di->vbat_mV <= 0)
 		return di->voltage_mV;
 	else
-		return v;
+		return di->vbat_mV;
+}
+
+/* make the current measurements visible to get_property() */
+static void twl6030_publish_snapshot(struct twl6030_bci_device_info *di)
+{
+	write_seqlock(&di->snap_lock);
+	di->snap.voltage_mV = twl6030_get_battery_voltage(di);
+	di->snap.vbus_mV = di->vbus_mV;
+	di->snap.id_level = di->id_level;
+	di->snap.current_uA = di->current_uA;
+	di->snap.current_avg_uA = di->current_avg_uA;
+	di->snap.capacity_uAh = di->capacity_uAh;
+	di->snap.capacity = di->capacity;
+	di->snap.state = di->state;
+	di->snap.vbus_online = di->vbus_online;
+	di->snap.bat_health = di->bat_health;
+	write_sequnlock(&di->snap_lock);
+}
+
+static void twl6030_read_snapshot(struct twl6030_bci_device_info *di,
+				  struct twl6030_bci_snapshot *snap)
+{
+	unsigned seq;
+
+	do {
+		seq = read_seqbegin(&di->snap_lock);
+		*snap = di->snap;
+	} while (read_seqretry(&di->snap_lock, seq));
 }
 
 static int twl6030_read_gasguage_regs(struct twl6030_bci_device_info *di)
@@ -885,20 +978,25 @@ static void twl6030_update_voltage(struct twl6030_bci_device_info *di)
 
 			msleep(200);
 
-			ret = twl6030_get_gpadc_conversion(di, di->gpadc_vbat_chnl);
-			if (ret > 0)
-				curr_voltage = ret;
+			/* must be sampled now, with the charger off */
+			ret = twl6030_get_gpadc_conversion(di,
+						di->gpadc_vbat_chnl, 0);
 
 			twl6030_start_usb_charger(di, 500);
+
+			if (ret <= 0)
+				return;
+			curr_voltage = ret;
 		} else {
 			/* if no sample is taken don't bother recalculating the weighted average */
 			return;
 		}
 	} else {
 		di->vbat_jiffies = jiffies;
-		ret = twl6030_get_gpadc_conversion(di, di->gpadc_vbat_chnl);
-		if (ret > 0)
-			curr_voltage = ret;
+		/* sampled by twl6030_sample_adc() */
+		if (di->vbat_mV <= 0)
+			return;
+		curr_voltage = di->vbat_mV;
 	}
 
 	/*
@@ -1040,6 +1138,7 @@ static void twl6030_read_fuelgauge(struct twl6030_bci_device_info *di)
 
 	if ((newcap != di->capacity) || statechanged) {
 		di->capacity = newcap;
+		twl6030_publish_snapshot(di);
 		power_supply_changed(&di->bat);
 	}
 
@@ -1059,6 +1158,7 @@ static void twl6030_determine_charge_state(struct twl6030_bci_device_info *di)
 {
 	u8 stat1;
 	int newstate = STATE_BATTERY;
+	int vbus_online = di->vbus_online;
 
 	/* TODO: i2c error -> fault? */
 	twl_i2c_read_u8(TWL6030_MODULE_CHARGER, &stat1, CONTROLLER_STAT1);
@@ -1089,7 +1189,7 @@ static void twl6030_determine_charge_state(struct twl6030_bci_device_info *di)
 	}
 
 	if (di->state == newstate)
-		return;
+		goto out;
 
 	switch (newstate) {
 	case STATE_FAULT:
@@ -1117,8 +1217,17 @@ static void twl6030_determine_charge_state(struct twl6030_bci_device_info *di)
 		printk("battery: state %s -> %s\n",
 			twl6030_state[di->state], twl6030_state[newstate]);
 		di->state = newstate;
+		twl6030_publish_snapshot(di);
 		power_supply_changed(&di->bat);
 		power_supply_changed(&di->usb);
+		return;
+	}
+
+out:
+	/* VBUS can come and go without a state change, e.g. while FULL */
+	if (di->vbus_online != vbus_online) {
+		twl6030_publish_snapshot(di);
+		power_supply_changed(&di->usb);
 	}
 }
 
@@ -1148,6 +1257,16 @@ static void twl6030_calibration_work(struct work_struct *work)
 	twl6030_calibrate_fuelgauge(di);
 }
 
+/* sample faster only while something interesting is going on */
+static unsigned int twl6030_monitor_interval(struct twl6030_bci_device_info *di)
+{
+	if (is_charging(di) || di->capacity <= LOW_CAPACITY_THRESHOLD)
+		return min_t(unsigned int, MONITOR_FAST_INTERVAL,
+						di->monitoring_interval);
+
+	return di->monitoring_interval;
+}
+
 static void twl6030_monitor_work(struct work_struct *work)
 {
 	struct twl6030_bci_device_info *di = container_of(work,
@@ -1159,8 +1278,9 @@ static void twl6030_monitor_work(struct work_struct *work)
 	if (is_charging(di))
 		twl6030_set_watchdog(di, di->watchdog_duration);
 
-	queue_delayed_work(di->wq, &di->monitor_work,
-			msecs_to_jiffies(1000 * di->monitoring_interval));
+	/* take every measurement in one go */
+	twl6030_sample_adc(di);
+	twl6030battery_current(di);
 
 	twl6030_read_fuelgauge(di);
 
@@ -1168,6 +1288,11 @@ static void twl6030_monitor_work(struct work_struct *work)
 
 	twl6030_determine_charge_state(di);
 
+	twl6030_publish_snapshot(di);
+
+	queue_delayed_work(di->wq, &di->monitor_work,
+			msecs_to_jiffies(1000 * twl6030_monitor_interval(di)));
+
 	wake_unlock(&battery_wake_lock);
 }
 
@@ -1182,13 +1307,16 @@ static int twl6030_usb_get_property(struct power_supply *psy,
 					union power_supply_propval *val)
 {
 	struct twl6030_bci_device_info *di = to_twl6030_usb_device_info(psy);
+	struct twl6030_bci_snapshot snap;
+
+	twl6030_read_snapshot(di, &snap);
 
 	switch (psp) {
 	case POWER_SUPPLY_PROP_ONLINE:
-		val->intval = di->vbus_online;
+		val->intval = snap.vbus_online;
 		break;
 	case POWER_SUPPLY_PROP_VOLTAGE_NOW:
-		val->intval = twl6030_get_gpadc_conversion(di, 10) * 1000;
+		val->intval = snap.vbus_mV * 1000;
 		break;
 	default:
 		return -EINVAL;
@@ -1202,12 +1330,14 @@ static int twl6030_bci_battery_get_property(struct power_supply *psy,
 					union power_supply_propval *val)
 {
 	struct twl6030_bci_device_info *di;
+	struct twl6030_bci_snapshot snap;
 
 	di = to_twl6030_bci_device_info(psy);
+	twl6030_read_snapshot(di, &snap);
 
 	switch (psp) {
 	case POWER_SUPPLY_PROP_STATUS:
-		switch (di->state) {
+		switch (snap.state) {
 		case STATE_USB:
 		case STATE_AC:
 		case STATE_FULL: /* TODO ?? */
@@ -1218,14 +1348,13 @@ static int twl6030_bci_battery_get_property(struct power_supply *psy,
 		}
 		break;
 	case POWER_SUPPLY_PROP_VOLTAGE_NOW:
-		val->intval = twl6030_get_battery_voltage(di) * 1000;
+		val->intval = snap.voltage_mV * 1000;
 		break;
 	case POWER_SUPPLY_PROP_CURRENT_NOW:
-		twl6030battery_current(di);
-		val->intval = di->current_uA;
+		val->intval = snap.current_uA;
 		break;
 	case POWER_SUPPLY_PROP_CHARGE_COUNTER:
-		val->intval = di->capacity_uAh;
+		val->intval = snap.capacity_uAh;
 		break;
 	case POWER_SUPPLY_PROP_TEMP:
 		val->intval = 275; // simulate a healthy battery temp
@@ -1234,13 +1363,13 @@ static int twl6030_bci_battery_get_property(struct power_supply *psy,
 		val->intval = 1;
 		break;
 	case POWER_SUPPLY_PROP_CURRENT_AVG:
-		val->intval = di->current_avg_uA;
+		val->intval = snap.current_avg_uA;
 		break;
 	case POWER_SUPPLY_PROP_HEALTH:
-		val->intval = di->bat_health;
+		val->intval = snap.bat_health;
 		break;
 	case POWER_SUPPLY_PROP_CAPACITY:
-		val->intval = di->capacity;
+		val->intval = snap.capacity;
 		break;
 	default:
 		return -EINVAL;
@@ -1281,23 +1410,23 @@ static int twl6030_usb_notifier_call(struct notifier_block *nb,
 static ssize_t show_vbus_voltage(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
-	int val;
 	struct twl6030_bci_device_info *di = dev_get_drvdata(dev);
+	struct twl6030_bci_snapshot snap;
 
-	val = twl6030_get_gpadc_conversion(di, 10);
+	twl6030_read_snapshot(di, &snap);
 
-	return sprintf(buf, "%d\n", val);
+	return sprintf(buf, "%d\n", snap.vbus_mV);
 }
 
 static ssize_t show_id_level(struct device *dev, struct device_attribute *attr,
 							char *buf)
 {
-	int val;
 	struct twl6030_bci_device_info *di = dev_get_drvdata(dev);
+	struct twl6030_bci_snapshot snap;
 
-	val = twl6030_get_gpadc_conversion(di, 14);
+	twl6030_read_snapshot(di, &snap);
 
-	return sprintf(buf, "%d\n", val);
+	return sprintf(buf, "%d\n", snap.id_level);
 }
 
 static ssize_t set_regulation_voltage(struct device *dev,
@@ -1490,6 +1619,7 @@ static int __devinit twl6030_bci_battery_probe(struct platform_device *pdev)
 	}
 
 	di->state = STATE_BATTERY;
+	seqlock_init(&di->snap_lock);
 
 	di->monitoring_interval = 15;
 	di->capacity_max_uAh = 570000;
@@ -1583,7 +1713,8 @@ static int __devinit twl6030_bci_battery_probe(struct platform_device *pdev)
 	di->charger_incurrentmA = twl6030_get_usb_max_power(di->otg);
 	di->gpadc_vbat_chnl = TWL6030_GPADC_VBAT_CHNL;
 
-	di->voltage_mV = twl6030_get_gpadc_conversion(di, di->gpadc_vbat_chnl);
+	di->voltage_mV = twl6030_get_gpadc_conversion(di, di->gpadc_vbat_chnl,
+						      0);
 	dev_info(&pdev->dev, "Battery Voltage at Bootup is %d mV\n", di->voltage_mV);
 
 	/* initialize the voltage history table */
@@ -1598,6 +1729,8 @@ static int __devinit twl6030_bci_battery_probe(struct platform_device *pdev)
 	if (di->capacity > 50)
 		di->capacity = 50;
 
+	twl6030_publish_snapshot(di);
+
 	ret = twl6030backupbatt_setup();
 	if (ret)
 		dev_err(&pdev->dev, "Backup Bat charging setup failed\n");
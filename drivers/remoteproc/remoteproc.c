@@ -39,6 +39,10 @@
 #include <linux/uaccess.h>
 #include <linux/elf.h>
 #include <linux/elfcore.h>
+#include <linux/vmalloc.h>
+#include <linux/crc32.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
 #include <plat/remoteproc.h>
 
 /* list of available remote processors on this board */
@@ -48,6 +52,15 @@ static DEFINE_SPINLOCK(rprocs_lock);
 /* debugfs parent dir */
 static struct dentry *rproc_dbg;
 
+/*
+ * keep the resource table and writable sections of the last booted image
+ * so that idle restarts do not have to go through request_firmware again;
+ * the code stays in the carveouts, crash recovery still reloads it all
+ */
+static bool fw_cache = true;
+module_param(fw_cache, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(fw_cache, "Restart remote processors from cached data sections");
+
 static ssize_t rproc_format_trace_buf(char __user *userbuf, size_t count,
 				    loff_t *ppos, const void *src, int size)
 {
@@ -616,6 +629,8 @@ static int rproc_crash(struct rproc *rproc)
 		memcpy(rproc->last_trace_buf1, rproc->trace_buf1,
 				rproc->last_trace_len1);
 	rproc->state = RPROC_CRASHED;
+	/* the crashed core may have scribbled over its own code */
+	rproc->fw_text_resident = false;
 
 	return 0;
 }
@@ -644,6 +659,404 @@ static int _event_notify(struct rproc *rproc, int type, void *data)
 	return blocking_notifier_call_chain(&rproc->nbh, type, data);
 }
 
+#ifdef CONFIG_REMOTE_PROC_AUTOSUSPEND
+/*
+ * Traffic-aware idling. rpmsg bursts that keep coming at a steady interval
+ * on a channel (the camera 3A loop, video frames) are used to predict when
+ * the next burst is due. The remote processor is then suspended only when
+ * the predicted idle time pays for a suspend and a resume, and it is woken
+ * up ahead of the next predicted burst.
+ */
+#define RPROC_TRAFFIC_CHANS		8
+#define RPROC_TRAFFIC_MIN_BURSTS	4
+/* longest burst interval considered for a prediction */
+#define RPROC_TRAFFIC_MAX_PERIOD_US	(10 * USEC_PER_SEC)
+
+static bool traffic_policy = true;
+module_param(traffic_policy, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(traffic_policy,
+		"Suspend and pre-wake remote processors from rpmsg traffic");
+
+static unsigned traffic_burst_us = 3000;
+module_param(traffic_burst_us, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(traffic_burst_us,
+		"Messages closer than this (us) belong to the same burst");
+
+static unsigned traffic_settle_ms = 20;
+module_param(traffic_settle_ms, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(traffic_settle_ms,
+		"Autosuspend delay (ms) after a burst of periodic traffic");
+
+/**
+ * struct rproc_traffic_chan - burst history of one rpmsg channel
+ * @addr: local rpmsg address of the channel
+ * @last: time of the last message
+ * @burst: time of the first message of the current burst
+ * @period_us: running average of the burst start-to-start interval
+ * @jitter_us: running average of the deviation from @period_us
+ * @bursts: number of bursts seen
+ */
+struct rproc_traffic_chan {
+	u32 addr;
+	ktime_t last;
+	ktime_t burst;
+	u32 period_us;
+	u32 jitter_us;
+	u32 bursts;
+};
+
+/**
+ * struct rproc_traffic - rpmsg traffic history of a remote processor
+ * @rproc: the remote processor
+ * @lock: protects everything below
+ * @chan: per-channel burst history
+ * @suspend_us: running average of the cost of a runtime suspend
+ * @resume_us: running average of the cost of a runtime resume
+ * @periodic: the autosuspend delay is shortened to traffic_settle_ms
+ * @prewoken: the last resume was a pre-wake not yet followed by traffic
+ * @prewake_timer: fires ahead of the next predicted burst
+ * @prewake_work: resumes the remote processor for @prewake_timer
+ */
+struct rproc_traffic {
+	struct rproc *rproc;
+	spinlock_t lock;
+	struct rproc_traffic_chan chan[RPROC_TRAFFIC_CHANS];
+	u32 suspend_us;
+	u32 resume_us;
+	bool periodic;
+	bool prewoken;
+	struct hrtimer prewake_timer;
+	struct work_struct prewake_work;
+	/* statistics */
+	u32 suspends;
+	u32 avoided;
+	u32 prewakes;
+	u32 prewake_hits;
+	u32 prewake_misses;
+	u32 resume_last_us;
+	u32 resume_max_us;
+};
+
+static bool rproc_traffic_predictable(struct rproc_traffic_chan *c,
+								ktime_t now)
+{
+	if (c->bursts < RPROC_TRAFFIC_MIN_BURSTS)
+		return false;
+	if (c->jitter_us > c->period_us / 4)
+		return false;
+	/* three missed bursts in a row, the loop has stopped */
+	return ktime_us_delta(now, c->burst) < 3 * (s64) c->period_us;
+}
+
+/* below this a suspend costs more than it saves */
+static u32 rproc_traffic_break_even_us(struct rproc_traffic *t)
+{
+	return 2 * (t->suspend_us + t->resume_us);
+}
+
+/*
+ * Time from @now to the earliest predicted burst, or -1 if no channel
+ * is periodic. Called with the lock held.
+ */
+static s64 rproc_traffic_next_us(struct rproc_traffic *t, ktime_t now,
+					bool *periodic)
+{
+	s64 next = -1, due;
+	int i;
+
+	*periodic = false;
+	for (i = 0; i < RPROC_TRAFFIC_CHANS; i++) {
+		struct rproc_traffic_chan *c = &t->chan[i];
+
+		if (!rproc_traffic_predictable(c, now))
+			continue;
+
+		due = c->period_us - ktime_us_delta(now, c->burst);
+		while (due <= 0)
+			due += c->period_us;
+		due = max_t(s64, due - c->jitter_us, 0);
+		if (next < 0 || due < next)
+			next = due;
+
+		if (c->period_us > rproc_traffic_break_even_us(t))
+			*periodic = true;
+	}
+
+	return next;
+}
+
+static void rproc_traffic_reset(struct rproc *rproc)
+{
+	struct rproc_traffic *t = rproc->traffic;
+	unsigned long flags;
+
+	if (!t)
+		return;
+
+	hrtimer_cancel(&t->prewake_timer);
+	cancel_work_sync(&t->prewake_work);
+
+	spin_lock_irqsave(&t->lock, flags);
+	memset(t->chan, 0, sizeof(t->chan));
+	t->periodic = false;
+	t->prewoken = false;
+	spin_unlock_irqrestore(&t->lock, flags);
+}
+
+/* the remote processor was resumed, @us is what it cost */
+static void rproc_traffic_resumed(struct rproc *rproc, u32 us)
+{
+	struct rproc_traffic *t = rproc->traffic;
+	unsigned long flags;
+
+	if (!t)
+		return;
+
+	spin_lock_irqsave(&t->lock, flags);
+	t->resume_us = (3 * t->resume_us + us) / 4;
+	t->resume_last_us = us;
+	t->resume_max_us = max(t->resume_max_us, us);
+	spin_unlock_irqrestore(&t->lock, flags);
+}
+
+/* the remote processor was suspended, @us is what it cost */
+static void rproc_traffic_suspended(struct rproc *rproc, u32 us)
+{
+	struct rproc_traffic *t = rproc->traffic;
+	unsigned long flags;
+
+	if (!t)
+		return;
+
+	spin_lock_irqsave(&t->lock, flags);
+	t->suspend_us = (3 * t->suspend_us + us) / 4;
+	t->suspends++;
+	/* woken up for a burst that never came */
+	if (t->prewoken) {
+		t->prewoken = false;
+		t->prewake_misses++;
+	}
+	spin_unlock_irqrestore(&t->lock, flags);
+}
+
+/* true if the next predicted burst is too close for a suspend to pay off */
+static bool rproc_traffic_keep_awake(struct rproc *rproc)
+{
+	struct rproc_traffic *t = rproc->traffic;
+	unsigned long flags;
+	bool periodic, keep = false;
+	s64 next;
+
+	if (!t || !traffic_policy)
+		return false;
+
+	spin_lock_irqsave(&t->lock, flags);
+	next = rproc_traffic_next_us(t, ktime_get(), &periodic);
+	if (next >= 0 && next < rproc_traffic_break_even_us(t)) {
+		t->avoided++;
+		keep = true;
+	}
+	spin_unlock_irqrestore(&t->lock, flags);
+
+	return keep;
+}
+
+static enum hrtimer_restart rproc_prewake_timer(struct hrtimer *timer)
+{
+	struct rproc_traffic *t = container_of(timer, struct rproc_traffic,
+								prewake_timer);
+
+	schedule_work(&t->prewake_work);
+
+	return HRTIMER_NORESTART;
+}
+
+static void rproc_prewake_work(struct work_struct *work)
+{
+	struct rproc_traffic *t = container_of(work, struct rproc_traffic,
+								prewake_work);
+	struct rproc *rproc = t->rproc;
+	struct device *dev = rproc->dev;
+	unsigned long flags;
+
+	/* never wake it up behind the back of system suspend */
+	if (rproc->state != RPROC_RUNNING || !pm_runtime_suspended(dev))
+		return;
+
+	if (pm_runtime_get_sync(dev) >= 0) {
+		spin_lock_irqsave(&t->lock, flags);
+		t->prewakes++;
+		t->prewoken = true;
+		spin_unlock_irqrestore(&t->lock, flags);
+	}
+	pm_runtime_mark_last_busy(dev);
+	pm_runtime_put_autosuspend(dev);
+}
+
+static ssize_t rproc_traffic_read(struct file *filp, char __user *userbuf,
+						size_t count, loff_t *ppos)
+{
+	struct rproc *rproc = filp->private_data;
+	struct rproc_traffic *t = rproc->traffic;
+	unsigned long flags;
+	ktime_t now = ktime_get();
+	char *buf;
+	int i, len = 0, size = 1024;
+	ssize_t ret;
+
+	buf = kmalloc(size, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	spin_lock_irqsave(&t->lock, flags);
+	len += scnprintf(buf + len, size - len,
+		"suspends: %u\navoided suspends: %u\nprewakes: %u\n"
+		"prewake hits: %u\nprewake misses: %u\n"
+		"suspend cost: %u us\nresume cost: %u us\n"
+		"last resume: %u us\nmax resume: %u us\nperiodic: %d\n",
+		t->suspends, t->avoided, t->prewakes, t->prewake_hits,
+		t->prewake_misses, t->suspend_us, t->resume_us,
+		t->resume_last_us, t->resume_max_us, t->periodic);
+	for (i = 0; i < RPROC_TRAFFIC_CHANS; i++) {
+		struct rproc_traffic_chan *c = &t->chan[i];
+
+		if (!c->last.tv64)
+			continue;
+		len += scnprintf(buf + len, size - len,
+			"chan 0x%x: bursts %u period %u us jitter %u us%s\n",
+			c->addr, c->bursts, c->period_us, c->jitter_us,
+			rproc_traffic_predictable(c, now) ?
+						" predictable" : "");
+	}
+	spin_unlock_irqrestore(&t->lock, flags);
+
+	ret = simple_read_from_buffer(userbuf, count, ppos, buf, len);
+	kfree(buf);
+
+	return ret;
+}
+
+static const struct file_operations rproc_traffic_ops = {
+	.read = rproc_traffic_read,
+	.open = rproc_open_generic,
+	.llseek	= generic_file_llseek,
+};
+
+static void rproc_traffic_init(struct rproc *rproc)
+{
+	struct rproc_traffic *t;
+
+	t = kzalloc(sizeof(*t), GFP_KERNEL);
+	if (!t) {
+		dev_warn(rproc->dev, "no memory for traffic history\n");
+		return;
+	}
+
+	t->rproc = rproc;
+	spin_lock_init(&t->lock);
+	/* pessimistic until measured */
+	t->suspend_us = t->resume_us = 2000;
+	hrtimer_init(&t->prewake_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	t->prewake_timer.function = rproc_prewake_timer;
+	INIT_WORK(&t->prewake_work, rproc_prewake_work);
+	rproc->traffic = t;
+}
+
+static void rproc_traffic_exit(struct rproc *rproc)
+{
+	rproc_traffic_reset(rproc);
+	kfree(rproc->traffic);
+	rproc->traffic = NULL;
+}
+#else
+static inline void rproc_traffic_reset(struct rproc *rproc) { }
+#endif
+
+/**
+ * rproc_traffic - account an rpmsg message to or from the remote processor
+ * @rproc: the remote processor
+ * @addr: local rpmsg address of the channel the message went through
+ *
+ * Feeds the traffic history used to decide when the remote processor may
+ * be suspended, and when it should be woken up ahead of the next burst.
+ */
+void rproc_traffic(struct rproc *rproc, u32 addr)
+{
+#ifdef CONFIG_REMOTE_PROC_AUTOSUSPEND
+	struct rproc_traffic *t = rproc->traffic;
+	struct rproc_traffic_chan *c = NULL, *victim;
+	ktime_t now = ktime_get();
+	unsigned long flags;
+	bool periodic, changed;
+	s64 next, interval;
+	u32 dev;
+	int i;
+
+	if (!t || !traffic_policy)
+		return;
+
+	/* inbound traffic is activity just as much as outbound */
+	pm_runtime_mark_last_busy(rproc->dev);
+
+	spin_lock_irqsave(&t->lock, flags);
+
+	victim = &t->chan[0];
+	for (i = 0; i < RPROC_TRAFFIC_CHANS; i++) {
+		if (t->chan[i].last.tv64 && t->chan[i].addr == addr) {
+			c = &t->chan[i];
+			break;
+		}
+		if (t->chan[i].last.tv64 < victim->last.tv64)
+			victim = &t->chan[i];
+	}
+
+	if (!c) {
+		c = victim;
+		memset(c, 0, sizeof(*c));
+		c->addr = addr;
+		c->burst = now;
+	} else if (ktime_us_delta(now, c->last) > traffic_burst_us) {
+		/* first message of a new burst */
+		interval = min_t(s64, ktime_us_delta(now, c->burst),
+						RPROC_TRAFFIC_MAX_PERIOD_US);
+		if (!c->bursts++) {
+			c->period_us = interval;
+		} else {
+			dev = abs((s32) interval - (s32) c->period_us);
+			c->period_us = (7 * c->period_us + (u32) interval) / 8;
+			c->jitter_us = (3 * c->jitter_us + dev) / 4;
+		}
+		c->burst = now;
+	}
+	c->last = now;
+
+	if (t->prewoken) {
+		t->prewoken = false;
+		t->prewake_hits++;
+	}
+
+	next = rproc_traffic_next_us(t, now, &periodic);
+	if (periodic && next > t->resume_us)
+		hrtimer_start(&t->prewake_timer,
+			ktime_add_us(now, next - t->resume_us),
+			HRTIMER_MODE_ABS);
+
+	changed = periodic != t->periodic;
+	t->periodic = periodic;
+
+	spin_unlock_irqrestore(&t->lock, flags);
+
+	/*
+	 * with periodic traffic worth suspending for, suspend as soon as a
+	 * burst has settled, the next one will be pre-woken for
+	 */
+	if (changed)
+		pm_runtime_set_autosuspend_delay(rproc->dev,
+			periodic ? traffic_settle_ms : rproc->sus_timeout);
+#endif
+}
+EXPORT_SYMBOL(rproc_traffic);
+
 /**
  * rproc_start - power on the remote processor and let it start running
  * @rproc: the remote processor
@@ -651,7 +1064,7 @@ static int _event_notify(struct rproc *rproc, int type, void *data)
  *
  * Start a remote processor (i.e. power it on, take it out of reset, etc..)
  */
-static void rproc_start(struct rproc *rproc, u64 bootaddr)
+static int rproc_start(struct rproc *rproc, u64 bootaddr)
 {
 	struct device *dev = rproc->dev;
 	int err;
@@ -659,7 +1072,7 @@ static void rproc_start(struct rproc *rproc, u64 bootaddr)
 	err = mutex_lock_interruptible(&rproc->lock);
 	if (err) {
 		dev_err(dev, "can't lock remote processor %d\n", err);
-		return;
+		return err;
 	}
 
 	if (rproc->ops->iommu_init) {
@@ -691,6 +1104,7 @@ static void rproc_start(struct rproc *rproc, u64 bootaddr)
 	}
 
 #ifdef CONFIG_REMOTE_PROC_AUTOSUSPEND
+	rproc_traffic_reset(rproc);
 	pm_runtime_use_autosuspend(dev);
 	pm_runtime_set_autosuspend_delay(dev, rproc->sus_timeout);
 	pm_runtime_get_noresume(rproc->dev);
@@ -708,7 +1122,7 @@ static void rproc_start(struct rproc *rproc, u64 bootaddr)
 	complete_all(&rproc->secure_restart);
 	mutex_unlock(&rproc->lock);
 
-	return;
+	return 0;
 
 	/*
 	 * signal always, as we would need a notification in both the
@@ -725,6 +1139,8 @@ unlock_mutex:
 	rproc->secure_ok = false;
 	complete_all(&rproc->secure_restart);
 	mutex_unlock(&rproc->lock);
+
+	return err;
 }
 
 static void rproc_reset_poolmem(struct rproc *rproc)
@@ -1113,30 +1529,86 @@ exit:
 	return ret;
 }
 
-static void rproc_loader_cont(const struct firmware *fw, void *context)
+static void rproc_fw_cache_drop(struct rproc *rproc)
+{
+	vfree(rproc->fw_cache);
+	rproc->fw_cache = NULL;
+	rproc->fw_cache_len = 0;
+	rproc->fw_text_resident = false;
+}
+
+/*
+ * Copy a booted image without its FW_TEXT sections into @out, or only size
+ * it when @out is NULL. Returns the length of the stripped image.
+ */
+static size_t rproc_fw_strip_text(const u8 *data, size_t size, u8 *out)
+{
+	const struct fw_header *image = (const struct fw_header *) data;
+	const struct fw_section *section;
+	size_t len = sizeof(struct fw_header) + image->header_len;
+	int left = size - len;
+	u32 slen;
+
+	if (out)
+		memcpy(out, data, len);
+
+	section = (const struct fw_section *)(image->header + image->header_len);
+	while (left > sizeof(struct fw_section)) {
+		slen = sizeof(struct fw_section) + section->len;
+		if (section->type != FW_TEXT) {
+			if (out)
+				memcpy(out + len, section, slen);
+			len += slen;
+		}
+		section = (const struct fw_section *)(section->content +
+								section->len);
+		left -= slen;
+	}
+
+	return len;
+}
+
+static void rproc_fw_cache_store(struct rproc *rproc, const u8 *data,
+								size_t size)
+{
+	size_t len;
+
+	rproc_fw_cache_drop(rproc);
+
+	len = rproc_fw_strip_text(data, size, NULL);
+	rproc->fw_cache = vmalloc(len);
+	if (!rproc->fw_cache) {
+		dev_warn(rproc->dev, "no memory to cache %s\n", rproc->firmware);
+		return;
+	}
+	rproc_fw_strip_text(data, size, rproc->fw_cache);
+	rproc->fw_cache_len = len;
+	rproc->fw_cache_crc = crc32(0, rproc->fw_cache, len);
+	/* the image we just booted is the one now sitting in the carveouts */
+	rproc->fw_text_resident = true;
+}
+
+/**
+ * rproc_boot_image - lay out a BIOS image and start the remote processor
+ * @rproc: the remote processor
+ * @data: the BIOS image, or its cached copy without the FW_TEXT sections
+ * @size: length of @data
+ */
+static int rproc_boot_image(struct rproc *rproc, const u8 *data, size_t size)
 {
-	struct rproc *rproc = context;
 	struct device *dev = rproc->dev;
-	const char *fwfile = rproc->firmware;
 	u64 bootaddr = 0;
 	struct fw_header *image;
 	struct fw_section *section;
 	int left, ret = -EINVAL;
 
-	if (!fw) {
-		dev_err(dev, "%s: failed to load %s\n", __func__, fwfile);
-		goto complete_fw;
-	}
-
-	dev_info(dev, "Loaded BIOS image %s, size %d\n", fwfile, fw->size);
-
 	/* make sure this image is sane */
-	if (fw->size < sizeof(struct fw_header)) {
+	if (size < sizeof(struct fw_header)) {
 		dev_err(dev, "Image is too small\n");
 		goto out;
 	}
 
-	image = (struct fw_header *) fw->data;
+	image = (struct fw_header *) data;
 
 	if (memcmp(image->magic, "RPRC", 4)) {
 		dev_err(dev, "Image is corrupted (bad magic)\n");
@@ -1166,7 +1638,7 @@ static void rproc_loader_cont(const struct firmware *fw, void *context)
 	/* now process the image, section by section */
 	section = (struct fw_section *)(image->header + image->header_len);
 
-	left = fw->size - sizeof(struct fw_header) - image->header_len;
+	left = size - sizeof(struct fw_header) - image->header_len;
 
 	/* event currently used to bump the remoteproc to max freq
 	 * while booting.  */
@@ -1178,40 +1650,113 @@ static void rproc_loader_cont(const struct firmware *fw, void *context)
 		goto out;
 	}
 
-	rproc_start(rproc, bootaddr);
-
+	ret = rproc_start(rproc, bootaddr);
 out:
-	release_firmware(fw);
-complete_fw:
+	return ret;
+}
+
+static void rproc_boot_done(struct rproc *rproc, int ret)
+{
 	/* allow all contexts calling rproc_put() to proceed */
 	complete_all(&rproc->firmware_loading_complete);
 	if (ret)
 		_event_notify(rproc, RPROC_LOAD_ERROR, NULL);
 }
 
-static int rproc_loader(struct rproc *rproc)
+static void rproc_loader_cont(const struct firmware *fw, void *context)
 {
+	struct rproc *rproc = context;
+	struct device *dev = rproc->dev;
 	const char *fwfile = rproc->firmware;
+	int ret = -EINVAL;
+
+	if (!fw) {
+		dev_err(dev, "%s: failed to load %s\n", __func__, fwfile);
+		goto complete_fw;
+	}
+
+	dev_info(dev, "Loaded BIOS image %s, size %d\n", fwfile, fw->size);
+
+	ret = rproc_boot_image(rproc, fw->data, fw->size);
+
+	/* secure loads lay the image out differently, never reuse them */
+	if (!ret && fw_cache && !rproc->secure_mode)
+		rproc_fw_cache_store(rproc, fw->data, fw->size);
+
+	release_firmware(fw);
+complete_fw:
+	rproc_boot_done(rproc, ret);
+}
+
+static int rproc_request_fw(struct rproc *rproc)
+{
 	struct device *dev = rproc->dev;
 	int ret;
 
-	if (!fwfile) {
+	/*
+	 * allow building remoteproc as built-in kernel code, without
+	 * hanging the boot process
+	 */
+	ret = request_firmware_nowait(THIS_MODULE, FW_ACTION_HOTPLUG,
+			rproc->firmware, dev, GFP_KERNEL, rproc,
+			rproc_loader_cont);
+	if (ret < 0)
+		dev_err(dev, "request_firmware_nowait failed: %d\n", ret);
+
+	return ret;
+}
+
+static void rproc_boot_work(struct work_struct *work)
+{
+	struct rproc *rproc = container_of(work, struct rproc, boot_work);
+	struct device *dev = rproc->dev;
+	int ret;
+
+	if (crc32(0, rproc->fw_cache, rproc->fw_cache_len) !=
+							rproc->fw_cache_crc) {
+		dev_warn(dev, "cached %s is corrupted, reloading it\n",
+							rproc->firmware);
+		rproc_fw_cache_drop(rproc);
+		ret = rproc_request_fw(rproc);
+		if (!ret)
+			return;
+		goto out;
+	}
+
+	dev_info(dev, "booting %s from cached data, code in place\n",
+							rproc->firmware);
+
+	ret = rproc_boot_image(rproc, rproc->fw_cache, rproc->fw_cache_len);
+	/* whatever went wrong, go back to the full image next time */
+	if (ret)
+		rproc->fw_text_resident = false;
+out:
+	rproc_boot_done(rproc, ret);
+}
+
+static int rproc_loader(struct rproc *rproc)
+{
+	struct device *dev = rproc->dev;
+
+	if (!rproc->firmware) {
 		dev_err(dev, "%s: no firmware to load\n", __func__);
 		return -EINVAL;
 	}
 
 	/*
-	 * allow building remoteproc as built-in kernel code, without
-	 * hanging the boot process
+	 * nothing is loading now, so this is the one place the cache can
+	 * be dropped without racing a boot that is using it. It holds no
+	 * code, so it is only any use while the code is still in place.
 	 */
-	ret = request_firmware_nowait(THIS_MODULE, FW_ACTION_HOTPLUG, fwfile,
-			dev, GFP_KERNEL, rproc, rproc_loader_cont);
-	if (ret < 0) {
-		dev_err(dev, "request_firmware_nowait failed: %d\n", ret);
-		return ret;
+	if (!fw_cache || rproc->secure_mode || !rproc->fw_text_resident)
+		rproc_fw_cache_drop(rproc);
+
+	if (rproc->fw_cache) {
+		schedule_work(&rproc->boot_work);
+		return 0;
 	}
 
-	return 0;
+	return rproc_request_fw(rproc);
 }
 
 int rproc_pa_to_da(struct rproc *rproc, phys_addr_t pa, u64 *da)
@@ -1379,6 +1924,9 @@ void rproc_put(struct rproc *rproc)
 	if (--rproc->count)
 		goto out;
 
+	/* no more pre-wakes for a processor going down */
+	rproc_traffic_reset(rproc);
+
 	if (rproc->trace_buf0)
 		/* iounmap normal memory, so make sparse happy */
 		iounmap((__force void __iomem *) rproc->trace_buf0);
@@ -1587,13 +2135,18 @@ static int rproc_runtime_resume(struct device *dev)
 	struct rproc *rproc = platform_get_drvdata(pdev);
 	int ret = 0;
 
+	ktime_t start = ktime_get();
+
 	dev_dbg(dev, "Enter %s\n", __func__);
 
 	if (rproc->ops->resume)
 		ret = rproc->ops->resume(rproc);
 
-	if (!ret)
+	if (!ret) {
+		rproc_traffic_resumed(rproc,
+				ktime_us_delta(ktime_get(), start));
 		_event_notify(rproc, RPROC_RESUME, NULL);
+	}
 
 	return 0;
 }
@@ -1604,6 +2157,7 @@ static int rproc_runtime_suspend(struct device *dev)
 	struct rproc *rproc = platform_get_drvdata(pdev);
 	int ret = 0;
 	unsigned to;
+	ktime_t start;
 
 	dev_dbg(dev, "Enter %s\n", __func__);
 
@@ -1617,6 +2171,13 @@ static int rproc_runtime_suspend(struct device *dev)
 		goto abort;
 	}
 
+	/* the next predicted burst is too close for a suspend to pay off */
+	if (!rproc->force_suspend && rproc_traffic_keep_awake(rproc)) {
+		dev_dbg(dev, "suspend avoided, traffic expected\n");
+		ret = -EBUSY;
+		goto abort;
+	}
+
 	/*
 	 * Notify PROC_PRE_SUSPEND only when the suspend is not forced.
 	 * Users can use pre suspend call back to cancel autosuspend, but
@@ -1634,6 +2195,7 @@ static int rproc_runtime_suspend(struct device *dev)
 		goto abort;
 	}
 	/* Now call machine-specific suspend function (if exist) */
+	start = ktime_get();
 	if (rproc->ops->suspend)
 		ret = rproc->ops->suspend(rproc, rproc->force_suspend);
 	/*
@@ -1649,6 +2211,7 @@ static int rproc_runtime_suspend(struct device *dev)
 			dev_err(dev, "suspend error %d", ret);
 		goto abort;
 	}
+	rproc_traffic_suspended(rproc, ktime_us_delta(ktime_get(), start));
 	/* we are not interested in the returned value */
 	_event_notify(rproc, RPROC_POS_SUSPEND, NULL);
 	mutex_unlock(&rproc->pm_lock);
@@ -1741,10 +2304,12 @@ int rproc_register(struct device *dev, const char *name,
 #ifdef CONFIG_REMOTE_PROC_AUTOSUSPEND
 	rproc->sus_timeout = sus_timeout;
 	mutex_init(&rproc->pm_lock);
+	rproc_traffic_init(rproc);
 #endif
 	mutex_init(&rproc->lock);
 	mutex_init(&rproc->secure_lock);
 	INIT_WORK(&rproc->error_work, rproc_error_work);
+	INIT_WORK(&rproc->boot_work, rproc_boot_work);
 	BLOCKING_INIT_NOTIFIER_HEAD(&rproc->nbh);
 
 	rproc->state = RPROC_OFFLINE;
@@ -1752,6 +2317,9 @@ int rproc_register(struct device *dev, const char *name,
 	rproc->qos_request = kzalloc(sizeof(*rproc->qos_request),
 			GFP_KERNEL);
 	if (!rproc->qos_request) {
+#ifdef CONFIG_REMOTE_PROC_AUTOSUSPEND
+		rproc_traffic_exit(rproc);
+#endif
 		kfree(rproc);
 		return -ENOMEM;
 	}
@@ -1782,6 +2350,11 @@ int rproc_register(struct device *dev, const char *name,
 
 	debugfs_create_file("name", 0444, rproc->dbg_dir, rproc,
 							&rproc_name_ops);
+#ifdef CONFIG_REMOTE_PROC_AUTOSUSPEND
+	if (rproc->traffic)
+		debugfs_create_file("traffic", 0444, rproc->dbg_dir, rproc,
+							&rproc_traffic_ops);
+#endif
 
 out:
 	return 0;
@@ -1809,6 +2382,11 @@ int rproc_unregister(const char *name)
 
 	rproc->secure_mode = false;
 	rproc->secure_ttb = NULL;
+	cancel_work_sync(&rproc->boot_work);
+	rproc_fw_cache_drop(rproc);
+#ifdef CONFIG_REMOTE_PROC_AUTOSUSPEND
+	rproc_traffic_exit(rproc);
+#endif
 	pm_qos_remove_request(rproc->qos_request);
 	kfree(rproc->qos_request);
 	kfree(rproc->last_trace_buf0);
@@ -31,6 +31,7 @@
 #include <linux/sched.h>
 #include <linux/wait.h>
 #include <linux/rpmsg.h>
+#include <linux/remoteproc.h>
 
 /**
  * struct virtproc_info - virtual remote processor info
@@ -528,6 +529,10 @@ int rpmsg_send_offchannel_raw(struct rpmsg_channel *rpdev, u32 src, u32 dst,
 	/* descriptors must be written before kicking remote processor */
 	wmb();
 
+	/* feed the remote processor's idle predictor */
+	if (vrp->rproc)
+		rproc_traffic(vrp->rproc, src);
+
 	/* tell the remote processor it has a pending message to read */
 	virtqueue_kick(vrp->svq);
 
@@ -584,6 +589,9 @@ static void rpmsg_recv_done(struct virtqueue *rvq)
 	else
 		dev_warn(dev, "msg received with no recepient\n");
 
+	if (vrp->rproc)
+		rproc_traffic(vrp->rproc, msg->dst);
+
 	/* add the buffer back to the remote processor's virtqueue */
 	offset = ((unsigned long) msg) - ((unsigned long) vrp->rbufs);
 	sim_addr = vrp->sim_base + offset;
@@ -16,8 +16,10 @@
 #include <linux/console.h>
 #include <linux/init.h>
 #include <linux/module.h>
+#include <linux/notifier.h>
 #include <linux/platform_device.h>
 #include <linux/proc_fs.h>
+#include <linux/reboot.h>
 #include <linux/string.h>
 #include <linux/uaccess.h>
 #include <linux/io.h>
@@ -56,6 +58,17 @@ static int ram_console_bad_blocks;
 #define ECC_POLY CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION_POLYNOMIAL
 #endif
 
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION_DEFERRED
+/*
+ * The block being filled is only encoded once it is complete, or by
+ * ram_console_flush() on panic and reboot. From then on every write is
+ * encoded right away, as nothing may come after it.
+ */
+static int ram_console_ecc_eager;
+static int ram_console_unverified_bytes;
+static uint8_t __initdata ram_console_head_block[ECC_BLOCK_SIZE];
+#endif
+
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
 static void ram_console_encode_rs8(uint8_t *data, size_t len, uint8_t *ecc)
 {
@@ -84,6 +97,7 @@ static void ram_console_update(const char *s, unsigned int count)
 	struct ram_console_buffer *buffer = ram_console_buffer;
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
 	uint8_t *buffer_end = buffer->data + ram_console_buffer_size;
+	uint8_t *end = buffer->data + buffer->start + count;
 	uint8_t *block;
 	uint8_t *par;
 	int size = ECC_BLOCK_SIZE;
@@ -96,13 +110,67 @@ static void ram_console_update(const char *s, unsigned int count)
 	do {
 		if (block + ECC_BLOCK_SIZE > buffer_end)
 			size = buffer_end - block;
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION_DEFERRED
+		/* leave the partial block to whoever completes it */
+		if (block + size > end && !ram_console_ecc_eager)
+			break;
+#endif
 		ram_console_encode_rs8(block, size, par);
 		block += ECC_BLOCK_SIZE;
 		par += ECC_SIZE;
-	} while (block < buffer->data + buffer->start + count);
+	} while (block < end);
 #endif
 }
 
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION_DEFERRED
+/* Encode the partially written block and stop deferring. */
+static void ram_console_flush(void)
+{
+	struct ram_console_buffer *buffer = ram_console_buffer;
+	uint8_t *buffer_end = buffer->data + ram_console_buffer_size;
+	uint8_t *block;
+	uint8_t *par;
+	int size = ECC_BLOCK_SIZE;
+
+	ram_console_ecc_eager = 1;
+
+	block = buffer->data + (buffer->start & ~(ECC_BLOCK_SIZE - 1));
+	if (block >= buffer_end)
+		return;
+	if (block + size > buffer_end)
+		size = buffer_end - block;
+
+	par = ram_console_par_buffer +
+	      (buffer->start / ECC_BLOCK_SIZE) * ECC_SIZE;
+	ram_console_encode_rs8(block, size, par);
+}
+
+/* Other CPUs are stopped by now, no need for the console lock */
+static int ram_console_panic_notify(struct notifier_block *nb,
+				    unsigned long event, void *unused)
+{
+	ram_console_flush();
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block ram_console_panic_nb = {
+	.notifier_call = ram_console_panic_notify,
+};
+
+static int ram_console_reboot_notify(struct notifier_block *nb,
+				     unsigned long event, void *unused)
+{
+	console_lock();
+	ram_console_flush();
+	console_unlock();
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block ram_console_reboot_nb = {
+	.notifier_call = ram_console_reboot_notify,
+};
+#endif
+
 static void ram_console_update_header(void)
 {
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
@@ -178,6 +246,24 @@ ram_console_save_old(struct ram_console_buffer *buffer, const char *bootinfo,
 		int size = ECC_BLOCK_SIZE;
 		if (block + size > buffer->data + ram_console_buffer_size)
 			size = buffer->data + ram_console_buffer_size - block;
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION_DEFERRED
+		/*
+		 * The block that was being filled has stale parity unless the
+		 * previous kernel flushed it. Correcting it could roll new
+		 * text back to what was there before, so only check it.
+		 */
+		if ((buffer->start & (ECC_BLOCK_SIZE - 1)) &&
+		    block == buffer->data +
+			     (buffer->start & ~(ECC_BLOCK_SIZE - 1))) {
+			memcpy(ram_console_head_block, block, size);
+			if (ram_console_decode_rs8(ram_console_head_block,
+						   size, par))
+				ram_console_unverified_bytes = size;
+			block += ECC_BLOCK_SIZE;
+			par += ECC_SIZE;
+			continue;
+		}
+#endif
 		numerr = ram_console_decode_rs8(block, size, par);
 		if (numerr > 0) {
 #if 0
@@ -199,6 +285,12 @@ ram_console_save_old(struct ram_console_buffer *buffer, const char *bootinfo,
 		strbuf_len = snprintf(strbuf, sizeof(strbuf),
 			"\n%d Corrected bytes, %d unrecoverable blocks\n",
 			ram_console_corrected_bytes, ram_console_bad_blocks);
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION_DEFERRED
+	else if (ram_console_unverified_bytes)
+		strbuf_len = snprintf(strbuf, sizeof(strbuf),
+			"\nNo errors detected, last %d bytes unchecked\n",
+			ram_console_unverified_bytes);
+#endif
 	else
 		strbuf_len = snprintf(strbuf, sizeof(strbuf),
 				      "\nNo errors detected\n");
@@ -320,6 +412,11 @@ static int __init ram_console_init(struct ram_console_buffer *buffer,
 	buffer->size = 0;
 
 	register_console(&ram_console);
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION_DEFERRED
+	atomic_notifier_chain_register(&panic_notifier_list,
+				       &ram_console_panic_nb);
+	register_reboot_notifier(&ram_console_reboot_nb);
+#endif
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ENABLE_VERBOSE
 	console_verbose();
 #endif
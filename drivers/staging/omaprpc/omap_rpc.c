@@ -55,20 +55,20 @@ static struct timeval end_time;
 static long usec_elapsed;
 #endif
 
+static int omaprpc_fxn_free(int id, void *p, void *data)
+{
+	kfree(p);
+	return 0;
+}
+
 static void omaprpc_fxn_del(struct omaprpc_instance_t *rpc)
 {
 	/* Free any outstanding function calls */
-	if (!list_empty(&rpc->fxn_list)) {
-		struct omaprpc_call_function_list_t *pos, *n;
-
-		mutex_lock(&rpc->lock);
-		list_for_each_entry_safe(pos, n, &rpc->fxn_list, list)  {
-			list_del(&pos->list);
-			kfree(pos->function);
-			kfree(pos);
-		}
-		mutex_lock(&rpc->lock);
-	}
+	mutex_lock(&rpc->lock);
+	idr_for_each(&rpc->fxn_idr, omaprpc_fxn_free, NULL);
+	idr_remove_all(&rpc->fxn_idr);
+	idr_destroy(&rpc->fxn_idr);
+	mutex_unlock(&rpc->lock);
 }
 
 static struct omaprpc_call_function_t *omaprpc_fxn_get(
@@ -76,21 +76,14 @@ static struct omaprpc_call_function_t *omaprpc_fxn_get(
 					u16 msgId)
 {
 	struct omaprpc_call_function_t *function = NULL;
-	struct omaprpc_call_function_list_t *pos, *n;
 
 	mutex_lock(&rpc->lock);
-	list_for_each_entry_safe(pos, n, &rpc->fxn_list, list) {
-		OMAPRPC_INFO(rpc->rpcserv->dev,
-			"Looking for msg %u, found msg %u\n",
-			msgId, pos->msgId);
-		if (pos->msgId == msgId) {
-			function = pos->function;
-			list_del(&pos->list);
-			kfree(pos);
-			break;
-		}
-	}
+	function = idr_find(&rpc->fxn_idr, msgId);
+	if (function)
+		idr_remove(&rpc->fxn_idr, msgId);
 	mutex_unlock(&rpc->lock);
+	OMAPRPC_INFO(rpc->rpcserv->dev,
+		"Looking for msg %u, found %p\n", msgId, function);
 	return function;
 }
 
@@ -98,24 +91,31 @@ static int omaprpc_fxn_add(struct omaprpc_instance_t *rpc,
 			   struct omaprpc_call_function_t *function,
 			   u16 msgId)
 {
-	struct omaprpc_call_function_list_t *fxn = NULL;
-	fxn = (struct omaprpc_call_function_list_t *)
-		kmalloc(sizeof(struct omaprpc_call_function_list_t),
-			GFP_KERNEL);
-	if (fxn) {
-		fxn->function = function;
-		fxn->msgId = msgId;
+	int ret, id;
+
+	do {
+		if (!idr_pre_get(&rpc->fxn_idr, GFP_KERNEL)) {
+			ret = -ENOMEM;
+			break;
+		}
 		mutex_lock(&rpc->lock);
-		list_add(&fxn->list, &rpc->fxn_list);
+		ret = idr_get_new_above(&rpc->fxn_idr, function, msgId, &id);
+		if (!ret && id != msgId) {
+			/* msgId wrapped onto a call that never returned */
+			idr_remove(&rpc->fxn_idr, id);
+			ret = -EBUSY;
+		}
 		mutex_unlock(&rpc->lock);
-		OMAPRPC_INFO(rpc->rpcserv->dev,
-			"Added msg id %u to list", msgId);
-	} else {
+	} while (ret == -EAGAIN);
+
+	if (ret) {
 		OMAPRPC_ERR(rpc->rpcserv->dev,
 			"Failed to add function %p to list with id %d\n",
 			function, msgId);
-		return -ENOMEM;
+		return ret;
 	}
+	OMAPRPC_INFO(rpc->rpcserv->dev,
+		"Added msg id %u to list", msgId);
 	return 0;
 }
 
@@ -373,6 +373,7 @@ static long omaprpc_ioctl(struct file *filp,
 				__func__,
 				_IOC_NR(cmd), ret);
 		}
+		omaprpc_xlate_cache_remove(rpc, data.handle);
 		ion_free(rpc->ion_client, data.handle);
 		if (copy_to_user((char __user *)arg, &data, sizeof(data))) {
 			ret = -EFAULT;
@@ -430,8 +431,8 @@ static int omaprpc_open(struct inode *inode, struct file *filp)
 	/* Initialize the current msg id */
 	rpc->msgId = 0;
 
-	/* Initialize the remember function call list */
-	INIT_LIST_HEAD(&rpc->fxn_list);
+	/* Initialize the remember function call table */
+	idr_init(&rpc->fxn_idr);
 
 #if defined(OMAPRPC_USE_DMABUF)
 	INIT_LIST_HEAD(&rpc->dma_list);
@@ -452,6 +453,7 @@ static int omaprpc_open(struct inode *inode, struct file *filp)
 						(1 << ION_HEAP_TYPE_CARVEOUT) |
 						(1 << OMAP_ION_HEAP_TYPE_TILER),
 						"rpmsg-rpc");
+	omaprpc_xlate_cache_init(rpc);
 #endif
 
 	/* remember rpc in filp's private data */
@@ -536,6 +538,8 @@ static int omaprpc_release(struct inode *inode, struct file *filp)
 
 #if defined(OMAPRPC_USE_ION)
 	if (rpc->ion_client) {
+		/* Drop the cached translations and mappings */
+		omaprpc_xlate_cache_flush(rpc);
 		/* Destroy our local client to ion */
 		ion_client_destroy(rpc->ion_client);
 		rpc->ion_client = NULL;
@@ -141,12 +141,6 @@ struct omaprpc_service_t {
 #endif
 };
 
-struct omaprpc_call_function_list_t {
-	struct list_head list;
-	struct omaprpc_call_function_t *function;
-	u16 msgId;
-};
-
 struct omaprpc_instance_t {
 	struct list_head list;
 	struct omaprpc_service_t *rpcserv;
@@ -161,11 +155,16 @@ struct omaprpc_instance_t {
 	u32 core;
 #if defined(OMAPRPC_USE_ION)
 	struct ion_client *ion_client;
+	/* translation cache, most recently used first */
+	struct mutex xlate_lock;
+	struct list_head xlate_list;
+	int xlate_count;
 #elif defined(OMAPRPC_USE_DMABUF)
 	struct list_head dma_list;
 #endif
 	u16 msgId;
-	struct list_head fxn_list;
+	/* outstanding calls, keyed by msgId */
+	struct idr fxn_idr;
 };
 
 #if defined(OMAPRPC_USE_DMABUF)
@@ -213,6 +212,18 @@ phys_addr_t omaprpc_buffer_lookup(struct omaprpc_instance_t *rpc,
  */
 long omaprpc_recalc_off(phys_addr_t lpa, long uoff);
 
+#if defined(OMAPRPC_USE_ION)
+/*!
+ * The translation cache remembers, per instance, the physical address and
+ * kernel mapping of each ION handle (or PVR fd) passed in a call, until the
+ * handle is unregistered or the instance is released.
+ */
+void omaprpc_xlate_cache_init(struct omaprpc_instance_t *rpc);
+void omaprpc_xlate_cache_remove(struct omaprpc_instance_t *rpc,
+				struct ion_handle *handle);
+void omaprpc_xlate_cache_flush(struct omaprpc_instance_t *rpc);
+#endif
+
 
 #endif
 
@@ -32,9 +32,164 @@
 
 #include "omap_rpc_internal.h"
 
-uint8_t *omaprpc_map_parameter(struct omaprpc_instance_t *rpc,
-				struct omaprpc_param_t *param)
+#define OMAPRPC_XLATE_CACHE_SIZE	(32)
+
+/* a cached translation of one ION handle or PVR fd */
+struct omaprpc_xlate_t {
+	struct list_head list;
+	void *key;			/* handle or fd as passed by the user */
+	struct ion_handle *handle;
+	struct ion_buffer *buffer;	/* buffer the fd referred to */
+	int imported;			/* handle is our own ion_import() */
+	int pinned;			/* kva in use by a translation */
+	phys_addr_t lpa;
+	uint8_t *kva;
+	long last_uoff;			/* last offset looked up ... */
+	phys_addr_t last_rpa;		/* ... and its remote address */
+};
+
+void omaprpc_xlate_cache_init(struct omaprpc_instance_t *rpc)
 {
+	mutex_init(&rpc->xlate_lock);
+	INIT_LIST_HEAD(&rpc->xlate_list);
+	rpc->xlate_count = 0;
+}
+
+static void omaprpc_xlate_drop(struct omaprpc_instance_t *rpc,
+				struct omaprpc_xlate_t *x)
+{
+	list_del(&x->list);
+	rpc->xlate_count--;
+	if (x->kva)
+		ion_unmap_kernel(rpc->ion_client, x->handle);
+	if (x->imported)
+		ion_free(rpc->ion_client, x->handle);
+	kfree(x);
+}
+
+static struct omaprpc_xlate_t *omaprpc_xlate_get(
+					struct omaprpc_instance_t *rpc,
+					void *key)
+{
+	struct omaprpc_xlate_t *x, *n;
+	struct ion_handle *handle = (struct ion_handle *)key;
+	struct ion_buffer *ion_buffer = NULL;
+	ion_phys_addr_t paddr;
+	size_t unused;
+	int num_handles = 1;
+
+	list_for_each_entry(x, &rpc->xlate_list, list) {
+		if (x->key != key)
+			continue;
+
+		/* an fd may have been closed and reused for another buffer */
+		if (x->imported) {
+			ion_buffer = NULL;
+			if (omap_ion_share_fd_to_buffers((int)key, &ion_buffer,
+					&num_handles) < 0 ||
+			    ion_buffer != x->buffer) {
+				/* a pinned entry goes when it is unpinned */
+				if (x->pinned)
+					x->key = NULL;
+				else
+					omaprpc_xlate_drop(rpc, x);
+				break;
+			}
+		}
+		list_move(&x->list, &rpc->xlate_list);
+		return x;
+	}
+
+	x = kzalloc(sizeof(*x), GFP_KERNEL);
+	if (!x)
+		return NULL;
+
+	/* is it an ion handle? */
+	if (!ion_phys(rpc->ion_client, handle, &paddr, &unused)) {
+		OMAPRPC_INFO(rpc->rpcserv->dev,
+			"Handle %p is an ION Handle to ARM PA %p\n",
+			key, (void *)paddr);
+	} else {
+		/* is it an pvr buffer wrapping an ion handle? */
+
+		/* @TODO need to support 2 ion handles per 1 pvr handle
+		 (NV12 case) */
+		ion_buffer = NULL;
+		num_handles = 1;
+		if (omap_ion_share_fd_to_buffers((int)key, &ion_buffer,
+				&num_handles) < 0 || !ion_buffer)
+			goto err;
+
+		handle = ion_import(rpc->ion_client, ion_buffer);
+		if (IS_ERR_OR_NULL(handle))
+			goto err;
+		if (ion_phys(rpc->ion_client, handle, &paddr, &unused)) {
+			ion_free(rpc->ion_client, handle);
+			goto err;
+		}
+		OMAPRPC_INFO(rpc->rpcserv->dev,
+			"FD %d is an PVR Handle to ARM PA %p\n",
+			(int)key, (void *)paddr);
+		x->imported = 1;
+		x->buffer = ion_buffer;
+	}
+
+	x->key = key;
+	x->handle = handle;
+	x->lpa = (phys_addr_t)paddr;
+	x->last_uoff = -1;
+
+	/* make room by dropping the least recently used idle entry */
+	if (rpc->xlate_count >= OMAPRPC_XLATE_CACHE_SIZE) {
+		list_for_each_entry_reverse(n, &rpc->xlate_list, list) {
+			if (!n->pinned) {
+				omaprpc_xlate_drop(rpc, n);
+				break;
+			}
+		}
+	}
+
+	list_add(&x->list, &rpc->xlate_list);
+	rpc->xlate_count++;
+	return x;
+err:
+	kfree(x);
+	return NULL;
+}
+
+void omaprpc_xlate_cache_remove(struct omaprpc_instance_t *rpc,
+				struct ion_handle *handle)
+{
+	struct omaprpc_xlate_t *x, *n;
+
+	mutex_lock(&rpc->xlate_lock);
+	list_for_each_entry_safe(x, n, &rpc->xlate_list, list) {
+		if (x->handle == handle || x->key == (void *)handle)
+			omaprpc_xlate_drop(rpc, x);
+	}
+	mutex_unlock(&rpc->xlate_lock);
+}
+
+void omaprpc_xlate_cache_flush(struct omaprpc_instance_t *rpc)
+{
+	struct omaprpc_xlate_t *x, *n;
+
+	mutex_lock(&rpc->xlate_lock);
+	list_for_each_entry_safe(x, n, &rpc->xlate_list, list)
+		omaprpc_xlate_drop(rpc, x);
+	mutex_unlock(&rpc->xlate_lock);
+}
+
+/*
+ * Called with xlate_lock held. The cache entry is pinned and returned in
+ * *pin; it has to be handed back to omaprpc_unmap_parameter() as is, since
+ * its key may be cleared meanwhile if the fd turns out to be stale.
+ */
+static uint8_t *omaprpc_map_parameter(struct omaprpc_instance_t *rpc,
+				struct omaprpc_param_t *param,
+				struct omaprpc_xlate_t **pin)
+{
+	struct omaprpc_xlate_t *x;
 	uint32_t pri_offset = 0;
 	uint8_t *kva = NULL;
 	uint8_t *bkva = NULL;
@@ -42,8 +197,20 @@ uint8_t *omaprpc_map_parameter(struct omaprpc_instance_t *rpc,
 	/* calc any primary offset if present */
 	pri_offset = param->data - param->base;
 
-	bkva = (uint8_t *)ion_map_kernel(rpc->ion_client,
-		(struct ion_handle *)param->reserved);
+	x = omaprpc_xlate_get(rpc, (void *)param->reserved);
+	if (!x)
+		return NULL;
+
+	/* the mapping is kept with the cache entry */
+	if (!x->kva) {
+		bkva = (uint8_t *)ion_map_kernel(rpc->ion_client, x->handle);
+		if (IS_ERR_OR_NULL(bkva))
+			return NULL;
+		x->kva = bkva;
+	}
+	bkva = x->kva;
+	x->pinned++;
+	*pin = x;
 
 	/* set the kernel VA equal to the base kernel VA plus the primary
 	 offset */
@@ -62,15 +229,17 @@ uint8_t *omaprpc_map_parameter(struct omaprpc_instance_t *rpc,
 
 }
 
-void omaprpc_unmap_parameter(struct omaprpc_instance_t *rpc,
-				struct omaprpc_param_t *param,
-				uint8_t *ptr,
-				uint32_t sec_offset)
+/* called with xlate_lock held */
+static void omaprpc_unmap_parameter(struct omaprpc_instance_t *rpc,
+				struct omaprpc_xlate_t *x)
 {
-	ion_unmap_kernel(rpc->ion_client, (struct ion_handle *)param->reserved);
+	/* the kernel mapping stays cached, just let the entry go again */
+	if (--x->pinned == 0 && !x->key)
+		omaprpc_xlate_drop(rpc, x);
 }
 
-phys_addr_t omaprpc_buffer_lookup(struct omaprpc_instance_t *rpc,
+/* called with xlate_lock held */
+static phys_addr_t __omaprpc_buffer_lookup(struct omaprpc_instance_t *rpc,
 				uint32_t core, virt_addr_t uva,
 				virt_addr_t buva, void *reserved)
 {
@@ -94,60 +263,25 @@ phys_addr_t omaprpc_buffer_lookup(struct omaprpc_instance_t *rpc,
 
 #if defined(OMAPRPC_USE_ION)
 	if (reserved) {
-		struct ion_handle *handle;
-		ion_phys_addr_t paddr;
-		size_t unused;
-
-		/* is it an ion handle? */
-		handle = (struct ion_handle *)reserved;
-		if (!ion_phys(rpc->ion_client, handle, &paddr, &unused)) {
-			lpa = (phys_addr_t)paddr;
-			OMAPRPC_INFO(rpc->rpcserv->dev,
-				"Handle %p is an ION Handle to ARM PA %p "
-				"(Uoff=%ld)\n", reserved, (void *)lpa, uoff);
-			uoff = omaprpc_recalc_off(lpa, uoff);
-			lpa += uoff;
-			goto to_va;
-		} else {
-			/* is it an pvr buffer wrapping an ion handle? */
-
-			/* @TODO need to support 2 ion handles per 1 pvr handle
-			 (NV12 case) */
-			struct ion_buffer *ion_buffer = NULL;
-			int num_handles = 1;
-			handle = NULL;
-			if (omap_ion_share_fd_to_buffers((int)reserved,
-				&ion_buffer, &num_handles) < 0) {
-				goto to_va;
-			}
-			if (ion_buffer) {
-				handle = ion_import(rpc->ion_client,
-							ion_buffer);
-			}
-			if (handle && !ion_phys(rpc->ion_client, handle,
-				&paddr, &unused)) {
-				lpa = (phys_addr_t)paddr;
-				OMAPRPC_INFO(rpc->rpcserv->dev,
-					"FD %d is an PVR Handle to ARM PA %p "
-					"(Uoff=%ld)\n", (int)reserved,
-					(void *)lpa, uoff);
-				uoff = omaprpc_recalc_off(lpa, uoff);
-				lpa += uoff;
-				goto to_va;
+		struct omaprpc_xlate_t *x = omaprpc_xlate_get(rpc, reserved);
+
+		if (x) {
+			lpa = x->lpa;
+			if (x->last_uoff == uoff) {
+				rpa = x->last_rpa;
+				goto to_end;
 			}
-			/* @TODO need to do some buffer tracking and call
-			 * ion_free when it is no longer being used. this
-			 * will make sure the buffer is not freed while
-			 * we are still using it */
-			if (handle)
-				ion_free(rpc->ion_client, handle);
+			lpa += omaprpc_recalc_off(lpa, uoff);
+			rpa = rpmsg_local_to_remote_pa(rpc, lpa);
+			x->last_uoff = uoff;
+			x->last_rpa = rpa;
+			goto to_end;
 		}
 	}
 #endif
 
 	/* Ask the TILER to convert from virtual to physical */
 	lpa = (phys_addr_t)tiler_virt2phys(uva);
-to_va:
 
 	/* convert the local physical address to remote physical address */
 	rpa = rpmsg_local_to_remote_pa(rpc, lpa);
@@ -158,7 +292,20 @@ to_end:
 	return rpa;
 }
 
-int omaprpc_xlate_buffers(struct omaprpc_instance_t *rpc,
+phys_addr_t omaprpc_buffer_lookup(struct omaprpc_instance_t *rpc,
+				uint32_t core, virt_addr_t uva,
+				virt_addr_t buva, void *reserved)
+{
+	phys_addr_t rpa;
+
+	mutex_lock(&rpc->xlate_lock);
+	rpa = __omaprpc_buffer_lookup(rpc, core, uva, buva, reserved);
+	mutex_unlock(&rpc->xlate_lock);
+
+	return rpa;
+}
+
+static int __omaprpc_xlate_buffers(struct omaprpc_instance_t *rpc,
 			struct omaprpc_call_function_t *function,
 			int direction)
 {
@@ -166,6 +313,7 @@ int omaprpc_xlate_buffers(struct omaprpc_instance_t *rpc,
 	uint32_t ptr_idx = 0, offset = 0, size = 0;
 	/* @NOTE not all the parameters are pointers so this may be sparse */
 	uint8_t *base_ptrs[OMAPRPC_MAX_PARAMETERS];
+	struct omaprpc_xlate_t *pins[OMAPRPC_MAX_PARAMETERS];
 
 	if (function->num_translations == 0)
 		return 0;
@@ -216,7 +364,7 @@ restart:
 			/* map the UVA pointer to KVA space, the offset could
 			 potentially be modified due to the mapping */
 			base_ptrs[ptr_idx] = omaprpc_map_parameter(rpc,
-				&function->params[ptr_idx]);
+				&function->params[ptr_idx], &pins[ptr_idx]);
 		}
 
 		/* if the KVA pointer is not NULL */
@@ -239,7 +387,8 @@ restart:
 					OMAPRPC_ERR(rpc->rpcserv->dev,
 						"ERROR: KVA %p is unaligned!\n",
 						(void *)kva);
-					return -EADDRNOTAVAIL;
+					ret = -EADDRNOTAVAIL;
+					break;
 				}
 				/* load the user's VA */
 				uva = *(virt_addr_t *)kva;
@@ -251,7 +400,7 @@ restart:
 					offset, idx);
 
 				/* calc the new RPA (remote physical address) */
-				rpa = omaprpc_buffer_lookup(rpc, rpc->core,
+				rpa = __omaprpc_buffer_lookup(rpc, rpc->core,
 					uva, buva, reserved);
 				/* save the old value */
 				function->translations[idx].reserved = uva;
@@ -279,8 +428,10 @@ restart:
 				phys_addr_t rpa = 0;
 				/* make sure we won't cause an unalign mem
 				 access */
-				if ((kva & 0x3) > 0)
-					return -EADDRNOTAVAIL;
+				if ((kva & 0x3) > 0) {
+					ret = -EADDRNOTAVAIL;
+					break;
+				}
 				/* get what was there for debugging */
 				rpa = *(phys_addr_t *)kva;
 				/* convienence value of uva */
@@ -334,13 +485,26 @@ unwind:
 	/* unmap all the pointers that were mapped and not freed yet */
 	for (idx = 0; idx < OMAPRPC_MAX_PARAMETERS; idx++) {
 		if (base_ptrs[idx]) {
-			omaprpc_unmap_parameter(rpc,
-				&function->params[idx],
-				base_ptrs[idx], 0);
+			omaprpc_unmap_parameter(rpc, pins[idx]);
 			base_ptrs[idx] = NULL;
 		}
 	}
 	return ret;
 }
 
+int omaprpc_xlate_buffers(struct omaprpc_instance_t *rpc,
+			struct omaprpc_call_function_t *function,
+			int direction)
+{
+	int ret;
+
+	if (function->num_translations == 0)
+		return 0;
 
+	/* keeps cached mappings alive while the pointers are patched */
+	mutex_lock(&rpc->xlate_lock);
+	ret = __omaprpc_xlate_buffers(rpc, function, direction);
+	mutex_unlock(&rpc->xlate_lock);
+
+	return ret;
+}
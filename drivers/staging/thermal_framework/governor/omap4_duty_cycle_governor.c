@@ -19,10 +19,13 @@
 #include <linux/module.h>
 #include <linux/slab.h>
 #include <linux/omap4_duty_cycle_governor.h>
+#include <linux/thermal_framework.h>
 #include <plat/omap_device.h>
 
 #define NORMAL_TEMP_MONITORING_RATE 1000
 #define NORMAL_MONITORING_RATE 10000
+#define SLOW_TEMP_MONITORING_RATE 10000
+#define PCB_MIN_TEMP -40000
 #define DEFAULT_TEMPERATURE 65000
 #define TEMP_THRESHOLD 1
 #define INIT_SECTION -1
@@ -37,6 +40,8 @@ struct duty_governor {
 	int previous_temp;
 	int curr_pcb_temp;
 	int previous_pcb_temp;
+	int sample_pcb_temp;
+	unsigned long sample_time;
 	bool cur_turbo_sprint;
 	int working_section;
 	int npcb_sections;
@@ -89,6 +94,21 @@ int omap4_duty_pcb_register(struct pcb_sens *tpcb)
 	return 0;
 }
 
+/*
+ * omap4_duty_pcb_changed() - let the PCB sensor request an immediate
+ * evaluation, e.g. when turbo sprint is toggled, instead of waiting for
+ * a possibly stretched sampling period.
+ */
+void omap4_duty_pcb_changed(void)
+{
+	if (!IS_ERR_OR_NULL(t_governor) &&
+	    !IS_ERR_OR_NULL(t_governor->tpcb) &&
+	    !IS_ERR_OR_NULL(t_governor->tduty)) {
+		cancel_delayed_work(&t_governor->duty_cycle_governor_work);
+		schedule_delayed_work(&t_governor->duty_cycle_governor_work, 0);
+	}
+}
+
 static bool is_threshold(struct duty_governor *tgov)
 {
 	int delta;
@@ -219,6 +239,40 @@ static void omap4_duty_update(struct duty_governor *tgov)
 		dump_active_profile(tgov);
 }
 
+/*
+ * omap4_duty_next_period() - stretch the PCB sampling period while the
+ * temperature is stable and far from the boundaries of the active section.
+ */
+static int omap4_duty_next_period(struct duty_governor *tgov)
+{
+	struct pcb_section *sections = tgov->tpcb_sections;
+	int working_section = tgov->working_section;
+	unsigned int elapsed;
+	int low = PCB_MIN_TEMP;
+	int high = DEFAULT_TEMPERATURE;
+	int period;
+
+	if (tgov->cur_turbo_sprint) {
+		sections = tgov->turbo_sprint_tpcb_sections;
+		working_section = tgov->turbo_sprint_working_session;
+	}
+
+	if (working_section >= 0) {
+		high = sections[working_section].pcb_temp_level;
+		if (working_section > 0)
+			low = sections[working_section - 1].pcb_temp_level;
+	}
+
+	elapsed = jiffies_to_msecs(jiffies - tgov->sample_time);
+	period = thermal_adaptive_rate(tgov->curr_pcb_temp,
+			tgov->sample_pcb_temp, elapsed, low, high,
+			NORMAL_TEMP_MONITORING_RATE, SLOW_TEMP_MONITORING_RATE);
+	tgov->sample_pcb_temp = tgov->curr_pcb_temp;
+	tgov->sample_time = jiffies;
+
+	return period;
+}
+
 static void omap4_duty_governor_delayed_work_fn(struct work_struct *work)
 {
 	if (!IS_ERR_OR_NULL(t_governor->tpcb)) {
@@ -233,6 +287,7 @@ static void omap4_duty_governor_delayed_work_fn(struct work_struct *work)
 			    if (is_threshold(t_governor))
 			        omap4_duty_update(t_governor);
 			}
+			t_governor->period = omap4_duty_next_period(t_governor);
 		} else {
 			pr_err("%s:update_temp() isn't defined\n", __func__);
 		}
@@ -277,6 +332,7 @@ static int __init omap4_duty_governor_init(void)
 	t_governor->turbo_sprint_tpcb_sections = turbo_sprint_pcb_sections;
 	t_governor->turbo_sprint_npcb_sections = turbo_sprint_pcb_sections_size;
 	t_governor->working_section = INIT_SECTION;
+	t_governor->sample_time = jiffies;
 	INIT_DELAYED_WORK(&t_governor->duty_cycle_governor_work,
 				omap4_duty_governor_delayed_work_fn);
 
@@ -44,6 +44,8 @@
 #define NORMAL_TEMP_MONITORING_RATE 1000
 #define FAST_TEMP_MONITORING_RATE 250
 #define DECREASE_MPU_FREQ_PERIOD 2000
+/* slowest averaging period while the die temperature is stable */
+#define AVERAGE_PERIOD_STRETCH 4
 
 #define OMAP_GRADIENT_SLOPE_4460    348
 #define OMAP_GRADIENT_CONST_4460  -9301
@@ -70,6 +72,8 @@ struct omap_die_governor {
 	int sensor_temp;
 	int absolute_delta;
 	int average_period;
+	int average_next_period;
+	unsigned long average_last;
 	int avg_cpu_sensor_temp;
 	int avg_is_valid;
 	struct delayed_work average_cpu_sensor_work;
@@ -275,8 +279,7 @@ static int omap_enter_zone(struct omap_thermal_zone *zone,
 	omap_gov->hotspot_temp_upper = zone->temp_upper;
 	temp_lower = hotspot_temp_to_sensor_temp(omap_gov->hotspot_temp_lower);
 	temp_upper = hotspot_temp_to_sensor_temp(omap_gov->hotspot_temp_upper);
-	thermal_device_call(omap_gov->temp_sensor, set_temp_thresh, temp_lower,
-								temp_upper);
+	thermal_governor_set_window(therm_fw, temp_lower, temp_upper);
 	omap_update_report_rate(omap_gov->temp_sensor, zone->update_rate);
 	if (thermal_lookup_temp("pcb") >= 0)
 		omap_gov->average_period = zone->average_rate;
@@ -411,7 +414,9 @@ static void average_on_die_temperature(void)
 	int i;
 	int die_temp_lower = 0;
 	int die_temp_upper = 0;
+	unsigned int elapsed;
 
+	omap_gov->average_next_period = omap_gov->average_period;
 	if (omap_gov->temp_sensor == NULL)
 		return;
 
@@ -451,8 +456,18 @@ static void average_on_die_temperature(void)
 		omap_gov->hotspot_temp_lower);
 	die_temp_upper = hotspot_temp_to_sensor_temp(
 		omap_gov->hotspot_temp_upper);
-	thermal_device_call(omap_gov->temp_sensor, set_temp_thresh,
-					die_temp_lower, die_temp_upper);
+	thermal_governor_set_window(therm_fw, die_temp_lower, die_temp_upper);
+
+	/*
+	 * The bandgap alert takes care of crossings, so only keep averaging
+	 * at the zone rate while the temperature is actually moving.
+	 */
+	elapsed = jiffies_to_msecs(jiffies - omap_gov->average_last);
+	omap_gov->average_last = jiffies;
+	omap_gov->average_next_period = thermal_adaptive_rate(
+		omap_gov->sensor_temp, cpu_sensor_temp_table[1], elapsed,
+		die_temp_lower, die_temp_upper, omap_gov->average_period,
+		omap_gov->average_period * AVERAGE_PERIOD_STRETCH);
 
 	return;
 }
@@ -466,7 +481,7 @@ static void average_cpu_sensor_delayed_work_fn(struct work_struct *work)
 	average_on_die_temperature();
 
 	schedule_delayed_work(&omap_gov->average_cpu_sensor_work,
-				msecs_to_jiffies(omap_gov->average_period));
+				msecs_to_jiffies(omap_gov->average_next_period));
 }
 
 static int omap_process_cpu_temp(struct thermal_dev *gov,
@@ -550,6 +565,8 @@ static int __init omap_die_governor_init(void)
 			  decrease_mpu_freq_fn);
 
 	omap_gov->average_period = NORMAL_TEMP_MONITORING_RATE;
+	omap_gov->average_next_period = NORMAL_TEMP_MONITORING_RATE;
+	omap_gov->average_last = jiffies;
 	omap_gov->decrease_mpu_freq_period = DECREASE_MPU_FREQ_PERIOD;
 	omap_gov->avg_is_valid = 0;
 
@@ -30,6 +30,7 @@
 #include <linux/workqueue.h>
 #include <linux/mutex.h>
 #include <linux/platform_device.h>
+#include <linux/thermal_framework.h>
 #include <linux/omap4_duty_cycle_governor.h>
 #include <linux/omap4_duty_cycle.h>
 #include <plat/omap_device.h>
@@ -46,6 +47,22 @@ enum omap4_duty_state {
 	OMAP4_DUTY_COOLING_1,
 };
 
+/*
+ * Controller selection. The nitro controller is the original open loop
+ * duty cycle between nitro_rate and cooling_rate. The PID controller
+ * samples the die and PCB temperatures from the thermal framework and
+ * computes the highest frequency cap that keeps both below their limits.
+ */
+enum omap4_duty_controller {
+	OMAP4_DUTY_CTRL_NITRO = 0,
+	OMAP4_DUTY_CTRL_PID,
+};
+
+static const char * const controller_names[] = {
+	[OMAP4_DUTY_CTRL_NITRO]	= "nitro",
+	[OMAP4_DUTY_CTRL_PID]	= "pid",
+};
+
 /* state struct */
 static unsigned int nitro_interval = 20000;
 module_param(nitro_interval, int, 0);
@@ -59,6 +76,37 @@ module_param(nitro_rate, int, 0);
 static unsigned int cooling_rate = 1008000;
 module_param(cooling_rate, int, 0);
 
+static unsigned int controller = OMAP4_DUTY_CTRL_NITRO;
+module_param(controller, int, 0);
+
+/* PID controller sampling period in ms */
+static unsigned int pid_interval = 1000;
+module_param(pid_interval, int, 0);
+
+/* PID controller limits in milli degrees Celsius */
+static unsigned int pcb_limit = 45000;
+module_param(pcb_limit, int, 0);
+
+static unsigned int die_limit = 90000;
+module_param(die_limit, int, 0);
+
+/*
+ * PID gains. kp is in kHz per degree, ki in kHz per degree per second
+ * and kd in kHz per degree per second of temperature slope.
+ */
+static unsigned int pid_kp = 40000;
+module_param(pid_kp, int, 0);
+
+static unsigned int pid_ki = 4000;
+module_param(pid_ki, int, 0);
+
+static unsigned int pid_kd;
+module_param(pid_kd, int, 0);
+
+/* lowest cap the PID controller may impose */
+static unsigned int min_rate = 300000;
+module_param(min_rate, int, 0);
+
 struct duty_cycle_desc {
 	bool enabled;
 	bool saved_hotplug_enabled;
@@ -67,7 +115,33 @@ struct duty_cycle_desc {
 	int (*cool_device) (struct thermal_dev *, int temp);
 };
 
+/*
+ * struct duty_pid_desc - PID controller state
+ * @die_valid/@pcb_valid: the domain has a sensor that can report
+ * @die_temp/@pcb_temp: last sampled temperatures (milli Celsius)
+ * @error: smallest headroom to a limit in the last sample (milli Celsius)
+ * @integral: accumulated error in milli Celsius * ms, clamped for windup
+ * @cap: frequency cap currently applied through cool_device (kHz)
+ * @t_last: jiffies of the last sample
+ * @total_ms/@throttled_ms: time controlled / time spent below nitro_rate
+ * @cap_changes: number of times a new cap was applied
+ */
+struct duty_pid_desc {
+	bool die_valid;
+	bool pcb_valid;
+	int die_temp;
+	int pcb_temp;
+	int error;
+	s64 integral;
+	unsigned int cap;
+	unsigned long t_last;
+	u64 total_ms;
+	u64 throttled_ms;
+	unsigned int cap_changes;
+};
+
 static struct duty_cycle_desc duty_desc;
+static struct duty_pid_desc pid_desc;
 static struct duty_cycle *t_duty;
 static struct workqueue_struct *duty_wq;
 static struct delayed_work work_exit_cool;
@@ -77,6 +151,7 @@ static struct work_struct work_enter_cool0;
 static struct work_struct work_enter_cool1;
 static struct work_struct work_cpu1_plugin;
 static struct work_struct work_cpu1_plugout;
+static struct delayed_work work_pid;
 static enum omap4_duty_state state;
 
 /* protect our data */
@@ -176,6 +251,104 @@ static void omap4_duty_enter_heat_wq(struct work_struct *work)
 	mutex_unlock(&mutex_duty);
 }
 
+static int omap4_duty_pid_read(const char *domain, bool *valid, int *temp)
+{
+	int ret;
+
+	if (!*valid)
+		return -ENODEV;
+
+	ret = thermal_lookup_temp(domain);
+	if (ret == -ENODEV) {
+		/* do not keep asking a domain without a sensor */
+		*valid = false;
+		return ret;
+	}
+	/* a failed read only costs this sample */
+	if (ret < 0)
+		return ret;
+	*temp = ret;
+
+	return 0;
+}
+
+static void omap4_duty_pid_reset(void)
+{
+	pid_desc.die_valid = true;
+	pid_desc.pcb_valid = true;
+	pid_desc.error = 0;
+	pid_desc.integral = 0;
+	pid_desc.cap = nitro_rate;
+	pid_desc.t_last = jiffies;
+}
+
+static void omap4_duty_pid_wq(struct work_struct *work)
+{
+	unsigned int dt, cap, floor;
+	int error = INT_MAX;
+	int prev_error;
+	s64 out, windup;
+
+	mutex_lock(&mutex_duty);
+	if (!duty_desc.enabled || controller != OMAP4_DUTY_CTRL_PID)
+		goto unlock;
+
+	dt = jiffies_to_msecs(jiffies - pid_desc.t_last);
+	pid_desc.t_last = jiffies;
+	if (!dt)
+		dt = 1;
+
+	/* account residency for the cap that was in force until now */
+	pid_desc.total_ms += dt;
+	if (pid_desc.cap < nitro_rate)
+		pid_desc.throttled_ms += dt;
+
+	if (!omap4_duty_pid_read("cpu", &pid_desc.die_valid,
+				 &pid_desc.die_temp))
+		error = min(error, (int)die_limit - pid_desc.die_temp);
+	if (!omap4_duty_pid_read("board", &pid_desc.pcb_valid,
+				 &pid_desc.pcb_temp))
+		error = min(error, (int)pcb_limit - pid_desc.pcb_temp);
+
+	if (error == INT_MAX) {
+		/* nothing to regulate against */
+		cap = nitro_rate;
+		goto apply;
+	}
+
+	floor = min(min_rate, nitro_rate);
+	prev_error = pid_desc.error;
+	pid_desc.error = error;
+	pid_desc.integral += (s64)error * dt;
+	if (pid_ki) {
+		windup = div_s64((s64)(nitro_rate - floor) * 1000000,
+				 pid_ki);
+		pid_desc.integral = clamp(pid_desc.integral, -windup, windup);
+	}
+
+	/* cooling_rate is the feed forward point around which we regulate */
+	out = (s64)cooling_rate;
+	out += div_s64((s64)pid_kp * error, 1000);
+	out += div_s64((s64)pid_ki * pid_desc.integral, 1000000);
+	out += div_s64((s64)pid_kd * (error - prev_error), dt);
+	cap = clamp_t(s64, out, floor, nitro_rate);
+
+apply:
+	if (cap != pid_desc.cap) {
+		pr_debug("%s: die %d pcb %d error %d cap %u->%u\n", __func__,
+			 pid_desc.die_temp, pid_desc.pcb_temp, error,
+			 pid_desc.cap, cap);
+		pid_desc.cap = cap;
+		pid_desc.cap_changes++;
+		if (duty_desc.cool_device != NULL)
+			duty_desc.cool_device(NULL, cap);
+	}
+
+	queue_delayed_work(duty_wq, &work_pid, msecs_to_jiffies(pid_interval));
+unlock:
+	mutex_unlock(&mutex_duty);
+}
+
 static int omap4_duty_frequency_change(struct notifier_block *nb,
 					unsigned long val, void *data)
 {
@@ -242,7 +415,24 @@ static int omap4_duty_cycle_set_enabled(bool val, bool update)
 	if (ret)
 		goto unlock_enabled;
 
-	if (duty_desc.enabled != val) {
+	if (duty_desc.enabled != val &&
+	    controller == OMAP4_DUTY_CTRL_PID) {
+		duty_desc.enabled = val;
+		if (duty_desc.enabled) {
+			omap4_duty_enter_normal();
+			omap4_duty_pid_reset();
+			queue_delayed_work(duty_wq, &work_pid, 0);
+		} else {
+			mutex_unlock(&mutex_duty);
+			cancel_delayed_work_sync(&work_pid);
+			ret = mutex_lock_interruptible(&mutex_duty);
+			if (ret)
+				goto unlock_enabled;
+			omap4_duty_enter_normal();
+		}
+		if (num_online_cpus() == 1 && update)
+			duty_desc.saved_hotplug_enabled = duty_desc.enabled;
+	} else if (duty_desc.enabled != val) {
 		duty_desc.enabled = val;
 		if (duty_desc.enabled) {
 			/* Register the cpufreq notification */
@@ -518,12 +708,198 @@ static ssize_t store_enabled(struct device *dev,
 }
 static DEVICE_ATTR(enabled, S_IRUGO | S_IWUSR, show_enabled, store_enabled);
 
+static ssize_t show_controller(struct device *dev,
+			struct device_attribute *devattr, char *buf)
+{
+	int ret;
+
+	ret = mutex_lock_interruptible(&mutex_duty);
+	if (ret)
+		return ret;
+	ret = sprintf(buf, "%s\n", controller_names[controller]);
+	mutex_unlock(&mutex_duty);
+
+	return ret;
+}
+
+static ssize_t store_controller(struct device *dev,
+					struct device_attribute *attr,
+					const char *buf,
+					size_t count)
+{
+	unsigned int val;
+	bool was_enabled;
+	int ret;
+
+	for (val = 0; val < ARRAY_SIZE(controller_names); val++)
+		if (sysfs_streq(buf, controller_names[val]))
+			break;
+	if (val == ARRAY_SIZE(controller_names))
+		return -EINVAL;
+
+	ret = mutex_lock_interruptible(&mutex_duty);
+	if (ret)
+		return ret;
+	was_enabled = duty_desc.enabled;
+	mutex_unlock(&mutex_duty);
+
+	/* stop the running controller before switching */
+	ret = omap4_duty_cycle_set_enabled(false, false);
+	if (ret)
+		return ret;
+
+	ret = mutex_lock_interruptible(&mutex_duty);
+	if (ret)
+		return ret;
+	controller = val;
+	mutex_unlock(&mutex_duty);
+
+	if (was_enabled) {
+		ret = omap4_duty_cycle_set_enabled(true, false);
+		if (ret)
+			return ret;
+	}
+
+	return count;
+}
+static DEVICE_ATTR(controller, S_IRUGO | S_IWUSR, show_controller,
+							store_controller);
+
+#define DUTY_PID_ATTR(_name)						\
+static ssize_t show_##_name(struct device *dev,				\
+			struct device_attribute *devattr, char *buf)	\
+{									\
+	int ret;							\
+									\
+	ret = mutex_lock_interruptible(&mutex_duty);			\
+	if (ret)							\
+		return ret;						\
+	ret = sprintf(buf, "%u\n", _name);				\
+	mutex_unlock(&mutex_duty);					\
+									\
+	return ret;							\
+}									\
+									\
+static ssize_t store_##_name(struct device *dev,			\
+			struct device_attribute *attr,			\
+			const char *buf, size_t count)			\
+{									\
+	unsigned long val;						\
+	int ret;							\
+									\
+	ret = strict_strtoul(buf, 0, &val);				\
+	if (ret)							\
+		return ret;						\
+									\
+	ret = mutex_lock_interruptible(&mutex_duty);			\
+	if (ret)							\
+		return ret;						\
+	_name = val;							\
+	mutex_unlock(&mutex_duty);					\
+									\
+	return count;							\
+}									\
+static DEVICE_ATTR(_name, S_IRUGO | S_IWUSR, show_##_name, store_##_name)
+
+DUTY_PID_ATTR(pcb_limit);
+DUTY_PID_ATTR(die_limit);
+DUTY_PID_ATTR(pid_kp);
+DUTY_PID_ATTR(pid_ki);
+DUTY_PID_ATTR(pid_kd);
+DUTY_PID_ATTR(min_rate);
+
+static ssize_t show_pid_interval(struct device *dev,
+			struct device_attribute *devattr, char *buf)
+{
+	int ret;
+
+	ret = mutex_lock_interruptible(&mutex_duty);
+	if (ret)
+		return ret;
+	ret = sprintf(buf, "%u\n", pid_interval);
+	mutex_unlock(&mutex_duty);
+
+	return ret;
+}
+
+static ssize_t store_pid_interval(struct device *dev,
+					struct device_attribute *attr,
+					const char *buf,
+					size_t count)
+{
+	unsigned long val;
+	int ret;
+
+	ret = strict_strtoul(buf, 0, &val);
+	if (ret)
+		return ret;
+	if (val == 0)
+		return -EINVAL;
+
+	ret = mutex_lock_interruptible(&mutex_duty);
+	if (ret)
+		return ret;
+	pid_interval = val;
+	mutex_unlock(&mutex_duty);
+
+	return count;
+}
+static DEVICE_ATTR(pid_interval, S_IRUGO | S_IWUSR, show_pid_interval,
+							store_pid_interval);
+
+static ssize_t show_pid_state(struct device *dev,
+			struct device_attribute *devattr, char *buf)
+{
+	int ret;
+
+	ret = mutex_lock_interruptible(&mutex_duty);
+	if (ret)
+		return ret;
+	ret = sprintf(buf, "die %d\npcb %d\nerror %d\nintegral %lld\n"
+			"cap %u\ncap_changes %u\n",
+			pid_desc.die_valid ? pid_desc.die_temp : 0,
+			pid_desc.pcb_valid ? pid_desc.pcb_temp : 0,
+			pid_desc.error, pid_desc.integral, pid_desc.cap,
+			pid_desc.cap_changes);
+	mutex_unlock(&mutex_duty);
+
+	return ret;
+}
+static DEVICE_ATTR(pid_state, S_IRUGO, show_pid_state, NULL);
+
+static ssize_t show_throttle_residency(struct device *dev,
+			struct device_attribute *devattr, char *buf)
+{
+	int ret;
+
+	ret = mutex_lock_interruptible(&mutex_duty);
+	if (ret)
+		return ret;
+	ret = sprintf(buf, "%llu %llu\n", pid_desc.throttled_ms,
+			pid_desc.total_ms);
+	mutex_unlock(&mutex_duty);
+
+	return ret;
+}
+static DEVICE_ATTR(throttle_residency, S_IRUGO, show_throttle_residency,
+							NULL);
+
 static struct attribute *attrs[] = {
 	&dev_attr_nitro_interval.attr,
 	&dev_attr_nitro_percentage.attr,
 	&dev_attr_nitro_rate.attr,
 	&dev_attr_cooling_rate.attr,
 	&dev_attr_enabled.attr,
+	&dev_attr_controller.attr,
+	&dev_attr_pid_interval.attr,
+	&dev_attr_pcb_limit.attr,
+	&dev_attr_die_limit.attr,
+	&dev_attr_pid_kp.attr,
+	&dev_attr_pid_ki.attr,
+	&dev_attr_pid_kd.attr,
+	&dev_attr_min_rate.attr,
+	&dev_attr_pid_state.attr,
+	&dev_attr_throttle_residency.attr,
 	NULL,
 };
 
@@ -616,7 +992,8 @@ static int __init omap4_duty_module_init(void)
 
 	if ((!nitro_interval) || (nitro_percentage > 100) ||
 		(nitro_percentage <= 0) || (nitro_rate <= 0) ||
-		(cooling_rate <= 0))
+		(cooling_rate <= 0) || (!pid_interval) ||
+		(controller >= ARRAY_SIZE(controller_names)))
 		return -EINVAL;
 
 	/* Data initialization */
@@ -628,6 +1005,7 @@ static int __init omap4_duty_module_init(void)
 	INIT_WORK(&work_enter_cool1, omap4_duty_enter_c1_wq);
 	INIT_WORK(&work_cpu1_plugin, omap4_duty_enable_wq);
 	INIT_WORK(&work_cpu1_plugout, omap4_duty_disable_wq);
+	INIT_DELAYED_WORK(&work_pid, omap4_duty_pid_wq);
 	duty_desc.heating_budget = NITRO_P(nitro_percentage, nitro_interval);
 
 	if (num_online_cpus() > 1)
@@ -693,6 +1071,7 @@ static void __exit omap4_duty_module_exit(void)
 	cancel_work_sync(&work_enter_cool1);
 	cancel_work_sync(&work_cpu1_plugin);
 	cancel_work_sync(&work_cpu1_plugout);
+	cancel_delayed_work_sync(&work_pid);
 	kfree(t_duty);
 	destroy_workqueue(duty_wq);
 
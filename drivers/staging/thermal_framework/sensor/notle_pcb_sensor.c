@@ -47,10 +47,12 @@
  * pcb_temp_sensor structure
  * @pdev - Platform device pointer
  * @dev - device pointer
+ * @therm_fw - thermal device reporting the "board" domain temperature
  */
 struct pcb_temp_sensor {
 	struct platform_device *pdev;
 	struct device *dev;
+	struct thermal_dev *therm_fw;
 };
 struct pcb_temp_sensor *temp_sensor;
 struct pcb_sens notle_pcb_sensor;
@@ -67,6 +69,8 @@ struct mutex turbo_sprint_mode_mutex;
 #define TWL6030_ADC_START_VALUE 0
 #define TWL6030_ADC_END_VALUE   1536
 #define TWL6030_GPADC_CHANNEL	 6
+/* readings this recent are reused instead of converting again */
+#define PCB_GPADC_MAX_AGE_MS	100
 
 static int adc_to_temp_conversion(int adc_val)
 {
@@ -168,7 +172,7 @@ static int pcb_read_current_thermistor(void)
 	req.channels = (1 << TWL6030_GPADC_CHANNEL);
 	req.method = TWL6030_GPADC_SW2;
 	req.func_cb = NULL;
-	ret = twl6030_gpadc_conversion(&req);
+	ret = twl6030_gpadc_conversion_cached(&req, PCB_GPADC_MAX_AGE_MS);
 	if (ret < 0) {
 		pr_err("%s:TWL6030_GPADC conversion is invalid %d\n",
 			   __func__, ret);
@@ -185,6 +189,26 @@ static int pcb_read_current_temp(void)
 	return adc_to_temp_conversion(temp);
 }
 
+static int pcb_get_temp(struct thermal_dev *tdev)
+{
+	struct platform_device *pdev = to_platform_device(tdev->dev);
+	struct pcb_temp_sensor *temp_sensor = platform_get_drvdata(pdev);
+	int adc_val;
+
+	/* a failed conversion is not a temperature, skip the sample */
+	adc_val = pcb_read_current_thermistor();
+	if (adc_val < 0)
+		return adc_val;
+
+	temp_sensor->therm_fw->current_temp = adc_to_temp_conversion(adc_val);
+
+	return temp_sensor->therm_fw->current_temp;
+}
+
+static struct thermal_dev_ops pcb_sensor_ops = {
+	.report_temp = pcb_get_temp,
+};
+
 static void turn_off_turbo_sprint_mode_delay_work_fn(struct work_struct *work)
 {
 	struct timespec current_time;
@@ -208,6 +232,7 @@ static void turn_off_turbo_sprint_mode_delay_work_fn(struct work_struct *work)
 	if (elapsed_time_nS > turbo_sprint_mode_duration_requested_nS ) {
 	    printk("Turbo Sprint Off elapsed Time %lld nS", elapsed_time_nS);
 	    turbo_sprint = false;
+	    omap4_duty_pcb_changed();
 	}
 	else {
 	    schedule_delayed_work(&turn_off_turbo_sprint_mode_work,
@@ -275,6 +300,7 @@ static ssize_t pcb_temp_set_turbo_sprint_mode(struct device *dev,
 	        schedule_delayed_work(&turn_off_turbo_sprint_mode_work,
 	                msecs_to_jiffies(TURBO_SPRINT_CHECK_PERIOD_MSEC));
 	        turbo_sprint = true;
+	        omap4_duty_pcb_changed();
 	    }
 	    mutex_unlock(&turbo_sprint_mode_mutex);
 	}
@@ -337,6 +363,25 @@ static int __devinit pcb_temp_sensor_probe(struct platform_device *pdev)
 	kobject_uevent(&pdev->dev.kobj, KOBJ_ADD);
 	platform_set_drvdata(pdev, temp_sensor);
 
+	temp_sensor->therm_fw = kzalloc(sizeof(struct thermal_dev), GFP_KERNEL);
+	if (temp_sensor->therm_fw) {
+		temp_sensor->therm_fw->name = "notle_pcb_sensor";
+		/*
+		 * Not "pcb": the die governor switches to its PCB hot spot
+		 * gradient whenever that domain exists, and that model was
+		 * not characterised against this thermistor.
+		 */
+		temp_sensor->therm_fw->domain_name = "board";
+		temp_sensor->therm_fw->dev = temp_sensor->dev;
+		temp_sensor->therm_fw->dev_ops = &pcb_sensor_ops;
+		thermal_sensor_dev_register(temp_sensor->therm_fw);
+	} else {
+		dev_err(&pdev->dev, "%s:Cannot alloc memory for thermal fw\n",
+			__func__);
+		ret = -ENOMEM;
+		goto therm_fw_alloc_err;
+	}
+
 	ret = sysfs_create_group(&pdev->dev.kobj,
 				 &pcb_temp_sensor_group);
 	if (ret) {
@@ -358,6 +403,9 @@ static int __devinit pcb_temp_sensor_probe(struct platform_device *pdev)
 	return 0;
 
 sysfs_create_err:
+	thermal_sensor_dev_unregister(temp_sensor->therm_fw);
+	kfree(temp_sensor->therm_fw);
+therm_fw_alloc_err:
 	platform_set_drvdata(pdev, NULL);
 	kfree(temp_sensor);
 	return ret;
@@ -368,6 +416,8 @@ static int __devexit pcb_temp_sensor_remove(struct platform_device *pdev)
 	struct pcb_temp_sensor *temp_sensor = platform_get_drvdata(pdev);
 
 	sysfs_remove_group(&pdev->dev.kobj, &pcb_temp_sensor_group);
+	thermal_sensor_dev_unregister(temp_sensor->therm_fw);
+	kfree(temp_sensor->therm_fw);
 	kobject_uevent(&temp_sensor->dev->kobj, KOBJ_REMOVE);
 	platform_set_drvdata(pdev, NULL);
 	kfree(temp_sensor);
@@ -52,6 +52,13 @@ static DEFINE_MUTEX(thermal_domain_list_lock);
  *
  * The sensor, governor and the cooling agents are linked in the framework
  * via the domain_name in the thermal_dev structure.
+ *
+ * Sensors are expected to report only when the temperature leaves the trip
+ * window the governor published with thermal_governor_set_window().  Sensors
+ * with a hardware comparator program it through set_temp_thresh, so nothing
+ * needs to run between crossings.  Agents that still have to sample can use
+ * thermal_adaptive_rate() to stretch their period while the temperature is
+ * stable and far from the window edges.
 */
 /**
  * struct thermal_domain  - Structure that contains the pointers to the
@@ -61,6 +68,9 @@ static DEFINE_MUTEX(thermal_domain_list_lock);
  * @temp_sensor: The domains temperature sensor thermal device pointer.
  * @governor: The domain governor thermal device pointer.
  * @cooling_agents: The domains list of available cooling agents
+ * @window_valid: The governor published a trip window
+ * @window_low: Lower edge of the trip window
+ * @window_high: Upper edge of the trip window
  *
  */
 #define MAX_DOMAIN_NAME_SZ	32
@@ -70,6 +80,9 @@ struct thermal_domain {
 	struct thermal_dev *temp_sensor;
 	struct thermal_dev *governor;
 	struct list_head cooling_agents;
+	bool window_valid;
+	int window_low;
+	int window_high;
 };
 
 #ifdef CONFIG_THERMAL_FRAMEWORK_DEBUG
@@ -91,6 +104,9 @@ static int thermal_debug_show_domain(struct seq_file *s, void *data)
 			thermal_device_call(domain->temp_sensor, report_temp));
 		thermal_device_call(domain->temp_sensor, debug_report, s);
 	}
+	if (domain->window_valid)
+		seq_printf(s, "Trip window: %d %d\n", domain->window_low,
+			   domain->window_high);
 	seq_printf(s, "Governor:\n");
 	if (domain->governor) {
 		seq_printf(s, "\tName: %s\n", domain->governor->name);
@@ -207,6 +223,74 @@ out:
 }
 EXPORT_SYMBOL_GPL(thermal_sensor_set_temp);
 
+/**
+ * thermal_governor_set_window() - External API to allow a governor to publish
+ *				the temperature range its current state is
+ *				valid for.
+ * @gov: The governor thermal device
+ * @low: Lower edge of the window, the sensor reports when going below it
+ * @high: Upper edge of the window, the sensor reports when going above it
+ *
+ * The window is remembered by the domain so a sensor registering later gets
+ * it programmed as well.
+ *
+ * Returns the result of the sensor set_temp_thresh call. ENODEV if the
+ * governor is not part of a domain.
+ */
+int thermal_governor_set_window(struct thermal_dev *gov, int low, int high)
+{
+	struct thermal_domain *thermal_domain;
+
+	thermal_domain = gov->domain;
+	if (!thermal_domain) {
+		pr_err("%s: device not part of a domain\n", __func__);
+		return -ENODEV;
+	}
+
+	thermal_domain->window_low = low;
+	thermal_domain->window_high = high;
+	thermal_domain->window_valid = true;
+
+	return thermal_device_call(thermal_domain->temp_sensor,
+				   set_temp_thresh, low, high);
+}
+EXPORT_SYMBOL_GPL(thermal_governor_set_window);
+
+/**
+ * thermal_adaptive_rate() - Compute the next sampling period for an agent
+ *			     which has to poll a temperature.
+ * @temp: The latest sample
+ * @prev_temp: The previous sample
+ * @elapsed: Time between the two samples in ms
+ * @low: Lower edge of the trip window
+ * @high: Upper edge of the trip window
+ * @min_rate: Fastest period allowed in ms
+ * @max_rate: Slowest period allowed in ms
+ *
+ * The period is chosen so that at the current gradient the temperature
+ * is sampled at least twice before it can reach an edge of the window.
+ *
+ * Returns the next period in ms.
+ */
+int thermal_adaptive_rate(int temp, int prev_temp, unsigned int elapsed,
+			  int low, int high, int min_rate, int max_rate)
+{
+	int headroom;
+	int slope;
+
+	if (temp <= low || temp >= high || !elapsed)
+		return min_rate;
+
+	headroom = min(temp - low, high - temp);
+	/* gradient in milli degrees per second */
+	slope = abs(temp - prev_temp) * 1000 / elapsed;
+	if (!slope)
+		return max_rate;
+
+	return clamp(headroom * 500 / slope, min_rate, max_rate);
+}
+EXPORT_SYMBOL_GPL(thermal_adaptive_rate);
+
 /**
  * thermal_request_temp() - Requests the thermal sensor to report it's current
  *			    temperature to the governor.
@@ -459,6 +543,9 @@ int thermal_sensor_dev_register(struct thermal_dev *tdev)
 	tdev->domain = domain;
 	thermal_debug_register_device(tdev);
 	mutex_unlock(&thermal_domain_list_lock);
+	if (domain->window_valid)
+		thermal_device_call(tdev, set_temp_thresh,
+				    domain->window_low, domain->window_high);
 	thermal_init_thermal_state(tdev);
 	pr_debug("%s: added %s sensor\n", __func__, tdev->name);
 
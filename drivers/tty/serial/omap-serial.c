@@ -37,6 +37,7 @@
 #include <linux/clk.h>
 #include <linux/serial_core.h>
 #include <linux/irq.h>
+#include <linux/notifier.h>
 #include <linux/pm_runtime.h>
 
 #include <plat/dma.h>
@@ -75,6 +76,9 @@ static bool dpll_registration_done;
 
 static struct uart_omap_port *ui[OMAP_MAX_HSUART_PORTS];
 
+/* Called in atomic context with the port id when a port receives data */
+static ATOMIC_NOTIFIER_HEAD(serial_omap_rx_notifier);
+
 /* Forward declaration of functions */
 static void uart_tx_dma_callback(int lch, u16 ch_status, void *data);
 static void serial_omap_rxdma_poll(unsigned long uart_no);
@@ -480,6 +484,7 @@ static inline irqreturn_t serial_omap_irq(int irq, void *dev_id)
 	unsigned int int_id;
 	unsigned long flags;
 	int ret = IRQ_HANDLED;
+	bool rx = false;
 
 	serial_omap_port_enable(up);
 	iir = serial_in(up, UART_IIR);
@@ -494,6 +499,7 @@ static inline irqreturn_t serial_omap_irq(int irq, void *dev_id)
 	lsr = serial_in(up, UART_LSR);
 	if (int_id == UART_IIR_RDI || int_id == UART_OMAP_IIR_RX_TIMEOUT ||
 	    int_id == UART_IIR_RLSI) {
+		rx = lsr & UART_LSR_DR;
 		if (!up->use_dma) {
 			if (lsr & UART_LSR_DR)
 				receive_chars(up, &lsr);
@@ -517,6 +523,10 @@ static inline irqreturn_t serial_omap_irq(int irq, void *dev_id)
 	spin_unlock_irqrestore(&up->port.lock, flags);
 	serial_omap_port_disable(up);
 
+	if (rx)
+		atomic_notifier_call_chain(&serial_omap_rx_notifier,
+					   up->pdev->id, up);
+
 	up->port_activity = jiffies;
 	return ret;
 }
@@ -1356,6 +1366,7 @@ static void serial_omap_rxdma_poll(unsigned long uart_no)
 			up->uart_dma.rx_buf_dma_phys),
 			curr_transmitted_size);
 	tty_flip_buffer_push(up->port.state->port.tty);
+	atomic_notifier_call_chain(&serial_omap_rx_notifier, up->pdev->id, up);
 	up->uart_dma.prev_rx_dma_pos = curr_dma_pos;
 	if (up->uart_dma.rx_buf_size +
 			up->uart_dma.rx_buf_dma_phys == curr_dma_pos) {
@@ -1930,6 +1941,22 @@ static void __exit serial_omap_exit(void)
 #endif
 }
 
+/*
+ * Lets a driver for the device on the other end of a port follow its
+ * activity without polling, e.g. to tell whether it is awake.
+ */
+int omap_serial_register_rx_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_register(&serial_omap_rx_notifier, nb);
+}
+EXPORT_SYMBOL(omap_serial_register_rx_notifier);
+
+int omap_serial_unregister_rx_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_unregister(&serial_omap_rx_notifier, nb);
+}
+EXPORT_SYMBOL(omap_serial_unregister_rx_notifier);
+
 /* Used by ext client device connected to uart to control uart */
 int omap_serial_ext_uart_enable(u8 port_id)
 {
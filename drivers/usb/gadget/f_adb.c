@@ -32,6 +32,35 @@
 /* number of tx requests to allocate */
 #define TX_REQ_MAX 4
 
+/* upper bound for the adb_rx_reqs module parameter */
+#define RX_REQ_LIMIT 16
+
+/* size of an ADB message header (struct amessage in adbd) */
+#define ADB_MSG_HDR_SIZE               24
+
+/*
+ * Size of each bulk request and depth of the OUT queue. The values are
+ * read at bind time. With adb_rx_pipeline set, OUT requests are queued
+ * ahead of adb_read(): the ADB message headers are parsed as they arrive
+ * so each request covers exactly one header or one payload chunk and
+ * always completes, and data is handed to userspace in completion order.
+ */
+static unsigned int adb_tx_req_len = 16384;
+module_param(adb_tx_req_len, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(adb_tx_req_len, "Size of each ADB IN request");
+
+static unsigned int adb_rx_req_len = 16384;
+module_param(adb_rx_req_len, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(adb_rx_req_len, "Size of each ADB OUT request");
+
+static unsigned int adb_rx_reqs = 4;
+module_param(adb_rx_reqs, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(adb_rx_reqs, "Number of ADB OUT requests (1 to 16)");
+
+static bool adb_rx_pipeline = 1;
+module_param(adb_rx_pipeline, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(adb_rx_pipeline, "Queue OUT requests ahead of adb_read");
+
 static const char adb_shortname[] = "android_adb";
 
 struct adb_dev {
@@ -53,8 +82,28 @@ struct adb_dev {
 
 	wait_queue_head_t read_wq;
 	wait_queue_head_t write_wq;
-	struct usb_request *rx_req;
-	int rx_done;
+
+	/* request geometry chosen at bind time */
+	unsigned tx_req_len;
+	unsigned rx_req_len;
+	unsigned rx_reqs;
+
+	/*
+	 * OUT request ring, protected by lock. Starting at rx_tail there are
+	 * rx_ready completed requests waiting for adb_read(), followed by
+	 * rx_queued requests owned by the controller.
+	 */
+	struct usb_request *rx_req[RX_REQ_LIMIT];
+	bool rx_is_header[RX_REQ_LIMIT];
+	int rx_tail;
+	int rx_ready;
+	int rx_queued;
+	unsigned rx_offset;	/* bytes of rx_req[rx_tail] already read */
+	u32 rx_frame_left;	/* payload bytes not yet queued */
+	bool rx_wait_header;	/* a header is queued but not yet parsed */
+	bool rx_framed;		/* headers parse, queue ahead of reads */
+	bool rx_filling;	/* adb_rx_fill() is queueing requests */
+	bool rx_refill;		/* slots freed while rx_filling */
 };
 
 static struct usb_interface_descriptor adb_interface_desc = {
@@ -202,17 +251,173 @@ static void adb_complete_in(struct usb_ep *ep, struct usb_request *req)
 	wake_up(&dev->write_wq);
 }
 
+static void adb_rx_reset(struct adb_dev *dev)
+{
+	dev->rx_tail = 0;
+	dev->rx_ready = 0;
+	dev->rx_queued = 0;
+	dev->rx_offset = 0;
+	dev->rx_frame_left = 0;
+	dev->rx_wait_header = false;
+	dev->rx_framed = adb_rx_pipeline && dev->rx_reqs > 1;
+}
+
+/*
+ * Reserve the next ring slot to queue, or return NULL; called with
+ * dev->lock held. When framed, queue the rest of the current payload and
+ * then the next header, but nothing past a header until it has been
+ * parsed. Otherwise queue one request sized by the reader, as the driver
+ * always did.
+ */
+static struct usb_request *adb_rx_next(struct adb_dev *dev, size_t want)
+{
+	struct usb_request *req;
+	bool header = false;
+	int slot;
+
+	if (!dev->online || dev->error)
+		return NULL;
+
+	if (!dev->rx_framed) {
+		if (dev->rx_ready || dev->rx_queued || !want)
+			return NULL;
+		slot = dev->rx_tail;
+		req = dev->rx_req[slot];
+		req->length = min_t(size_t, want, dev->rx_req_len);
+	} else {
+		if (dev->rx_wait_header ||
+		    dev->rx_ready + dev->rx_queued >= dev->rx_reqs)
+			return NULL;
+		slot = (dev->rx_tail + dev->rx_ready + dev->rx_queued)
+			% dev->rx_reqs;
+		req = dev->rx_req[slot];
+
+		header = !dev->rx_frame_left;
+		if (header) {
+			req->length = ADB_MSG_HDR_SIZE;
+		} else {
+			req->length = min(dev->rx_frame_left, dev->rx_req_len);
+			dev->rx_frame_left -= req->length;
+		}
+		dev->rx_wait_header = header;
+	}
+
+	dev->rx_is_header[slot] = header;
+	dev->rx_queued++;
+	return req;
+}
+
+/*
+ * Queue OUT requests into free ring slots. usb_ep_queue() may complete a
+ * request synchronously, so dev->lock is dropped around it; rx_filling
+ * keeps the requests queued in ring order when the completion handler
+ * and a reader race to refill.
+ */
+static void adb_rx_fill(struct adb_dev *dev, size_t want)
+{
+	struct usb_request *req;
+	unsigned long flags;
+	int ret;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	if (dev->rx_filling) {
+		dev->rx_refill = true;
+		goto out;
+	}
+	dev->rx_filling = true;
+	do {
+		dev->rx_refill = false;
+		while ((req = adb_rx_next(dev, want))) {
+			spin_unlock_irqrestore(&dev->lock, flags);
+			ret = usb_ep_queue(dev->ep_out, req, GFP_ATOMIC);
+			spin_lock_irqsave(&dev->lock, flags);
+			if (ret < 0) {
+				pr_debug("adb: failed to queue req %p (%d)\n",
+					req, ret);
+				dev->rx_queued--;
+				dev->error = 1;
+				break;
+			}
+		}
+	} while (dev->rx_refill);
+	dev->rx_filling = false;
+out:
+	spin_unlock_irqrestore(&dev->lock, flags);
+}
+
+/* learn the payload length from a completed header */
+static void adb_rx_parse_header(struct adb_dev *dev, struct usb_request *req)
+{
+	__le32 *msg = req->buf;
+
+	dev->rx_wait_header = false;
+
+	/* amessage: command, arg0, arg1, data_length, data_check, magic */
+	if (req->actual != ADB_MSG_HDR_SIZE ||
+	    le32_to_cpu(msg[5]) != (le32_to_cpu(msg[0]) ^ 0xffffffff)) {
+		pr_debug("adb: unframed OUT data, stop queueing ahead\n");
+		dev->rx_framed = false;
+		return;
+	}
+
+	dev->rx_frame_left = le32_to_cpu(msg[3]);
+}
+
 static void adb_complete_out(struct usb_ep *ep, struct usb_request *req)
 {
 	struct adb_dev *dev = _adb_dev;
+	unsigned long flags;
+	int slot;
+
+	spin_lock_irqsave(&dev->lock, flags);
+
+	/* requests on one endpoint complete in the order they were queued */
+	slot = (dev->rx_tail + dev->rx_ready) % dev->rx_reqs;
+	dev->rx_queued--;
+	dev->rx_ready++;
 
-	dev->rx_done = 1;
 	if (req->status != 0)
 		dev->error = 1;
+	else if (dev->rx_is_header[slot] && req->actual == 0)
+		/* a 0-len packet; the reader skips it, queue a new header */
+		dev->rx_wait_header = false;
+	else if (dev->rx_is_header[slot])
+		adb_rx_parse_header(dev, req);
+
+	spin_unlock_irqrestore(&dev->lock, flags);
 
+	/* with no adbd, leave the host NAKed rather than buffer its data */
+	if (atomic_read(&dev->open_excl))
+		adb_rx_fill(dev, 0);
 	wake_up(&dev->read_wq);
 }
 
+/*
+ * Take back the OUT requests still queued and forget any buffered data
+ * and framing state, so the next adbd starts on a fresh stream.
+ */
+static void adb_rx_flush(struct adb_dev *dev)
+{
+	int i, slot, queued;
+
+	spin_lock_irq(&dev->lock);
+	/* stops adb_rx_next() from queueing anything new */
+	dev->error = 1;
+	slot = dev->rx_reqs ? (dev->rx_tail + dev->rx_ready) % dev->rx_reqs : 0;
+	queued = dev->rx_queued;
+	spin_unlock_irq(&dev->lock);
+
+	for (i = 0; i < queued; i++)
+		usb_ep_dequeue(dev->ep_out,
+			dev->rx_req[(slot + i) % dev->rx_reqs]);
+
+	/* otherwise adb_open() resets once the last one completes */
+	spin_lock_irq(&dev->lock);
+	if (!dev->rx_queued)
+		adb_rx_reset(dev);
+	spin_unlock_irq(&dev->lock);
+}
+
 static int adb_create_bulk_endpoints(struct adb_dev *dev,
 				struct usb_endpoint_descriptor *in_desc,
 				struct usb_endpoint_descriptor *out_desc)
@@ -243,20 +448,27 @@ static int adb_create_bulk_endpoints(struct adb_dev *dev,
 	dev->ep_out = ep;
 
 	/* now allocate requests for our endpoints */
-	req = adb_request_new(dev->ep_out, ADB_BULK_BUFFER_SIZE);
-	if (!req)
-		goto fail;
-	req->complete = adb_complete_out;
-	dev->rx_req = req;
+	dev->rx_req_len = max_t(unsigned, adb_rx_req_len, ADB_BULK_BUFFER_SIZE);
+	dev->tx_req_len = max_t(unsigned, adb_tx_req_len, ADB_BULK_BUFFER_SIZE);
+	dev->rx_reqs = clamp_t(unsigned, adb_rx_reqs, 1, RX_REQ_LIMIT);
+
+	for (i = 0; i < dev->rx_reqs; i++) {
+		req = adb_request_new(dev->ep_out, dev->rx_req_len);
+		if (!req)
+			goto fail;
+		req->complete = adb_complete_out;
+		dev->rx_req[i] = req;
+	}
 
 	for (i = 0; i < TX_REQ_MAX; i++) {
-		req = adb_request_new(dev->ep_in, ADB_BULK_BUFFER_SIZE);
+		req = adb_request_new(dev->ep_in, dev->tx_req_len);
 		if (!req)
 			goto fail;
 		req->complete = adb_complete_in;
 		adb_req_put(dev, &dev->tx_idle, req);
 	}
 
+	adb_rx_reset(dev);
 	return 0;
 
 fail:
@@ -269,14 +481,15 @@ static ssize_t adb_read(struct file *fp, char __user *buf,
 {
 	struct adb_dev *dev = fp->private_data;
 	struct usb_request *req;
-	int r = count, xfer;
-	int ret;
+	size_t copied = 0, xfer;
+	int r, ret;
 
 	pr_debug("adb_read(%d)\n", count);
 	if (!_adb_dev)
 		return -ENODEV;
 
-	if (count > ADB_BULK_BUFFER_SIZE)
+	/* framed reads block until count is met, keep it to one request */
+	if (count > dev->rx_req_len)
 		return -EINVAL;
 
 	if (adb_lock(&dev->read_excl))
@@ -292,46 +505,61 @@ static ssize_t adb_read(struct file *fp, char __user *buf,
 			return ret;
 		}
 	}
-	if (dev->error) {
-		r = -EIO;
-		goto done;
-	}
 
-requeue_req:
-	/* queue a request */
-	req = dev->rx_req;
-	req->length = count;
-	dev->rx_done = 0;
-	ret = usb_ep_queue(dev->ep_out, req, GFP_ATOMIC);
-	if (ret < 0) {
-		pr_debug("adb_read: failed to queue req %p (%d)\n", req, ret);
-		r = -EIO;
-		dev->error = 1;
-		goto done;
-	} else {
-		pr_debug("rx %p queue\n", req);
-	}
+	while (copied < count) {
+		adb_rx_fill(dev, count - copied);
 
-	/* wait for a request to complete */
-	ret = wait_event_interruptible(dev->read_wq, dev->rx_done);
-	if (ret < 0) {
-		dev->error = 1;
-		r = ret;
-		usb_ep_dequeue(dev->ep_out, req);
-		goto done;
-	}
-	if (!dev->error) {
-		/* If we got a 0-len packet, throw it back and try again. */
-		if (req->actual == 0)
-			goto requeue_req;
+		/* wait for the oldest request to complete */
+		ret = wait_event_interruptible(dev->read_wq,
+				dev->rx_ready || dev->error);
+		if (ret < 0) {
+			/*
+			 * Bytes already taken from the ring are gone; hand them
+			 * back. With nothing read, reset the ring on next open.
+			 */
+			if (copied) {
+				r = copied;
+			} else {
+				dev->error = 1;
+				r = ret;
+			}
+			goto done;
+		}
+		if (dev->error) {
+			r = -EIO;
+			goto done;
+		}
 
+		/* completed requests belong to the reader until released */
+		req = dev->rx_req[dev->rx_tail];
 		pr_debug("rx %p %d\n", req, req->actual);
-		xfer = (req->actual < count) ? req->actual : count;
-		if (copy_to_user(buf, req->buf, xfer))
+		xfer = min_t(size_t, req->actual - dev->rx_offset,
+			     count - copied);
+		if (copy_to_user(buf + copied, req->buf + dev->rx_offset,
+				 xfer)) {
 			r = -EFAULT;
-
-	} else
-		r = -EIO;
+			goto done;
+		}
+		copied += xfer;
+
+		spin_lock_irq(&dev->lock);
+		dev->rx_offset += xfer;
+		if (dev->rx_offset == req->actual) {
+			dev->rx_tail = (dev->rx_tail + 1) % dev->rx_reqs;
+			dev->rx_ready--;
+			dev->rx_offset = 0;
+		}
+		/*
+		 * Framed requests always complete, so keep reading until the
+		 * caller's count is met. Unframed reads return what arrived.
+		 */
+		if (!dev->rx_framed && !dev->rx_ready && copied) {
+			spin_unlock_irq(&dev->lock);
+			break;
+		}
+		spin_unlock_irq(&dev->lock);
+	}
+	r = copied;
 
 done:
 	adb_unlock(&dev->read_excl);
@@ -372,8 +600,8 @@ static ssize_t adb_write(struct file *fp, const char __user *buf,
 		}
 
 		if (req != 0) {
-			if (count > ADB_BULK_BUFFER_SIZE)
-				xfer = ADB_BULK_BUFFER_SIZE;
+			if (count > dev->tx_req_len)
+				xfer = dev->tx_req_len;
 			else
 				xfer = count;
 			if (copy_from_user(req->buf, buf, xfer)) {
@@ -417,8 +645,12 @@ static int adb_open(struct inode *ip, struct file *fp)
 
 	fp->private_data = _adb_dev;
 
-	/* clear the error latch */
+	/* clear the error latch, dropping OUT data left from the failure */
+	spin_lock_irq(&_adb_dev->lock);
+	if (_adb_dev->error && !_adb_dev->rx_queued)
+		adb_rx_reset(_adb_dev);
 	_adb_dev->error = 0;
+	spin_unlock_irq(&_adb_dev->lock);
 
 	adb_ready_callback();
 
@@ -429,6 +661,8 @@ static int adb_release(struct inode *ip, struct file *fp)
 {
 	pr_info("adb_release\n");
 
+	adb_rx_flush(_adb_dev);
+
 	adb_closed_callback();
 
 	adb_unlock(&_adb_dev->open_excl);
@@ -495,6 +729,7 @@ adb_function_unbind(struct usb_configuration *c, struct usb_function *f)
 {
 	struct adb_dev	*dev = func_to_adb(f);
 	struct usb_request *req;
+	int i;
 
 
 	dev->online = 0;
@@ -502,7 +737,10 @@ adb_function_unbind(struct usb_configuration *c, struct usb_function *f)
 
 	wake_up(&dev->read_wq);
 
-	adb_request_free(dev->rx_req, dev->ep_out);
+	for (i = 0; i < RX_REQ_LIMIT; i++) {
+		adb_request_free(dev->rx_req[i], dev->ep_out);
+		dev->rx_req[i] = NULL;
+	}
 	while ((req = adb_req_get(dev, &dev->tx_idle)))
 		adb_request_free(req, dev->ep_in);
 }
@@ -529,7 +767,10 @@ static int adb_function_set_alt(struct usb_function *f,
 		usb_ep_disable(dev->ep_in);
 		return ret;
 	}
+	spin_lock_irq(&dev->lock);
+	adb_rx_reset(dev);
 	dev->online = 1;
+	spin_unlock_irq(&dev->lock);
 
 	/* readers may be blocked waiting for us to go online */
 	wake_up(&dev->read_wq);
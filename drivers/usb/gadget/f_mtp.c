@@ -54,6 +54,31 @@
 #define RX_REQ_MAX 2
 #define INTR_REQ_MAX 5
 
+/* upper bound for the mtp_rx_reqs module parameter */
+#define RX_REQ_LIMIT 16
+
+/*
+ * Size and number of the bulk requests used for file transfers. Larger,
+ * deeper queues let eMMC I/O overlap with USB DMA. The values are read at
+ * bind time; if the buffers can not be allocated the driver falls back to
+ * MTP_BULK_BUFFER_SIZE with TX_REQ_MAX and RX_REQ_MAX requests.
+ */
+static unsigned int mtp_tx_req_len = 131072;
+module_param(mtp_tx_req_len, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_tx_req_len, "Size of each MTP IN request");
+
+static unsigned int mtp_tx_reqs = 8;
+module_param(mtp_tx_reqs, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_tx_reqs, "Number of MTP IN requests");
+
+static unsigned int mtp_rx_req_len = 131072;
+module_param(mtp_rx_req_len, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_rx_req_len, "Size of each MTP OUT request");
+
+static unsigned int mtp_rx_reqs = 4;
+module_param(mtp_rx_reqs, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_rx_reqs, "Number of MTP OUT requests (2 to 16)");
+
 /* ID for Microsoft MTP OS String */
 #define MTP_OS_STRING_ID   0xEE
 
@@ -91,8 +116,15 @@ struct mtp_dev {
 	wait_queue_head_t read_wq;
 	wait_queue_head_t write_wq;
 	wait_queue_head_t intr_wq;
-	struct usb_request *rx_req[RX_REQ_MAX];
+	struct usb_request *rx_req[RX_REQ_LIMIT];
 	int rx_done;
+	/* OUT requests completed since receive_file_work last reset it */
+	atomic_t rx_completed;
+
+	/* request geometry chosen at bind time */
+	unsigned tx_req_len;
+	unsigned rx_req_len;
+	unsigned rx_reqs;
 
 	/* for processing MTP_SEND_FILE, MTP_RECEIVE_FILE and
 	 * MTP_SEND_FILE_WITH_HEADER ioctls on a work queue
@@ -364,7 +396,9 @@ static void mtp_complete_out(struct usb_ep *ep, struct usb_request *req)
 	struct mtp_dev *dev = _mtp_dev;
 
 	dev->rx_done = 1;
-	if (req->status != 0)
+	atomic_inc(&dev->rx_completed);
+	/* requests cancelled by receive_file_work are not an error */
+	if (req->status != 0 && req->status != -ECONNRESET)
 		dev->state = STATE_ERROR;
 
 	wake_up(&dev->read_wq);
@@ -382,6 +416,55 @@ static void mtp_complete_intr(struct usb_ep *ep, struct usb_request *req)
 	wake_up(&dev->intr_wq);
 }
 
+static void mtp_free_bulk_requests(struct mtp_dev *dev)
+{
+	struct usb_request *req;
+	int i;
+
+	while ((req = mtp_req_get(dev, &dev->tx_idle)))
+		mtp_request_free(req, dev->ep_in);
+	for (i = 0; i < RX_REQ_LIMIT; i++) {
+		mtp_request_free(dev->rx_req[i], dev->ep_out);
+		dev->rx_req[i] = NULL;
+	}
+}
+
+static int mtp_alloc_bulk_requests(struct mtp_dev *dev,
+		unsigned tx_len, unsigned tx_reqs,
+		unsigned rx_len, unsigned rx_reqs)
+{
+	struct usb_request *req;
+	int i;
+
+	for (i = 0; i < tx_reqs; i++) {
+		req = mtp_request_new(dev->ep_in, tx_len);
+		if (!req)
+			return -ENOMEM;
+		req->complete = mtp_complete_in;
+		mtp_req_put(dev, &dev->tx_idle, req);
+	}
+	for (i = 0; i < rx_reqs; i++) {
+		req = mtp_request_new(dev->ep_out, rx_len);
+		if (!req)
+			return -ENOMEM;
+		req->complete = mtp_complete_out;
+		dev->rx_req[i] = req;
+	}
+
+	dev->tx_req_len = tx_len;
+	dev->rx_req_len = rx_len;
+	dev->rx_reqs = rx_reqs;
+	return 0;
+}
+
+/* bulk requests are a whole number of high-speed packets, at least one */
+static unsigned mtp_bulk_req_len(unsigned len)
+{
+	unsigned maxpacket = le16_to_cpu(mtp_highspeed_in_desc.wMaxPacketSize);
+
+	return max_t(unsigned, rounddown(len, maxpacket), maxpacket);
+}
+
 static int mtp_create_bulk_endpoints(struct mtp_dev *dev,
 				struct usb_endpoint_descriptor *in_desc,
 				struct usb_endpoint_descriptor *out_desc,
@@ -390,7 +473,7 @@ static int mtp_create_bulk_endpoints(struct mtp_dev *dev,
 	struct usb_composite_dev *cdev = dev->cdev;
 	struct usb_request *req;
 	struct usb_ep *ep;
-	int i;
+	int i, ret;
 
 	DBG(cdev, "create_bulk_endpoints dev: %p\n", dev);
 
@@ -431,19 +514,18 @@ static int mtp_create_bulk_endpoints(struct mtp_dev *dev,
 	dev->ep_intr = ep;
 
 	/* now allocate requests for our endpoints */
-	for (i = 0; i < TX_REQ_MAX; i++) {
-		req = mtp_request_new(dev->ep_in, MTP_BULK_BUFFER_SIZE);
-		if (!req)
-			goto fail;
-		req->complete = mtp_complete_in;
-		mtp_req_put(dev, &dev->tx_idle, req);
-	}
-	for (i = 0; i < RX_REQ_MAX; i++) {
-		req = mtp_request_new(dev->ep_out, MTP_BULK_BUFFER_SIZE);
-		if (!req)
+	ret = mtp_alloc_bulk_requests(dev, mtp_bulk_req_len(mtp_tx_req_len),
+			max_t(unsigned, mtp_tx_reqs, 1),
+			mtp_bulk_req_len(mtp_rx_req_len),
+			clamp_t(unsigned, mtp_rx_reqs, 2, RX_REQ_LIMIT));
+	if (ret) {
+		mtp_free_bulk_requests(dev);
+		DBG(cdev, "falling back to %d byte requests\n",
+			MTP_BULK_BUFFER_SIZE);
+		ret = mtp_alloc_bulk_requests(dev, MTP_BULK_BUFFER_SIZE,
+				TX_REQ_MAX, MTP_BULK_BUFFER_SIZE, RX_REQ_MAX);
+		if (ret)
 			goto fail;
-		req->complete = mtp_complete_out;
-		dev->rx_req[i] = req;
 	}
 	for (i = 0; i < INTR_REQ_MAX; i++) {
 		req = mtp_request_new(dev->ep_intr, INTR_BUFFER_SIZE);
@@ -471,7 +553,7 @@ static ssize_t mtp_read(struct file *fp, char __user *buf,
 
 	DBG(cdev, "mtp_read(%d)\n", count);
 
-	if (count > MTP_BULK_BUFFER_SIZE)
+	if (count > dev->rx_req_len)
 		return -EINVAL;
 
 	/* we will block until we're online */
@@ -590,8 +672,8 @@ static ssize_t mtp_write(struct file *fp, const char __user *buf,
 			break;
 		}
 
-		if (count > MTP_BULK_BUFFER_SIZE)
-			xfer = MTP_BULK_BUFFER_SIZE;
+		if (count > dev->tx_req_len)
+			xfer = dev->tx_req_len;
 		else
 			xfer = count;
 		if (xfer && copy_from_user(req->buf, buf, xfer)) {
@@ -681,8 +763,8 @@ static void send_file_work(struct work_struct *data) {
 			break;
 		}
 
-		if (count > MTP_BULK_BUFFER_SIZE)
-			xfer = MTP_BULK_BUFFER_SIZE;
+		if (count > dev->tx_req_len)
+			xfer = dev->tx_req_len;
 		else
 			xfer = count;
 
@@ -727,16 +809,34 @@ static void send_file_work(struct work_struct *data) {
 	smp_wmb();
 }
 
-/* read from USB and write to a local file */
+/* cancel OUT requests still queued by receive_file_work */
+static void mtp_rx_flush(struct mtp_dev *dev, int tail, int pending,
+		int queued)
+{
+	while (pending--) {
+		usb_ep_dequeue(dev->ep_out, dev->rx_req[tail]);
+		tail = (tail + 1) % dev->rx_reqs;
+	}
+	/* dequeue gives the requests back, wait until they are ours again */
+	wait_event(dev->read_wq, atomic_read(&dev->rx_completed) == queued);
+}
+
+/* read from USB and write to a local file
+ *
+ * Up to rx_reqs - 1 OUT requests are kept queued while the oldest
+ * completed one is written out, so eMMC writes overlap with USB DMA.
+ * Requests on one endpoint complete in queue order, so the ring is
+ * retired from its tail.
+ */
 static void receive_file_work(struct work_struct *data)
 {
 	struct mtp_dev	*dev = container_of(data, struct mtp_dev, receive_file_work);
 	struct usb_composite_dev *cdev = dev->cdev;
-	struct usb_request *read_req = NULL, *write_req = NULL;
+	struct usb_request *read_req, *write_req = NULL;
 	struct file *filp;
 	loff_t offset;
-	int64_t count;
-	int ret, cur_buf = 0;
+	int64_t count, unqueued;
+	int ret, max_pending, head = 0, tail = 0, pending = 0, queued = 0;
 	int r = 0;
 
 	/* read our parameters */
@@ -744,24 +844,39 @@ static void receive_file_work(struct work_struct *data)
 	filp = dev->xfer_file;
 	offset = dev->xfer_file_offset;
 	count = dev->xfer_file_length;
+	unqueued = count;
 
 	DBG(cdev, "receive_file_work(%lld)\n", count);
 
-	while (count > 0 || write_req) {
-		if (count > 0) {
-			/* queue a request */
-			read_req = dev->rx_req[cur_buf];
-			cur_buf = (cur_buf + 1) % RX_REQ_MAX;
+	/* if xfer_file_length is 0xFFFFFFFF, then we read until we get
+	 * a short packet, so never have more than one request queued or
+	 * we could swallow the next command.
+	 */
+	if (count == 0xFFFFFFFF)
+		max_pending = 1;
+	else
+		max_pending = dev->rx_reqs - 1;
+
+	atomic_set(&dev->rx_completed, 0);
 
-			read_req->length = (count > MTP_BULK_BUFFER_SIZE
-					? MTP_BULK_BUFFER_SIZE : count);
+	while (1) {
+		/* keep the pipeline full, never reusing write_req's buffer */
+		while (unqueued > 0 && pending < max_pending) {
+			read_req = dev->rx_req[head];
+			read_req->length = (unqueued > dev->rx_req_len
+					? dev->rx_req_len : unqueued);
 			dev->rx_done = 0;
 			ret = usb_ep_queue(dev->ep_out, read_req, GFP_KERNEL);
 			if (ret < 0) {
 				r = -EIO;
 				dev->state = STATE_ERROR;
-				break;
+				goto out;
 			}
+			if (count != 0xFFFFFFFF)
+				unqueued -= read_req->length;
+			head = (head + 1) % dev->rx_reqs;
+			pending++;
+			queued++;
 		}
 
 		if (write_req) {
@@ -777,32 +892,43 @@ static void receive_file_work(struct work_struct *data)
 			write_req = NULL;
 		}
 
-		if (read_req) {
-			/* wait for our last read to complete */
-			ret = wait_event_interruptible(dev->read_wq,
-				dev->rx_done || dev->state != STATE_BUSY);
-			if (dev->state == STATE_CANCELED) {
-				r = -ECANCELED;
-				if (!dev->rx_done)
-					usb_ep_dequeue(dev->ep_out, read_req);
-				break;
-			}
-			/* if xfer_file_length is 0xFFFFFFFF, then we read until
-			 * we get a zero length packet
-			 */
-			if (count != 0xFFFFFFFF)
-				count -= read_req->actual;
-			if (read_req->actual < read_req->length) {
-				/* short packet is used to signal EOF for sizes > 4 gig */
-				DBG(cdev, "got short packet\n");
-				count = 0;
-			}
+		if (!pending)
+			break;
 
-			write_req = read_req;
-			read_req = NULL;
+		/* wait for the oldest read to complete */
+		ret = wait_event_interruptible(dev->read_wq,
+			atomic_read(&dev->rx_completed) > queued - pending
+			|| dev->state != STATE_BUSY);
+		if (dev->state == STATE_CANCELED) {
+			r = -ECANCELED;
+			break;
+		}
+		if (dev->state != STATE_BUSY) {
+			r = -EIO;
+			break;
 		}
+
+		read_req = dev->rx_req[tail];
+		tail = (tail + 1) % dev->rx_reqs;
+		pending--;
+
+		if (read_req->actual < read_req->length) {
+			/* short packet is used to signal EOF for sizes > 4 gig */
+			DBG(cdev, "got short packet\n");
+			unqueued = 0;
+			if (pending) {
+				mtp_rx_flush(dev, tail, pending, queued);
+				pending = 0;
+			}
+		}
+
+		write_req = read_req;
 	}
 
+out:
+	if (pending)
+		mtp_rx_flush(dev, tail, pending, queued);
+
 	DBG(cdev, "receive_file_work returning %d\n", r);
 	/* write the result */
 	dev->xfer_result = r;
@@ -1135,12 +1261,8 @@ mtp_function_unbind(struct usb_configuration *c, struct usb_function *f)
 {
 	struct mtp_dev	*dev = func_to_mtp(f);
 	struct usb_request *req;
-	int i;
 
-	while ((req = mtp_req_get(dev, &dev->tx_idle)))
-		mtp_request_free(req, dev->ep_in);
-	for (i = 0; i < RX_REQ_MAX; i++)
-		mtp_request_free(dev->rx_req[i], dev->ep_out);
+	mtp_free_bulk_requests(dev);
 	while ((req = mtp_req_get(dev, &dev->intr_idle)))
 		mtp_request_free(req, dev->ep_intr);
 	dev->state = STATE_OFFLINE;
@@ -1247,6 +1369,7 @@ static int mtp_setup(void)
 	init_waitqueue_head(&dev->intr_wq);
 	atomic_set(&dev->open_excl, 0);
 	atomic_set(&dev->ioctl_excl, 0);
+	atomic_set(&dev->rx_completed, 0);
 	INIT_LIST_HEAD(&dev->tx_idle);
 	INIT_LIST_HEAD(&dev->intr_idle);
 
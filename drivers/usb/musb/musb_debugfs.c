@@ -192,6 +192,57 @@ static const struct file_operations musb_regdump_fops = {
 	.release		= single_release,
 };
 
+#ifdef CONFIG_USB_GADGET_MUSB_HDRC
+static void musb_ep_stats_show_one(struct seq_file *s, struct musb_ep *ep)
+{
+	struct musb_ep_stats	*st = &ep->stats;
+	unsigned		per_req;
+
+	if (!st->requests && !st->irqs)
+		return;
+
+	per_req = st->requests ? st->irqs * 100 / st->requests : 0;
+	seq_printf(s, "%-8s %10lu %10lu %4u.%02u %10lu %10lu\n",
+			ep->end_point.name, st->requests, st->irqs,
+			per_req / 100, per_req % 100,
+			st->mode1, st->short_aborts);
+}
+
+static int musb_ep_stats_show(struct seq_file *s, void *unused)
+{
+	struct musb		*musb = s->private;
+	unsigned long		flags;
+	u8			epnum;
+
+	seq_printf(s, "%-8s %10s %10s %7s %10s %10s\n", "ep",
+			"requests", "irqs", "irq/req", "mode1", "short");
+
+	spin_lock_irqsave(&musb->lock, flags);
+	for (epnum = 1; epnum < musb->nr_endpoints; epnum++) {
+		struct musb_hw_ep	*hw_ep = &musb->endpoints[epnum];
+
+		musb_ep_stats_show_one(s, &hw_ep->ep_in);
+		if (!hw_ep->is_shared_fifo)
+			musb_ep_stats_show_one(s, &hw_ep->ep_out);
+	}
+	spin_unlock_irqrestore(&musb->lock, flags);
+
+	return 0;
+}
+
+static int musb_ep_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, musb_ep_stats_show, inode->i_private);
+}
+
+static const struct file_operations musb_ep_stats_fops = {
+	.open			= musb_ep_stats_open,
+	.read			= seq_read,
+	.llseek			= seq_lseek,
+	.release		= single_release,
+};
+#endif
+
 static int musb_test_mode_open(struct inode *inode, struct file *file)
 {
 	return single_open(file, musb_test_mode_show, inode->i_private);
@@ -275,6 +326,15 @@ int __init musb_init_debugfs(struct musb *musb)
 		goto err1;
 	}
 
+#ifdef CONFIG_USB_GADGET_MUSB_HDRC
+	file = debugfs_create_file("ep_stats", S_IRUGO, root, musb,
+			&musb_ep_stats_fops);
+	if (IS_ERR(file)) {
+		ret = PTR_ERR(file);
+		goto err1;
+	}
+#endif
+
 	musb_debugfs_root = root;
 
 	return 0;
@@ -92,6 +92,13 @@
 
 /* ----------------------------------------------------------------------- */
 
+/*
+ * How long musb_g_rx() lets a busy mode 1 RX channel unload a full packet
+ * queued ahead of a short one in a double-buffered FIFO. One 512 byte
+ * packet takes a few microseconds.
+ */
+#define MUSB_RX_DRAIN_US	50
+
 #define is_buffer_mapped(req) (is_dma_capable() && \
 					(req->map_state != UN_MAPPED))
 
@@ -194,6 +201,7 @@ __acquires(ep->musb->lock)
 	if (req->request.status == -EINPROGRESS)
 		req->request.status = status;
 	musb = req->musb;
+	ep->stats.requests++;
 
 	ep->busy = 1;
 	spin_unlock(&musb->lock);
@@ -374,10 +382,12 @@ static void txstate(struct musb *musb, struct musb_request *req)
 
 #if defined(CONFIG_USB_INVENTRA_DMA) || defined(CONFIG_USB_UX500_DMA)
 		{
-			if (request_size < musb_ep->packet_sz)
+			if (request_size < musb_ep->packet_sz) {
 				musb_ep->dma->desired_mode = 0;
-			else
+			} else {
 				musb_ep->dma->desired_mode = 1;
+				musb_ep->stats.mode1++;
+			}
 
 			use_dma = use_dma && c->channel_program(
 					musb_ep->dma, musb_ep->packet_sz,
@@ -497,6 +507,7 @@ void musb_g_tx(struct musb *musb, u8 epnum)
 	musb_ep_select(mbase, epnum);
 	req = next_request(musb_ep);
 	request = &req->request;
+	musb_ep->stats.irqs++;
 
 	csr = musb_readw(epio, MUSB_TXCSR);
 	dev_dbg(musb->controller, "<== %s, txcsr %04x\n", musb_ep->end_point.name, csr);
@@ -694,8 +705,16 @@ static void rxstate(struct musb *musb, struct musb_request *req)
 	if (csr & MUSB_RXCSR_RXPKTRDY) {
 		len = musb_readw(epio, MUSB_RXCOUNT);
 
-		 /* Disable mode1 rx dma */
-		use_mode_1 = 0;
+		/*
+		 * Mode 1 only when the board enables it for bulk OUT, the
+		 * first packet is full and more than one packet is wanted.
+		 * A short packet then stops the DMA early, see musb_g_rx().
+		 */
+		use_mode_1 = musb->config->bulk_rx_mode1 &&
+			musb_ep->type == USB_ENDPOINT_XFER_BULK &&
+			!musb_ep->hb_mult &&
+			len == musb_ep->packet_sz &&
+			request->length - request->actual > musb_ep->packet_sz;
 
 		if (request->actual < request->length) {
 #ifdef CONFIG_USB_INVENTRA_DMA
@@ -756,7 +775,11 @@ static void rxstate(struct musb *musb, struct musb_request *req)
 		if (use_mode_1) {
 					transfer_size = min(request->length - request->actual,
 							channel->max_len);
+					/* whole packets only; a tail is PIO/mode 0 */
+					transfer_size -= transfer_size
+						% musb_ep->packet_sz;
 					musb_ep->dma->desired_mode = 1;
+					musb_ep->stats.mode1++;
 		} else {
 					transfer_size = min(request->length - request->actual,
 							(unsigned)len);
@@ -913,6 +936,7 @@ void musb_g_rx(struct musb *musb, u8 epnum)
 
 	csr = musb_readw(epio, MUSB_RXCSR);
 	dma = is_dma_capable() ? musb_ep->dma : NULL;
+	musb_ep->stats.irqs++;
 
 	dev_dbg(musb->controller, "<== %s, rxcsr %04x%s %p\n", musb_ep->end_point.name,
 			csr, dma ? " (dma)" : "", request);
@@ -939,7 +963,49 @@ void musb_g_rx(struct musb *musb, u8 epnum)
 	}
 
 	if (dma_channel_status(dma) == MUSB_DMA_STATUS_BUSY) {
+#ifdef CONFIG_USB_INVENTRA_DMA
+		/*
+		 * In DMA mode 1 the DMA only takes full packets; a short
+		 * one raises RXPKTRDY on the endpoint instead. With a
+		 * double-buffered FIFO the short packet may still sit
+		 * behind a full one the channel is unloading, and no
+		 * further interrupt will come for it: wait for the full
+		 * packet to drain. Then stop the channel, account what it
+		 * moved and let rxstate() take the short packet.
+		 */
+		if (dma->desired_mode == 1 && (csr & MUSB_RXCSR_RXPKTRDY)) {
+			int us = MUSB_RX_DRAIN_US;
+
+			while (musb_readw(epio, MUSB_RXCOUNT)
+					== musb_ep->packet_sz && us--) {
+				udelay(1);
+				csr = musb_readw(epio, MUSB_RXCSR);
+				if (!(csr & MUSB_RXCSR_RXPKTRDY))
+					break;
+			}
+		}
+		if (dma->desired_mode == 1 && (csr & MUSB_RXCSR_RXPKTRDY) &&
+		    musb_readw(epio, MUSB_RXCOUNT) < musb_ep->packet_sz) {
+			musb->dma_controller->channel_abort(dma);
+			request->actual += dma->actual_len;
+			dma->actual_len = 0;
+			dma->desired_mode = 0;
+			musb_ep->stats.short_aborts++;
+
+			csr = musb_readw(epio, MUSB_RXCSR);
+			csr &= ~(MUSB_RXCSR_AUTOCLEAR
+					| MUSB_RXCSR_DMAENAB
+					| MUSB_RXCSR_DMAMODE);
+			musb_writew(epio, MUSB_RXCSR,
+				MUSB_RXCSR_P_WZC_BITS | csr);
+			goto exit;
+		}
+#endif
 		/* "should not happen"; likely RXPKTRDY pending for DMA */
+		if (dma->desired_mode == 1 && (csr & MUSB_RXCSR_RXPKTRDY))
+			dev_warn(musb->controller, "%s: short packet stuck "
+				"behind mode 1 DMA, csr %04x\n",
+				musb_ep->end_point.name, csr);
 		dev_dbg(musb->controller, "%s busy, csr %04x\n",
 			musb_ep->end_point.name, csr);
 		return;
@@ -970,10 +1036,13 @@ void musb_g_rx(struct musb *musb, u8 epnum)
 			musb_writew(epio, MUSB_RXCSR, csr);
 		}
 
-		/* incomplete, and not short? wait for next IN packet */
+		/* incomplete, and not short? wait for next IN packet
+		 * (mode 1 moves a whole number of packets at once)
+		 */
 		if ((request->actual < request->length)
-				&& (musb_ep->dma->actual_len
-					== musb_ep->packet_sz)) {
+				&& musb_ep->dma->actual_len
+				&& !(musb_ep->dma->actual_len
+					& (musb_ep->packet_sz - 1))) {
 			/* In double buffer case, continue to unload fifo if
  			 * there is Rx packet in FIFO.
  			 **/
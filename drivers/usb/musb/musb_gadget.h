@@ -66,6 +66,14 @@ extern void musb_free_request(struct usb_ep *ep, struct usb_request *req);
 /*
  * struct musb_ep - peripheral side view of endpoint rx or tx side
  */
+/* per-endpoint counters, reported in debugfs */
+struct musb_ep_stats {
+	unsigned long			requests;	/* requests given back */
+	unsigned long			irqs;		/* endpoint + DMA irqs */
+	unsigned long			mode1;		/* DMA mode 1 programs */
+	unsigned long			short_aborts;	/* mode 1 RX cut short */
+};
+
 struct musb_ep {
 	/* stuff towards the head is basically write-once. */
 	struct usb_ep			end_point;
@@ -90,6 +98,8 @@ struct musb_ep {
 	u8				busy;
 
 	u8				hb_mult;
+
+	struct musb_ep_stats		stats;
 };
 
 static inline struct musb_ep *to_musb_ep(struct usb_ep *ep)
@@ -473,9 +473,46 @@ static const struct musb_platform_ops omap2430_ops = {
 
 static u64 omap2430_dmamask = DMA_BIT_MASK(32);
 
+/*
+ * FIFO layout used when the board asks for double-buffered bulk
+ * endpoints: ep1..ep5 get two 512 byte packet buffers per direction so
+ * the host can fill (or drain) one while DMA works on the other. Like
+ * fifo_mode 4 it uses all 16KB of FIFO RAM.
+ */
+static struct musb_fifo_cfg omap2430_dpb_fifo_cfg[] = {
+	MUSB_EP_FIFO_DOUBLE(1, FIFO_TX, 512),
+	MUSB_EP_FIFO_DOUBLE(1, FIFO_RX, 512),
+	MUSB_EP_FIFO_DOUBLE(2, FIFO_TX, 512),
+	MUSB_EP_FIFO_DOUBLE(2, FIFO_RX, 512),
+	MUSB_EP_FIFO_DOUBLE(3, FIFO_TX, 512),
+	MUSB_EP_FIFO_DOUBLE(3, FIFO_RX, 512),
+	MUSB_EP_FIFO_DOUBLE(4, FIFO_TX, 512),
+	MUSB_EP_FIFO_DOUBLE(4, FIFO_RX, 512),
+	MUSB_EP_FIFO_DOUBLE(5, FIFO_TX, 512),
+	MUSB_EP_FIFO_DOUBLE(5, FIFO_RX, 512),
+	MUSB_EP_FIFO_SINGLE(6, FIFO_TX, 512),
+	MUSB_EP_FIFO_SINGLE(6, FIFO_RX, 512),
+	MUSB_EP_FIFO_SINGLE(7, FIFO_TX, 512),
+	MUSB_EP_FIFO_SINGLE(7, FIFO_RX, 512),
+	MUSB_EP_FIFO_SINGLE(8, FIFO_TX, 512),
+	MUSB_EP_FIFO_SINGLE(8, FIFO_RX, 512),
+	MUSB_EP_FIFO_SINGLE(9, FIFO_TX, 512),
+	MUSB_EP_FIFO_SINGLE(9, FIFO_RX, 512),
+	MUSB_EP_FIFO_SINGLE(10, FIFO_TX, 256),
+	MUSB_EP_FIFO_SINGLE(10, FIFO_RX, 64),
+	MUSB_EP_FIFO_SINGLE(11, FIFO_TX, 256),
+	MUSB_EP_FIFO_SINGLE(11, FIFO_RX, 64),
+	MUSB_EP_FIFO_SINGLE(12, FIFO_TX, 256),
+	MUSB_EP_FIFO_SINGLE(12, FIFO_RX, 64),
+	MUSB_EP_FIFO_SINGLE(13, FIFO_RXTX, 512),
+	MUSB_EP_FIFO_SINGLE(14, FIFO_RXTX, 256),
+	MUSB_EP_FIFO_SINGLE(15, FIFO_RXTX, 256),
+};
+
 static int __init omap2430_probe(struct platform_device *pdev)
 {
 	struct musb_hdrc_platform_data	*pdata = pdev->dev.platform_data;
+	struct omap_musb_board_data	*data = pdata->board_data;
 	struct platform_device		*musb;
 	struct omap2430_glue		*glue;
 	int				ret = -ENOMEM;
@@ -501,6 +538,15 @@ static int __init omap2430_probe(struct platform_device *pdev)
 
 	pdata->platform_ops		= &omap2430_ops;
 
+	if (data && pdata->config) {
+		if (data->bulk_double_buffer && !pdata->config->fifo_cfg) {
+			pdata->config->fifo_cfg = omap2430_dpb_fifo_cfg;
+			pdata->config->fifo_cfg_size =
+				ARRAY_SIZE(omap2430_dpb_fifo_cfg);
+		}
+		pdata->config->bulk_rx_mode1 = data->bulk_rx_dma_mode1;
+	}
+
 	platform_set_drvdata(pdev, glue);
 
 	ret = platform_device_add_resources(musb, pdev->resource,
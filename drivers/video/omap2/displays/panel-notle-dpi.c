@@ -17,13 +17,14 @@
  * this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <linux/bitops.h>
+#include <linux/completion.h>
 #include <linux/delay.h>
 #include <linux/i2c.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
 #include <linux/slab.h>
 #include <linux/spi/spi.h>
-#include <plat/omap_hwmod.h>
-#include <plat/omap-pm.h>
 
 
 #include <video/omapdss.h>
@@ -68,6 +69,16 @@
 #define ICE40_LCOS       0x03
 #define ICE40_LCOS_DISP_ENB     0x01
 
+/* Registers mirrored in the shadow register file */
+#define ICE40_NUM_REGS   0x20
+/* Most writes a single batch can hold */
+#define ICE40_MAX_BATCH  16
+/* Give up waiting for vsync and write immediately after this */
+#define ICE40_VSYNC_TIMEOUT_MS  50
+
+/* Most LCOS panel writes sent in a single I2C transfer */
+#define PANEL_MAX_BATCH  64
+
 /*
  * TODO(petermalkin): remove definitions of notle_version from here.
  * Move them to some place else where they could be shared by other
@@ -175,6 +186,45 @@ static struct panel_notle_busses {
         struct spi_device *ice40_device;
 } bus_data;
 
+/*
+ * Serializes iCE40 accesses and protects the shadow registers and the
+ * batch below.
+ */
+static DEFINE_MUTEX(ice40_lock);
+
+/* Last value written to each iCE40 register, if known */
+static struct {
+        u8 value[ICE40_NUM_REGS];
+        DECLARE_BITMAP(valid, ICE40_NUM_REGS);
+} ice40_shadow;
+
+/*
+ * iCE40 writes collected between ice40_batch_begin() and
+ * ice40_batch_commit() and sent as a single SPI message. Chip select is
+ * toggled between the transfers, so the FPGA still sees the usual two
+ * byte register writes.  An optional register read can lead the writes,
+ * see ice40_batch_dummy_read().
+ */
+static struct {
+        struct spi_message msg;
+        struct spi_transfer dummy_xfer;
+        struct spi_transfer xfers[ICE40_MAX_BATCH];
+        u8 buf[ICE40_MAX_BATCH][2];
+        u8 dummy_buf[2];
+        int dummy;
+        int num;
+        /* set by whoever submits the message, the vsync ISR or commit */
+        atomic_t submitted;
+        struct completion done;
+} ice40_batch;
+
+/* LCOS panel writes sent as one I2C transfer with repeated starts */
+static struct {
+        struct i2c_msg msgs[PANEL_MAX_BATCH];
+        u8 buf[PANEL_MAX_BATCH][2];
+        int num;
+} panel_batch;
+
 struct panel_config {
         struct omap_video_timings timings;
 
@@ -262,15 +312,25 @@ static inline struct panel_notle_data
         return (struct panel_notle_data *) dssdev->data;
 }
 
-static int requested_l3_throughput;
 /* Local functions used by the sysfs interface */
 static char tmp_buf[PAGE_SIZE];
 static int fpga_rev = -1;
+/*
+ * Display whose vsync FPGA updates wait for, or NULL to write them right
+ * away when nothing is being scanned out.
+ */
+static inline struct omap_dss_device *vsync_dssdev(struct notle_drv_data *d) {
+        return d->enabled ? d->dssdev : NULL;
+}
+
 static void panel_notle_power_off(struct omap_dss_device *dssdev);
 static int panel_notle_power_on(struct omap_dss_device *dssdev);
 static int ice40_read_register(u8 reg_addr);
 static int ice40_write_register(u8 reg_addr, u8 reg_value);
-static int ice40_set_backlight(int led_en, int r, int g, int b);
+static int ice40_set_backlight(struct omap_dss_device *dssdev,
+                               int led_en, int r, int g, int b);
+static int ice40_update_bits(struct omap_dss_device *dssdev,
+                             u8 reg_addr, u8 mask, int set);
 static int fpga_read_revision(void);
 static void led_config_to_linecuts(struct omap_dss_device *dssdev,
                                    struct led_config *led, int *red_linecut,
@@ -423,7 +483,8 @@ static ssize_t colormix_store(struct notle_drv_data *notle_data,
         if (notle_data->enabled && led_config.brightness) {
               led_config_to_linecuts(notle_data->dssdev, &led_config,
                                      &red, &green, &blue);
-              if (ice40_set_backlight(1, red, green, blue)) {
+              if (ice40_set_backlight(vsync_dssdev(notle_data),
+                                      1, red, green, blue)) {
                 printk(KERN_ERR LOG_TAG "Failed to colormix_store:"
                        " spi write failed\n");
               }
@@ -468,16 +529,11 @@ static ssize_t testpattern_store(struct notle_drv_data *notle_data,
                 return -EINVAL;
         }
 
-        i = ice40_read_register(ICE40_PIPELINE);
+        i = ice40_update_bits(vsync_dssdev(notle_data), ICE40_PIPELINE,
+                              ICE40_PIPELINE_TESTPAT, notle_data->pattern);
         if (i < 0) {
                 printk(KERN_ERR LOG_TAG "Failed to testpattern_store: "
-                       "register read failed: %i\n", i);
-                return -EIO;
-        }
-        i = (i & ~ICE40_PIPELINE_TESTPAT) | notle_data->pattern;
-        if ((i = ice40_write_register(ICE40_PIPELINE, (u8)(i & 0xff))) < 0) {
-                printk(KERN_ERR LOG_TAG "Failed to testpattern_store: "
-                       "register write failed: %i\n", i);
+                       "register update failed: %i\n", i);
                 return -EIO;
         }
 
@@ -516,23 +572,12 @@ static ssize_t forcer_store(struct notle_drv_data *notle_data,
         if (r)
                 return r;
 
-        r = ice40_read_register(ICE40_BACKLIGHT);
-        if (r < 0) {
-                printk(KERN_ERR LOG_TAG "Failed to forcer_store: "
-                       "spi read failed: %i\n", r);
-                return -EIO;
-        }
-
-        if (val) {
-                r |= ICE40_BACKLIGHT_FORCER;
-        } else {
-                r &= ~ICE40_BACKLIGHT_FORCER;
-        }
-
-        r = ice40_write_register(ICE40_BACKLIGHT, r);
+        r = ice40_update_bits(vsync_dssdev(notle_data), ICE40_BACKLIGHT,
+                              ICE40_BACKLIGHT_FORCER,
+                              val ? ICE40_BACKLIGHT_FORCER : 0);
         if (r < 0) {
                 printk(KERN_ERR LOG_TAG "Failed to forcer_store: "
-                       "spi write failed: %i\n", r);
+                       "spi update failed: %i\n", r);
                 return -EIO;
         }
 
@@ -570,23 +615,12 @@ static ssize_t forceg_store(struct notle_drv_data *notle_data,
         if (r)
                 return r;
 
-        r = ice40_read_register(ICE40_BACKLIGHT);
-        if (r < 0) {
-                printk(KERN_ERR LOG_TAG "Failed to forceg_store: "
-                       "spi read failed: %i\n", r);
-                return -EIO;
-        }
-
-        if (val) {
-                r |= ICE40_BACKLIGHT_FORCEG;
-        } else {
-                r &= ~ICE40_BACKLIGHT_FORCEG;
-        }
-
-        r = ice40_write_register(ICE40_BACKLIGHT, r);
+        r = ice40_update_bits(vsync_dssdev(notle_data), ICE40_BACKLIGHT,
+                              ICE40_BACKLIGHT_FORCEG,
+                              val ? ICE40_BACKLIGHT_FORCEG : 0);
         if (r < 0) {
                 printk(KERN_ERR LOG_TAG "Failed to forceg_store: "
-                       "spi write failed: %i\n", r);
+                       "spi update failed: %i\n", r);
                 return -EIO;
         }
 
@@ -624,23 +658,12 @@ static ssize_t forceb_store(struct notle_drv_data *notle_data,
         if (r)
                 return r;
 
-        r = ice40_read_register(ICE40_BACKLIGHT);
-        if (r < 0) {
-                printk(KERN_ERR LOG_TAG "Failed to forceb_store: "
-                       "spi read failed: %i\n", r);
-                return -EIO;
-        }
-
-        if (val) {
-                r |= ICE40_BACKLIGHT_FORCEB;
-        } else {
-                r &= ~ICE40_BACKLIGHT_FORCEB;
-        }
-
-        r = ice40_write_register(ICE40_BACKLIGHT, r);
+        r = ice40_update_bits(vsync_dssdev(notle_data), ICE40_BACKLIGHT,
+                              ICE40_BACKLIGHT_FORCEB,
+                              val ? ICE40_BACKLIGHT_FORCEB : 0);
         if (r < 0) {
                 printk(KERN_ERR LOG_TAG "Failed to forceb_store: "
-                       "spi write failed: %i\n", r);
+                       "spi update failed: %i\n", r);
                 return -EIO;
         }
 
@@ -678,23 +701,12 @@ static ssize_t cpsel_store(struct notle_drv_data *notle_data,
         if (r)
                 return r;
 
-        r = ice40_read_register(ICE40_BACKLIGHT);
-        if (r < 0) {
-                printk(KERN_ERR LOG_TAG "Failed to cpsel_store: "
-                       "spi read failed: %i\n", r);
-                return -EIO;
-        }
-
-        if (val) {
-                r |= ICE40_BACKLIGHT_CPSEL;
-        } else {
-                r &= ~ICE40_BACKLIGHT_CPSEL;
-        }
-
-        r = ice40_write_register(ICE40_BACKLIGHT, r);
+        r = ice40_update_bits(vsync_dssdev(notle_data), ICE40_BACKLIGHT,
+                              ICE40_BACKLIGHT_CPSEL,
+                              val ? ICE40_BACKLIGHT_CPSEL : 0);
         if (r < 0) {
                 printk(KERN_ERR LOG_TAG "Failed to cpsel_store: "
-                       "spi write failed: %i\n", r);
+                       "spi update failed: %i\n", r);
                 return -EIO;
         }
 
@@ -732,18 +744,9 @@ static ssize_t mono_store(struct notle_drv_data *notle_data,
                 return -EINVAL;
         }
 
-        r = ice40_read_register(ICE40_BACKLIGHT);
-        if (r < 0) {
-            printk(KERN_ERR LOG_TAG "Failed to read iCE40 register: "
-                   "0x%02x\n", ICE40_BACKLIGHT);
-            return -EIO;
-        }
-        if (value) {
-            r |= ICE40_BACKLIGHT_MONO;
-        } else {
-            r &= ~ICE40_BACKLIGHT_MONO;
-        }
-        r = ice40_write_register(ICE40_BACKLIGHT, r);
+        r = ice40_update_bits(vsync_dssdev(notle_data), ICE40_BACKLIGHT,
+                              ICE40_BACKLIGHT_MONO,
+                              value ? ICE40_BACKLIGHT_MONO : 0);
         if (r < 0) {
             printk(KERN_ERR LOG_TAG "Failed to write iCE40 register: "
                    "0x%02x\n", ICE40_BACKLIGHT);
@@ -784,12 +787,14 @@ static ssize_t brightness_store(struct notle_drv_data *notle_data,
             if (led_config.brightness) {
                 led_config_to_linecuts(notle_data->dssdev, &led_config,
                                    &r, &g, &b);
-                if (ice40_set_backlight(1, r, g, b)) {
+                if (ice40_set_backlight(vsync_dssdev(notle_data),
+                                        1, r, g, b)) {
                     printk(KERN_ERR LOG_TAG "Failed to brightness_store: "
                          "spi write failed\n");
                 }
             } else {
-                if (ice40_set_backlight(0, -1, -1, -1)) {
+                if (ice40_set_backlight(vsync_dssdev(notle_data),
+                                        0, -1, -1, -1)) {
                     printk(KERN_ERR LOG_TAG "Failed to brightness_store: "
                        "spi write failed\n");
                 }
@@ -1030,99 +1035,331 @@ static void led_config_to_linecuts(struct omap_dss_device *dssdev,
         return;
 }
 
-static int panel_write_register(u8 reg, u8 value) {
-        static int printed_error = 0;
-        u8 buf[2];
+/* Send the queued LCOS panel writes in a single I2C transfer. */
+static int panel_batch_flush(void) {
         int r;
-        struct i2c_msg msgs[1];
+
+        if (!panel_batch.num)
+                return 0;
 
         if (!bus_data.panel_client) {
                 printk(KERN_ERR LOG_TAG
-                       "No I2C data set in panel_write_register\n");
+                       "No I2C data set in panel_batch_flush\n");
+                panel_batch.num = 0;
                 return -1;
         }
 
-        buf[0] = reg;
-        buf[1] = value;
-
-        msgs[0].addr = bus_data.panel_client->addr;
-        msgs[0].flags = 0;
-        msgs[0].len = sizeof(buf);
-        msgs[0].buf = buf;
-
-        r = i2c_transfer(bus_data.panel_client->adapter, msgs, 1);
+        r = i2c_transfer(bus_data.panel_client->adapter, panel_batch.msgs,
+                         panel_batch.num);
         if (r < 0) {
-                if (!printed_error) {
-                        printk(KERN_ERR LOG_TAG
-                               "Failed to write 0x%02x to panel "
-                               "register 0x%02x: %i\n", value, reg, r);
-                        printed_error = 1;
-                }
-                return r;
+                printk(KERN_ERR LOG_TAG "Failed to write %d panel "
+                       "registers: %i\n", panel_batch.num, r);
         }
 
-        return 0;
+        panel_batch.num = 0;
+        return r < 0 ? r : 0;
 }
 
-static int ice40_read_register(u8 reg_addr) {
-  int val;
+/*
+ * Queue a write to the LCOS panel.  The panel is reset while powered off,
+ * so unlike the FPGA there is no shadow to diff against.
+ */
+static void panel_batch_write(u8 reg, u8 value) {
+        struct i2c_msg *msg;
+
+        if (panel_batch.num == PANEL_MAX_BATCH)
+                panel_batch_flush();
+
+        if (!bus_data.panel_client)
+                return;
+
+        msg = &panel_batch.msgs[panel_batch.num];
+        panel_batch.buf[panel_batch.num][0] = reg;
+        panel_batch.buf[panel_batch.num][1] = value;
+        msg->addr = bus_data.panel_client->addr;
+        msg->flags = 0;
+        msg->len = 2;
+        msg->buf = panel_batch.buf[panel_batch.num];
+        panel_batch.num++;
+}
 
+static int __ice40_read_register(u8 reg_addr) {
   if (!bus_data.ice40_device) {
     printk(KERN_ERR LOG_TAG "No iCE40 bus data set in ice40_read_register()\n");
     return -1;
   }
-  val = spi_w8r8(bus_data.ice40_device, (reg_addr & 0x7f));
+  return spi_w8r8(bus_data.ice40_device, (reg_addr & 0x7f));
+}
+
+static void ice40_shadow_update(u8 reg_addr, u8 reg_value, int ok) {
+  if (reg_addr >= ICE40_NUM_REGS)
+    return;
+
+  if (ok) {
+    ice40_shadow.value[reg_addr] = reg_value;
+    set_bit(reg_addr, ice40_shadow.valid);
+  } else {
+    clear_bit(reg_addr, ice40_shadow.valid);
+  }
+}
+
+static void ice40_shadow_invalidate(void) {
+  mutex_lock(&ice40_lock);
+  bitmap_zero(ice40_shadow.valid, ICE40_NUM_REGS);
+  mutex_unlock(&ice40_lock);
+}
+
+/* Reads always go to the FPGA, only debugging and the revision use them. */
+static int ice40_read_register(u8 reg_addr) {
+  int val;
+
+  mutex_lock(&ice40_lock);
+  val = __ice40_read_register(reg_addr);
+  mutex_unlock(&ice40_lock);
+
   return val;
 }
 
+/* Unconditional single write, keeps the shadow coherent. */
 static int ice40_write_register(u8 reg_addr, u8 reg_value) {
   u8 buf[] = {reg_addr | 0x80, reg_value};
+  int r;
 
   if (!bus_data.ice40_device) {
     printk(KERN_ERR LOG_TAG "No iCE40 bus data set in ice40_write_register()\n");
     return -1;
   }
-  return spi_write(bus_data.ice40_device, buf, sizeof(buf));
+
+  mutex_lock(&ice40_lock);
+  r = spi_write(bus_data.ice40_device, buf, sizeof(buf));
+  ice40_shadow_update(reg_addr, reg_value, !r);
+  mutex_unlock(&ice40_lock);
+
+  return r;
+}
+
+static void ice40_batch_begin(void) {
+  mutex_lock(&ice40_lock);
+  ice40_batch.num = 0;
+  ice40_batch.dummy = 0;
 }
 
 /*
- * Set backlight parameters.  Pass -1 to any argument to ignore that value and
- * not set it in the relevant register.
+ * Lead the batch with a read of reg_addr whose result is thrown away, like
+ * the read ice40_set_backlight() always did before touching the LED
+ * registers.  Only sent if the batch has writes.
+ */
+static void ice40_batch_dummy_read(u8 reg_addr) {
+  ice40_batch.dummy_buf[0] = reg_addr & 0x7f;
+  ice40_batch.dummy_buf[1] = 0;
+  ice40_batch.dummy = 1;
+}
+
+/*
+ * Current value of a register as the batch will leave it: a queued write,
+ * the shadow, or the FPGA itself if neither is known.
+ */
+static int ice40_batch_get(u8 reg_addr) {
+  int i, val;
+
+  for (i = ice40_batch.num - 1; i >= 0; i--)
+    if (ice40_batch.buf[i][0] == (reg_addr | 0x80))
+      return ice40_batch.buf[i][1];
+
+  if (reg_addr < ICE40_NUM_REGS && test_bit(reg_addr, ice40_shadow.valid))
+    return ice40_shadow.value[reg_addr];
+
+  val = __ice40_read_register(reg_addr);
+  if (val >= 0)
+    ice40_shadow_update(reg_addr, val, 1);
+
+  return val;
+}
+
+/* Queue a write, dropped if the register already holds the value. */
+static void ice40_batch_write(u8 reg_addr, u8 reg_value) {
+  int i;
+
+  for (i = 0; i < ice40_batch.num; i++) {
+    if (ice40_batch.buf[i][0] == (reg_addr | 0x80)) {
+      ice40_batch.buf[i][1] = reg_value;
+      return;
+    }
+  }
+
+  if (reg_addr < ICE40_NUM_REGS && test_bit(reg_addr, ice40_shadow.valid) &&
+      ice40_shadow.value[reg_addr] == reg_value)
+    return;
+
+  if (WARN_ON(ice40_batch.num == ICE40_MAX_BATCH))
+    return;
+
+  ice40_batch.buf[ice40_batch.num][0] = reg_addr | 0x80;
+  ice40_batch.buf[ice40_batch.num][1] = reg_value;
+  ice40_batch.num++;
+}
+
+static void ice40_batch_complete(void *context) {
+  complete(&ice40_batch.done);
+}
+
+/*
+ * Runs in interrupt context at the start of vertical sync, so the new
+ * values land while the LEDs are not being sequenced.
  */
-static int ice40_set_backlight(int led_en, int r, int g, int b) {
+static void ice40_batch_vsync_isr(void *arg, u32 mask) {
+  int r;
+
+  if (atomic_cmpxchg(&ice40_batch.submitted, 0, 1))
+    return;
+
+  r = spi_async(bus_data.ice40_device, &ice40_batch.msg);
+  if (r) {
+    ice40_batch.msg.status = r;
+    complete(&ice40_batch.done);
+  }
+}
+
+/*
+ * Send the queued writes as one SPI message and release the batch.  If
+ * dssdev is given the message is submitted from its vsync interrupt,
+ * otherwise (or if vsync does not come) it is sent right away.
+ */
+static int ice40_batch_commit(struct omap_dss_device *dssdev) {
+  struct spi_message *msg = &ice40_batch.msg;
+  u32 irq;
+  unsigned long done = 0;
+  int i, r = 0;
+
+  if (!ice40_batch.num)
+    goto out;
+
+  if (!bus_data.ice40_device) {
+    printk(KERN_ERR LOG_TAG "No iCE40 bus data set in ice40_batch_commit()\n");
+    r = -1;
+    goto out;
+  }
+
+  spi_message_init(msg);
+  if (ice40_batch.dummy) {
+    /* same single full duplex transfer spi_w8r8() would do */
+    memset(&ice40_batch.dummy_xfer, 0, sizeof(ice40_batch.dummy_xfer));
+    ice40_batch.dummy_xfer.tx_buf = ice40_batch.dummy_buf;
+    ice40_batch.dummy_xfer.rx_buf = ice40_batch.dummy_buf;
+    ice40_batch.dummy_xfer.len = 2;
+    ice40_batch.dummy_xfer.cs_change = 1;
+    spi_message_add_tail(&ice40_batch.dummy_xfer, msg);
+  }
+  for (i = 0; i < ice40_batch.num; i++) {
+    struct spi_transfer *t = &ice40_batch.xfers[i];
+
+    memset(t, 0, sizeof(*t));
+    t->tx_buf = ice40_batch.buf[i];
+    t->len = 2;
+    t->cs_change = i < ice40_batch.num - 1;
+    spi_message_add_tail(t, msg);
+  }
+  msg->complete = ice40_batch_complete;
+  init_completion(&ice40_batch.done);
+  atomic_set(&ice40_batch.submitted, 0);
+
+  if (dssdev) {
+    irq = dssdev->channel == OMAP_DSS_CHANNEL_LCD2 ?
+        DISPC_IRQ_VSYNC2 : DISPC_IRQ_VSYNC;
+    if (!omap_dispc_register_isr(ice40_batch_vsync_isr, NULL, irq)) {
+      done = wait_for_completion_timeout(&ice40_batch.done,
+          msecs_to_jiffies(ICE40_VSYNC_TIMEOUT_MS));
+      omap_dispc_unregister_isr(ice40_batch_vsync_isr, NULL, irq);
+    }
+  }
+
+  if (!atomic_cmpxchg(&ice40_batch.submitted, 0, 1)) {
+    r = spi_sync(bus_data.ice40_device, msg);
+  } else {
+    /* the ISR submitted it, wait unless it has already completed */
+    if (!done)
+      wait_for_completion(&ice40_batch.done);
+    r = msg->status;
+  }
+
+  for (i = 0; i < ice40_batch.num; i++)
+    ice40_shadow_update(ice40_batch.buf[i][0] & 0x7f, ice40_batch.buf[i][1],
+                        !r);
+
+out:
+  ice40_batch.num = 0;
+  ice40_batch.dummy = 0;
+  mutex_unlock(&ice40_lock);
+  return r;
+}
+
+/* Queue backlight writes, see ice40_set_backlight(). */
+static int ice40_batch_backlight(int led_en, int r, int g, int b) {
   int val;
-  int ret = 0;
 
-  ice40_read_register(ICE40_BACKLIGHT);
+  ice40_batch_dummy_read(ICE40_BACKLIGHT);
 
   if (r > -1) {
-    ret |= ice40_write_register(ICE40_LED_RED_H, (r & 0xff00) >> 8);
-    ret |= ice40_write_register(ICE40_LED_RED_L, (r & 0xff));
+    ice40_batch_write(ICE40_LED_RED_H, (r & 0xff00) >> 8);
+    ice40_batch_write(ICE40_LED_RED_L, (r & 0xff));
   }
   if (g > -1) {
-    ret |= ice40_write_register(ICE40_LED_GREEN_H, (g & 0xff00) >> 8);
-    ret |= ice40_write_register(ICE40_LED_GREEN_L, (g & 0xff));
+    ice40_batch_write(ICE40_LED_GREEN_H, (g & 0xff00) >> 8);
+    ice40_batch_write(ICE40_LED_GREEN_L, (g & 0xff));
   }
   if (b > -1) {
-    ret |= ice40_write_register(ICE40_LED_BLUE_H, (b & 0xff00) >> 8);
-    ret |= ice40_write_register(ICE40_LED_BLUE_L, (b & 0xff));
+    ice40_batch_write(ICE40_LED_BLUE_H, (b & 0xff00) >> 8);
+    ice40_batch_write(ICE40_LED_BLUE_L, (b & 0xff));
   }
 
   if (led_en > -1) {
-    val = ice40_read_register(ICE40_BACKLIGHT);
-    if (val < 0) {
-      ret |= val;
-    } else if (led_en) {
+    val = ice40_batch_get(ICE40_BACKLIGHT);
+    if (val < 0)
+      return val;
+    if (led_en) {
       val |= ICE40_BACKLIGHT_LEDEN;
     } else {
       val &= ~ICE40_BACKLIGHT_LEDEN;
     }
-    ret |= ice40_write_register(ICE40_BACKLIGHT, val);
+    ice40_batch_write(ICE40_BACKLIGHT, val);
   }
 
+  return 0;
+}
+
+/*
+ * Set backlight parameters.  Pass -1 to any argument to ignore that value and
+ * not set it in the relevant register.  Only registers whose value changes
+ * are written, at the next vsync of dssdev if it is not NULL.
+ */
+static int ice40_set_backlight(struct omap_dss_device *dssdev,
+                               int led_en, int r, int g, int b) {
+  int ret;
+
+  ice40_batch_begin();
+  ret = ice40_batch_backlight(led_en, r, g, b);
+  ret |= ice40_batch_commit(dssdev);
+
   return ret;
 }
 
+/* Read-modify-write of the bits in mask, through the shadow. */
+static int ice40_update_bits(struct omap_dss_device *dssdev,
+                             u8 reg_addr, u8 mask, int set) {
+  int val;
+
+  ice40_batch_begin();
+  val = ice40_batch_get(reg_addr);
+  if (val < 0) {
+    ice40_batch_commit(NULL);
+    return val;
+  }
+
+  ice40_batch_write(reg_addr, (val & ~mask) | (set & mask));
+
+  return ice40_batch_commit(dssdev);
+}
+
 static int fpga_read_revision(void) {
         int r, rev = -1;
 
@@ -1175,6 +1412,7 @@ static int panel_notle_power_on(struct omap_dss_device *dssdev) {
         */
         for (i = 0; i < ARRAY_SIZE(panel_init_regs); ++i) {
           if (panel_init_regs[i].reg == REG_DELAY) {
+            panel_batch_flush();
             if ( notle_version_after(V1_EVT1) ){
               r = ice40_write_register(ICE40_LCOS, ICE40_LCOS_DISP_ENB);
               if (r) {
@@ -1195,31 +1433,32 @@ static int panel_notle_power_on(struct omap_dss_device *dssdev) {
             gamma_reg = panel_init_regs[i].value;
             for (j = 0; j < (sizeof(gamma_curve) /
                              sizeof(struct gamma_point)); ++j) {
-              panel_write_register(gamma_reg + (6 * j) + 0,
-                                   gamma_curve[j].red_p);
-              panel_write_register(gamma_reg + (6 * j) + 1,
-                                   gamma_curve[j].green_p);
-              panel_write_register(gamma_reg + (6 * j) + 2,
-                                   gamma_curve[j].blue_p);
-              panel_write_register(gamma_reg + (6 * j) + 3,
-                                   gamma_curve[j].red_n);
-              panel_write_register(gamma_reg + (6 * j) + 4,
-                                   gamma_curve[j].green_n);
-              panel_write_register(gamma_reg + (6 * j) + 5,
-                                   gamma_curve[j].blue_n);
+              panel_batch_write(gamma_reg + (6 * j) + 0,
+                                gamma_curve[j].red_p);
+              panel_batch_write(gamma_reg + (6 * j) + 1,
+                                gamma_curve[j].green_p);
+              panel_batch_write(gamma_reg + (6 * j) + 2,
+                                gamma_curve[j].blue_p);
+              panel_batch_write(gamma_reg + (6 * j) + 3,
+                                gamma_curve[j].red_n);
+              panel_batch_write(gamma_reg + (6 * j) + 4,
+                                gamma_curve[j].green_n);
+              panel_batch_write(gamma_reg + (6 * j) + 5,
+                                gamma_curve[j].blue_n);
             }
             continue;
           }
 
           /* Make sure we don't misinterpret any special regs. */
           if (!(panel_init_regs[i].reg & ~0xFF)) {
-            panel_write_register((u8)(panel_init_regs[i].reg & 0xFF),
-                                 panel_init_regs[i].value);
+            panel_batch_write((u8)(panel_init_regs[i].reg & 0xFF),
+                              panel_init_regs[i].value);
           } else {
             printk(KERN_WARNING LOG_TAG "Unrecognized special register in"
                    " LCOS initialization: 0x%04x", panel_init_regs[i].reg);
           }
         }
+        panel_batch_flush();
 
         if (!notle_version_supported()) {
               printk(KERN_ERR LOG_TAG "Unsupported Notle version:"
@@ -1227,16 +1466,19 @@ static int panel_notle_power_on(struct omap_dss_device *dssdev) {
               goto err1;
         }
 
-        /* Load defaults */
-        ice40_write_register(ICE40_PIPELINE, ice40_defaults.pipeline);
-        ice40_write_register(ICE40_BACKLIGHT, ice40_defaults.backlight);
+        /* Load defaults, nothing written before power off is trusted */
+        ice40_shadow_invalidate();
+        ice40_batch_begin();
+        ice40_batch_write(ICE40_PIPELINE, ice40_defaults.pipeline);
+        ice40_batch_write(ICE40_BACKLIGHT, ice40_defaults.backlight);
+        ice40_batch_commit(NULL);
         fpga_read_revision();
 
         /* Enable LED backlight if we have nonzero brightness */
         if (led_config.brightness > 0) {
               msleep(1);
               led_config_to_linecuts(dssdev, &led_config, &r, &g, &b);
-              ice40_set_backlight(1, r, g, b);
+              ice40_set_backlight(NULL, 1, r, g, b);
         }
 
         drv_data->enabled = 1;
@@ -1267,24 +1509,30 @@ static void panel_notle_power_off(struct omap_dss_device *dssdev) {
 
         /* Disable LED backlight */
         /* Don't change the color mix, just disable the backlight. */
-        if (ice40_set_backlight(0, -1, -1, -1)) {
+        ice40_batch_begin();
+        if (ice40_batch_backlight(0, -1, -1, -1)) {
           printk(KERN_ERR LOG_TAG "Failed to disable iCE40 FPGA LED_EN\n");
         }
         /* Save register values so we can restore them when we power on. */
-        i = ice40_read_register(ICE40_BACKLIGHT);
+        i = ice40_batch_get(ICE40_BACKLIGHT);
         if (i > 0) {
           ice40_defaults.backlight = i;
         }
+        if (ice40_batch_commit(NULL)) {
+          printk(KERN_ERR LOG_TAG "Failed to disable iCE40 FPGA LED_EN\n");
+        }
 
         for (i = 0; i < ARRAY_SIZE(panel_shutdown_regs); ++i) {
           if (panel_shutdown_regs[i].reg == REG_DELAY) {
+            panel_batch_flush();
             msleep(panel_shutdown_regs[i].value);
             continue;
           }
 
-          panel_write_register(panel_shutdown_regs[i].reg,
-                               panel_shutdown_regs[i].value);
+          panel_batch_write(panel_shutdown_regs[i].reg,
+                            panel_shutdown_regs[i].value);
         }
+        panel_batch_flush();
 
         /*
          * TODO(madsci): Use fpga version instead of notle version here
@@ -1390,31 +1638,13 @@ static int panel_notle_enable(struct omap_dss_device *dssdev) {
         return 0;
 }
 
-#define L3_TPUT 800000 /* MiB/s */
 static int panel_notle_resume(struct omap_dss_device *dssdev) {
-        struct device *dss_dev;
-        int r = -1;
+        int r;
 
         /*
-         * This is a notle optimization.
-         * Hold L3 constraint to OPP 100 (200Mhz) when display is on
+         * The L3 constraint follows the active overlays, see
+         * dss/bandwidth.c.
          */
-        if (!requested_l3_throughput) {
-                dss_dev = omap_hwmod_name_get_dev("dss_core");
-                if (dss_dev) {
-                        r = omap_pm_set_min_bus_tput(&dssdev->dev,
-                                         OCP_INITIATOR_AGENT,
-                                         L3_TPUT);
-
-                        if (!r)
-                                requested_l3_throughput = 1;
-
-                }
-
-                if (r)
-                        printk(KERN_ERR LOG_TAG "Failed to set L3 bus speed\n");
-        }
-
         r = panel_notle_power_on(dssdev);
         if (r)
                 return r;
@@ -1435,16 +1665,6 @@ static int panel_notle_suspend(struct omap_dss_device *dssdev) {
 
         dssdev->state = OMAP_DSS_DISPLAY_SUSPENDED;
 
-        /*
-         * Release L3 constraint on display off.
-         */
-        if (requested_l3_throughput) {
-                omap_pm_set_min_bus_tput(&dssdev->dev,
-                        OCP_INITIATOR_AGENT, -1);
-                requested_l3_throughput = 0;
-        }
-
-
         return 0;
 }
 
@@ -32,6 +32,7 @@
 #include <linux/slab.h>
 #include <linux/regulator/consumer.h>
 #include <linux/mutex.h>
+#include <linux/spinlock.h>
 
 #include <video/omapdss.h>
 #include <video/omap-panel-nokia-dsi.h>
@@ -63,8 +64,16 @@
 #define DCS_GET_ID2		0xdb
 #define DCS_GET_ID3		0xdc
 
+/*
+ * Damage rectangles kept between updates. Each one costs a TE period and
+ * a DCS window setup when sent, so the set is kept small and rectangles
+ * are merged as soon as covering the gap between them is cheap.
+ */
+#define TAAL_MAX_DAMAGE		4
+
 static irqreturn_t taal_te_isr(int irq, void *data);
 static void taal_te_timeout_work_callback(struct work_struct *work);
+static void taal_update_work(struct work_struct *work);
 static int _taal_enable_te(struct omap_dss_device *dssdev, bool enable);
 
 static int taal_panel_reset(struct omap_dss_device *dssdev);
@@ -193,6 +202,13 @@ static struct panel_config panel_configs[] = {
 	},
 };
 
+struct taal_rect {
+	u16 x;
+	u16 y;
+	u16 w;
+	u16 h;
+};
+
 struct taal_data {
 	struct mutex lock;
 
@@ -222,6 +238,20 @@ struct taal_data {
 
 	struct delayed_work te_timeout_work;
 
+	/* damage reported by update() and not yet taken for sending */
+	spinlock_t damage_lock;
+	struct taal_rect damage[TAAL_MAX_DAMAGE];
+	int num_damage;
+
+	/*
+	 * regions of the update in flight, owned by the bus lock holder.
+	 * update_work sends the next one from the framedone callback.
+	 */
+	struct taal_rect pending[TAAL_MAX_DAMAGE];
+	int num_pending;
+	int next_pending;
+	struct work_struct update_work;
+
 	bool use_dsi_bl;
 	bool cabc_broken;
 	bool intro_printed;
@@ -1004,6 +1034,8 @@ static int taal_probe(struct omap_dss_device *dssdev)
 	td->ulps_timeout = panel_data->ulps_timeout;
 
 	mutex_init(&td->lock);
+	spin_lock_init(&td->damage_lock);
+	INIT_WORK(&td->update_work, taal_update_work);
 
 	atomic_set(&td->do_update, 0);
 
@@ -1432,6 +1464,21 @@ static void taal_framedone_cb(int err, void *data)
 		if (dsi_bus_was_unlocked(dssdev))
 			return;
 	}
+
+	/* keep the bus for the remaining regions of this update */
+	if (!err && td->next_pending < td->num_pending) {
+		schedule_work(&td->update_work);
+		return;
+	}
+
+	td->num_pending = 0;
+
+	/* count the ULPS timeout from the end of the last transfer */
+	if (td->ulps_timeout > 0) {
+		__cancel_delayed_work(&td->ulps_work);
+		taal_queue_ulps_work(dssdev);
+	}
+
 	dsi_bus_unlock(dssdev);
 	return;
 }
@@ -1461,6 +1508,7 @@ static irqreturn_t taal_te_isr(int irq, void *data)
 	return IRQ_HANDLED;
 err:
 	dev_err(&dssdev->dev, "start update failed\n");
+	td->num_pending = 0;
 	dsi_bus_unlock(dssdev);
 	return IRQ_HANDLED;
 }
@@ -1474,37 +1522,137 @@ static void taal_te_timeout_work_callback(struct work_struct *work)
 	dev_err(&dssdev->dev, "TE not received for 250ms!\n");
 
 	atomic_set(&td->do_update, 0);
+	td->num_pending = 0;
 	dsi_bus_unlock(dssdev);
 }
 
-static int taal_update(struct omap_dss_device *dssdev,
-				    u16 x, u16 y, u16 w, u16 h)
+static u32 taal_rect_area(const struct taal_rect *r)
+{
+	return r->w * r->h;
+}
+
+static void taal_rect_union(struct taal_rect *d, const struct taal_rect *a,
+		const struct taal_rect *b)
+{
+	u16 x2 = max(a->x + a->w, b->x + b->w);
+	u16 y2 = max(a->y + a->h, b->y + b->h);
+
+	d->x = min(a->x, b->x);
+	d->y = min(a->y, b->y);
+	d->w = x2 - d->x;
+	d->h = y2 - d->y;
+}
+
+/* pixels sent in vain if a and b are sent as their bounding rectangle */
+static u32 taal_rect_merge_cost(const struct taal_rect *a,
+		const struct taal_rect *b)
+{
+	struct taal_rect u;
+	u32 area;
+
+	taal_rect_union(&u, a, b);
+	area = taal_rect_area(a) + taal_rect_area(b);
+
+	return taal_rect_area(&u) > area ? taal_rect_area(&u) - area : 0;
+}
+
+static bool taal_rect_touch(const struct taal_rect *a,
+		const struct taal_rect *b)
+{
+	return a->x <= b->x + b->w && b->x <= a->x + a->w &&
+		a->y <= b->y + b->h && b->y <= a->y + a->h;
+}
+
+/*
+ * Add a rectangle to the damage set. Rectangles that overlap or touch are
+ * always merged, disjoint ones only if that wastes less than a sixteenth
+ * of the panel. When the set is full the cheapest merge is done instead.
+ */
+static void taal_damage_add(struct omap_dss_device *dssdev,
+		u16 x, u16 y, u16 w, u16 h)
 {
 	struct taal_data *td = dev_get_drvdata(&dssdev->dev);
-	struct nokia_dsi_panel_data *panel_data = get_panel_data(dssdev);
-	int r;
+	struct taal_rect r;
+	u16 dw, dh;
+	u32 slack;
+	int i, best;
 
-	dev_dbg(&dssdev->dev, "update %d, %d, %d x %d\n", x, y, w, h);
+	dssdev->driver->get_resolution(dssdev, &dw, &dh);
 
-	mutex_lock(&td->lock);
-	dsi_bus_lock(dssdev);
+	if (x >= dw || y >= dh || w == 0 || h == 0)
+		return;
 
-	r = taal_wake_up(dssdev);
-	if (r)
-		goto err;
+	/* DISPC can only send even widths starting at even columns */
+	r.x = x & ~1;
+	r.y = y;
+	r.w = min_t(u16, ALIGN(w + (x & 1), 2), dw - r.x);
+	r.h = min_t(u16, h, dh - y);
 
-	if (!td->enabled) {
-		r = 0;
-		goto err;
+	slack = (u32)dw * dh / 16;
+
+	spin_lock(&td->damage_lock);
+again:
+	for (i = 0; i < td->num_damage; i++) {
+		struct taal_rect *d = &td->damage[i];
+
+		if (!taal_rect_touch(d, &r) &&
+				taal_rect_merge_cost(d, &r) > slack)
+			continue;
+
+		taal_rect_union(&r, d, &r);
+		td->damage[i] = td->damage[--td->num_damage];
+		goto again;
+	}
+
+	if (td->num_damage == TAAL_MAX_DAMAGE) {
+		best = 0;
+		for (i = 1; i < td->num_damage; i++)
+			if (taal_rect_merge_cost(&td->damage[i], &r) <
+				taal_rect_merge_cost(&td->damage[best], &r))
+				best = i;
+
+		taal_rect_union(&r, &td->damage[best], &r);
+		td->damage[best] = td->damage[--td->num_damage];
+		goto again;
 	}
 
+	td->damage[td->num_damage++] = r;
+	spin_unlock(&td->damage_lock);
+}
+
+/* move the damage set to the pending list, called with the bus locked */
+static int taal_damage_take(struct taal_data *td)
+{
+	spin_lock(&td->damage_lock);
+	memcpy(td->pending, td->damage,
+			td->num_damage * sizeof(struct taal_rect));
+	td->num_pending = td->num_damage;
+	td->next_pending = 0;
+	td->num_damage = 0;
+	spin_unlock(&td->damage_lock);
+
+	return td->num_pending;
+}
+
+/* send the next pending region, synchronized to TE if it is used */
+static int taal_update_region(struct omap_dss_device *dssdev)
+{
+	struct taal_data *td = dev_get_drvdata(&dssdev->dev);
+	struct nokia_dsi_panel_data *panel_data = get_panel_data(dssdev);
+	struct taal_rect *rect = &td->pending[td->next_pending++];
+	u16 x = rect->x, y = rect->y, w = rect->w, h = rect->h;
+	int r;
+
+	dev_dbg(&dssdev->dev, "region %d/%d: %d, %d, %d x %d\n",
+			td->next_pending, td->num_pending, x, y, w, h);
+
 	r = omap_dsi_prepare_update(dssdev, &x, &y, &w, &h, true);
 	if (r)
-		goto err;
+		return r;
 
 	r = taal_set_update_window(td, x, y, w, h);
 	if (r)
-		goto err;
+		return r;
 
 	if (td->te_enabled && panel_data->use_ext_te) {
 		td->update_region.x = x;
@@ -1519,7 +1667,66 @@ static int taal_update(struct omap_dss_device *dssdev,
 		r = omap_dsi_update(dssdev, td->channel, x, y, w, h,
 				taal_framedone_cb, dssdev);
 		if (r)
-			goto err;
+			return r;
+	}
+
+	return 0;
+}
+
+/*
+ * Sends the remaining regions of an update. Runs with the bus still held
+ * from taal_update(), so it must not take td->lock.
+ */
+static void taal_update_work(struct work_struct *work)
+{
+	struct taal_data *td = container_of(work, struct taal_data,
+			update_work);
+	struct omap_dss_device *dssdev = td->dssdev;
+	int r;
+
+	r = taal_update_region(dssdev);
+	if (r) {
+		dev_err(&dssdev->dev, "region update failed %d\n", r);
+		td->num_pending = 0;
+		dsi_bus_unlock(dssdev);
+	}
+}
+
+static int taal_update(struct omap_dss_device *dssdev,
+				    u16 x, u16 y, u16 w, u16 h)
+{
+	struct taal_data *td = dev_get_drvdata(&dssdev->dev);
+	int r;
+
+	dev_dbg(&dssdev->dev, "update %d, %d, %d x %d\n", x, y, w, h);
+
+	/*
+	 * Damage reported while an update is in flight piles up here and is
+	 * sent by whoever gets the bus next, later callers find it empty.
+	 */
+	taal_damage_add(dssdev, x, y, w, h);
+
+	mutex_lock(&td->lock);
+	dsi_bus_lock(dssdev);
+
+	r = taal_wake_up(dssdev);
+	if (r)
+		goto err;
+
+	if (!td->enabled) {
+		r = 0;
+		goto err;
+	}
+
+	if (!taal_damage_take(td)) {
+		r = 0;
+		goto err;
+	}
+
+	r = taal_update_region(dssdev);
+	if (r) {
+		td->num_pending = 0;
+		goto err;
 	}
 
 	/* note: no bus_unlock here. unlock is in framedone_cb */
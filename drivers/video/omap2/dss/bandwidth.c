@@ -0,0 +1,390 @@
+/*
+ * linux/drivers/video/omap2/dss/bandwidth.c
+ *
+ * Display bandwidth manager
+ *
+ * Derives the L3/EMIF throughput constraint and the DISPC FIFO thresholds
+ * from what the enabled overlays actually fetch, instead of holding a
+ * worst case constraint for as long as a display is on.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define DSS_SUBSYS_NAME "BW"
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/err.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/seq_file.h>
+#include <linux/workqueue.h>
+#include <asm/div64.h>
+#include <plat/omap_hwmod.h>
+#include <plat/omap-pm.h>
+
+#include <video/omapdss.h>
+
+#include "dss.h"
+#include "dss_features.h"
+
+/*
+ * Constraint used when the manager is disabled or after an underflow. It
+ * keeps L3 at OPP100, which is what the displays used to request
+ * unconditionally.
+ */
+#define DSS_BW_WORST_CASE	800000	/* KiB/s */
+
+static bool bw_manage = true;
+module_param(bw_manage, bool, 0644);
+MODULE_PARM_DESC(bw_manage, "Derive the L3 constraint from the active overlays");
+
+static unsigned int bw_margin = 25;
+module_param(bw_margin, uint, 0644);
+MODULE_PARM_DESC(bw_margin, "Headroom added to the measured fetch bandwidth (%)");
+
+/* not characterised on this platform yet, 0 keeps the default thresholds */
+static unsigned int bw_latency_us;
+module_param(bw_latency_us, uint, 0644);
+MODULE_PARM_DESC(bw_latency_us, "Worst case L3/EMIF wakeup latency the FIFO must cover (us, 0 = default thresholds)");
+
+static DEFINE_SPINLOCK(bw_lock);
+static DEFINE_MUTEX(bw_commit_lock);
+
+static struct {
+	/* instantaneous fetch rate of each plane, 0 when disabled */
+	u32 plane_tput[MAX_DSS_OVERLAYS];
+	enum omap_channel plane_channel[MAX_DSS_OVERLAYS];
+	/* channels currently scanning out */
+	u32 channel_mask;
+	/* set by an underflow, cleared when the displays go off */
+	bool boost;
+	/* a lowering waits for the new configuration to be latched */
+	bool lower_armed;
+
+	/* KiB/s currently requested, 0 if released */
+	u32 requested;
+	u32 peak;
+	u32 num_requests;
+	u32 underflows[MAX_DSS_OVERLAYS];
+} dss_bw;
+
+/*
+ * Return the rate (KiB/s) at which DISPC fetches a width x height plane
+ * while the display is in its active area. Blanking is accounted for by
+ * scaling with the pixel clock instead of the frame rate, since the FIFO
+ * has to be refilled at line rate, not at frame rate.
+ */
+u32 dss_bw_plane_tput(struct omap_dss_device *dssdev, u16 width, u16 height,
+		enum omap_color_mode color_mode, u8 rotation,
+		enum omap_dss_rotation_type rotation_type)
+{
+	struct omap_video_timings *t = &dssdev->panel.timings;
+	u64 bytes;
+	u32 active;
+
+	/* bits per pixel, NV12 carries a half size chroma plane */
+	bytes = (u64)width * height * dispc_get_color_mode_bpp(color_mode);
+	if (color_mode == OMAP_DSS_COLOR_NV12)
+		bytes = bytes * 3 / 2;
+	do_div(bytes, 8);
+
+	/* rotated TILER fetches cross a page every few lines */
+	if (rotation_type == OMAP_DSS_ROT_TILER && (rotation & 1))
+		bytes = bytes * 5 / 4;
+
+	active = t->x_res * t->y_res;
+	if (!t->pixel_clock || !active) {
+		bytes *= 60;
+		do_div(bytes, 1024);
+		return (u32)bytes;
+	}
+
+	bytes *= t->pixel_clock;	/* kHz */
+	bytes *= 1000;
+	do_div(bytes, active);
+	do_div(bytes, 1024);
+
+	return (u32)bytes;
+}
+
+/*
+ * Record the fetch rate of a plane. Called with the manager cache lock
+ * held, the constraint itself is updated by dss_bw_commit().
+ */
+void dss_bw_set_plane(enum omap_plane plane, enum omap_channel channel,
+		u32 tput)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&bw_lock, flags);
+	dss_bw.plane_tput[plane] = tput;
+	dss_bw.plane_channel[plane] = channel;
+	spin_unlock_irqrestore(&bw_lock, flags);
+}
+
+void dss_bw_set_channel(enum omap_channel channel, bool enable)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&bw_lock, flags);
+	if (enable)
+		dss_bw.channel_mask |= 1 << channel;
+	else
+		dss_bw.channel_mask &= ~(1 << channel);
+	if (!dss_bw.channel_mask)
+		dss_bw.boost = false;
+	spin_unlock_irqrestore(&bw_lock, flags);
+
+	dss_bw_commit();
+}
+
+/*
+ * FIFO thresholds for a plane fetching @tput KiB/s. The high threshold
+ * stays at the top of the FIFO, the low threshold only needs to cover
+ * what drains while the interconnect wakes up. Refilling in big chunks
+ * lets L3 and EMIF idle between them.
+ */
+void dss_bw_get_overlay_fifo_thresholds(enum omap_plane plane,
+		u32 fifo_size, u32 tput, enum omap_burst_size *burst_size,
+		u32 *fifo_low, u32 *fifo_high)
+{
+	unsigned burst_size_bytes;
+	u32 drain;
+
+	unsigned long flags;
+	bool boost;
+
+	default_get_overlay_fifo_thresholds(plane, fifo_size, burst_size,
+			fifo_low, fifo_high);
+
+	spin_lock_irqsave(&bw_lock, flags);
+	boost = dss_bw.boost;
+	spin_unlock_irqrestore(&bw_lock, flags);
+
+	if (!bw_manage || !tput || !bw_latency_us || boost)
+		return;
+
+	burst_size_bytes = 16 * 32 / 8;
+
+	/* KiB/s * us ~= bytes / 1000, keep a 2x margin */
+	drain = DIV_ROUND_UP(tput * 1024 / 1000 * bw_latency_us, 1000) * 2;
+
+	*fifo_low = clamp_t(u32, drain + burst_size_bytes,
+			burst_size_bytes * 2, *fifo_low);
+}
+
+static void dss_bw_lower_work(struct work_struct *work);
+static DECLARE_WORK(dss_bw_work, dss_bw_lower_work);
+
+static u32 dss_bw_irq_mask(void)
+{
+	u32 mask = DISPC_IRQ_VSYNC | DISPC_IRQ_EVSYNC_ODD |
+		DISPC_IRQ_EVSYNC_EVEN | DISPC_IRQ_FRAMEDONE;
+
+	if (dss_has_feature(FEAT_MGR_LCD2))
+		mask |= DISPC_IRQ_VSYNC2 | DISPC_IRQ_FRAMEDONE2;
+
+	return mask;
+}
+
+/* true while a channel still has a GO pending, dispc must be enabled */
+static bool dss_bw_go_busy(u32 channel_mask)
+{
+	int i;
+
+	for (i = 0; i < dss_feat_get_num_mgrs(); i++)
+		if ((channel_mask & (1 << i)) && dispc_go_busy(i))
+			return true;
+
+	return false;
+}
+
+/*
+ * Once every scanning out manager has latched its shadow registers, the
+ * planes that needed the higher constraint are gone and it can be lowered.
+ */
+static void dss_bw_vsync_isr(void *arg, u32 mask)
+{
+	spin_lock(&bw_lock);
+	if (dss_bw.lower_armed && !dss_bw_go_busy(dss_bw.channel_mask)) {
+		omap_dispc_unregister_isr(dss_bw_vsync_isr, NULL,
+				dss_bw_irq_mask());
+		dss_bw.lower_armed = false;
+		schedule_work(&dss_bw_work);
+	}
+	spin_unlock(&bw_lock);
+}
+
+/* called with bw_commit_lock held and dispc enabled */
+static void dss_bw_arm_lower(void)
+{
+	unsigned long flags;
+	bool armed;
+
+	spin_lock_irqsave(&bw_lock, flags);
+	armed = dss_bw.lower_armed;
+	dss_bw.lower_armed = true;
+	spin_unlock_irqrestore(&bw_lock, flags);
+
+	if (!armed && omap_dispc_register_isr(dss_bw_vsync_isr, NULL,
+			dss_bw_irq_mask())) {
+		spin_lock_irqsave(&bw_lock, flags);
+		dss_bw.lower_armed = false;
+		spin_unlock_irqrestore(&bw_lock, flags);
+		/* no way to tell when the GO completes, try again later */
+		schedule_work(&dss_bw_work);
+	}
+}
+
+/* called with bw_commit_lock held */
+static void dss_bw_disarm_lower(void)
+{
+	unsigned long flags;
+	bool armed;
+
+	spin_lock_irqsave(&bw_lock, flags);
+	armed = dss_bw.lower_armed;
+	dss_bw.lower_armed = false;
+	spin_unlock_irqrestore(&bw_lock, flags);
+
+	if (armed)
+		omap_dispc_unregister_isr(dss_bw_vsync_isr, NULL,
+				dss_bw_irq_mask());
+}
+
+/*
+ * Raising the constraint is immediate. Lowering it is left to the first
+ * VSYNC/FRAMEDONE after the GO bits clear: until then DISPC still fetches
+ * with the old configuration, which may need the higher throughput.
+ */
+static void __dss_bw_commit(bool lower)
+{
+	struct device *dss_dev;
+	unsigned long flags;
+	u32 total = 0;
+	u32 mask;
+	bool boost;
+	int i;
+
+	mutex_lock(&bw_commit_lock);
+
+	spin_lock_irqsave(&bw_lock, flags);
+	mask = dss_bw.channel_mask;
+	boost = dss_bw.boost;
+	for (i = 0; i < MAX_DSS_OVERLAYS; i++)
+		if (mask & (1 << dss_bw.plane_channel[i]))
+			total += dss_bw.plane_tput[i];
+	spin_unlock_irqrestore(&bw_lock, flags);
+
+	if (!mask)
+		total = 0;
+	else if (!bw_manage || boost)
+		total = DSS_BW_WORST_CASE;
+	else
+		total += total * bw_margin / 100;
+
+	if (total == dss_bw.requested)
+		goto out;
+
+	if (total < dss_bw.requested && mask) {
+		bool busy = true;
+
+		if (!dispc_runtime_get()) {
+			busy = !lower || dss_bw_go_busy(mask);
+			if (busy)
+				dss_bw_arm_lower();
+			dispc_runtime_put();
+		}
+		if (busy)
+			goto out;
+	}
+	dss_bw_disarm_lower();
+
+	dss_dev = omap_hwmod_name_get_dev("dss_core");
+	if (IS_ERR_OR_NULL(dss_dev)) {
+		DSSDBG("Failed to set L3 bus speed\n");
+		goto out;
+	}
+
+	DSSDBG("L3 constraint %u -> %u KiB/s\n", dss_bw.requested, total);
+
+	omap_pm_set_min_bus_tput(dss_dev, OCP_INITIATOR_AGENT,
+			total ? total : -1);
+
+	dss_bw.requested = total;
+	dss_bw.peak = max(dss_bw.peak, total);
+	dss_bw.num_requests++;
+out:
+	mutex_unlock(&bw_commit_lock);
+}
+
+void dss_bw_commit(void)
+{
+	__dss_bw_commit(false);
+}
+
+static void dss_bw_lower_work(struct work_struct *work)
+{
+	__dss_bw_commit(true);
+}
+
+/*
+ * Called from the DISPC error worker. The estimate was too optimistic for
+ * this use case, hold the worst case constraint until the displays go off.
+ */
+void dss_bw_underflow(enum omap_plane plane)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&bw_lock, flags);
+	dss_bw.underflows[plane]++;
+	dss_bw.boost = true;
+	spin_unlock_irqrestore(&bw_lock, flags);
+
+	dss_bw_commit();
+}
+
+void dss_bw_exit(void)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&bw_lock, flags);
+	dss_bw.channel_mask = 0;
+	dss_bw.boost = false;
+	spin_unlock_irqrestore(&bw_lock, flags);
+
+	dss_bw_commit();
+	cancel_work_sync(&dss_bw_work);
+}
+
+void dss_bw_dump(struct seq_file *s)
+{
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&bw_lock, flags);
+
+	seq_printf(s, "requested %u KiB/s\n", dss_bw.requested);
+	seq_printf(s, "peak %u KiB/s\n", dss_bw.peak);
+	seq_printf(s, "requests %u\n", dss_bw.num_requests);
+	seq_printf(s, "channels 0x%x%s\n", dss_bw.channel_mask,
+			dss_bw.boost ? " (boosted)" : "");
+
+	for (i = 0; i < omap_dss_get_num_overlays(); i++)
+		seq_printf(s, "ovl%d: channel %d %u KiB/s underflows %u\n", i,
+				dss_bw.plane_channel[i], dss_bw.plane_tput[i],
+				dss_bw.underflows[i]);
+
+	spin_unlock_irqrestore(&bw_lock, flags);
+}
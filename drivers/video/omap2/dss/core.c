@@ -32,8 +32,6 @@
 #include <linux/io.h>
 #include <linux/device.h>
 #include <linux/regulator/consumer.h>
-#include <plat/omap_hwmod.h>
-#include <plat/omap-pm.h>
 
 #include <video/omapdss.h>
 
@@ -122,6 +120,8 @@ static int dss_initialize_debugfs(void)
 
 	debugfs_create_file("clk", S_IRUGO, dss_debugfs_dir,
 			&dss_debug_dump_clocks, &dss_debug_fops);
+	debugfs_create_file("bandwidth", S_IRUGO, dss_debugfs_dir,
+			&dss_bw_dump, &dss_debug_fops);
 
 #ifdef CONFIG_OMAP2_DSS_COLLECT_IRQ_STATS
 	debugfs_create_file("dispc_irq", S_IRUGO, dss_debugfs_dir,
@@ -136,6 +136,8 @@ static int dss_initialize_debugfs(void)
 			&dss_dump_regs, &dss_debug_fops);
 	debugfs_create_file("dispc", S_IRUGO, dss_debugfs_dir,
 			&dispc_dump_regs, &dss_debug_fops);
+	debugfs_create_file("dispc_writes", S_IRUGO, dss_debugfs_dir,
+			&dispc_dump_writes, &dss_debug_fops);
 #ifdef CONFIG_OMAP2_DSS_RFBI
 	debugfs_create_file("rfbi", S_IRUGO, dss_debugfs_dir,
 			&rfbi_dump_regs, &dss_debug_fops);
@@ -167,40 +169,6 @@ static inline void dss_uninitialize_debugfs(void)
 }
 #endif /* CONFIG_DEBUG_FS && CONFIG_OMAP2_DSS_DEBUG_SUPPORT */
 
-/*
- * The value of HIGH_RES_TPUT corresponds to one dispc pipe layer of
- * 1920x1080x4(bpp)x60(Hz) = ~500000(MiB/s). We add another 100000
- * for the other partial screen pipes. This is above the threshold for
- * selecting the higher OPP and L3 frequency, so it's "as fast" as we
- * can go so covers the higest supported resolution.
- */
-#define HIGH_RES_TPUT 600000 /* MiB/s */
-static void omap_dss_request_bandwidth(struct omap_dss_device *display)
-{
-	struct device *dss_dev;
-
-	if (display->panel.timings.x_res * display->panel.timings.y_res >=
-							(1080 * 1920)) {
-		dss_dev = omap_hwmod_name_get_dev("dss_core");
-		if (dss_dev)
-			omap_pm_set_min_bus_tput(dss_dev,
-						 OCP_INITIATOR_AGENT,
-						 HIGH_RES_TPUT);
-		else
-			DSSDBG("Failed to set L3 bus speed\n");
-	}
-}
-
-static void omap_dss_reset_bandwidth(void)
-{
-	struct device *dss_dev;
-	dss_dev = omap_hwmod_name_get_dev("dss_core");
-	if (IS_ERR_OR_NULL(dss_dev))
-		return;
-	omap_pm_set_min_bus_tput(dss_dev,
-				 OCP_INITIATOR_AGENT, -1);
-}
-
 /* PLATFORM DEVICE */
 static int omap_dss_probe(struct platform_device *pdev)
 {
@@ -304,6 +272,8 @@ static int omap_dss_remove(struct platform_device *pdev)
 
 	dss_uninitialize_debugfs();
 
+	dss_bw_exit();
+
 	venc_uninit_platform_driver();
 	dispc_uninit_platform_driver();
 	rfbi_uninit_platform_driver();
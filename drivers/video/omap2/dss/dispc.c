@@ -98,6 +98,29 @@ struct dispc_irq_stats {
 	unsigned irqs[32];
 };
 
+/*
+ * Last values written to the per-plane register groups that are expensive
+ * to reprogram. -1 / false means unknown, forcing the next write.
+ */
+struct dispc_plane_shadow {
+	/* coefficient tables in the FIRH/FIRHV and FIRV banks, per component */
+	s8 h_coef[2];
+	s8 hv_coef[2];
+	s8 v_coef[2];
+	bool fir_valid[2];
+	u32 fir[2];
+	bool cconv_valid;
+	struct omap_dss_cconv_coefs cconv;
+};
+
+/* register write accounting, approximate as it is not locked */
+struct dispc_write_stats {
+	unsigned long last_reset;
+	u32 writes;
+	u32 skipped;
+	u32 frames;
+};
+
 static struct {
 	struct platform_device *pdev;
 	void __iomem    *base;
@@ -124,6 +147,10 @@ static struct {
 	bool		ctx_valid;
 	u32		ctx[DISPC_SZ_REGS / sizeof(u32)];
 
+	/* indexed by plane, including the writeback pipeline */
+	struct dispc_plane_shadow shadow[OMAP_DSS_WB + 1];
+	struct dispc_write_stats stats;
+
 #ifdef CONFIG_OMAP2_DSS_COLLECT_IRQ_STATS
 	spinlock_t irq_stats_lock;
 	struct dispc_irq_stats irq_stats;
@@ -146,6 +173,7 @@ static void _omap_dispc_set_irqs(void);
 
 static inline void dispc_write_reg(const u16 idx, u32 val)
 {
+	dispc.stats.writes++;
 	__raw_writel(val, dispc.base + idx);
 }
 
@@ -176,6 +204,18 @@ static int dispc_get_ctx_loss_count(void)
 #define RR(reg) \
 	dispc_write_reg(DISPC_##reg, dispc.ctx[DISPC_##reg / sizeof(u32)])
 
+static void dispc_invalidate_shadow(void)
+{
+	int i;
+
+	memset(dispc.shadow, 0, sizeof(dispc.shadow));
+	for (i = 0; i < ARRAY_SIZE(dispc.shadow); i++) {
+		memset(dispc.shadow[i].h_coef, -1, sizeof(dispc.shadow[i].h_coef));
+		memset(dispc.shadow[i].hv_coef, -1, sizeof(dispc.shadow[i].hv_coef));
+		memset(dispc.shadow[i].v_coef, -1, sizeof(dispc.shadow[i].v_coef));
+	}
+}
+
 static void dispc_save_context(void)
 {
 	int i, o;
@@ -598,6 +638,8 @@ int dispc_runtime_get(void)
 		if (r < 0)
 			goto err_runtime_get;
 
+		/* the registers may have been reset while we were off */
+		dispc_invalidate_shadow();
 		dispc_restore_context();
 	}
 
@@ -709,6 +751,8 @@ void dispc_go(enum omap_channel channel)
 		return;
 	}
 
+	dispc.stats.frames++;
+
 	DSSDBG("GO %s\n", channel == OMAP_DSS_CHANNEL_LCD ? "LCD" :
 		(channel == OMAP_DSS_CHANNEL_LCD2 ? "LCD2" : "DIGIT"));
 
@@ -754,10 +798,26 @@ static void _dispc_write_firv2_reg(enum omap_plane plane, int reg, u32 value)
 	dispc_write_reg(DISPC_OVL_FIR_COEF_V2(plane, reg), value);
 }
 
-static const struct dispc_hv_coef *
-dispc_get_scaling_coef(u32 inc, bool five_taps)
-{
-	static const struct dispc_hv_coef coef3_M8[8] = {
+enum dispc_coef_table {
+	COEF3_M8,
+	COEF3_M16,
+	COEF_M8,
+	COEF_M9,
+	COEF_M10,
+	COEF_M11,
+	COEF_M12,
+	COEF_M13,
+	COEF_M14,
+	COEF_M16,
+	COEF_M19,
+	COEF_M22,
+	COEF_M26,
+	COEF_M32,
+	DISPC_NUM_COEF_TABLES
+};
+
+static const struct dispc_hv_coef dispc_coef_tables[DISPC_NUM_COEF_TABLES][8] = {
+	[COEF3_M8] = {
 		{    0,    0,  128,    0,    0 },
 		{    0,    2,  123,    3,    0 },
 		{    0,    5,  111,   12,    0 },
@@ -766,9 +826,8 @@ dispc_get_scaling_coef(u32 inc, bool five_taps)
 		{    0,   32,   89,    7,    0 },
 		{    0,   12,  111,    5,    0 },
 		{    0,    3,  123,    2,    0 },
-	};
-
-	static const struct dispc_hv_coef coef3_M16[8] = {
+	},
+	[COEF3_M16] = {
 		{    0,   36,   56,   36,    0 },
 		{    0,   31,   57,   40,    0 },
 		{    0,   27,   56,   45,    0 },
@@ -777,9 +836,8 @@ dispc_get_scaling_coef(u32 inc, bool five_taps)
 		{    0,   50,   55,   23,    0 },
 		{    0,   45,   56,   27,    0 },
 		{    0,   40,   57,   31,    0 },
-	};
-
-	static const struct dispc_hv_coef coef_M8[8] = {
+	},
+	[COEF_M8] = {
 		{    0,    0,  128,    0,    0 },
 		{    0,   -8,  124,   13,   -1 },
 		{   -1,  -11,  112,   30,   -2 },
@@ -788,9 +846,8 @@ dispc_get_scaling_coef(u32 inc, bool five_taps)
 		{   -5,   51,   95,  -11,   -2 },
 		{   -2,   30,  112,  -11,   -1 },
 		{   -1,   13,  124,   -8,    0 },
-	};
-
-	static const struct dispc_hv_coef coef_M9[8] = {
+	},
+	[COEF_M9] = {
 		{    8,   -8,  128,   -8,    8 },
 		{   14,  -21,  126,    8,    1 },
 		{   17,  -27,  117,   30,   -9 },
@@ -799,9 +856,8 @@ dispc_get_scaling_coef(u32 inc, bool five_taps)
 		{  -18,   56,  103,  -30,   17 },
 		{   -9,   30,  117,  -27,   17 },
 		{    1,    8,  126,  -21,   14 },
-	};
-
-	static const struct dispc_hv_coef coef_M10[8] = {
+	},
+	[COEF_M10] = {
 		{   -2,    2,  128,    2,   -2 },
 		{    5,  -12,  125,   20,  -10 },
 		{   11,  -22,  116,   41,  -18 },
@@ -810,9 +866,8 @@ dispc_get_scaling_coef(u32 inc, bool five_taps)
 		{  -24,   62,  102,  -27,   15 },
 		{  -18,   41,  116,  -22,   11 },
 		{  -10,   20,  125,  -12,    5 },
-	};
-
-	static const struct dispc_hv_coef coef_M11[8] = {
+	},
+	[COEF_M11] = {
 		{  -12,   12,  128,   12,  -12 },
 		{   -4,   -3,  124,   30,  -19 },
 		{    3,  -15,  115,   49,  -24 },
@@ -821,9 +876,8 @@ dispc_get_scaling_coef(u32 inc, bool five_taps)
 		{  -27,   67,  101,  -22,    9 },
 		{  -24,   49,  115,  -15,    3 },
 		{  -19,   30,  124,   -3,   -4 },
-	};
-
-	static const struct dispc_hv_coef coef_M12[8] = {
+	},
+	[COEF_M12] = {
 		{  -19,   21,  124,   21,  -19 },
 		{  -12,    6,  120,   38,  -24 },
 		{   -6,   -7,  112,   55,  -26 },
@@ -832,9 +886,8 @@ dispc_get_scaling_coef(u32 inc, bool five_taps)
 		{  -25,   70,   98,  -16,    1 },
 		{  -26,   55,  112,   -7,   -6 },
 		{  -24,   38,  120,    6,  -12 },
-	};
-
-	static const struct dispc_hv_coef coef_M13[8] = {
+	},
+	[COEF_M13] = {
 		{  -22,   27,  118,   27,  -22 },
 		{  -18,   13,  115,   43,  -25 },
 		{  -12,    0,  107,   58,  -25 },
@@ -843,9 +896,8 @@ dispc_get_scaling_coef(u32 inc, bool five_taps)
 		{  -22,   71,   95,  -10,   -6 },
 		{  -25,   58,  107,    0,  -12 },
 		{  -25,   43,  115,   13,  -18 },
-	};
-
-	static const struct dispc_hv_coef coef_M14[8] = {
+	},
+	[COEF_M14] = {
 		{  -23,   32,  110,   32,  -23 },
 		{  -20,   18,  108,   46,  -24 },
 		{  -16,    6,  101,   59,  -22 },
@@ -854,9 +906,8 @@ dispc_get_scaling_coef(u32 inc, bool five_taps)
 		{  -18,   70,   91,   -4,  -11 },
 		{  -22,   59,  101,    6,  -16 },
 		{  -24,   46,  108,   18,  -20 },
-	};
-
-	static const struct dispc_hv_coef coef_M16[8] = {
+	},
+	[COEF_M16] = {
 		{  -20,   37,   94,   37,  -20 },
 		{  -21,   26,   93,   48,  -18 },
 		{  -19,   15,   88,   58,  -14 },
@@ -865,9 +916,8 @@ dispc_get_scaling_coef(u32 inc, bool five_taps)
 		{   -9,   66,   82,    6,  -17 },
 		{  -14,   58,   88,   15,  -19 },
 		{  -18,   48,   93,   26,  -21 },
-	};
-
-	static const struct dispc_hv_coef coef_M19[8] = {
+	},
+	[COEF_M19] = {
 		{  -12,   38,   76,   38,  -12 },
 		{  -14,   31,   72,   47,   -8 },
 		{  -16,   22,   73,   53,   -4 },
@@ -876,9 +926,8 @@ dispc_get_scaling_coef(u32 inc, bool five_taps)
 		{    1,   59,   69,   15,  -16 },
 		{   -4,   53,   73,   22,  -16 },
 		{   -9,   47,   72,   31,  -13 },
-	};
-
-	static const struct dispc_hv_coef coef_M22[8] = {
+	},
+	[COEF_M22] = {
 		{   -6,   37,   66,   37,   -6 },
 		{   -8,   32,   61,   44,   -1 },
 		{  -11,   25,   63,   48,    3 },
@@ -887,9 +936,8 @@ dispc_get_scaling_coef(u32 inc, bool five_taps)
 		{    8,   53,   61,   19,  -13 },
 		{    3,   48,   63,   25,  -11 },
 		{   -2,   44,   61,   32,   -7 },
-	};
-
-	static const struct dispc_hv_coef coef_M26[8] = {
+	},
+	[COEF_M26] = {
 		{    1,   36,   54,   36,    1 },
 		{   -2,   31,   55,   40,    4 },
 		{   -5,   27,   54,   44,    8 },
@@ -898,9 +946,8 @@ dispc_get_scaling_coef(u32 inc, bool five_taps)
 		{   13,   48,   53,   22,   -8 },
 		{    8,   44,   54,   27,   -5 },
 		{    4,   40,   55,   31,   -2 },
-	};
-
-	static const struct dispc_hv_coef coef_M32[8] = {
+	},
+	[COEF_M32] = {
 		{    7,   34,   46,   34,    7 },
 		{    4,   31,   46,   37,   10 },
 		{    1,   27,   46,   39,   14 },
@@ -909,47 +956,85 @@ dispc_get_scaling_coef(u32 inc, bool five_taps)
 		{   17,   42,   46,   24,   -1 },
 		{   14,   39,   46,   28,    1 },
 		{   10,   37,   46,   31,    4 },
-	};
+	},
+};
 
+static enum dispc_coef_table dispc_get_scaling_coef(u32 inc, bool five_taps)
+{
 	inc >>= 7;	/* /= 128 */
 	if (five_taps) {
 		if (inc > 26)
-			return coef_M32;
+			return COEF_M32;
 		if (inc > 22)
-			return coef_M26;
+			return COEF_M26;
 		if (inc > 19)
-			return coef_M22;
+			return COEF_M22;
 		if (inc > 16)
-			return coef_M19;
+			return COEF_M19;
 		if (inc > 14)
-			return coef_M16;
+			return COEF_M16;
 		if (inc > 13)
-			return coef_M14;
+			return COEF_M14;
 		if (inc > 12)
-			return coef_M13;
+			return COEF_M13;
 		if (inc > 11)
-			return coef_M12;
+			return COEF_M12;
 		if (inc > 10)
-			return coef_M11;
+			return COEF_M11;
 		if (inc > 9)
-			return coef_M10;
+			return COEF_M10;
 		if (inc > 8)
-			return coef_M9;
+			return COEF_M9;
 		/* reduce blockiness when upscaling much */
 		if (inc > 3)
-			return coef_M8;
+			return COEF_M8;
 		if (inc > 2)
-			return coef_M11;
+			return COEF_M11;
 		if (inc > 1)
-			return coef_M16;
-		return coef_M19;
+			return COEF_M16;
+		return COEF_M19;
 	} else {
 		if (inc > 14)
-			return coef3_M16;
+			return COEF3_M16;
 		/* reduce blockiness when upscaling much */
 		if (inc > 3)
-			return coef3_M8;
-		return coef3_M16;
+			return COEF3_M8;
+		return COEF3_M16;
+	}
+}
+
+/*
+ * FIR coefficient register images, packed once from dispc_coef_tables.
+ * The HV registers mix the horizontal and vertical tables, so both halves
+ * are kept separately and OR'ed at write time.
+ */
+static struct dispc_coef_regs {
+	u32 h[8];
+	u32 hv_h[8];
+	u32 hv_v[8];
+	u32 v[8];
+} dispc_coef_regs[DISPC_NUM_COEF_TABLES];
+
+static void dispc_init_scaling_coefs(void)
+{
+	int t, i;
+
+	for (t = 0; t < DISPC_NUM_COEF_TABLES; t++) {
+		const struct dispc_hv_coef *c = dispc_coef_tables[t];
+		struct dispc_coef_regs *r = &dispc_coef_regs[t];
+
+		for (i = 0; i < 8; i++) {
+			r->h[i] = FLD_VAL(c[i].hc0_vc00, 7, 0)
+				| FLD_VAL(c[i].hc1_vc0, 15, 8)
+				| FLD_VAL(c[i].hc2_vc1, 23, 16)
+				| FLD_VAL(c[i].hc3_vc2, 31, 24);
+			r->hv_h[i] = FLD_VAL(c[i].hc4_vc22, 7, 0);
+			r->hv_v[i] = FLD_VAL(c[i].hc1_vc0, 15, 8)
+				| FLD_VAL(c[i].hc2_vc1, 23, 16)
+				| FLD_VAL(c[i].hc3_vc2, 31, 24);
+			r->v[i] = FLD_VAL(c[i].hc0_vc00, 7, 0)
+				| FLD_VAL(c[i].hc4_vc22, 15, 8);
+		}
 	}
 }
 
@@ -957,52 +1042,67 @@ static void _dispc_set_scale_coef(enum omap_plane plane, int hinc,
 				  int vinc, bool five_taps,
 				  enum omap_color_component color_comp)
 {
-	const struct dispc_hv_coef *h_coef;
-	const struct dispc_hv_coef *v_coef;
+	struct dispc_plane_shadow *sh = &dispc.shadow[plane];
+	int comp = color_comp == DISPC_COLOR_COMPONENT_RGB_Y ? 0 : 1;
+	const struct dispc_coef_regs *h_regs, *v_regs;
+	int h_coef, v_coef;
 	int i;
 
 	h_coef = dispc_get_scaling_coef(hinc, true);
 	v_coef = dispc_get_scaling_coef(vinc, five_taps);
 
-	for (i = 0; i < 8; i++) {
-		u32 h, hv;
-
-		h = FLD_VAL(h_coef[i].hc0_vc00, 7, 0)
-			| FLD_VAL(h_coef[i].hc1_vc0, 15, 8)
-			| FLD_VAL(h_coef[i].hc2_vc1, 23, 16)
-			| FLD_VAL(h_coef[i].hc3_vc2, 31, 24);
-		hv = FLD_VAL(h_coef[i].hc4_vc22, 7, 0)
-			| FLD_VAL(v_coef[i].hc1_vc0, 15, 8)
-			| FLD_VAL(v_coef[i].hc2_vc1, 23, 16)
-			| FLD_VAL(v_coef[i].hc3_vc2, 31, 24);
-
-		if (color_comp == DISPC_COLOR_COMPONENT_RGB_Y) {
-			_dispc_write_firh_reg(plane, i, h);
-			_dispc_write_firhv_reg(plane, i, hv);
-		} else {
-			_dispc_write_firh2_reg(plane, i, h);
-			_dispc_write_firhv2_reg(plane, i, hv);
-		}
-	}
+	h_regs = &dispc_coef_regs[h_coef];
+	v_regs = &dispc_coef_regs[v_coef];
 
-	if (five_taps) {
+	if (sh->h_coef[comp] != h_coef || sh->hv_coef[comp] != v_coef) {
 		for (i = 0; i < 8; i++) {
-			u32 v;
-			v = FLD_VAL(v_coef[i].hc0_vc00, 7, 0)
-				| FLD_VAL(v_coef[i].hc4_vc22, 15, 8);
-			if (color_comp == DISPC_COLOR_COMPONENT_RGB_Y)
-				_dispc_write_firv_reg(plane, i, v);
-			else
-				_dispc_write_firv2_reg(plane, i, v);
+			u32 hv = h_regs->hv_h[i] | v_regs->hv_v[i];
+
+			if (comp == 0) {
+				_dispc_write_firh_reg(plane, i, h_regs->h[i]);
+				_dispc_write_firhv_reg(plane, i, hv);
+			} else {
+				_dispc_write_firh2_reg(plane, i, h_regs->h[i]);
+				_dispc_write_firhv2_reg(plane, i, hv);
+			}
 		}
+		sh->h_coef[comp] = h_coef;
+		sh->hv_coef[comp] = v_coef;
+	} else {
+		dispc.stats.skipped += 16;
 	}
+
+	if (!five_taps)
+		return;
+
+	if (sh->v_coef[comp] == v_coef) {
+		dispc.stats.skipped += 8;
+		return;
+	}
+
+	for (i = 0; i < 8; i++) {
+		if (comp == 0)
+			_dispc_write_firv_reg(plane, i, v_regs->v[i]);
+		else
+			_dispc_write_firv2_reg(plane, i, v_regs->v[i]);
+	}
+	sh->v_coef[comp] = v_coef;
 }
 
 void _dispc_setup_color_conv_coef(enum omap_plane plane,
 	const struct omap_dss_cconv_coefs *ct)
 {
+	struct dispc_plane_shadow *sh = &dispc.shadow[plane];
+
 	BUG_ON(plane < OMAP_DSS_VIDEO1 || plane > OMAP_DSS_VIDEO3);
 
+	if (sh->cconv_valid && !memcmp(&sh->cconv, ct, sizeof(*ct))) {
+		dispc.stats.skipped += 6;
+		return;
+	}
+	sh->cconv = *ct;
+	sh->cconv_valid = true;
+
 #define CVAL(x, y) (FLD_VAL(x, 26, 16) | FLD_VAL(y, 10, 0))
 
 	dispc_write_reg(DISPC_OVL_CONV_COEF(plane, 0), CVAL(ct->rcr, ct->ry));
@@ -1506,6 +1606,8 @@ static void _dispc_set_fir(enum omap_plane plane,
 				int hinc, int vinc,
 				enum omap_color_component color_comp)
 {
+	struct dispc_plane_shadow *sh = &dispc.shadow[plane];
+	int comp = color_comp == DISPC_COLOR_COMPONENT_RGB_Y ? 0 : 1;
 	u32 val;
 
 	if (color_comp == DISPC_COLOR_COMPONENT_RGB_Y) {
@@ -1517,12 +1619,21 @@ static void _dispc_set_fir(enum omap_plane plane,
 					&vinc_start, &vinc_end);
 		val = FLD_VAL(vinc, vinc_start, vinc_end) |
 				FLD_VAL(hinc, hinc_start, hinc_end);
-
-		dispc_write_reg(DISPC_OVL_FIR(plane), val);
 	} else {
 		val = FLD_VAL(vinc, 28, 16) | FLD_VAL(hinc, 12, 0);
-		dispc_write_reg(DISPC_OVL_FIR2(plane), val);
 	}
+
+	if (sh->fir_valid[comp] && sh->fir[comp] == val) {
+		dispc.stats.skipped++;
+		return;
+	}
+	sh->fir[comp] = val;
+	sh->fir_valid[comp] = true;
+
+	if (comp == 0)
+		dispc_write_reg(DISPC_OVL_FIR(plane), val);
+	else
+		dispc_write_reg(DISPC_OVL_FIR2(plane), val);
 }
 
 static void _dispc_set_vid_accu0(enum omap_plane plane, int haccu, int vaccu)
@@ -1576,16 +1687,13 @@ static void _dispc_set_scale_param(enum omap_plane plane,
 		enum omap_color_component color_comp)
 {
 	int fir_hinc, fir_vinc;
-	int hscaleup, vscaleup;
-
-	hscaleup = orig_width <= out_width;
-	vscaleup = orig_height <= out_height;
-
-	_dispc_set_scale_coef(plane, hscaleup, vscaleup, five_taps, color_comp);
 
 	fir_hinc = 1024 * orig_width / out_width;
 	fir_vinc = 1024 * orig_height / out_height;
 
+	/* the coefficient set is picked by the quantized ratio */
+	_dispc_set_scale_coef(plane, fir_hinc, fir_vinc, five_taps, color_comp);
+
 	_dispc_set_fir(plane, fir_hinc, fir_vinc, color_comp);
 }
 
@@ -1848,6 +1956,11 @@ static int color_mode_to_bpp(enum omap_color_mode color_mode)
 	}
 }
 
+int dispc_get_color_mode_bpp(enum omap_color_mode color_mode)
+{
+	return color_mode_to_bpp(color_mode);
+}
+
 static s32 pixinc(int pixels, u8 ps)
 {
 	if (pixels == 1)
@@ -3573,6 +3686,23 @@ void dispc_dump_irqs(struct seq_file *s)
 }
 #endif
 
+void dispc_dump_writes(struct seq_file *s)
+{
+	struct dispc_write_stats stats;
+
+	stats = dispc.stats;
+	memset(&dispc.stats, 0, sizeof(dispc.stats));
+	dispc.stats.last_reset = jiffies;
+
+	seq_printf(s, "period %u ms\n",
+			jiffies_to_msecs(jiffies - stats.last_reset));
+	seq_printf(s, "frames %u\n", stats.frames);
+	seq_printf(s, "writes %u\n", stats.writes);
+	seq_printf(s, "skipped %u\n", stats.skipped);
+	if (stats.frames)
+		seq_printf(s, "writes/frame %u\n", stats.writes / stats.frames);
+}
+
 void dispc_dump_regs(struct seq_file *s)
 {
 	int i, o;
@@ -4111,6 +4241,7 @@ static void dispc_error_worker(struct work_struct *work)
 
 	if (errors & DISPC_IRQ_GFX_FIFO_UNDERFLOW) {
 		DSSERR("GFX_FIFO_UNDERFLOW, disabling GFX\n");
+		dss_bw_underflow(OMAP_DSS_GFX);
 		for (i = 0; i < omap_dss_get_num_overlays(); ++i) {
 			struct omap_overlay *ovl;
 			ovl = omap_dss_get_overlay(i);
@@ -4129,6 +4260,7 @@ static void dispc_error_worker(struct work_struct *work)
 
 	if (errors & DISPC_IRQ_VID1_FIFO_UNDERFLOW) {
 		DSSERR("VID1_FIFO_UNDERFLOW, disabling VID1\n");
+		dss_bw_underflow(OMAP_DSS_VIDEO1);
 		for (i = 0; i < omap_dss_get_num_overlays(); ++i) {
 			struct omap_overlay *ovl;
 			ovl = omap_dss_get_overlay(i);
@@ -4147,6 +4279,7 @@ static void dispc_error_worker(struct work_struct *work)
 
 	if (errors & DISPC_IRQ_VID2_FIFO_UNDERFLOW) {
 		DSSERR("VID2_FIFO_UNDERFLOW, disabling VID2\n");
+		dss_bw_underflow(OMAP_DSS_VIDEO2);
 		for (i = 0; i < omap_dss_get_num_overlays(); ++i) {
 			struct omap_overlay *ovl;
 			ovl = omap_dss_get_overlay(i);
@@ -4165,6 +4298,7 @@ static void dispc_error_worker(struct work_struct *work)
 
 	if (errors & DISPC_IRQ_VID3_FIFO_UNDERFLOW) {
 		DSSERR("VID3_FIFO_UNDERFLOW, disabling VID3\n");
+		dss_bw_underflow(OMAP_DSS_VIDEO3);
 		for (i = 0; i < omap_dss_get_num_overlays(); ++i) {
 			struct omap_overlay *ovl;
 			ovl = omap_dss_get_overlay(i);
@@ -4495,6 +4629,9 @@ static void _omap_dispc_initial_config(void)
 
 	if (dss_has_feature(FEAT_GLOBAL_MFLAG))
 		dispc_write_reg(DISPC_GLOBAL_MFLAG, 2);
+
+	dispc_init_scaling_coefs();
+	dispc_invalidate_shadow();
 }
 
 /* DISPC HW IP initialisation */
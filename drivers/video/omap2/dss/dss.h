@@ -242,6 +242,21 @@ int dss_setup_partial_planes(struct omap_dss_device *dssdev,
 				bool enlarge_update_area);
 void dss_start_update(struct omap_dss_device *dssdev);
 
+/* bandwidth */
+u32 dss_bw_plane_tput(struct omap_dss_device *dssdev, u16 width, u16 height,
+		enum omap_color_mode color_mode, u8 rotation,
+		enum omap_dss_rotation_type rotation_type);
+void dss_bw_set_plane(enum omap_plane plane, enum omap_channel channel,
+		u32 tput);
+void dss_bw_set_channel(enum omap_channel channel, bool enable);
+void dss_bw_get_overlay_fifo_thresholds(enum omap_plane plane,
+		u32 fifo_size, u32 tput, enum omap_burst_size *burst_size,
+		u32 *fifo_low, u32 *fifo_high);
+void dss_bw_commit(void);
+void dss_bw_underflow(enum omap_plane plane);
+void dss_bw_exit(void);
+void dss_bw_dump(struct seq_file *s);
+
 /* overlay */
 void dss_init_overlays(struct platform_device *pdev);
 void dss_uninit_overlays(struct platform_device *pdev);
@@ -425,6 +440,7 @@ int dispc_init_platform_driver(void);
 void dispc_uninit_platform_driver(void);
 void dispc_dump_clocks(struct seq_file *s);
 void dispc_dump_irqs(struct seq_file *s);
+void dispc_dump_writes(struct seq_file *s);
 void dispc_dump_regs(struct seq_file *s);
 void dispc_irq_handler(void);
 void dispc_fake_vsync_irq(void);
@@ -443,6 +459,7 @@ void dispc_enable_fifohandcheck(enum omap_channel channel, bool enable);
 void dispc_set_lcd_size(enum omap_channel channel, u16 width, u16 height);
 void dispc_set_digit_size(u16 width, u16 height);
 u32 dispc_get_plane_fifo_size(enum omap_plane plane);
+int dispc_get_color_mode_bpp(enum omap_color_mode color_mode);
 void dispc_setup_plane_fifo(enum omap_plane plane, u32 low, u32 high);
 void dispc_enable_fifomerge(bool enable);
 void dispc_set_burst_size(enum omap_plane plane,
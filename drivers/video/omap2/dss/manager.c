@@ -2231,10 +2231,11 @@ skip_mgr:
 	 */
 	use_fifomerge = false;
 
-	/* Configure overlay fifos */
+	/* Configure overlay fifos and account their fetch bandwidth */
 	for (i = 0; i < omap_dss_get_num_overlays(); ++i) {
 		struct omap_dss_device *dssdev;
 		u32 size;
+		u32 tput;
 
 		ovl = omap_dss_get_overlay(i);
 
@@ -2243,13 +2244,20 @@ skip_mgr:
 
 		oc = &dss_cache.overlay_cache[ovl->id];
 
-		if (!oc->enabled)
+		if (!oc->enabled) {
+			dss_bw_set_plane(ovl->id, oc->channel, 0);
 			continue;
+		}
 
 		dssdev = ovl->manager->device;
 		if (!dssdev)
 			continue;
 
+		tput = dss_bw_plane_tput(dssdev, oc->width, oc->height,
+				oc->color_mode, oc->rotation,
+				oc->rotation_type);
+		dss_bw_set_plane(ovl->id, oc->channel, tput);
+
 		size = dispc_get_plane_fifo_size(ovl->id);
 		if (use_fifomerge)
 			size *= 3;
@@ -2260,8 +2268,8 @@ skip_mgr:
 		case OMAP_DISPLAY_TYPE_SDI:
 		case OMAP_DISPLAY_TYPE_VENC:
 		case OMAP_DISPLAY_TYPE_HDMI:
-			default_get_overlay_fifo_thresholds(ovl->id, size,
-					&oc->burst_size, &oc->fifo_low,
+			dss_bw_get_overlay_fifo_thresholds(ovl->id, size,
+					tput, &oc->burst_size, &oc->fifo_low,
 					&oc->fifo_high);
 			break;
 #ifdef CONFIG_OMAP2_DSS_DSI
@@ -2295,6 +2303,13 @@ done:
 
 	dispc_runtime_put();
 
+	/*
+	 * The new configuration only takes effect at the next VSYNC, which
+	 * leaves plenty of time to raise the constraint if needed. A lower
+	 * constraint is held back until that VSYNC.
+	 */
+	dss_bw_commit();
+
 	return r;
 }
 
@@ -2516,6 +2531,7 @@ static void omap_dss_mgr_get_info(struct omap_overlay_manager *mgr,
 static int dss_mgr_enable(struct omap_overlay_manager *mgr)
 {
 	mgr->info.gamma_table_dirty = true;  /* trigger reload of table */
+	dss_bw_set_channel(mgr->id, true);
 	dispc_enable_channel(mgr->id, mgr->device->type, 1);
 	return 0;
 }
@@ -2523,6 +2539,7 @@ static int dss_mgr_enable(struct omap_overlay_manager *mgr)
 static int dss_mgr_disable(struct omap_overlay_manager *mgr)
 {
 	dispc_enable_channel(mgr->id, mgr->device->type, 0);
+	dss_bw_set_channel(mgr->id, false);
 	return 0;
 }
 
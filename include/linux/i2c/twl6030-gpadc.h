@@ -148,5 +148,7 @@ struct twl6030_gpadc_user_parms {
 };
 
 int twl6030_gpadc_conversion(struct twl6030_gpadc_request *conv);
+int twl6030_gpadc_conversion_cached(struct twl6030_gpadc_request *conv,
+				    unsigned int max_age_ms);
 
 #endif
@@ -46,6 +46,7 @@ struct duty_cycle {
 void omap4_duty_pcb_section_reg(struct pcb_section *pcb_sect, int sect_size);
 void omap4_duty_turbo_sprint_pcb_section_reg(struct pcb_section *pcb_sect, int sect_size);
 int omap4_duty_pcb_register(struct pcb_sens *tpcb);
+void omap4_duty_pcb_changed(void);
 
 #ifdef CONFIG_OMAP4_DUTY_CYCLE_GOVERNOR
 int omap4_duty_cycle_register(struct duty_cycle *tduty);
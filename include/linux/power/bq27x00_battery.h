@@ -16,11 +16,17 @@ struct bq27000_platform_data {
 	int (*read)(struct device *dev, unsigned int);
 };
 
-/*
- * Optional board specific thermistor translation hook.
+/**
+ * struct bq27x00_platform_data - Platform data for i2c bq27x00 devices
+ * @translate_temp: Optional board specific thermistor translation hook.
+ * @soc_int_gpio: gpio wired to SOC_INT, -1 if not connected. When present
+ *	the driver refreshes on state of charge changes instead of polling.
+ * @bat_low_gpio: gpio wired to BAT_LOW, -1 if not connected.
  */
 struct bq27x00_platform_data {
 	int (*translate_temp)(int temperature);
+	int soc_int_gpio;
+	int bat_low_gpio;
 };
 
 #endif
@@ -147,6 +147,7 @@ enum rproc_constraint {
 };
 
 struct rproc;
+struct rproc_traffic;
 
 struct rproc_ops {
 	int (*start)(struct rproc *rproc, u64 bootaddr);
@@ -258,6 +259,13 @@ enum rproc_event {
  * @secure_mode: flag to dictate whether to enable secure loading
  * @secure_ok: restart status flag to be looked up upon the event's completion
  * @secure_reset: flag to uninstall the firewalls
+ * @fw_cache: last successfully booted BIOS image without its FW_TEXT sections
+ * @fw_cache_len: length of @fw_cache
+ * @fw_cache_crc: crc32 of @fw_cache, checked before every boot from it
+ * @fw_text_resident: the FW_TEXT sections left out of @fw_cache are still in
+ *                    place in the carveouts from the last clean boot
+ * @boot_work: boots the remote processor from @fw_cache
+ * @traffic: rpmsg traffic history driving autosuspend and pre-wake
  */
 struct rproc {
 	struct list_head next;
@@ -288,6 +296,7 @@ struct rproc {
 	bool force_suspend;
 	bool need_resume;
 	struct mutex pm_lock;
+	struct rproc_traffic *traffic;
 #endif
 	struct pm_qos_request_list *qos_request;
 	void *secure_ttb;
@@ -299,6 +308,11 @@ struct rproc {
 	bool halt_on_crash;
 	char *header;
 	int header_len;
+	void *fw_cache;
+	size_t fw_cache_len;
+	u32 fw_cache_crc;
+	bool fw_text_resident;
+	struct work_struct boot_work;
 };
 
 int rproc_set_secure(const char *, bool);
@@ -311,6 +325,7 @@ int rproc_register(struct device *, const char *, const struct rproc_ops *,
 		unsigned int timeout);
 int rproc_unregister(const char *);
 void rproc_last_busy(struct rproc *);
+void rproc_traffic(struct rproc *, u32);
 int rproc_da_to_pa(struct rproc *, u64, phys_addr_t *);
 int rproc_pa_to_da(struct rproc *, phys_addr_t, u64 *);
 #ifdef CONFIG_REMOTE_PROC_AUTOSUSPEND
@@ -28,6 +28,7 @@
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/stat.h>
+#include <linux/string.h>
 #include <linux/types.h>
 #include <linux/wait.h>
 
@@ -414,6 +415,11 @@ struct rmi_function_handler {
  * @irq_pos: The position in the irq bitfield this function holds
  * @irq_mask: For convience, can be used to mask IRQ bits off during ATTN
  * interrupt handling.
+ * @attn_size: Number of data registers, starting at fd.data_base_addr, that
+ * the function reads on every attention.  The sensor driver folds these into
+ * its single interrupt status read when they sit on the same page.
+ * @attn_data: Those registers as fetched with the interrupt status, or NULL.
+ * Only valid inside the attention() callback; see rmi_read_data_block().
  * @data: Private data pointer
  *
  * @list: Used to create a list of function containers.
@@ -430,6 +436,9 @@ struct rmi_function_container {
 	int irq_pos;
 	u8 *irq_mask;
 
+	int attn_size;
+	u8 *attn_data;
+
 	void *data;
 
 	struct list_head list;
@@ -589,6 +598,31 @@ static inline int rmi_read_block(struct rmi_device *d, u16 addr, u8 *buf,
 	return d->phys->read_block(d->phys, addr, buf, len);
 }
 
+/**
+ * rmi_read_data_block - read function data registers from attention()
+ * @fc: The function container doing the read
+ * @addr: The start address to read from
+ * @buf: The read buffer
+ * @len: Length of the read buffer
+ *
+ * Same as rmi_read_block(), except that registers already fetched together
+ * with the interrupt status are copied from fc->attn_data instead of costing
+ * another bus transfer.
+ */
+static inline int rmi_read_data_block(struct rmi_function_container *fc,
+				      u16 addr, u8 *buf, int len)
+{
+	u16 base = fc->fd.data_base_addr;
+
+	if (fc->attn_data && addr >= base &&
+	    addr + len <= base + fc->attn_size) {
+		memcpy(buf, fc->attn_data + (addr - base), len);
+		return len;
+	}
+
+	return rmi_read_block(fc->rmi_dev, addr, buf, len);
+}
+
 /**
  * rmi_write - write a single byte
  * @d: Pointer to an RMI device
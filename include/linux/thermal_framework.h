@@ -113,6 +113,11 @@ struct thermal_dev {
 extern int thermal_request_temp(struct thermal_dev *tdev);
 extern int thermal_lookup_temp(const char *domain_name);
 extern int thermal_sensor_set_temp(struct thermal_dev *tdev);
+extern int thermal_governor_set_window(struct thermal_dev *gov,
+				       int low, int high);
+extern int thermal_adaptive_rate(int temp, int prev_temp,
+				 unsigned int elapsed, int low, int high,
+				 int min_rate, int max_rate);
 
 /* Registration and unregistration calls for the thermal devices */
 extern int thermal_sensor_dev_register(struct thermal_dev *tdev);
@@ -15,10 +15,13 @@
 #define DEBUG
 
 #include <linux/file.h>
+#include <linux/hash.h>
 #include <linux/inetdevice.h>
 #include <linux/module.h>
 #include <linux/netfilter/x_tables.h>
 #include <linux/netfilter/xt_qtaguid.h>
+#include <linux/rculist.h>
+#include <linux/seqlock.h>
 #include <linux/skbuff.h>
 #include <linux/workqueue.h>
 #include <net/addrconf.h>
@@ -135,6 +138,12 @@ static struct proc_dir_entry *iface_stat_fmt_procfile;
  * Notice how sock_tag_list_lock is held sometimes when uid_tag_data_tree_lock
  * is acquired.
  *
+ * The per packet matching does not take any of the global locks: it finds
+ * the iface_stat, sock_tag, tag_stat and tag_counter_set through the RCU
+ * hashes below, and bills the per cpu slot of the tag_stat counters.
+ * Writers still serialize on the locks above, and also keep the hashes
+ * in sync with the trees.
+ *
  * Call tree with all lock holders as of 2012-04-27:
  *
  * iface_stat_fmt_proc_read()
@@ -187,17 +196,21 @@ static struct proc_dir_entry *iface_stat_fmt_procfile;
  *     iface_stat_list_lock
  *
  * qtaguid_mt()
+ *   iface_stat_update_from_skb()
+ *     rcu_read_lock
+ *       (iface_stat_dev_hash)
  *   account_for_uid()
  *     if_tag_stat_update()
- *       get_sock_stat()
- *         sock_tag_list_lock
- *       struct iface_stat->tag_stat_list_lock
- *         tag_stat_update()
- *           get_active_counter_set()
- *             tag_counter_set_list_lock
+ *       rcu_read_lock
+ *         (iface_stat_dev_hash)
+ *         get_sock_tag_rcu()
+ *           (sock_tag_hash)
+ *         (struct iface_stat->tag_stat_hash)
+ *         get_or_create_if_tag_stat()
+ *           struct iface_stat->tag_stat_list_lock
  *         tag_stat_update()
  *           get_active_counter_set()
- *             tag_counter_set_list_lock
+ *             (tag_counter_set_hash)
  *
  *
  * qtaguid_ctrl_parse()
@@ -225,11 +238,28 @@ static struct proc_dir_entry *iface_stat_fmt_procfile;
 static LIST_HEAD(iface_stat_list);
 static DEFINE_SPINLOCK(iface_stat_list_lock);
 
+/*
+ * Active iface_stat entries indexed by their net_device.
+ * Writers hold iface_stat_list_lock.
+ */
+#define IFACE_STAT_DEV_HASH_BITS 4
+static struct hlist_head iface_stat_dev_hash[1 << IFACE_STAT_DEV_HASH_BITS];
+
 static struct rb_root sock_tag_tree = RB_ROOT;
 static DEFINE_SPINLOCK(sock_tag_list_lock);
+/*
+ * Same entries as sock_tag_tree, for the matching.
+ * Writers hold sock_tag_list_lock, and retag in place within sock_tag_seq.
+ */
+#define SOCK_TAG_HASH_BITS 8
+static struct hlist_head sock_tag_hash[1 << SOCK_TAG_HASH_BITS];
+static seqcount_t sock_tag_seq = SEQCNT_ZERO;
 
 static struct rb_root tag_counter_set_tree = RB_ROOT;
 static DEFINE_SPINLOCK(tag_counter_set_list_lock);
+/* Same entries as tag_counter_set_tree. Writers hold its lock. */
+#define TAG_COUNTER_SET_HASH_BITS 6
+static struct hlist_head tag_counter_set_hash[1 << TAG_COUNTER_SET_HASH_BITS];
 
 static struct rb_root uid_tag_data_tree = RB_ROOT;
 static DEFINE_SPINLOCK(uid_tag_data_tree_lock);
@@ -419,6 +449,18 @@ static void sock_tag_tree_insert(struct sock_tag *data, struct rb_root *root)
 	rb_insert_color(&data->sock_node, root);
 }
 
+static struct hlist_head *sock_tag_hash_head(const struct sock *sk)
+{
+	return &sock_tag_hash[hash_ptr((void *)sk, SOCK_TAG_HASH_BITS)];
+}
+
+/* Caller must hold sock_tag_list_lock */
+static void sock_tag_hash_add(struct sock_tag *st_entry)
+{
+	hlist_add_head_rcu(&st_entry->hash_node,
+			   sock_tag_hash_head(st_entry->sk));
+}
+
 static void sock_tag_tree_erase(struct rb_root *st_to_free_tree)
 {
 	struct rb_node *node;
@@ -435,7 +477,8 @@ static void sock_tag_tree_erase(struct rb_root *st_to_free_tree)
 			 get_uid_from_tag(st_entry->tag));
 		rb_erase(&st_entry->sock_node, st_to_free_tree);
 		sockfd_put(st_entry->socket);
-		kfree(st_entry);
+		/* The matching might still be looking at it. */
+		kfree_rcu(st_entry, rcu);
 	}
 }
 
@@ -746,21 +789,31 @@ static int read_proc_bool(char *page, char **start, off_t off,
 	return len;
 }
 
+static struct hlist_head *tag_counter_set_hash_head(tag_t tag)
+{
+	return &tag_counter_set_hash[hash_64(tag, TAG_COUNTER_SET_HASH_BITS)];
+}
+
 static int get_active_counter_set(tag_t tag)
 {
 	int active_set = 0;
 	struct tag_counter_set *tcs;
+	struct hlist_node *pos;
 
 	MT_DEBUG("qtaguid: get_active_counter_set(tag=0x%llx)"
 		 " (uid=%u)\n",
 		 tag, get_uid_from_tag(tag));
 	/* For now we only handle UID tags for active sets */
 	tag = get_utag_from_tag(tag);
-	spin_lock_bh(&tag_counter_set_list_lock);
-	tcs = tag_counter_set_tree_search(&tag_counter_set_tree, tag);
-	if (tcs)
-		active_set = tcs->active_set;
-	spin_unlock_bh(&tag_counter_set_list_lock);
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(tcs, pos, tag_counter_set_hash_head(tag),
+				 hash_node) {
+		if (tcs->tn.tag == tag) {
+			active_set = ACCESS_ONCE(tcs->active_set);
+			break;
+		}
+	}
+	rcu_read_unlock();
 	return active_set;
 }
 
@@ -788,6 +841,37 @@ done:
 	return iface_entry;
 }
 
+static struct hlist_head *iface_stat_dev_hash_head(
+	const struct net_device *net_dev)
+{
+	return &iface_stat_dev_hash[hash_ptr((void *)net_dev,
+					     IFACE_STAT_DEV_HASH_BITS)];
+}
+
+/*
+ * Find the entry for tracking the specified device from the matching.
+ * Caller must be in an RCU read-side section.
+ * Inactive entries are not in the dev hash, but it is ok to process data
+ * for them, so fall back to looking them up by name.
+ * Entries are never freed, so the result stays valid past the section.
+ */
+static struct iface_stat *get_iface_entry_rcu(const struct net_device *net_dev)
+{
+	struct iface_stat *iface_entry;
+	struct hlist_node *pos;
+
+	hlist_for_each_entry_rcu(iface_entry, pos,
+				 iface_stat_dev_hash_head(net_dev), dev_node) {
+		if (ACCESS_ONCE(iface_entry->net_dev) == net_dev)
+			return iface_entry;
+	}
+	list_for_each_entry_rcu(iface_entry, &iface_stat_list, list) {
+		if (!strcmp(net_dev->name, iface_entry->ifname))
+			return iface_entry;
+	}
+	return NULL;
+}
+
 static int iface_stat_fmt_proc_read(char *page, char **num_items_returned,
 				    off_t items_to_skip, int char_count,
 				    int *eof, void *data)
@@ -837,6 +921,8 @@ static int iface_stat_fmt_proc_read(char *page, char **num_items_returned,
 	 */
 	spin_lock_bh(&iface_stat_list_lock);
 	list_for_each_entry(iface_entry, &iface_stat_list, list) {
+		struct byte_packet_counters totals_via_skb[IFS_MAX_DIRECTIONS];
+
 		if (item_index++ < items_to_skip)
 			continue;
 
@@ -866,15 +952,16 @@ static int iface_stat_fmt_proc_read(char *page, char **num_items_returned,
 				stats->tx_bytes, stats->tx_packets
 				);
 		} else {
+			iface_stat_fold_skb_totals(iface_entry, totals_via_skb);
 			len = snprintf(
 				outp, char_count,
 				"%s "
 				"%llu %llu %llu %llu\n",
 				iface_entry->ifname,
-				iface_entry->totals_via_skb[IFS_RX].bytes,
-				iface_entry->totals_via_skb[IFS_RX].packets,
-				iface_entry->totals_via_skb[IFS_TX].bytes,
-				iface_entry->totals_via_skb[IFS_TX].packets
+				totals_via_skb[IFS_RX].bytes,
+				totals_via_skb[IFS_RX].packets,
+				totals_via_skb[IFS_TX].bytes,
+				totals_via_skb[IFS_TX].packets
 				);
 		}
 		if (len >= char_count) {
@@ -932,14 +1019,22 @@ static void iface_create_proc_worker(struct work_struct *work)
 /*
  * Will set the entry's active state, and
  * update the net_dev accordingly also.
+ * Caller must hold iface_stat_list_lock.
+ * Entries are never freed, so they can be moved between iface_stat_dev_hash
+ * chains without waiting for the matching: a reader that gets taken along
+ * only misses, and falls back to the lookup by name.
  */
 static void _iface_stat_set_active(struct iface_stat *entry,
 				   struct net_device *net_dev,
 				   bool activate)
 {
+	if (!hlist_unhashed(&entry->dev_node))
+		hlist_del_init_rcu(&entry->dev_node);
 	if (activate) {
 		entry->net_dev = net_dev;
 		entry->active = true;
+		hlist_add_head_rcu(&entry->dev_node,
+				   iface_stat_dev_hash_head(net_dev));
 		IF_DEBUG("qtaguid: %s(%s): "
 			 "enable tracking. rfcnt=%d\n", __func__,
 			 entry->ifname,
@@ -960,6 +1055,7 @@ static struct iface_stat *iface_alloc(struct net_device *net_dev)
 {
 	struct iface_stat *new_iface;
 	struct iface_stat_work *isw;
+	int i;
 
 	new_iface = kzalloc(sizeof(*new_iface), GFP_ATOMIC);
 	if (new_iface == NULL) {
@@ -974,9 +1070,19 @@ static struct iface_stat *iface_alloc(struct net_device *net_dev)
 		kfree(new_iface);
 		return NULL;
 	}
+	new_iface->cpu_skb_totals = kcalloc(nr_cpu_ids,
+					    sizeof(*new_iface->cpu_skb_totals),
+					    GFP_ATOMIC);
+	if (new_iface->cpu_skb_totals == NULL) {
+		pr_err("qtaguid: iface_stat: create(%s): "
+		       "skb totals alloc failed\n", net_dev->name);
+		goto err_free_name;
+	}
 	spin_lock_init(&new_iface->tag_stat_list_lock);
 	new_iface->tag_stat_tree = RB_ROOT;
-	_iface_stat_set_active(new_iface, net_dev, true);
+	for (i = 0; i < ARRAY_SIZE(new_iface->tag_stat_hash); i++)
+		INIT_HLIST_HEAD(&new_iface->tag_stat_hash[i]);
+	INIT_HLIST_NODE(&new_iface->dev_node);
 
 	/*
 	 * ipv6 notifier chains are atomic :(
@@ -986,16 +1092,22 @@ static struct iface_stat *iface_alloc(struct net_device *net_dev)
 	if (!isw) {
 		pr_err("qtaguid: iface_stat: create(%s): "
 		       "work alloc failed\n", new_iface->ifname);
-		_iface_stat_set_active(new_iface, net_dev, false);
-		kfree(new_iface->ifname);
-		kfree(new_iface);
-		return NULL;
+		goto err_free_totals;
 	}
+	/* Only publish to the matching once nothing can fail anymore. */
+	_iface_stat_set_active(new_iface, net_dev, true);
 	isw->iface_entry = new_iface;
 	INIT_WORK(&isw->iface_work, iface_create_proc_worker);
 	schedule_work(&isw->iface_work);
-	list_add(&new_iface->list, &iface_stat_list);
+	list_add_rcu(&new_iface->list, &iface_stat_list);
 	return new_iface;
+
+err_free_totals:
+	kfree(new_iface->cpu_skb_totals);
+err_free_name:
+	kfree(new_iface->ifname);
+	kfree(new_iface);
+	return NULL;
 }
 
 static void iface_check_stats_reset_and_adjust(struct net_device *net_dev,
@@ -1186,16 +1298,35 @@ static struct sock_tag *get_sock_stat_nl(const struct sock *sk)
 	return sock_tag_tree_search(&sock_tag_tree, sk);
 }
 
-static struct sock_tag *get_sock_stat(const struct sock *sk)
+/*
+ * Lookup from the matching, without sock_tag_list_lock.
+ * The sock_tag can be retagged in place by ctrl_cmd_tag(), so only its tag
+ * is returned, as read within sock_tag_seq.
+ */
+static bool get_sock_tag_rcu(const struct sock *sk, tag_t *tag)
 {
 	struct sock_tag *sock_tag_entry;
-	MT_DEBUG("qtaguid: get_sock_stat(sk=%p)\n", sk);
+	struct hlist_node *pos;
+	unsigned int seq;
+	bool found = false;
+
+	MT_DEBUG("qtaguid: get_sock_tag_rcu(sk=%p)\n", sk);
 	if (!sk)
-		return NULL;
-	spin_lock_bh(&sock_tag_list_lock);
-	sock_tag_entry = get_sock_stat_nl(sk);
-	spin_unlock_bh(&sock_tag_list_lock);
-	return sock_tag_entry;
+		return false;
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(sock_tag_entry, pos, sock_tag_hash_head(sk),
+				 hash_node) {
+		if (sock_tag_entry->sk != sk)
+			continue;
+		do {
+			seq = read_seqcount_begin(&sock_tag_seq);
+			*tag = sock_tag_entry->tag;
+		} while (read_seqcount_retry(&sock_tag_seq, seq));
+		found = true;
+		break;
+	}
+	rcu_read_unlock();
+	return found;
 }
 
 static int ipx_proto(const struct sk_buff *skb,
@@ -1302,6 +1433,7 @@ static void iface_stat_update_from_skb(const struct sk_buff *skb,
 				       struct xt_action_param *par)
 {
 	struct iface_stat *entry;
+	struct iface_stat_cpu *isc;
 	const struct net_device *el_dev;
 	enum ifs_tx_rx direction = par->in ? IFS_RX : IFS_TX;
 	int bytes = skb->len;
@@ -1336,37 +1468,87 @@ static void iface_stat_update_from_skb(const struct sk_buff *skb,
 			 par->family, proto);
 	}
 
-	spin_lock_bh(&iface_stat_list_lock);
-	entry = get_iface_entry(el_dev->name);
+	rcu_read_lock();
+	entry = get_iface_entry_rcu(el_dev);
+	rcu_read_unlock();
 	if (entry == NULL) {
 		IF_DEBUG("qtaguid: iface_stat: %s(%s): not tracked\n",
 			 __func__, el_dev->name);
-		spin_unlock_bh(&iface_stat_list_lock);
 		return;
 	}
 
 	IF_DEBUG("qtaguid: %s(%s): entry=%p\n", __func__,
 		 el_dev->name, entry);
 
-	entry->totals_via_skb[direction].bytes += bytes;
-	entry->totals_via_skb[direction].packets++;
-	spin_unlock_bh(&iface_stat_list_lock);
+	local_bh_disable();
+	isc = &entry->cpu_skb_totals[smp_processor_id()];
+	u64_stats_update_begin(&isc->syncp);
+	isc->totals_via_skb[direction].bytes += bytes;
+	isc->totals_via_skb[direction].packets++;
+	u64_stats_update_end(&isc->syncp);
+	local_bh_enable();
+}
+
+static void tag_stat_cpu_update(struct tag_stat_cpu *tsc, int set,
+				enum ifs_tx_rx direction, int proto, int bytes)
+{
+	u64_stats_update_begin(&tsc->syncp);
+	data_counters_update(&tsc->counters, set, direction, proto, bytes);
+	u64_stats_update_end(&tsc->syncp);
 }
 
 static void tag_stat_update(struct tag_stat *tag_entry,
 			enum ifs_tx_rx direction, int proto, int bytes)
 {
 	int active_set;
+	int cpu;
 	active_set = get_active_counter_set(tag_entry->tn.tag);
 	MT_DEBUG("qtaguid: tag_stat_update(tag=0x%llx (uid=%u) set=%d "
 		 "dir=%d proto=%d bytes=%d)\n",
 		 tag_entry->tn.tag, get_uid_from_tag(tag_entry->tn.tag),
 		 active_set, direction, proto, bytes);
-	data_counters_update(&tag_entry->counters, active_set, direction,
-			     proto, bytes);
-	if (tag_entry->parent_counters)
-		data_counters_update(tag_entry->parent_counters, active_set,
-				     direction, proto, bytes);
+	/*
+	 * The same cpu slot can be billed from process context (LOCAL_OUT)
+	 * and from the rx softirq.
+	 */
+	local_bh_disable();
+	cpu = smp_processor_id();
+	tag_stat_cpu_update(&tag_entry->cpu_stats[cpu], active_set,
+			    direction, proto, bytes);
+	if (tag_entry->parent)
+		tag_stat_cpu_update(&tag_entry->parent->cpu_stats[cpu],
+				    active_set, direction, proto, bytes);
+	local_bh_enable();
+}
+
+static struct hlist_head *tag_stat_hash_head(struct iface_stat *iface_entry,
+					     tag_t tag)
+{
+	return &iface_entry->tag_stat_hash[hash_64(tag, TAG_STAT_HASH_BITS)];
+}
+
+/* Caller must be in an RCU read-side section. */
+static struct tag_stat *tag_stat_hash_search(struct iface_stat *iface_entry,
+					     tag_t tag)
+{
+	struct tag_stat *ts_entry;
+	struct hlist_node *pos;
+
+	hlist_for_each_entry_rcu(ts_entry, pos,
+				 tag_stat_hash_head(iface_entry, tag),
+				 hash_node) {
+		if (ts_entry->tn.tag == tag)
+			return ts_entry;
+	}
+	return NULL;
+}
+
+static void tag_stat_free_rcu(struct rcu_head *head)
+{
+	struct tag_stat *ts_entry = container_of(head, struct tag_stat, rcu);
+
+	kfree(ts_entry->cpu_stats);
+	kfree(ts_entry);
 }
 
 /*
@@ -1375,7 +1557,8 @@ static void tag_stat_update(struct tag_stat *tag_entry,
  * iface_entry->tag_stat_list_lock should be held.
  */
 static struct tag_stat *create_if_tag_stat(struct iface_stat *iface_entry,
-					   tag_t tag)
+					   tag_t tag,
+					   struct tag_stat *parent)
 {
 	struct tag_stat *new_tag_stat_entry = NULL;
 	IF_DEBUG("qtaguid: iface_stat: %s(): ife=%p tag=0x%llx"
@@ -1386,103 +1569,110 @@ static struct tag_stat *create_if_tag_stat(struct iface_stat *iface_entry,
 		pr_err("qtaguid: iface_stat: tag stat alloc failed\n");
 		goto done;
 	}
+	new_tag_stat_entry->cpu_stats = kcalloc(
+		nr_cpu_ids, sizeof(*new_tag_stat_entry->cpu_stats),
+		GFP_ATOMIC);
+	if (!new_tag_stat_entry->cpu_stats) {
+		pr_err("qtaguid: iface_stat: tag stat counters alloc failed\n");
+		kfree(new_tag_stat_entry);
+		new_tag_stat_entry = NULL;
+		goto done;
+	}
 	new_tag_stat_entry->tn.tag = tag;
+	new_tag_stat_entry->parent = parent;
 	tag_stat_tree_insert(new_tag_stat_entry, &iface_entry->tag_stat_tree);
+	hlist_add_head_rcu(&new_tag_stat_entry->hash_node,
+			   tag_stat_hash_head(iface_entry, tag));
 done:
 	return new_tag_stat_entry;
 }
 
-static void if_tag_stat_update(const char *ifname, uid_t uid,
+/*
+ * Slow path of if_tag_stat_update(), for the first packet of a tag on the
+ * interface. The trees are searched again under the lock, as another cpu
+ * might have just created the entries.
+ */
+static struct tag_stat *get_or_create_if_tag_stat(
+	struct iface_stat *iface_entry, tag_t tag)
+{
+	struct tag_stat *tag_stat_entry;
+	struct tag_stat *uid_tag_stat_entry = NULL;
+	tag_t uid_tag = get_utag_from_tag(tag);
+
+	spin_lock_bh(&iface_entry->tag_stat_list_lock);
+	tag_stat_entry = tag_stat_tree_search(&iface_entry->tag_stat_tree,
+					      tag);
+	if (tag_stat_entry)
+		goto done;
+
+	if (get_atag_from_tag(tag)) {
+		/* Loop over tag list under this interface for {0,uid_tag} */
+		uid_tag_stat_entry = tag_stat_tree_search(
+			&iface_entry->tag_stat_tree, uid_tag);
+		/*
+		 * No parent counters. So
+		 *  - No {0, uid_tag} stats and no {acc_tag, uid_tag} stats.
+		 */
+		if (!uid_tag_stat_entry)
+			uid_tag_stat_entry = create_if_tag_stat(iface_entry,
+								uid_tag, NULL);
+		if (!uid_tag_stat_entry)
+			goto done;
+	}
+	/* Create the {acct_tag, uid_tag} and hook up parent, if any. */
+	tag_stat_entry = create_if_tag_stat(iface_entry, tag,
+					    uid_tag_stat_entry);
+done:
+	spin_unlock_bh(&iface_entry->tag_stat_list_lock);
+	return tag_stat_entry;
+}
+
+static void if_tag_stat_update(const struct net_device *net_dev, uid_t uid,
 			       const struct sock *sk, enum ifs_tx_rx direction,
 			       int proto, int bytes)
 {
 	struct tag_stat *tag_stat_entry;
 	tag_t tag, acct_tag;
-	tag_t uid_tag;
-	struct data_counters *uid_tag_counters;
-	struct sock_tag *sock_tag_entry;
 	struct iface_stat *iface_entry;
-	struct tag_stat *new_tag_stat = NULL;
 	MT_DEBUG("qtaguid: if_tag_stat_update(ifname=%s "
 		"uid=%u sk=%p dir=%d proto=%d bytes=%d)\n",
-		 ifname, uid, sk, direction, proto, bytes);
-
+		 net_dev->name, uid, sk, direction, proto, bytes);
 
-	iface_entry = get_iface_entry(ifname);
+	rcu_read_lock();
+	iface_entry = get_iface_entry_rcu(net_dev);
 	if (!iface_entry) {
 		pr_err("qtaguid: iface_stat: stat_update() %s not found\n",
-		       ifname);
-		return;
+		       net_dev->name);
+		goto unlock;
 	}
 	/* It is ok to process data when an iface_entry is inactive */
 
 	MT_DEBUG("qtaguid: iface_stat: stat_update() dev=%s entry=%p\n",
-		 ifname, iface_entry);
+		 net_dev->name, iface_entry);
 
 	/*
 	 * Look for a tagged sock.
 	 * It will have an acct_uid.
 	 */
-	sock_tag_entry = get_sock_stat(sk);
-	if (sock_tag_entry) {
-		tag = sock_tag_entry->tag;
-		acct_tag = get_atag_from_tag(tag);
-		uid_tag = get_utag_from_tag(tag);
-	} else {
+	if (!get_sock_tag_rcu(sk, &tag)) {
 		acct_tag = make_atag_from_value(0);
 		tag = combine_atag_with_uid(acct_tag, uid);
-		uid_tag = make_tag_from_uid(uid);
 	}
 	MT_DEBUG("qtaguid: iface_stat: stat_update(): "
 		 " looking for tag=0x%llx (uid=%u) in ife=%p\n",
 		 tag, get_uid_from_tag(tag), iface_entry);
-	/* Loop over tag list under this interface for {acct_tag,uid_tag} */
-	spin_lock_bh(&iface_entry->tag_stat_list_lock);
 
-	tag_stat_entry = tag_stat_tree_search(&iface_entry->tag_stat_tree,
-					      tag);
-	if (tag_stat_entry) {
-		/*
-		 * Updating the {acct_tag, uid_tag} entry handles both stats:
-		 * {0, uid_tag} will also get updated.
-		 */
+	tag_stat_entry = tag_stat_hash_search(iface_entry, tag);
+	if (!tag_stat_entry)
+		tag_stat_entry = get_or_create_if_tag_stat(iface_entry, tag);
+	/*
+	 * Updating the {acct_tag, uid_tag} entry handles both stats:
+	 * {0, uid_tag} will also get updated.
+	 */
+	if (tag_stat_entry)
 		tag_stat_update(tag_stat_entry, direction, proto, bytes);
-		spin_unlock_bh(&iface_entry->tag_stat_list_lock);
-		return;
-	}
-
-	/* Loop over tag list under this interface for {0,uid_tag} */
-	tag_stat_entry = tag_stat_tree_search(&iface_entry->tag_stat_tree,
-					      uid_tag);
-	if (!tag_stat_entry) {
-		/* Here: the base uid_tag did not exist */
-		/*
-		 * No parent counters. So
-		 *  - No {0, uid_tag} stats and no {acc_tag, uid_tag} stats.
-		 */
-		new_tag_stat = create_if_tag_stat(iface_entry, uid_tag);
-		uid_tag_counters = &new_tag_stat->counters;
-	} else {
-		uid_tag_counters = &tag_stat_entry->counters;
-	}
-
-	if (acct_tag) {
-		/* Create the child {acct_tag, uid_tag} and hook up parent. */
-		new_tag_stat = create_if_tag_stat(iface_entry, tag);
-		new_tag_stat->parent_counters = uid_tag_counters;
-	} else {
-		/*
-		 * For new_tag_stat to be still NULL here would require:
-		 *  {0, uid_tag} exists
-		 *  and {acct_tag, uid_tag} doesn't exist
-		 *  AND acct_tag == 0.
-		 * Impossible. This reassures us that new_tag_stat
-		 * below will always be assigned.
-		 */
-		BUG_ON(!new_tag_stat);
-	}
-	tag_stat_update(new_tag_stat, direction, proto, bytes);
-	spin_unlock_bh(&iface_entry->tag_stat_list_lock);
+unlock:
+	rcu_read_unlock();
 }
 
 static int iface_netdev_event_handler(struct notifier_block *nb,
@@ -1729,7 +1919,7 @@ static void account_for_uid(const struct sk_buff *skb,
 			 par->hooknum, el_dev->name, el_dev->type,
 			 par->family, proto);
 
-		if_tag_stat_update(el_dev->name, uid,
+		if_tag_stat_update(el_dev, uid,
 				skb->sk ? skb->sk : alternate_sk,
 				par->in ? IFS_RX : IFS_TX,
 				proto, skb->len);
@@ -2095,6 +2285,7 @@ static int ctrl_cmd_delete(const char *input)
 
 		if (!acct_tag || st_entry->tag == tag) {
 			rb_erase(&st_entry->sock_node, &sock_tag_tree);
+			hlist_del_rcu(&st_entry->hash_node);
 			/* Can't sockfd_put() within spinlock, do it later. */
 			sock_tag_tree_insert(st_entry, &st_to_free_tree);
 			tr_entry = lookup_tag_ref(st_entry->tag, NULL);
@@ -2127,7 +2318,8 @@ static int ctrl_cmd_delete(const char *input)
 			 get_uid_from_tag(tcs_entry->tn.tag),
 			 tcs_entry->active_set);
 		rb_erase(&tcs_entry->tn.node, &tag_counter_set_tree);
-		kfree(tcs_entry);
+		hlist_del_rcu(&tcs_entry->hash_node);
+		kfree_rcu(tcs_entry, rcu);
 	}
 	spin_unlock_bh(&tag_counter_set_list_lock);
 
@@ -2158,7 +2350,8 @@ static int ctrl_cmd_delete(const char *input)
 					 entry_uid);
 				rb_erase(&ts_entry->tn.node,
 					 &iface_entry->tag_stat_tree);
-				kfree(ts_entry);
+				hlist_del_rcu(&ts_entry->hash_node);
+				call_rcu(&ts_entry->rcu, tag_stat_free_rcu);
 			}
 		}
 		spin_unlock_bh(&iface_entry->tag_stat_list_lock);
@@ -2240,7 +2433,10 @@ static int ctrl_cmd_counter_set(const char *input)
 			goto err;
 		}
 		tcs->tn.tag = tag;
+		tcs->active_set = counter_set;
 		tag_counter_set_tree_insert(tcs, &tag_counter_set_tree);
+		hlist_add_head_rcu(&tcs->hash_node,
+				   tag_counter_set_hash_head(tag));
 		CT_DEBUG("qtaguid: ctrl_counterset(%s): added tcs tag=0x%llx "
 			 "(uid=%u) set=%d\n",
 			 input, tag, get_uid_from_tag(tag), counter_set);
@@ -2341,7 +2537,9 @@ static int ctrl_cmd_tag(const char *input)
 		BUG_ON(IS_ERR_OR_NULL(prev_tag_ref_entry));
 		BUG_ON(prev_tag_ref_entry->num_sock_tags <= 0);
 		prev_tag_ref_entry->num_sock_tags--;
+		write_seqcount_begin(&sock_tag_seq);
 		sock_tag_entry->tag = full_tag;
+		write_seqcount_end(&sock_tag_seq);
 	} else {
 		CT_DEBUG("qtaguid: ctrl_tag(%s): newtag for sk=%p\n",
 			 input, el_socket->sk);
@@ -2381,6 +2579,7 @@ static int ctrl_cmd_tag(const char *input)
 		spin_unlock_bh(&uid_tag_data_tree_lock);
 
 		sock_tag_tree_insert(sock_tag_entry, &sock_tag_tree);
+		sock_tag_hash_add(sock_tag_entry);
 		atomic64_inc(&qtu_events.sockets_tagged);
 	}
 	spin_unlock_bh(&sock_tag_list_lock);
@@ -2447,6 +2646,7 @@ static int ctrl_cmd_untag(const char *input)
 	 * so it can do whatever it wants to it.
 	 */
 	rb_erase(&sock_tag_entry->sock_node, &sock_tag_tree);
+	hlist_del_rcu(&sock_tag_entry->hash_node);
 
 	tag_ref_entry = lookup_tag_ref(sock_tag_entry->tag, &utd_entry);
 	BUG_ON(!tag_ref_entry);
@@ -2483,7 +2683,7 @@ static int ctrl_cmd_untag(const char *input)
 		 atomic_long_read(&el_socket->file->f_count) - 1);
 	sockfd_put(el_socket);
 
-	kfree(sock_tag_entry);
+	kfree_rcu(sock_tag_entry, rcu);
 	atomic64_inc(&qtu_events.sockets_untagged);
 
 	return 0;
@@ -2571,6 +2771,7 @@ static int pp_stats_line(struct proc_print_info *ppi, int cnt_set)
 {
 	int len;
 	struct data_counters *cnts;
+	struct data_counters folded_cnts;
 
 	if (!ppi->item_index) {
 		if (ppi->item_index++ < ppi->items_to_skip)
@@ -2600,7 +2801,8 @@ static int pp_stats_line(struct proc_print_info *ppi, int cnt_set)
 		}
 		if (ppi->item_index++ < ppi->items_to_skip)
 			return 0;
-		cnts = &ppi->ts_entry->counters;
+		tag_stat_fold_counters(ppi->ts_entry, &folded_cnts);
+		cnts = &folded_cnts;
 		len = snprintf(
 			ppi->outp, ppi->char_count,
 			"%d %s 0x%llx %u %u "
@@ -2848,6 +3050,7 @@ static int qtudev_release(struct inode *inode, struct file *file)
 		free_tag_ref_from_utd_entry(tr, utd_entry);
 
 		rb_erase(&st_entry->sock_node, &sock_tag_tree);
+		hlist_del_rcu(&st_entry->hash_node);
 		list_del(&st_entry->list);
 		/* Can't sockfd_put() within spinlock, do it later. */
 		sock_tag_tree_insert(st_entry, &st_to_free_tree);
@@ -11,8 +11,13 @@
 #define __XT_QTAGUID_INTERNAL_H__
 
 #include <linux/types.h>
+#include <linux/cpumask.h>
+#include <linux/list.h>
 #include <linux/rbtree.h>
+#include <linux/rcupdate.h>
 #include <linux/spinlock_types.h>
+#include <linux/string.h>
+#include <linux/u64_stats_sync.h>
 #include <linux/workqueue.h>
 
 /* Iface handling */
@@ -185,16 +190,39 @@ struct tag_node {
 	tag_t tag;
 };
 
+/*
+ * One cpu's share of a tag_stat's counters.
+ * The matching code only updates the slot of the cpu it runs on (with BHs
+ * off), so no lock is needed per packet. Readers fold all the slots with
+ * tag_stat_fold_counters().
+ */
+struct tag_stat_cpu {
+	struct data_counters counters;
+	struct u64_stats_sync syncp;
+} ____cacheline_aligned_in_smp;
+
 struct tag_stat {
 	struct tag_node tn;
-	struct data_counters counters;
+	/* in iface_stat.tag_stat_hash, walked under RCU by the matching */
+	struct hlist_node hash_node;
+	struct rcu_head rcu;
+	/* nr_cpu_ids entries */
+	struct tag_stat_cpu *cpu_stats;
 	/*
 	 * If this tag is acct_tag based, we need to count against the
 	 * matching parent uid_tag.
 	 */
-	struct data_counters *parent_counters;
+	struct tag_stat *parent;
 };
 
+/* Same as tag_stat_cpu, for the per iface totals_via_skb. */
+struct iface_stat_cpu {
+	struct byte_packet_counters totals_via_skb[IFS_MAX_DIRECTIONS];
+	struct u64_stats_sync syncp;
+} ____cacheline_aligned_in_smp;
+
+#define TAG_STAT_HASH_BITS 4
+
 struct iface_stat {
 	struct list_head list;  /* in iface_stat_list */
 	char *ifname;
@@ -202,8 +230,12 @@ struct iface_stat {
 	/* net_dev is only valid for active iface_stat */
 	struct net_device *net_dev;
 
+	/* in iface_stat_dev_hash while active */
+	struct hlist_node dev_node;
+
 	struct byte_packet_counters totals_via_dev[IFS_MAX_DIRECTIONS];
-	struct byte_packet_counters totals_via_skb[IFS_MAX_DIRECTIONS];
+	/* nr_cpu_ids entries, see iface_stat_fold_skb_totals() */
+	struct iface_stat_cpu *cpu_skb_totals;
 	/*
 	 * We keep the last_known, because some devices reset their counters
 	 * just before NETDEV_UP, while some will reset just before
@@ -219,6 +251,9 @@ struct iface_stat {
 	struct proc_dir_entry *proc_ptr;
 
 	struct rb_root tag_stat_tree;
+	/* Same entries as tag_stat_tree, for the lockless lookup by tag */
+	struct hlist_head tag_stat_hash[1 << TAG_STAT_HASH_BITS];
+	/* Protects tag_stat_tree and the writers of tag_stat_hash */
 	spinlock_t tag_stat_list_lock;
 };
 
@@ -236,6 +271,9 @@ struct iface_stat_work {
  */
 struct sock_tag {
 	struct rb_node sock_node;
+	/* in sock_tag_hash, walked under RCU by the matching */
+	struct hlist_node hash_node;
+	struct rcu_head rcu;
 	struct sock *sk;  /* Only used as a number, never dereferenced */
 	/* The socket is needed for sockfd_put() */
 	struct socket *socket;
@@ -281,6 +319,9 @@ struct qtaguid_event_counts {
 /* Track the set active_set for the given tag. */
 struct tag_counter_set {
 	struct tag_node tn;
+	/* in tag_counter_set_hash, walked under RCU by the matching */
+	struct hlist_node hash_node;
+	struct rcu_head rcu;
 	int active_set;
 };
 
@@ -329,5 +370,63 @@ struct proc_qtu_data {
 	/* No spinlock_t sock_tag_list_lock; use the global one. */
 };
 
+/*----------------------------------------------*/
+/*
+ * Sum up the per cpu counters of a tag_stat into dc.
+ * Can be called while the matching is updating them.
+ */
+static inline void tag_stat_fold_counters(const struct tag_stat *ts,
+					  struct data_counters *dc)
+{
+	int cpu, set, dir, proto;
+
+	memset(dc, 0, sizeof(*dc));
+	for_each_possible_cpu(cpu) {
+		const struct tag_stat_cpu *tsc = &ts->cpu_stats[cpu];
+		struct data_counters snap;
+		unsigned int start;
+
+		do {
+			start = u64_stats_fetch_begin_bh(&tsc->syncp);
+			snap = tsc->counters;
+		} while (u64_stats_fetch_retry_bh(&tsc->syncp, start));
+
+		for (set = 0; set < IFS_MAX_COUNTER_SETS; set++)
+			for (dir = 0; dir < IFS_MAX_DIRECTIONS; dir++)
+				for (proto = 0; proto < IFS_MAX_PROTOS;
+				     proto++) {
+					dc->bpc[set][dir][proto].bytes +=
+						snap.bpc[set][dir][proto].bytes;
+					dc->bpc[set][dir][proto].packets +=
+						snap.bpc[set][dir][proto].packets;
+				}
+	}
+}
+
+/* Sum up the per cpu totals_via_skb of an iface_stat. */
+static inline void iface_stat_fold_skb_totals(
+	const struct iface_stat *is,
+	struct byte_packet_counters totals[IFS_MAX_DIRECTIONS])
+{
+	int cpu, dir;
+
+	memset(totals, 0, sizeof(*totals) * IFS_MAX_DIRECTIONS);
+	for_each_possible_cpu(cpu) {
+		const struct iface_stat_cpu *isc = &is->cpu_skb_totals[cpu];
+		struct byte_packet_counters snap[IFS_MAX_DIRECTIONS];
+		unsigned int start;
+
+		do {
+			start = u64_stats_fetch_begin_bh(&isc->syncp);
+			memcpy(snap, isc->totals_via_skb, sizeof(snap));
+		} while (u64_stats_fetch_retry_bh(&isc->syncp, start));
+
+		for (dir = 0; dir < IFS_MAX_DIRECTIONS; dir++) {
+			totals[dir].bytes += snap[dir].bytes;
+			totals[dir].packets += snap[dir].packets;
+		}
+	}
+}
+
 /*----------------------------------------------*/
 #endif  /* ifndef __XT_QTAGUID_INTERNAL_H__ */
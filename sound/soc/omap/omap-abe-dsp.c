@@ -41,6 +41,8 @@
 #include <linux/wait.h>
 #include <linux/firmware.h>
 #include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
 #include <linux/opp.h>
 #ifdef CONFIG_OMAP4_DPLL_CASCADING
 #include <linux/earlysuspend.h>
@@ -56,6 +58,7 @@
 #include <sound/pcm_params.h>
 #include <sound/soc.h>
 #include <sound/soc-dapm.h>
+#include <sound/soc-dsp.h>
 #include <sound/initval.h>
 #include <sound/tlv.h>
 #include <sound/omap-abe-dsp.h>
@@ -79,6 +82,20 @@ static int abe_fe_event(struct snd_soc_dapm_widget *w,
 static bool abe_can_enter_dpll_cascading;     /* initialized to false by gcc */
 #endif
 
+/*
+ * OPP lowering is held off for this long after the last stream change so
+ * that short gaps (track changes, voice recognition restarts) do not bounce
+ * the ABE between OPPs. Raising is always immediate.
+ */
+static unsigned int opp_down_delay_ms = 500;
+module_param(opp_down_delay_ms, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(opp_down_delay_ms, "Delay before lowering the ABE OPP (ms)");
+
+/* mixer/gain writes keep the ABE powered this long to batch a route change */
+static int mixer_autosuspend_ms = 100;
+module_param(mixer_autosuspend_ms, int, S_IRUGO);
+MODULE_PARM_DESC(mixer_autosuspend_ms, "ABE autosuspend delay after mixer writes (ms)");
+
 static const char *abe_memory_bank[5] = {
 	"dmem",
 	"cmem",
@@ -165,6 +182,18 @@ struct abe_data {
 	struct list_head opp_req;
 	int opp_req_count;
 
+	/* OPP manager: running FE streams, their rate and BEs */
+	unsigned int fe_rate[ABE_FRONTEND_DAI_NUM][2];
+	u32 fe_be_mask[ABE_FRONTEND_DAI_NUM][2];
+	struct delayed_work opp_work;
+
+	/* OPP residency, last slot is "ABE idle" */
+	spinlock_t opp_stat_lock;
+	ktime_t opp_stamp;
+	u64 opp_residency[OMAP_ABE_OPP_COUNT + 1];
+	unsigned long opp_transitions;
+	unsigned long opp_down_deferred;
+
 	u16 router[16];
 
 	struct snd_pcm_substream *ping_pong_substream;
@@ -198,6 +227,7 @@ struct abe_data {
 	struct dentry *debugfs_circ;
 	struct dentry *debugfs_elem_bytes;
 	struct dentry *debugfs_opp_level;
+	struct dentry *debugfs_opp_stats;
 	char *dbg_buffer;
 	struct omap_pcm_dma_data *dma_data;
 	int dma_ch;
@@ -213,6 +243,7 @@ struct abe_data {
 static struct abe_data *the_abe;
 
 static int aess_set_runtime_opp_level(struct abe_data *abe);
+static void abe_opp_account(struct abe_data *abe);
 
 // TODO: map to the new version of HAL
 static unsigned int abe_dsp_read(struct snd_soc_platform *platform,
@@ -290,6 +321,7 @@ void abe_dsp_shutdown(void)
 
 	if (!the_abe->active && !abe_check_activity()) {
 		abe_set_opp_processing(ABE_OPP25);
+		abe_opp_account(the_abe);
 		the_abe->opp = 25;
 		abe_stop_event_generator();
 		udelay(250);
@@ -415,6 +447,17 @@ static DECLARE_TLV_DB_SCALE(btul_tlv, -12000, 100, 3000);
 /* AMIC volume control from -120 to 30 dB in 1 dB steps */
 static DECLARE_TLV_DB_SCALE(amic_tlv, -12000, 100, 3000);
 
+/*
+ * Mixer, gain and route controls arrive in bursts from the audio HAL on
+ * every route change. Let the ABE autosuspend after each write so that a
+ * burst costs a single runtime PM wakeup instead of one per control.
+ */
+static inline void abe_mixer_pm_put(struct abe_data *abe)
+{
+	pm_runtime_mark_last_busy(abe->dev);
+	pm_runtime_put_autosuspend(abe->dev);
+}
+
 //TODO: we have to use the shift value atm to represent register id due to current HAL
 static int dl1_put_mixer(struct snd_kcontrol *kcontrol,
 	struct snd_ctl_elem_value *ucontrol)
@@ -436,7 +479,7 @@ static int dl1_put_mixer(struct snd_kcontrol *kcontrol,
 		snd_soc_dapm_mixer_update_power(widget, kcontrol, 0);
 		abe_disable_gain(MIXDL1, mc->reg);
 	}
-	pm_runtime_put_sync(the_abe->dev);
+	abe_mixer_pm_put(the_abe);
 
 	return 1;
 }
@@ -462,7 +505,7 @@ static int dl2_put_mixer(struct snd_kcontrol *kcontrol,
 		abe_disable_gain(MIXDL2, mc->reg);
 	}
 
-	pm_runtime_put_sync(the_abe->dev);
+	abe_mixer_pm_put(the_abe);
 	return 1;
 }
 #endif
@@ -486,7 +529,7 @@ static int audio_ul_put_mixer(struct snd_kcontrol *kcontrol,
 		snd_soc_dapm_mixer_update_power(widget, kcontrol, 0);
 		abe_disable_gain(MIXAUDUL, mc->reg);
 	}
-	pm_runtime_put_sync(the_abe->dev);
+	abe_mixer_pm_put(the_abe);
 
 	return 1;
 }
@@ -510,7 +553,7 @@ static int vxrec_put_mixer(struct snd_kcontrol *kcontrol,
 		snd_soc_dapm_mixer_update_power(widget, kcontrol, 0);
 		abe_disable_gain(MIXVXREC, mc->reg);
 	}
-	pm_runtime_put_sync(the_abe->dev);
+	abe_mixer_pm_put(the_abe);
 
 	return 1;
 }
@@ -534,7 +577,7 @@ static int sdt_put_mixer(struct snd_kcontrol *kcontrol,
 		snd_soc_dapm_mixer_update_power(widget, kcontrol, 0);
 		abe_disable_gain(MIXSDT, mc->reg);
 	}
-	pm_runtime_put_sync(the_abe->dev);
+	abe_mixer_pm_put(the_abe);
 
 	return 1;
 }
@@ -571,7 +614,7 @@ static int abe_dsp_set_mono_mixer(int id, int enable)
 
 	pm_runtime_get_sync(the_abe->dev);
 	abe_mono_mixer(mixer, enable);
-	pm_runtime_put_sync(the_abe->dev);
+	abe_mixer_pm_put(the_abe);
 
 	return 0;
 }
@@ -621,11 +664,11 @@ static int ul_mux_put_route(struct snd_kcontrol *kcontrol,
 	int mux = ucontrol->value.enumerated.item[0];
 	int reg = e->reg - ABE_MUX(0);
 
-	pm_runtime_get_sync(the_abe->dev);
-
 	if (mux > ABE_ROUTES_UL)
 		return 0;
 
+	pm_runtime_get_sync(the_abe->dev);
+
 	// TODO: get all this via firmware
 	if (reg < 8) {
 		/* 0  .. 9   = MM_UL */
@@ -645,7 +688,7 @@ static int ul_mux_put_route(struct snd_kcontrol *kcontrol,
 		the_abe->widget_opp[e->reg] = 0;
 
 	snd_soc_dapm_mux_update_power(widget, kcontrol, 1, mux, e);
-	pm_runtime_put_sync(the_abe->dev);
+	abe_mixer_pm_put(the_abe);
 
 	return 1;
 }
@@ -695,7 +738,7 @@ static int abe_put_switch(struct snd_kcontrol *kcontrol,
 		the_abe->widget_opp[mc->shift] = ucontrol->value.integer.value[0];
 		snd_soc_dapm_mixer_update_power(widget, kcontrol, 0);
 	}
-	pm_runtime_put_sync(the_abe->dev);
+	abe_mixer_pm_put(the_abe);
 
 	return 1;
 }
@@ -711,7 +754,7 @@ static int volume_put_sdt_mixer(struct snd_kcontrol *kcontrol,
 
 	abe_write_mixer(MIXSDT, abe_val_to_gain(ucontrol->value.integer.value[0]),
 				RAMP_2MS, mc->reg);
-	pm_runtime_put_sync(the_abe->dev);
+	abe_mixer_pm_put(the_abe);
 
 	return 1;
 }
@@ -725,7 +768,7 @@ static int volume_put_audul_mixer(struct snd_kcontrol *kcontrol,
 	pm_runtime_get_sync(the_abe->dev);
 	abe_write_mixer(MIXAUDUL, abe_val_to_gain(ucontrol->value.integer.value[0]),
 				RAMP_2MS, mc->reg);
-	pm_runtime_put_sync(the_abe->dev);
+	abe_mixer_pm_put(the_abe);
 
 	return 1;
 }
@@ -739,7 +782,7 @@ static int volume_put_vxrec_mixer(struct snd_kcontrol *kcontrol,
 	pm_runtime_get_sync(the_abe->dev);
 	abe_write_mixer(MIXVXREC, abe_val_to_gain(ucontrol->value.integer.value[0]),
 				RAMP_2MS, mc->reg);
-	pm_runtime_put_sync(the_abe->dev);
+	abe_mixer_pm_put(the_abe);
 
 	return 1;
 }
@@ -753,7 +796,7 @@ static int volume_put_dl1_mixer(struct snd_kcontrol *kcontrol,
 	pm_runtime_get_sync(the_abe->dev);
 	abe_write_mixer(MIXDL1, abe_val_to_gain(ucontrol->value.integer.value[0]),
 				RAMP_2MS, mc->reg);
-	pm_runtime_put_sync(the_abe->dev);
+	abe_mixer_pm_put(the_abe);
 
 	return 1;
 }
@@ -768,7 +811,7 @@ static int volume_put_dl2_mixer(struct snd_kcontrol *kcontrol,
 	pm_runtime_get_sync(the_abe->dev);
 	abe_write_mixer(MIXDL2, abe_val_to_gain(ucontrol->value.integer.value[0]),
 				RAMP_2MS, mc->reg);
-	pm_runtime_put_sync(the_abe->dev);
+	abe_mixer_pm_put(the_abe);
 
 	return 1;
 }
@@ -787,7 +830,7 @@ static int volume_put_gain(struct snd_kcontrol *kcontrol,
 	abe_write_gain(mc->reg,
 		       -12000 + (ucontrol->value.integer.value[1] * 100),
 		       RAMP_2MS, mc->rshift);
-	pm_runtime_put_sync(the_abe->dev);
+	abe_mixer_pm_put(the_abe);
 
 	return 1;
 }
@@ -802,7 +845,7 @@ static int volume_get_dl1_mixer(struct snd_kcontrol *kcontrol,
 	pm_runtime_get_sync(the_abe->dev);
 	abe_read_mixer(MIXDL1, &val, mc->reg);
 	ucontrol->value.integer.value[0] = abe_gain_to_val(val);
-	pm_runtime_put_sync(the_abe->dev);
+	abe_mixer_pm_put(the_abe);
 
 	return 0;
 }
@@ -818,7 +861,7 @@ static int volume_get_dl2_mixer(struct snd_kcontrol *kcontrol,
 	pm_runtime_get_sync(the_abe->dev);
 	abe_read_mixer(MIXDL2, &val, mc->reg);
 	ucontrol->value.integer.value[0] = abe_gain_to_val(val);
-	pm_runtime_put_sync(the_abe->dev);
+	abe_mixer_pm_put(the_abe);
 
 	return 0;
 }
@@ -834,7 +877,7 @@ static int volume_get_audul_mixer(struct snd_kcontrol *kcontrol,
 	pm_runtime_get_sync(the_abe->dev);
 	abe_read_mixer(MIXAUDUL, &val, mc->reg);
 	ucontrol->value.integer.value[0] = abe_gain_to_val(val);
-	pm_runtime_put_sync(the_abe->dev);
+	abe_mixer_pm_put(the_abe);
 
 	return 0;
 }
@@ -849,7 +892,7 @@ static int volume_get_vxrec_mixer(struct snd_kcontrol *kcontrol,
 	pm_runtime_get_sync(the_abe->dev);
 	abe_read_mixer(MIXVXREC, &val, mc->reg);
 	ucontrol->value.integer.value[0] = abe_gain_to_val(val);
-	pm_runtime_put_sync(the_abe->dev);
+	abe_mixer_pm_put(the_abe);
 
 	return 0;
 }
@@ -864,7 +907,7 @@ static int volume_get_sdt_mixer(struct snd_kcontrol *kcontrol,
 	pm_runtime_get_sync(the_abe->dev);
 	abe_read_mixer(MIXSDT, &val, mc->reg);
 	ucontrol->value.integer.value[0] = abe_gain_to_val(val);
-	pm_runtime_put_sync(the_abe->dev);
+	abe_mixer_pm_put(the_abe);
 
 	return 0;
 }
@@ -881,7 +924,7 @@ static int volume_get_gain(struct snd_kcontrol *kcontrol,
 	ucontrol->value.integer.value[0] = abe_gain_to_val(val);
 	abe_read_gain(mc->reg, &val, mc->rshift);
 	ucontrol->value.integer.value[1] = abe_gain_to_val(val);
-	pm_runtime_put_sync(the_abe->dev);
+	abe_mixer_pm_put(the_abe);
 
 	return 0;
 }
@@ -905,7 +948,7 @@ static int abe_dsp_set_equalizer(unsigned int id, unsigned int profile)
 
 	pm_runtime_get_sync(the_abe->dev);
 	abe_write_equalizer(id + 1, &equ_params);
-	pm_runtime_put_sync(the_abe->dev);
+	abe_mixer_pm_put(the_abe);
 
 	return 0;
 }
@@ -1932,6 +1975,51 @@ static const struct file_operations abe_data_fops = {
 	.release = abe_release_data,
 };
 
+static int abe_opp_stats_show(struct seq_file *m, void *v)
+{
+	static const char *name[OMAP_ABE_OPP_COUNT + 1] = {
+		"OPP25", "OPP50", "OPP100", "idle",
+	};
+	struct abe_data *abe = m->private;
+	u64 residency[OMAP_ABE_OPP_COUNT + 1];
+	unsigned long transitions, deferred;
+	unsigned long flags;
+	int i;
+
+	abe_opp_account(abe);
+
+	spin_lock_irqsave(&abe->opp_stat_lock, flags);
+	memcpy(residency, abe->opp_residency, sizeof(residency));
+	transitions = abe->opp_transitions;
+	spin_unlock_irqrestore(&abe->opp_stat_lock, flags);
+
+	seq_printf(m, "current: %d%%\n", abe->opp);
+	for (i = 0; i <= OMAP_ABE_OPP_COUNT; i++) {
+		do_div(residency[i], NSEC_PER_MSEC);
+		seq_printf(m, "%-7s %llu ms\n", name[i],
+			   (unsigned long long)residency[i]);
+	}
+	seq_printf(m, "transitions: %lu\n", transitions);
+	mutex_lock(&abe->opp_mutex);
+	deferred = abe->opp_down_deferred;
+	mutex_unlock(&abe->opp_mutex);
+	seq_printf(m, "deferred lowerings: %lu\n", deferred);
+
+	return 0;
+}
+
+static int abe_opp_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, abe_opp_stats_show, inode->i_private);
+}
+
+static const struct file_operations abe_opp_stats_fops = {
+	.open = abe_opp_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static void abe_init_debugfs(struct abe_data *abe)
 {
 	abe->debugfs_root = debugfs_create_dir("omap4-abe", NULL);
@@ -1988,6 +2076,12 @@ static void abe_init_debugfs(struct abe_data *abe)
 	if (!abe->debugfs_opp_level)
 		printk(KERN_WARNING "ABE: Failed to create OPP level debugfs file\n");
 
+	abe->debugfs_opp_stats = debugfs_create_file("opp_stats", 0444,
+						 abe->debugfs_root,
+						 abe, &abe_opp_stats_fops);
+	if (!abe->debugfs_opp_stats)
+		printk(KERN_WARNING "ABE: Failed to create OPP stats debugfs file\n");
+
 	abe->dbg_buffer_msecs = 500;
 	init_waitqueue_head(&abe->wait);
 }
@@ -2113,6 +2207,7 @@ EXPORT_SYMBOL(abe_remove_opp_req);
 static int abe_set_opp_mode(struct abe_data *abe, int opp)
 {
 	struct omap4_abe_dsp_pdata *pdata = abe->abe_pdata;
+	unsigned long flags;
 	int ret = 0;
 
 	if (abe->opp > opp) {
@@ -2173,6 +2268,12 @@ static int abe_set_opp_mode(struct abe_data *abe, int opp)
 			break;
 		}
 	}
+	if (abe->opp != opp) {
+		abe_opp_account(abe);
+		spin_lock_irqsave(&abe->opp_stat_lock, flags);
+		abe->opp_transitions++;
+		spin_unlock_irqrestore(&abe->opp_stat_lock, flags);
+	}
 	abe->opp = opp;
 	dev_dbg(abe->dev, "new OPP level is %d\n", opp);
 
@@ -2183,34 +2284,221 @@ err_scale:
 	return ret;
 }
 
-static int aess_set_runtime_opp_level(struct abe_data *abe)
+/*
+ * OPP needed by each front-end stream (playback, capture) and by each
+ * back-end it is routed to. These follow the OPP levels the DAPM widgets
+ * have always carried: the DL1 path runs at OPP25, any uplink processing,
+ * voice or external port needs OPP50 and DL2/vibra or the 8-channel MM_UL
+ * need OPP100.
+ */
+static const int abe_fe_opp[ABE_FRONTEND_DAI_NUM][2] = {
+	[ABE_FRONTEND_DAI_MEDIA]		= { 25, 100 },
+	[ABE_FRONTEND_DAI_MEDIA_CAPTURE]	= { 0, 50 },
+	[ABE_FRONTEND_DAI_VOICE]		= { 50, 50 },
+	[ABE_FRONTEND_DAI_TONES]		= { 25, 0 },
+	[ABE_FRONTEND_DAI_VIBRA]		= { 100, 0 },
+	[ABE_FRONTEND_DAI_MODEM]		= { 50, 50 },
+	[ABE_FRONTEND_DAI_LP_MEDIA]		= { 25, 0 },
+};
+
+static const int abe_be_opp[OMAP_ABE_DAI_NUM] = {
+	[OMAP_ABE_DAI_PDM_UL]	= 50,
+	[OMAP_ABE_DAI_PDM_DL1]	= 25,
+	[OMAP_ABE_DAI_PDM_DL2]	= 100,
+	[OMAP_ABE_DAI_PDM_VIB]	= 100,
+	[OMAP_ABE_DAI_BT_VX]	= 50,
+	[OMAP_ABE_DAI_MM_FM]	= 50,
+	[OMAP_ABE_DAI_MODEM]	= 50,
+	[OMAP_ABE_DAI_DMIC0]	= 50,
+	[OMAP_ABE_DAI_DMIC1]	= 50,
+	[OMAP_ABE_DAI_DMIC2]	= 50,
+	[OMAP_ABE_DAI_VXREC]	= 50,
+};
+
+static int abe_opp_index(int opp)
 {
-	int i, req_opp, opp = 0;
+	switch (opp) {
+	case 25:
+		return OMAP_ABE_OPP25;
+	case 50:
+		return OMAP_ABE_OPP50;
+	case 100:
+		return OMAP_ABE_OPP100;
+	default:
+		return OMAP_ABE_OPP_COUNT;
+	}
+}
 
-	mutex_lock(&abe->opp_mutex);
+/* charge the time since the last change to the current OPP (or idle) */
+static void abe_opp_account(struct abe_data *abe)
+{
+	unsigned long flags;
+	ktime_t now = ktime_get();
+	int idx;
+
+	idx = abe->active ? abe_opp_index(abe->opp) : OMAP_ABE_OPP_COUNT;
+
+	spin_lock_irqsave(&abe->opp_stat_lock, flags);
+	abe->opp_residency[idx] += ktime_to_ns(ktime_sub(now, abe->opp_stamp));
+	abe->opp_stamp = now;
+	spin_unlock_irqrestore(&abe->opp_stat_lock, flags);
+}
+
+/* OPP required by the running streams, called with opp_mutex held */
+static int abe_opp_required(struct abe_data *abe)
+{
+	int fe, stream, be, opp = 25;
 
-	/* now calculate OPP level based upon DAPM widget status */
-	for (i = 0; i < ABE_NUM_WIDGETS; i++) {
-		if (abe->widget_opp[ABE_WIDGET(i)]) {
-			dev_dbg(abe->dev, "OPP: id %d = %d%%\n", i,
-					abe->widget_opp[ABE_WIDGET(i)] * 25);
-			opp |= abe->widget_opp[ABE_WIDGET(i)];
+	for (fe = 0; fe < ABE_FRONTEND_DAI_NUM; fe++) {
+		for (stream = 0; stream < 2; stream++) {
+			unsigned int rate = abe->fe_rate[fe][stream];
+			u32 mask = abe->fe_be_mask[fe][stream];
+
+			if (!rate)
+				continue;
+
+			/* above 48kHz the ABE runs twice per tick */
+			if (rate > 48000)
+				opp = 100;
+
+			opp = max(opp, abe_fe_opp[fe][stream]);
+			for (be = 0; be < OMAP_ABE_DAI_NUM; be++)
+				if (mask & (1 << be))
+					opp = max(opp, abe_be_opp[be]);
 		}
 	}
-	opp = (1 << (fls(opp) - 1)) * 25;
 
 	/* opps requested outside ABE DSP driver (e.g. McPDM) */
-	req_opp = abe_get_opp_req(abe);
+	return max(opp, abe_get_opp_req(abe));
+}
 
-	pm_runtime_get_sync(abe->dev);
-	abe_set_opp_mode(abe, max(opp, req_opp));
-	pm_runtime_put_sync(abe->dev);
+static void abe_opp_update(struct abe_data *abe, bool defer_down)
+{
+	int opp;
+
+	mutex_lock(&abe->opp_mutex);
+
+	if (!abe->active)
+		goto out;
+
+	opp = abe_opp_required(abe);
+	if (opp < abe->opp && defer_down && opp_down_delay_ms) {
+		/* a running lowering keeps its original deadline */
+		if (!delayed_work_pending(&abe->opp_work)) {
+			abe->opp_down_deferred++;
+			schedule_delayed_work(&abe->opp_work,
+					msecs_to_jiffies(opp_down_delay_ms));
+		}
+		goto out;
+	}
+
+	/* raising (or settling) supersedes any pending lowering */
+	cancel_delayed_work(&abe->opp_work);
+	if (opp != abe->opp) {
+		pm_runtime_get_sync(abe->dev);
+		abe_set_opp_mode(abe, opp);
+		pm_runtime_put_sync(abe->dev);
+	}
 
+out:
 	mutex_unlock(&abe->opp_mutex);
+}
+
+static void abe_opp_work(struct work_struct *work)
+{
+	struct abe_data *abe = container_of(work, struct abe_data,
+					    opp_work.work);
+
+	abe_opp_update(abe, false);
+}
 
+static int aess_set_runtime_opp_level(struct abe_data *abe)
+{
+	abe_opp_update(abe, true);
 	return 0;
 }
 
+/*
+ * Called by the ABE DAI driver when a front-end stream is configured:
+ * rate is the FE sample rate and be_mask has a bit per OMAP_ABE_DAI_*
+ * back-end it is routed to. Raises the OPP right away if needed.
+ */
+void abe_dsp_opp_stream_start(int fe_id, int stream, unsigned int rate,
+		u32 be_mask)
+{
+	if (the_abe == NULL || fe_id >= ABE_FRONTEND_DAI_NUM)
+		return;
+
+	mutex_lock(&the_abe->opp_mutex);
+	the_abe->fe_rate[fe_id][stream] = rate;
+	the_abe->fe_be_mask[fe_id][stream] = be_mask;
+	mutex_unlock(&the_abe->opp_mutex);
+
+	abe_opp_update(the_abe, true);
+}
+EXPORT_SYMBOL_GPL(abe_dsp_opp_stream_start);
+
+void abe_dsp_opp_stream_stop(int fe_id, int stream)
+{
+	if (the_abe == NULL || fe_id >= ABE_FRONTEND_DAI_NUM)
+		return;
+
+	mutex_lock(&the_abe->opp_mutex);
+	if (!the_abe->fe_rate[fe_id][stream]) {
+		mutex_unlock(&the_abe->opp_mutex);
+		return;
+	}
+	the_abe->fe_rate[fe_id][stream] = 0;
+	the_abe->fe_be_mask[fe_id][stream] = 0;
+	mutex_unlock(&the_abe->opp_mutex);
+
+	abe_opp_update(the_abe, true);
+}
+EXPORT_SYMBOL_GPL(abe_dsp_opp_stream_stop);
+
+/*
+ * Re-read the BEs of every running FE from the DSP routes. A runtime
+ * update (mixer change) connects or prunes BEs of a running FE without a
+ * new hw_params, but always runs the DAPM stream event before the new BEs
+ * are triggered and after the old ones are stopped. BEs being pruned are
+ * not counted. Called from the stream event with the card dsp_mutex held.
+ */
+static void abe_opp_refresh_routes(struct abe_data *abe,
+		struct snd_soc_card *card)
+{
+	struct snd_soc_dsp_params *dsp_params;
+	int i, fe_id, stream;
+	u32 mask;
+
+	mutex_lock(&abe->opp_mutex);
+	for (i = 0; i < card->num_rtd; i++) {
+		struct snd_soc_pcm_runtime *fe = &card->rtd[i];
+
+		if (!fe->dai_link->dsp_link)
+			continue;
+
+		fe_id = fe->cpu_dai->id;
+		if (fe_id >= ABE_FRONTEND_DAI_NUM)
+			continue;
+
+		for (stream = 0; stream < 2; stream++) {
+			if (!abe->fe_rate[fe_id][stream])
+				continue;
+
+			mask = 0;
+			list_for_each_entry(dsp_params,
+					&fe->dsp[stream].be_clients, list_be) {
+				if (dsp_params->state ==
+						SND_SOC_DSP_LINK_STATE_FREE)
+					continue;
+				mask |= 1 << dsp_params->be->dai_link->be_id;
+			}
+			abe->fe_be_mask[fe_id][stream] = mask;
+		}
+	}
+	mutex_unlock(&abe->opp_mutex);
+}
+
 #ifdef CONFIG_OMAP4_DPLL_CASCADING
 static int abe_fe_active_count(struct abe_data *abe)
 {
@@ -2402,11 +2690,13 @@ static int aess_open(struct snd_pcm_substream *substream)
 
 	pm_runtime_get_sync(abe->dev);
 
-	if (!abe->active++) {
+	if (!abe->active) {
+		abe_opp_account(abe);
 		abe->opp = 0;
 		aess_restore_context(abe);
 		abe_wakeup();
 	}
+	abe->active++;
 
 	switch (dai->id) {
 	case ABE_FRONTEND_DAI_MODEM:
@@ -2504,7 +2794,10 @@ static int aess_close(struct snd_pcm_substream *substream)
 
 	dev_dbg(dai->dev, "%s: %s\n", __func__, dai->name);
 
+	if (abe->active == 1)
+		abe_opp_account(abe);
 	if (!--abe->active) {
+		cancel_delayed_work_sync(&abe->opp_work);
 		abe_disable_irq();
 		aess_save_context(abe);
 		abe_dsp_shutdown();
@@ -2576,8 +2869,10 @@ static int aess_stream_event(struct snd_soc_dapm_context *dapm)
 	struct snd_soc_platform *platform = dapm->platform;
 	struct abe_data *abe = snd_soc_platform_get_drvdata(platform);
 
-	if (abe->active)
+	if (abe->active) {
+		abe_opp_refresh_routes(abe, platform->card);
 		aess_set_runtime_opp_level(abe);
+	}
 
 #ifdef CONFIG_OMAP4_DPLL_CASCADING
 	/*
@@ -2812,6 +3107,8 @@ static int abe_probe(struct snd_soc_platform *platform)
 
 	pm_runtime_enable(abe->dev);
 	pm_runtime_irq_safe(abe->dev);
+	pm_runtime_set_autosuspend_delay(abe->dev, mixer_autosuspend_ms);
+	pm_runtime_use_autosuspend(abe->dev);
 
 #if defined(CONFIG_SND_OMAP_SOC_ABE_DSP_MODULE)
 	/* request firmware & coefficients */
@@ -2997,6 +3294,7 @@ static int abe_remove(struct snd_soc_platform *platform)
 	struct abe_data *abe = snd_soc_platform_get_drvdata(platform);
 	int i;
 
+	cancel_delayed_work_sync(&abe->opp_work);
 	free_irq(abe->irq, (void *)abe);
 
 	for (i = 0; i < abe->hdr.num_equ; i++)
@@ -3006,6 +3304,7 @@ static int abe_remove(struct snd_soc_platform *platform)
 	kfree(abe->equ_texts);
 	kfree(abe->firmware);
 
+	pm_runtime_dont_use_autosuspend(abe->dev);
 	pm_runtime_disable(abe->dev);
 
 	return 0;
@@ -3108,6 +3407,10 @@ static int __devinit abe_engine_probe(struct platform_device *pdev)
 	INIT_LIST_HEAD(&abe->opp_req);
 	abe->opp_req_count = 0;
 
+	INIT_DELAYED_WORK(&abe->opp_work, abe_opp_work);
+	spin_lock_init(&abe->opp_stat_lock);
+	abe->opp_stamp = ktime_get();
+
 	ret = snd_soc_register_platform(abe->dev,
 			&omap_aess_platform);
 
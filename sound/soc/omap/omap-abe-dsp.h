@@ -173,6 +173,9 @@ void abe_dsp_pm_get(void);
 void abe_dsp_pm_put(void);
 int abe_add_opp_req(struct device *dev, int opp);
 int abe_remove_opp_req(struct device *dev);
+void abe_dsp_opp_stream_start(int fe_id, int stream, unsigned int rate,
+		u32 be_mask);
+void abe_dsp_opp_stream_stop(int fe_id, int stream);
 void abe_dsp_set_power_mode(int mode);
 void abe_dsp_set_hs_offset(int left, int right, int mult);
 void abe_dsp_set_hf_offset(int left, int right);
@@ -980,6 +980,24 @@ static int omap_abe_dai_startup(struct snd_pcm_substream *substream,
 	return ret;
 }
 
+/* OMAP_ABE_DAI_* back-ends this front-end stream is currently routed to */
+static u32 omap_abe_fe_be_mask(struct snd_pcm_substream *substream)
+{
+	struct snd_soc_pcm_runtime *fe = substream->private_data;
+	struct snd_soc_dsp_params *dsp_params;
+	u32 mask = 0;
+
+	list_for_each_entry(dsp_params,
+			&fe->dsp[substream->stream].be_clients, list_be) {
+		/* BEs being pruned by a runtime update no longer count */
+		if (dsp_params->state == SND_SOC_DSP_LINK_STATE_FREE)
+			continue;
+		mask |= 1 << dsp_params->be->dai_link->be_id;
+	}
+
+	return mask;
+}
+
 static int omap_abe_dai_hw_params(struct snd_pcm_substream *substream,
 			struct snd_pcm_hw_params *params,
 			struct snd_soc_dai *dai)
@@ -1034,6 +1052,10 @@ static int omap_abe_dai_hw_params(struct snd_pcm_substream *substream,
 
 	format.f = params_rate(params);
 
+	/* let the OPP manager see the stream before any data flows */
+	abe_dsp_opp_stream_start(dai->id, substream->stream, format.f,
+			omap_abe_fe_be_mask(substream));
+
 	switch (dai->id) {
 	case ABE_FRONTEND_DAI_MEDIA:
 		if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK) {
@@ -1213,6 +1235,8 @@ static int omap_abe_dai_hw_free(struct snd_pcm_substream *substream,
 
 	dev_dbg(dai->dev, "%s: %s\n", __func__, dai->name);
 
+	abe_dsp_opp_stream_stop(dai->id, substream->stream);
+
 	if (dai->id == ABE_FRONTEND_DAI_MODEM) {
 
 		dev_dbg(abe_priv->modem_dai->dev, "%s: MODEM stream %d\n",
@@ -1243,6 +1267,7 @@ static void omap_abe_dai_shutdown(struct snd_pcm_substream *substream,
 				abe_priv->modem_dai);
 	}
 
+	abe_dsp_opp_stream_stop(dai->id, substream->stream);
 	abe_dsp_shutdown();
 	abe_dsp_pm_put();
 
@@ -22,6 +22,8 @@
  *
  */
 
+#include <linux/module.h>
+#include <linux/moduleparam.h>
 #include <linux/dma-mapping.h>
 #include <linux/slab.h>
 #include <sound/core.h>
@@ -48,13 +50,64 @@ static const struct snd_pcm_hardware omap_pcm_hardware = {
 	.buffer_bytes_max	= 128 * 1024,
 };
 
+/*
+ * Deep buffer mode: streams may ask for a ring larger than the preallocated
+ * buffer, up to deep_buffer_kb. The ring is allocated at hw_params time and
+ * still played by a single self-linked sDMA channel, whose element and
+ * frame counters cover several seconds of audio. Combined with
+ * SNDRV_PCM_INFO_NO_PERIOD_WAKEUP and the DMA position based pointer this
+ * lets screen-off playback and background capture run without any period
+ * interrupt.
+ */
+static unsigned int deep_buffer_kb = 512;
+module_param(deep_buffer_kb, uint, S_IRUGO);
+MODULE_PARM_DESC(deep_buffer_kb, "Largest deep buffer ring in KB (0: off)");
+
 struct omap_runtime_data {
 	spinlock_t			lock;
 	struct omap_pcm_dma_data	*dma_data;
 	int				dma_ch;
 	int				period_index;
+	struct snd_dma_buffer		deep_buf;
 };
 
+static void omap_pcm_free_deep_buffer(struct snd_pcm_substream *substream)
+{
+	struct omap_runtime_data *prtd = substream->runtime->private_data;
+	struct snd_dma_buffer *buf = &prtd->deep_buf;
+
+	if (!buf->area)
+		return;
+
+	dma_free_writecombine(substream->pcm->card->dev, buf->bytes,
+			      buf->area, buf->addr);
+	buf->area = NULL;
+	buf->bytes = 0;
+}
+
+static int omap_pcm_alloc_deep_buffer(struct snd_pcm_substream *substream,
+				      size_t size)
+{
+	struct omap_runtime_data *prtd = substream->runtime->private_data;
+	struct snd_dma_buffer *buf = &prtd->deep_buf;
+
+	if (buf->area && buf->bytes == size)
+		return 0;
+
+	omap_pcm_free_deep_buffer(substream);
+
+	buf->dev.type = SNDRV_DMA_TYPE_DEV;
+	buf->dev.dev = substream->pcm->card->dev;
+	buf->private_data = NULL;
+	buf->area = dma_alloc_writecombine(substream->pcm->card->dev, size,
+					   &buf->addr, GFP_KERNEL);
+	if (!buf->area)
+		return -ENOMEM;
+
+	buf->bytes = size;
+	return 0;
+}
+
 static void omap_pcm_dma_irq(int ch, u16 stat, void *data)
 {
 	struct snd_pcm_substream *substream = data;
@@ -102,6 +155,7 @@ static int omap_pcm_hw_params(struct snd_pcm_substream *substream,
 	struct snd_soc_pcm_runtime *rtd = substream->private_data;
 	struct omap_runtime_data *prtd = runtime->private_data;
 	struct omap_pcm_dma_data *dma_data;
+	size_t size = params_buffer_bytes(params);
 
 	int err = 0;
 
@@ -112,8 +166,17 @@ static int omap_pcm_hw_params(struct snd_pcm_substream *substream,
 	if (!dma_data)
 		return 0;
 
-	snd_pcm_set_runtime_buffer(substream, &substream->dma_buffer);
-	runtime->dma_bytes = params_buffer_bytes(params);
+	if (size > substream->dma_buffer.bytes) {
+		/* deep buffer, the ring does not fit the preallocated one */
+		err = omap_pcm_alloc_deep_buffer(substream, size);
+		if (err)
+			return err;
+		snd_pcm_set_runtime_buffer(substream, &prtd->deep_buf);
+	} else {
+		omap_pcm_free_deep_buffer(substream);
+		snd_pcm_set_runtime_buffer(substream, &substream->dma_buffer);
+	}
+	runtime->dma_bytes = size;
 
 	if (prtd->dma_data)
 		return 0;
@@ -144,6 +207,7 @@ static int omap_pcm_hw_free(struct snd_pcm_substream *substream)
 	prtd->dma_data = NULL;
 
 	snd_pcm_set_runtime_buffer(substream, NULL);
+	omap_pcm_free_deep_buffer(substream);
 
 	return 0;
 }
@@ -288,6 +352,13 @@ static int omap_pcm_open(struct snd_pcm_substream *substream)
 
 	snd_soc_set_runtime_hwparams(substream, &omap_pcm_hardware);
 
+	if (deep_buffer_kb * 1024 > omap_pcm_hardware.buffer_bytes_max &&
+	    !cpu_class_is_omap1()) {
+		runtime->hw.buffer_bytes_max = deep_buffer_kb * 1024;
+		runtime->hw.period_bytes_max = runtime->hw.buffer_bytes_max /
+					       runtime->hw.periods_min;
+	}
+
 	/* Ensure that buffer size is a multiple of period size */
 	ret = snd_pcm_hw_constraint_integer(runtime,
 					    SNDRV_PCM_HW_PARAM_PERIODS);
@@ -310,6 +381,7 @@ static int omap_pcm_close(struct snd_pcm_substream *substream)
 {
 	struct snd_pcm_runtime *runtime = substream->runtime;
 
+	omap_pcm_free_deep_buffer(substream);
 	kfree(runtime->private_data);
 	return 0;
 }